@@ -8,6 +8,7 @@
 import struct
 import weakref
 from functools import wraps
+from contextlib import ExitStack
 from gevent import socket, select
 from gevent import lock
 from gevent import queue
@@ -18,6 +19,8 @@ import numpy
 from .exceptions import CommunicationError, CommunicationTimeout
 from ..common.greenlet_utils import KillMask, protect_from_kill
 from . import serial
+from . import modbus_codec
+from .ringbuffer import RingBuffer
 
 from bliss.common.logtools import *
 from bliss import global_map
@@ -487,18 +490,83 @@ class ModbusTcp:
     @try_connect_modbustcp
     def read_coils(self, address, nb_coils, timeout=None):
         log_debug_data(self, "read_coils", {"address": address, "num": nb_coils})
-        timeout_errmsg = "timeout on read_coils tcp (%s, %d)" % (self._host, self._port)
-        nb_bytes = ((nb_coils + 7) & ~7) // 8
-        struct_format = "%dB" % nb_bytes
-        result = self._read(
-            0x01, address, nb_coils, struct_format, timeout_errmsg, timeout
+        return self.read_blocks([(0x01, address, nb_coils)], timeout=timeout)[0]
+
+    ##@brief read several ranges of coils or registers in one round trip
+    @try_connect_modbustcp
+    def read_blocks(self, requests, timeout=None):
+        """
+        requests is a list of (function code, address, count), with the
+        function codes 0x01 (coils), 0x02 (discrete inputs), 0x03 (holding
+        registers) or 0x04 (input registers).
+
+        The contiguous and overlapping ranges of a function are read
+        together (see modbus_codec.merge_ranges), all the requests are
+        sent at once, each with its own transaction id.
+
+        Return a numpy array per request: uint8 (0 or 1) for the coils and
+        discrete inputs, uint16 for the registers.
+        """
+        log_debug_data(self, "read_blocks", {"requests": requests})
+        if not requests:
+            return []
+        timeout_errmsg = "timeout on read_blocks modbus tcp (%s, %d)" % (
+            self._host,
+            self._port,
         )
-        if isinstance(result, tuple):
-            result = [int("{0:08b}".format(x)[::-1], 2) for x in result]
-        else:
-            result = int("{0:08b}".format(result)[::-1], 2)
-        a = numpy.array(result, dtype=numpy.uint8)
-        return numpy.unpackbits(a)[:nb_coils]
+        spans, blocks, placements = modbus_codec.merge_ranges(requests)
+        arrays = [
+            numpy.empty(
+                count,
+                numpy.uint16
+                if func_code in modbus_codec.REGISTER_FUNCTIONS
+                else numpy.uint8,
+            )
+            for func_code, _, count in spans
+        ]
+        with ExitStack() as transactions:
+            tids = [
+                transactions.enter_context(self.Transaction(self)).tid()
+                for _ in blocks
+            ]
+            with gevent.Timeout(
+                timeout or self._timeout, ModbusTimeout(timeout_errmsg)
+            ):
+                full_msg = modbus_codec.pack_reads(
+                    tids, self._unit, [request for request, _ in blocks]
+                )
+                log_debug_data(self, "raw_write", full_msg)
+                with self._lock:
+                    self._fd.sendall(full_msg)
+                for tid, ((func_code, address, count), (index, offset)) in zip(
+                    tids, blocks
+                ):
+                    read_values = self._transaction[tid].get()
+                    if isinstance(read_values, socket.error):
+                        raise read_values
+                    uid, f_code, msg = read_values
+                    if f_code != func_code:  # Error
+                        raise ModbusError(
+                            "Error expecting func code %s instead of %s"
+                            % (func_code, _error_code(msg))
+                        )
+                    out = arrays[index][offset : offset + count]
+                    if func_code in modbus_codec.REGISTER_FUNCTIONS:
+                        nb_bytes = 2 * count
+                    else:
+                        nb_bytes = (count + 7) // 8
+                    if msg[:1] != bytes([nb_bytes]) or len(msg) != nb_bytes + 1:
+                        raise ModbusError(
+                            "Wrong answer size for %d values at %d" % (count, address)
+                        )
+                    if func_code in modbus_codec.REGISTER_FUNCTIONS:
+                        modbus_codec.decode_registers(msg[1:], out)
+                    else:
+                        modbus_codec.decode_bits(msg[1:], count, out)
+        return [
+            arrays[index][offset : offset + count]
+            for (index, offset), (_, _, count) in zip(placements, requests)
+        ]
 
     @try_connect_modbustcp
     def write_coil(self, address, on_off, timeout=None):
@@ -623,29 +691,33 @@ class ModbusTcp:
 
     @staticmethod
     def _raw_read(modbus, fd):
-        data = b""
+        buffer = RingBuffer()
 
         try:
             while 1:
-                raw_data = fd.recv(16 * 1024)
-                if raw_data:
-                    data += raw_data
-                    while len(data) > 7:
-                        log_debug_data(modbus, "raw_read", data[:7])
-                        tid, pid, length, uid = struct.unpack(">HHHB", data[:7])
-                        if len(data) >= length + 6:  # new msg
-                            func_code = data[7]
-                            end_msg = 8 + length - 2
-                            msg = data[8:end_msg]
-                            data = data[end_msg:]
-                            transaction = modbus._transaction.get(tid)
-                            if transaction:
-                                transaction.put((uid, func_code, msg))
-                        else:
-                            break
-                else:
+                nbytes = fd.recv_into(buffer.reserve(16 * 1024))
+                if not nbytes:
                     break
-        except socket.error:
+                buffer.commit(nbytes)
+                while buffer:
+                    view = buffer.peek()
+                    # all the answers received, pipelined requests come together
+                    frames, consumed = modbus_codec.scan(view)
+                    for tid, uid, func_code, offset, size in frames:
+                        msg = bytes(view[offset : offset + size])
+                        log_debug_data(modbus, "raw_read", msg)
+                        transaction = modbus._transaction.get(tid)
+                        if transaction:
+                            transaction.put((uid, func_code, msg))
+                    if consumed:
+                        buffer.consume(consumed)
+                    elif len(view) < len(buffer):
+                        # the message wraps at the end of the ring
+                        buffer.write(buffer.read())
+                    else:
+                        break
+        except (socket.error, ValueError):
+            # ValueError: not a modbus tcp stream
             pass
         finally:
             fd.close()
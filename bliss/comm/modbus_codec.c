@@ -0,0 +1,97 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "modbus_codec.h"
+
+/* MBAP header */
+#define HEADER_SIZE 7
+/* largest length field: unit id, function code and 252 bytes of data */
+#define MAX_LENGTH 254
+
+static inline uint16_t _be16(const unsigned char *buf)
+{
+  return (uint16_t)((buf[0] << 8) | buf[1]);
+}
+
+static inline void _put_be16(unsigned char *buf,uint16_t value)
+{
+  buf[0] = value >> 8;
+  buf[1] = value & 0xff;
+}
+
+int modbus_codec_abi_version(void)
+{
+  return MODBUS_CODEC_ABI_VERSION;
+}
+
+void modbus_codec_pack_reads(unsigned char *dst,const unsigned short *tids,
+			     unsigned char unit,const unsigned char *funcs,
+			     const unsigned short *addresses,
+			     const unsigned short *counts,int nb)
+{
+  int i;
+  for(i = 0;i < nb;++i,dst += MODBUS_CODEC_READ_SIZE)
+    {
+      _put_be16(dst,tids[i]);
+      _put_be16(dst + 2,0);	/* protocol id */
+      _put_be16(dst + 4,6);	/* unit id, function code, address, count */
+      dst[6] = unit;
+      dst[7] = funcs[i];
+      _put_be16(dst + 8,addresses[i]);
+      _put_be16(dst + 10,counts[i]);
+    }
+}
+
+int modbus_codec_scan(const unsigned char *buf,size_t len,modbus_codec_frame *frames,
+		      int max,size_t *consumed)
+{
+  size_t anOffset = 0;
+  int nb = 0;
+
+  while(nb < max && len - anOffset >= HEADER_SIZE + 1)
+    {
+      const unsigned char *aHeader = buf + anOffset;
+      uint16_t aLength = _be16(aHeader + 4);
+      if(_be16(aHeader + 2) != 0 || aLength < 2 || aLength > MAX_LENGTH)
+	{
+	  if(!nb)
+	    return -1;
+	  break;
+	}
+      /* the length counts the unit id */
+      if(len - anOffset < (size_t)HEADER_SIZE - 1 + aLength)
+	break;
+      frames[nb].tid = _be16(aHeader);
+      frames[nb].unit = aHeader[6];
+      frames[nb].func = aHeader[7];
+      frames[nb].offset = anOffset + HEADER_SIZE + 1;
+      frames[nb].size = aLength - 2;
+      anOffset += HEADER_SIZE - 1 + aLength;
+      ++nb;
+    }
+  *consumed = anOffset;
+  return nb;
+}
+
+void modbus_codec_decode_registers(const unsigned char *src,size_t nb,
+				   unsigned short *dst)
+{
+  size_t i;
+  for(i = 0;i < nb;++i)
+    dst[i] = _be16(src + 2 * i);
+}
+
+void modbus_codec_decode_bits(const unsigned char *src,size_t nb,
+			      unsigned char *dst)
+{
+  size_t i;
+  for(i = 0;i < nb;++i)
+    dst[i] = (src[i >> 3] >> (i & 7)) & 1;
+}
@@ -0,0 +1,77 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Modbus/TCP framing and register decoding (bliss/comm/modbus_codec.py).
+ *
+ * A Modbus/TCP message (ADU) is a 7 bytes MBAP header (transaction id,
+ * protocol id, length, unit id) followed by the function code and its
+ * data. modbus_codec_pack_reads() encodes a batch of read requests in
+ * one buffer, each with its own transaction id, so they are sent
+ * together and answered while the next ones are in flight.
+ * modbus_codec_scan() locates all the complete answers of a receive
+ * buffer in one call, the register and coil data is then decoded
+ * straight into numpy arrays.
+ *
+ * The part between the CFFI markers is read by cffi (comm/modbus_codec.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __MODBUS_CODEC
+#define __MODBUS_CODEC
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {MODBUS_CODEC_ABI_VERSION = 1};
+
+/* size of a read request: MBAP header, function code, address, count */
+enum {MODBUS_CODEC_READ_SIZE = 12};
+
+typedef struct
+{
+  unsigned short tid;		/* transaction id */
+  unsigned char unit;
+  unsigned char func;		/* function code, with 0x80 for an exception */
+  size_t offset;		/* of the data after the function code */
+  size_t size;			/* of the data */
+} modbus_codec_frame;
+
+int modbus_codec_abi_version(void);
+
+/* encode nb read requests (function code, start address, quantity) with
+ * the transaction ids tids into dst (nb * MODBUS_CODEC_READ_SIZE bytes)
+ */
+void modbus_codec_pack_reads(unsigned char *dst,const unsigned short *tids,
+			     unsigned char unit,const unsigned char *funcs,
+			     const unsigned short *addresses,
+			     const unsigned short *counts,int nb);
+
+/* locate up to max complete messages from the start of buf: the number
+ * of messages, *consumed their total size. -1 if the first header is
+ * invalid (protocol id or length), an invalid header after complete
+ * messages stops the scan.
+ */
+int modbus_codec_scan(const unsigned char *buf,size_t len,modbus_codec_frame *frames,
+		      int max,size_t *consumed);
+
+/* nb big endian registers of src to host order */
+void modbus_codec_decode_registers(const unsigned char *src,size_t nb,
+				   unsigned short *dst);
+
+/* nb coils or discrete inputs packed in src, first one in the least
+ * significant bit, to one 0 or 1 byte each
+ */
+void modbus_codec_decode_bits(const unsigned char *src,size_t nb,
+			      unsigned char *dst);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
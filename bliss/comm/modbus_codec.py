@@ -0,0 +1,187 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Modbus/TCP framing and register decoding (see modbus_codec.h).
+
+:func:`merge_ranges` batches read requests: the contiguous and
+overlapping ranges of a function are read together, split in blocks
+within the Modbus limits. :func:`pack_reads` encodes the blocks in one
+buffer with a transaction id each (pipelined requests), :func:`scan`
+splits the received answers and :func:`decode_registers` and
+:func:`decode_bits` decode their data into numpy arrays.
+
+The native library is used when it is found, in this order:
+
+- the path given by the ``BLISS_MODBUS_CODEC_LIBRARY`` environment variable
+- the ``_modbus_codec`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_COMM_MODBUS_CODEC``) next to this file
+
+otherwise struct and numpy.
+"""
+
+import struct
+
+import numpy
+
+from . import native
+
+ffi, lib = native.load(__file__, "modbus_codec", "BLISS_MODBUS_CODEC_LIBRARY")
+
+# read functions: coils and discrete inputs, holding and input registers
+BIT_FUNCTIONS = (0x01, 0x02)
+REGISTER_FUNCTIONS = (0x03, 0x04)
+
+# largest quantity of a read request
+MAX_BITS = 2000
+MAX_REGISTERS = 125
+
+READ_SIZE = 12
+_READ = struct.Struct(">HHHBBHH")
+_HEADER = struct.Struct(">HHHBB")
+
+
+def _max_count(func):
+    if func in REGISTER_FUNCTIONS:
+        return MAX_REGISTERS
+    if func in BIT_FUNCTIONS:
+        return MAX_BITS
+    raise ValueError("not a modbus read function: %r" % (func,))
+
+
+def merge_ranges(requests):
+    """Batch read requests, a list of (function code, address, count).
+
+    Return (spans, blocks, placements):
+
+    - spans, the merged (function code, address, count) ranges
+    - blocks, the (function code, address, count) requests reading them,
+      within the Modbus limits, and the (span index, offset) of each
+    - placements, the (span index, offset) of each request
+    """
+    spans = []
+    placements = [None] * len(requests)
+    order = sorted(range(len(requests)), key=lambda i: requests[i][:2])
+    for i in order:
+        func, address, count = requests[i]
+        _max_count(func)
+        if count < 1 or address < 0 or address + count > 0x10000:
+            raise ValueError("invalid modbus range %r" % (requests[i],))
+        if spans and spans[-1][0] == func and address <= spans[-1][2]:
+            # contiguous or overlapping
+            spans[-1][2] = max(spans[-1][2], address + count)
+        else:
+            spans.append([func, address, address + count])
+        placements[i] = len(spans) - 1, address - spans[-1][1]
+
+    blocks = []
+    for index, (func, start, end) in enumerate(spans):
+        step = _max_count(func)
+        for address in range(start, end, step):
+            count = min(step, end - address)
+            blocks.append(((func, address, count), (index, address - start)))
+    spans = [(func, start, end - start) for func, start, end in spans]
+    return spans, blocks, placements
+
+
+def pack_reads(tids, unit, requests):
+    """Encoded read requests (function code, address, count), one per
+    transaction id of tids"""
+    if lib is None:
+        return b"".join(
+            _READ.pack(tid, 0, 6, unit, func, address, count)
+            for tid, (func, address, count) in zip(tids, requests)
+        )
+    nb = len(requests)
+    funcs, addresses, counts = zip(*requests) if nb else ((), (), ())
+    buf = bytearray(nb * READ_SIZE)
+    lib.modbus_codec_pack_reads(
+        ffi.from_buffer(buf),
+        ffi.from_buffer("unsigned short[]", numpy.array(tids, numpy.ushort)),
+        unit,
+        ffi.from_buffer("unsigned char[]", numpy.array(funcs, numpy.ubyte)),
+        ffi.from_buffer("unsigned short[]", numpy.array(addresses, numpy.ushort)),
+        ffi.from_buffer("unsigned short[]", numpy.array(counts, numpy.ushort)),
+        nb,
+    )
+    return bytes(buf)
+
+
+def scan(buf, max_frames=64):
+    """Complete messages at the start of buf: a tuple ([(tid, unit,
+    function code, offset, size)], consumed bytes), offset and size of
+    the data after the function code. Raise ValueError if the first header
+    is invalid"""
+    if lib is None:
+        frames = []
+        offset = 0
+        while len(frames) < max_frames and len(buf) - offset >= _HEADER.size:
+            tid, protocol, length, unit, func = _HEADER.unpack_from(buf, offset)
+            if protocol != 0 or not 2 <= length <= 254:
+                if frames:
+                    break
+                raise ValueError("not a modbus tcp header")
+            end = offset + 6 + length
+            if end > len(buf):
+                break
+            frames.append((tid, unit, func, offset + _HEADER.size, length - 2))
+            offset = end
+        return frames, offset
+
+    cframes = ffi.new("modbus_codec_frame[]", max_frames)
+    consumed = ffi.new("size_t *")
+    nb = lib.modbus_codec_scan(
+        ffi.from_buffer(buf), len(buf), cframes, max_frames, consumed
+    )
+    if nb < 0:
+        raise ValueError("not a modbus tcp header")
+    frames = []
+    for i in range(nb):
+        frame = cframes[i]
+        frames.append((frame.tid, frame.unit, frame.func, frame.offset, frame.size))
+    return frames, consumed[0]
+
+
+def decode_registers(data, out=None):
+    """uint16 array of the big endian registers of data, a view on out
+    when given"""
+    nb = len(data) // 2
+    if out is None:
+        out = numpy.empty(nb, numpy.uint16)
+    elif len(out) < nb or out.dtype != numpy.uint16 or not out.flags.c_contiguous:
+        raise ValueError("output array can't hold %d registers" % nb)
+    out = out[:nb]
+    if lib is None:
+        out[:] = numpy.frombuffer(data, ">u2", nb)
+    else:
+        lib.modbus_codec_decode_registers(
+            ffi.from_buffer(data),
+            nb,
+            ffi.from_buffer("unsigned short[]", out, require_writable=True),
+        )
+    return out
+
+
+def decode_bits(data, nb, out=None):
+    """uint8 array of the nb coils or discrete inputs (0 or 1) packed in
+    data, a view on out when given"""
+    if len(data) * 8 < nb:
+        raise ValueError("%d bytes can't hold %d bits" % (len(data), nb))
+    if out is None:
+        out = numpy.empty(nb, numpy.uint8)
+    elif len(out) < nb or out.dtype != numpy.uint8 or not out.flags.c_contiguous:
+        raise ValueError("output array can't hold %d bits" % nb)
+    out = out[:nb]
+    if lib is None:
+        bits = numpy.frombuffer(data, numpy.uint8)
+        out[:] = numpy.unpackbits(bits, bitorder="little")[:nb]
+    else:
+        lib.modbus_codec_decode_bits(
+            ffi.from_buffer(data),
+            nb,
+            ffi.from_buffer("unsigned char[]", out, require_writable=True),
+        )
+    return out
@@ -0,0 +1,91 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Loading of the optional native libraries, used through cffi.
+
+A library ``<name>`` comes with a ``<name>.h`` header next to the module
+using it. The part of the header between the ``/* CFFI_BEGIN */`` and
+``/* CFFI_END */`` markers is read by cffi, it declares the
+``<NAME>_ABI_VERSION`` constant returned by ``<name>_abi_version()``.
+
+The library is searched, in this order:
+
+- at the path given by an environment variable
+- as the ``_<name>`` library built by setup.py (opt-in) next to the module
+
+- as ``lib<name>`` in the system library path, when asked for
+
+A library of another ABI version is skipped. Without library, lib is None
+and the module falls back to Python::
+
+    ffi, lib = native.load(__file__, "xdr", "BLISS_XDR_LIBRARY")
+
+A library whose header or ABI symbols are not named after it gives them::
+
+    ffi, lib = native.load(
+        __file__, "pixmaptools_core", "PIXMAPTOOLS_CORE_LIBRARY",
+        header="pixmaptools_capi.h", abi="pixmaptools", system=True,
+    )
+"""
+
+import os
+import re
+import glob
+import logging
+import ctypes.util
+
+from cffi import FFI
+
+_logger = logging.getLogger(__name__)
+
+
+def cdef(header):
+    """The declarations of header (path) read by cffi"""
+    with open(header, "r") as h_file:
+        text = h_file.read()
+    match = re.search(r"/\* CFFI_BEGIN \*/(.*)/\* CFFI_END \*/", text, re.S)
+    if match is None:
+        raise ValueError("%s: no CFFI_BEGIN/CFFI_END section" % header)
+    return match.group(1)
+
+
+def _candidates(directory, name, env_var, system):
+    path = os.environ.get(env_var)
+    if path:
+        yield path
+    for pattern in ("_%s*.so" % name, "_%s*.pyd" % name):
+        yield from sorted(glob.glob(os.path.join(directory, pattern)))
+    path = ctypes.util.find_library(name) if system else None
+    if path:
+        yield path
+
+
+def load(module_file, name, env_var, header=None, abi=None, system=False):
+    """(ffi, lib) of the native library name of the module (its __file__),
+    lib is None when the library is not found
+
+    :param str header: the header next to the module, <name>.h by default
+    :param str abi: prefix of <abi>_abi_version() and <ABI>_ABI_VERSION,
+                    name by default
+    :param bool system: search lib<name> in the system library path too
+    """
+    directory = os.path.dirname(module_file)
+    abi = abi or name
+    ffi = FFI()
+    ffi.cdef(cdef(os.path.join(directory, header or name + ".h")))
+    for path in _candidates(directory, name, env_var, system):
+        try:
+            library = ffi.dlopen(path)
+        except OSError:
+            _logger.debug("Can't load %s", path, exc_info=True)
+            continue
+        version = getattr(library, abi + "_abi_version")()
+        if version != getattr(library, abi.upper() + "_ABI_VERSION"):
+            _logger.warning("%s: %s ABI version mismatch", path, abi)
+            continue
+        return ffi, library
+    return ffi, None
@@ -0,0 +1,236 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "ringbuffer.h"
+
+struct ringbuffer
+{
+  char		*data;
+  size_t	capacity;
+  size_t	head;		/* first byte to read */
+  size_t	count;		/* bytes to read, they may wrap at capacity */
+  size_t	reserved;	/* free bytes given by the last reserve */
+};
+
+static size_t _tail(const ringbuffer *rb)
+{
+  size_t aTail = rb->head + rb->count;
+  return aTail >= rb->capacity ? aTail - rb->capacity : aTail;
+}
+
+/* the data as 2 contiguous segments, the second one empty if not wrapped */
+static size_t _first_segment(const ringbuffer *rb)
+{
+  size_t anEnd = rb->capacity - rb->head;
+  return rb->count < anEnd ? rb->count : anEnd;
+}
+
+int ringbuffer_abi_version(void)
+{
+  return RINGBUFFER_ABI_VERSION;
+}
+
+ringbuffer* ringbuffer_new(size_t capacity)
+{
+  ringbuffer *rb = calloc(1,sizeof(ringbuffer));
+  if(!rb)
+    return NULL;
+  rb->capacity = capacity ? capacity : 1;
+  rb->data = malloc(rb->capacity);
+  if(!rb->data)
+    {
+      free(rb);
+      return NULL;
+    }
+  return rb;
+}
+
+void ringbuffer_free(ringbuffer *rb)
+{
+  if(!rb)
+    return;
+  free(rb->data);
+  free(rb);
+}
+
+size_t ringbuffer_size(const ringbuffer *rb)
+{
+  return rb->count;
+}
+
+/* copy the data at the start of a new memory of at least min_capacity */
+static int _relocate(ringbuffer *rb,size_t min_capacity)
+{
+  size_t aCapacity = rb->capacity;
+  size_t aFirst = _first_segment(rb);
+  char *aData;
+
+  while(aCapacity < min_capacity)
+    aCapacity *= 2;
+  aData = malloc(aCapacity);
+  if(!aData)
+    return -1;
+  memcpy(aData,rb->data + rb->head,aFirst);
+  memcpy(aData + aFirst,rb->data,rb->count - aFirst);
+  free(rb->data);
+  rb->data = aData;
+  rb->capacity = aCapacity;
+  rb->head = 0;
+  return 0;
+}
+
+char* ringbuffer_reserve(ringbuffer *rb,size_t min_size,size_t *size)
+{
+  size_t aTail,aFree;
+
+  if(!min_size)
+    min_size = 1;
+  if(!rb->count)
+    rb->head = 0;
+  aTail = _tail(rb);
+  /* free space after the tail: up to the head if the data wraps, else
+   * up to the end of the memory (the space before the head is not
+   * contiguous with it)
+   */
+  if(rb->count && aTail <= rb->head)
+    aFree = rb->head - aTail;
+  else
+    aFree = rb->capacity - aTail;
+  if(aFree < min_size)
+    {
+      if(_relocate(rb,rb->count + min_size))
+	return NULL;
+      aTail = rb->count;
+      aFree = rb->capacity - aTail;
+    }
+  rb->reserved = aFree;
+  *size = aFree;
+  return rb->data + aTail;
+}
+
+void ringbuffer_commit(ringbuffer *rb,size_t size)
+{
+  if(size > rb->reserved)
+    size = rb->reserved;
+  rb->reserved -= size;
+  rb->count += size;
+}
+
+int ringbuffer_write(ringbuffer *rb,const char *data,size_t size)
+{
+  while(size)
+    {
+      size_t aFree;
+      char *aSpace = ringbuffer_reserve(rb,size,&aFree);
+      if(!aSpace)
+	return -1;
+      if(aFree > size)
+	aFree = size;
+      memcpy(aSpace,data,aFree);
+      ringbuffer_commit(rb,aFree);
+      data += aFree,size -= aFree;
+    }
+  return 0;
+}
+
+static const char* _at(const ringbuffer *rb,size_t offset)
+{
+  size_t aPos = rb->head + offset;
+  return rb->data + (aPos >= rb->capacity ? aPos - rb->capacity : aPos);
+}
+
+/* eol at offset, it may straddle the 2 segments */
+static int _match(const ringbuffer *rb,size_t offset,const char *eol,size_t eol_size,
+		  size_t first)
+{
+  size_t aBefore;
+  if(offset >= first || offset + eol_size <= first)
+    return !memcmp(_at(rb,offset),eol,eol_size);
+  aBefore = first - offset;
+  return !memcmp(_at(rb,offset),eol,aBefore) &&
+    !memcmp(rb->data,eol + aBefore,eol_size - aBefore);
+}
+
+long long ringbuffer_find(const ringbuffer *rb,const char *eol,size_t eol_size,
+			  size_t start)
+{
+  size_t aFirst = _first_segment(rb);
+  size_t anOffset = start;
+
+  if(!eol_size)
+    return -1;
+  /* memchr the first byte of eol in the segment of offset, then compare */
+  while(anOffset + eol_size <= rb->count)
+    {
+      size_t aSegmentEnd = anOffset < aFirst ? aFirst : rb->count;
+      const char *aBegin = _at(rb,anOffset);
+      const char *aFound = memchr(aBegin,eol[0],aSegmentEnd - anOffset);
+      if(!aFound)
+	{
+	  anOffset = aSegmentEnd;
+	  continue;
+	}
+      anOffset += aFound - aBegin;
+      if(anOffset + eol_size > rb->count)
+	break;
+      if(_match(rb,anOffset,eol,eol_size,aFirst))
+	return (long long)anOffset;
+      ++anOffset;
+    }
+  return -1;
+}
+
+const char* ringbuffer_peek(const ringbuffer *rb,size_t *size)
+{
+  *size = _first_segment(rb);
+  return rb->data + rb->head;
+}
+
+void ringbuffer_consume(ringbuffer *rb,size_t size)
+{
+  if(size > rb->count)
+    size = rb->count;
+  rb->head += size;
+  if(rb->head >= rb->capacity)
+    rb->head -= rb->capacity;
+  rb->count -= size;
+}
+
+size_t ringbuffer_read(ringbuffer *rb,char *out,size_t size)
+{
+  size_t aFirst = _first_segment(rb);
+  if(size > rb->count)
+    size = rb->count;
+  if(size <= aFirst)
+    memcpy(out,rb->data + rb->head,size);
+  else
+    {
+      memcpy(out,rb->data + rb->head,aFirst);
+      memcpy(out + aFirst,rb->data,size - aFirst);
+    }
+  ringbuffer_consume(rb,size);
+  return size;
+}
+
+void ringbuffer_clear(ringbuffer *rb)
+{
+  /* keep the tail where a pending receive will commit */
+  ringbuffer_consume(rb,rb->count);
+}
+
+#ifdef _WIN32
+/* setup.py builds this library as a Python extension, which exports an
+ * init function; it is loaded by cffi, never imported
+ */
+void* PyInit__ringbuffer(void)
+{
+  return NULL;
+}
+#endif
@@ -0,0 +1,65 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Growable receive ring buffer of the tcp sockets (bliss/comm/tcp.py).
+ *
+ * One writer (the socket reader greenlet) receives directly into the
+ * free space given by ringbuffer_reserve() and publishes it with
+ * ringbuffer_commit(); readers find end of lines and consume from the
+ * head. Only ringbuffer_reserve() moves or reallocates the memory, so
+ * consuming or clearing while a receive is pending is safe.
+ *
+ * The part between the CFFI markers is read by cffi (comm/ringbuffer.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __RINGBUFFER
+#define __RINGBUFFER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {RINGBUFFER_ABI_VERSION = 1};
+
+typedef struct ringbuffer ringbuffer;
+
+int ringbuffer_abi_version(void);
+
+/* NULL if the memory can't be allocated */
+ringbuffer* ringbuffer_new(size_t capacity);
+void ringbuffer_free(ringbuffer *rb);
+
+/* number of bytes to read */
+size_t ringbuffer_size(const ringbuffer *rb);
+
+/* contiguous free space of at least min_size bytes (its size in size),
+ * the buffer grows if needed; NULL if the memory can't be allocated
+ */
+char* ringbuffer_reserve(ringbuffer *rb,size_t min_size,size_t *size);
+/* publish size bytes written to the last reserved space */
+void ringbuffer_commit(ringbuffer *rb,size_t size);
+/* copy data at the end, -1 if the memory can't be allocated */
+int ringbuffer_write(ringbuffer *rb,const char *data,size_t size);
+
+/* offset from the head of the first eol at or after start, -1 if none */
+long long ringbuffer_find(const ringbuffer *rb,const char *eol,size_t eol_size,
+			  size_t start);
+/* contiguous bytes from the head (its size in size) */
+const char* ringbuffer_peek(const ringbuffer *rb,size_t *size);
+/* copy and consume up to size bytes, return the number of bytes copied */
+size_t ringbuffer_read(ringbuffer *rb,char *out,size_t size);
+/* drop up to size bytes from the head */
+void ringbuffer_consume(ringbuffer *rb,size_t size);
+void ringbuffer_clear(ringbuffer *rb);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
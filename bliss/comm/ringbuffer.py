@@ -0,0 +1,146 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Receive buffer of the tcp sockets (see ringbuffer.h).
+
+:class:`RingBuffer` is backed by the native ring buffer when its library
+is found, in this order:
+
+- the path given by the ``BLISS_RINGBUFFER_LIBRARY`` environment variable
+- the ``_ringbuffer`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_COMM_RINGBUFFER``) next to this file
+
+otherwise by a bytearray with the same API. Both consume from the head
+without copying the remaining data, so bulk reads stay linear.
+
+The socket reader greenlet receives straight into the free space::
+
+    view = buffer.reserve(16 * 1024)
+    buffer.commit(fd.recv_into(view))
+"""
+
+from . import native
+
+ffi, lib = native.load(__file__, "ringbuffer", "BLISS_RINGBUFFER_LIBRARY")
+
+DEFAULT_CAPACITY = 64 * 1024
+
+
+class NativeRingBuffer:
+    """Ring buffer of the native library"""
+
+    def __init__(self, capacity=DEFAULT_CAPACITY):
+        rb = lib.ringbuffer_new(capacity)
+        if rb == ffi.NULL:
+            raise MemoryError("can't allocate a ring buffer of %d bytes" % capacity)
+        self._rb = ffi.gc(rb, lib.ringbuffer_free)
+        self._size = ffi.new("size_t *")
+
+    def __len__(self):
+        return lib.ringbuffer_size(self._rb)
+
+    def reserve(self, min_size):
+        """Writable memoryview on the contiguous free space (at least
+        min_size bytes), valid until the next reserve or write"""
+        space = lib.ringbuffer_reserve(self._rb, min_size, self._size)
+        if space == ffi.NULL:
+            raise MemoryError("can't grow the ring buffer")
+        return memoryview(ffi.buffer(space, self._size[0]))
+
+    def commit(self, size):
+        """Publish size bytes written to the reserved space"""
+        lib.ringbuffer_commit(self._rb, size)
+
+    def write(self, data):
+        if lib.ringbuffer_write(self._rb, ffi.from_buffer(data), len(data)):
+            raise MemoryError("can't grow the ring buffer")
+
+    def find(self, eol, start=0):
+        """Offset of the first eol at or after start, -1 if not found"""
+        return lib.ringbuffer_find(self._rb, eol, len(eol), start)
+
+    def peek(self):
+        """Memoryview on the contiguous data from the head, without copy.
+        It may be shorter than the data if it wraps, and it is only valid
+        until the next reserve or write: don't keep it across a gevent
+        switch"""
+        data = lib.ringbuffer_peek(self._rb, self._size)
+        return memoryview(ffi.buffer(data, self._size[0])).toreadonly()
+
+    def read(self, size=None):
+        """Consume and return up to size bytes (all if None)"""
+        size = len(self) if size is None else min(size, len(self))
+        data = lib.ringbuffer_peek(self._rb, self._size)
+        if self._size[0] >= size:
+            msg = ffi.buffer(data, size)[:]
+            lib.ringbuffer_consume(self._rb, size)
+        else:
+            msg = bytearray(size)
+            lib.ringbuffer_read(self._rb, ffi.from_buffer(msg), size)
+            msg = bytes(msg)
+        return msg
+
+    def consume(self, size):
+        lib.ringbuffer_consume(self._rb, size)
+
+    def clear(self):
+        lib.ringbuffer_clear(self._rb)
+
+
+class PyRingBuffer:
+    """Same API on a bytearray, the consumed head is dropped once it is
+    more than half of the buffer"""
+
+    def __init__(self, capacity=DEFAULT_CAPACITY):
+        self._buffer = bytearray()
+        self._start = 0
+        self._capacity = capacity
+        self._scratch = None
+
+    def __len__(self):
+        return len(self._buffer) - self._start
+
+    def reserve(self, min_size):
+        # the data can't be exported while it may be resized by a reader
+        if self._scratch is None or len(self._scratch) < min_size:
+            self._scratch = bytearray(max(min_size, self._capacity))
+        return memoryview(self._scratch)
+
+    def commit(self, size):
+        self._buffer += memoryview(self._scratch)[:size]
+
+    def write(self, data):
+        self._buffer += data
+
+    def find(self, eol, start=0):
+        pos = self._buffer.find(eol, self._start + start)
+        return pos if pos == -1 else pos - self._start
+
+    def peek(self):
+        # a copy, the bytearray can't be resized while exported
+        return memoryview(bytes(self._buffer[self._start :]))
+
+    def read(self, size=None):
+        end = len(self._buffer) if size is None else self._start + size
+        msg = bytes(self._buffer[self._start : end])
+        self.consume(len(msg))
+        return msg
+
+    def consume(self, size):
+        self._start = min(self._start + size, len(self._buffer))
+        if self._start == len(self._buffer):
+            self._buffer.clear()
+            self._start = 0
+        elif self._start > len(self._buffer) // 2:
+            del self._buffer[: self._start]
+            self._start = 0
+
+    def clear(self):
+        self.consume(len(self))
+
+
+RingBuffer = PyRingBuffer if lib is None else NativeRingBuffer
@@ -0,0 +1,181 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scpi_block.h"
+
+/* longest token given to strtod */
+#define MAX_TOKEN 64
+
+static int _host_big_endian(void)
+{
+  const uint16_t anOne = 1;
+  return !*(const unsigned char*)&anOne;
+}
+
+#define _CONVERT(TYPE,UTYPE,SWAP)					\
+  {									\
+    size_t i;								\
+    for(i = 0;i < nb;++i)						\
+      {									\
+	UTYPE aRaw;							\
+	TYPE aValue;							\
+	memcpy(&aRaw,src + i * sizeof(UTYPE),sizeof(UTYPE));		\
+	if(aSwap)							\
+	  aRaw = SWAP(aRaw);						\
+	memcpy(&aValue,&aRaw,sizeof(UTYPE));				\
+	dst[i] = ((double)aValue - offset) * scale + zero;		\
+      }									\
+    return 0;								\
+  }
+
+#define _NO_SWAP(x) (x)
+
+int scpi_block_abi_version(void)
+{
+  return SCPI_BLOCK_ABI_VERSION;
+}
+
+int scpi_block_to_double(const char *src,size_t nb,int width,int kind,int big_endian,
+			 double offset,double scale,double zero,double *dst)
+{
+  int aSwap = !big_endian != !_host_big_endian();
+  switch(kind)
+    {
+    case SCPI_BLOCK_INT:
+      switch(width)
+	{
+	case 1: _CONVERT(int8_t,uint8_t,_NO_SWAP);
+	case 2: _CONVERT(int16_t,uint16_t,__builtin_bswap16);
+	case 4: _CONVERT(int32_t,uint32_t,__builtin_bswap32);
+	case 8: _CONVERT(int64_t,uint64_t,__builtin_bswap64);
+	}
+      break;
+    case SCPI_BLOCK_UINT:
+      switch(width)
+	{
+	case 1: _CONVERT(uint8_t,uint8_t,_NO_SWAP);
+	case 2: _CONVERT(uint16_t,uint16_t,__builtin_bswap16);
+	case 4: _CONVERT(uint32_t,uint32_t,__builtin_bswap32);
+	case 8: _CONVERT(uint64_t,uint64_t,__builtin_bswap64);
+	}
+      break;
+    case SCPI_BLOCK_FLOAT:
+      switch(width)
+	{
+	case 4: _CONVERT(float,uint32_t,__builtin_bswap32);
+	case 8: _CONVERT(double,uint64_t,__builtin_bswap64);
+	}
+      break;
+    }
+  return -1;
+}
+
+static int _is_separator(char c)
+{
+  return c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* exactly representable powers of ten */
+static const double POW10[] =
+  {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+   1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+
+/* the usual [+-]digits[.digits][e[+-]digits] with at most 15 significant
+ * digits and a small exponent are exact with one multiplication or
+ * division, the other ones (long mantissa, 9.91E37, NAN, INF...) go
+ * through strtod. Return the end of the number, NULL if the token is not
+ * a number
+ */
+static const char* _parse(const char *p,const char *end,double *value)
+{
+  const char *aStart = p,*aTokenEnd;
+  uint64_t aMantissa = 0;
+  int aNegative = 0,aNbDigits = 0,aSignificant = 0,anExponent = 0;
+
+  if(p < end && (*p == '+' || *p == '-'))
+    aNegative = *p++ == '-';
+  for(;p < end && (unsigned char)(*p - '0') < 10;++p,++aNbDigits)
+    {
+      if(aSignificant < 19)
+	{
+	  aMantissa = aMantissa * 10 + (*p - '0');
+	  aSignificant += aMantissa != 0;
+	}
+      else
+	++anExponent;
+    }
+  if(p < end && *p == '.')
+    for(++p;p < end && (unsigned char)(*p - '0') < 10;++p,++aNbDigits)
+      {
+	if(aSignificant < 19)
+	  {
+	    aMantissa = aMantissa * 10 + (*p - '0');
+	    aSignificant += aMantissa != 0;
+	    --anExponent;
+	  }
+      }
+  if(aNbDigits && p < end && (*p == 'e' || *p == 'E'))
+    {
+      int anExpNegative = 0,anExpValue = 0;
+      ++p;
+      if(p < end && (*p == '+' || *p == '-'))
+	anExpNegative = *p++ == '-';
+      if(p == end || (unsigned char)(*p - '0') >= 10)
+	aNbDigits = 0;		/* "1e": let strtod decide */
+      for(;p < end && (unsigned char)(*p - '0') < 10;++p)
+	if(anExpValue < 10000)
+	  anExpValue = anExpValue * 10 + (*p - '0');
+      anExponent += anExpNegative ? -anExpValue : anExpValue;
+    }
+  if(aNbDigits && (p == end || _is_separator(*p)) &&
+     aSignificant <= 15 && anExponent >= -22 && anExponent <= 22)
+    {
+      double aValue = (double)aMantissa;
+      aValue = anExponent < 0 ? aValue / POW10[-anExponent] : aValue * POW10[anExponent];
+      *value = aNegative ? -aValue : aValue;
+      return p;
+    }
+
+  /* slow path on a null terminated copy of the token */
+  for(aTokenEnd = aStart;aTokenEnd < end && !_is_separator(*aTokenEnd);++aTokenEnd);
+  if(aTokenEnd == aStart || aTokenEnd - aStart >= MAX_TOKEN)
+    return NULL;
+  {
+    char aToken[MAX_TOKEN],*aParsedEnd;
+    size_t aSize = aTokenEnd - aStart;
+    memcpy(aToken,aStart,aSize);
+    aToken[aSize] = '\0';
+    *value = strtod(aToken,&aParsedEnd);
+    if(aParsedEnd != aToken + aSize)
+      return NULL;
+  }
+  return aTokenEnd;
+}
+
+size_t scpi_parse_doubles(const char *buf,size_t len,double *dst,size_t max,
+			  size_t *consumed)
+{
+  const char *p = buf,*end = buf + len;
+  size_t aNbValues = 0;
+
+  while(p < end && _is_separator(*p))
+    ++p;
+  while(aNbValues < max && p < end)
+    {
+      const char *aNext = _parse(p,end,dst + aNbValues);
+      if(!aNext)
+	break;
+      ++aNbValues;
+      for(p = aNext;p < end && _is_separator(*p);++p);
+    }
+  *consumed = p - buf;
+  return aNbValues;
+}
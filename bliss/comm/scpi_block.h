@@ -0,0 +1,58 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Decoding of the SCPI waveform data (bliss/comm/scpi_block.py).
+ *
+ * scpi_block_to_double() converts the raw values of an IEEE 488.2 binary
+ * block (#<n><length><data>) to doubles in one pass, with the byte swap
+ * and the instrument scaling, straight into the result array.
+ * scpi_parse_doubles() parses the ASCII curves (comma separated numbers)
+ * without going through Python strings.
+ *
+ * The part between the CFFI markers is read by cffi (comm/scpi_block.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __SCPI_BLOCK
+#define __SCPI_BLOCK
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {SCPI_BLOCK_ABI_VERSION = 1};
+
+/* kind of the raw values */
+enum
+  {
+    SCPI_BLOCK_INT = 0,
+    SCPI_BLOCK_UINT = 1,
+    SCPI_BLOCK_FLOAT = 2
+  };
+
+int scpi_block_abi_version(void);
+
+/* dst[i] = (value i of src - offset) * scale + zero for nb values of
+ * width bytes (1, 2, 4 or 8, 4 or 8 for floats) in the given byte order.
+ * 0, -1 for an unsupported width or kind
+ */
+int scpi_block_to_double(const char *src,size_t nb,int width,int kind,int big_endian,
+			 double offset,double scale,double zero,double *dst);
+
+/* parse up to max numbers separated by commas or white spaces from buf:
+ * the number of values, *consumed the bytes parsed with the trailing
+ * separators. It stops before the first token which is not a number.
+ */
+size_t scpi_parse_doubles(const char *buf,size_t len,double *dst,size_t max,
+			  size_t *consumed);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
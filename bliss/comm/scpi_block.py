@@ -0,0 +1,260 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Decoding of the SCPI waveform data: IEEE 488.2 binary blocks and ASCII
+curves (see scpi_block.h).
+
+The conversions use the native library when it is found, in this order:
+
+- the path given by the ``BLISS_SCPI_BLOCK_LIBRARY`` environment variable
+- the ``_scpi_block`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_COMM_SCPI_BLOCK``) next to this file
+
+otherwise numpy.
+
+:class:`BlockReader` decodes a block from the receive ring buffer of a
+socket as the data arrives (see :meth:`bliss.comm.tcp.Socket.read_block`)::
+
+    sock.write(b":CURVE?\\n")
+    raw = sock.read_block(">i2")
+    volts = sock.write_read_block(b":CURVE?\\n", ">i2", scaling=(yoff, ymult, yzero))
+
+:func:`decode_block` decodes a whole answer read at once, by the comms
+without receive buffer (gpib, serial, vxi11).
+"""
+
+import sys
+
+import numpy
+
+from . import native
+
+ffi, lib = native.load(__file__, "scpi_block", "BLISS_SCPI_BLOCK_LIBRARY")
+
+# SCPI_BLOCK_* kinds of scpi_block.h
+_KINDS = {"i": 0, "u": 1, "f": 2}
+
+
+def _big_endian(dtype):
+    if dtype.byteorder == "=":
+        return sys.byteorder == "big"
+    return dtype.byteorder == ">"
+
+
+def to_double(raw, dtype, out, scaling=(0., 1., 0.)):
+    """Convert the values of raw (bytes-like, of numpy dtype) into out, a
+    float64 array of the same length: (value - offset) * scale + zero
+    with scaling = (offset, scale, zero)"""
+    dtype = numpy.dtype(dtype)
+    offset, scale, zero = scaling
+    nb = len(out)
+    if lib is not None and dtype.kind in _KINDS:
+        if lib.scpi_block_to_double(
+            ffi.from_buffer(raw),
+            nb,
+            dtype.itemsize,
+            _KINDS[dtype.kind],
+            _big_endian(dtype),
+            offset,
+            scale,
+            zero,
+            ffi.from_buffer("double[]", out, require_writable=True),
+        ):
+            raise TypeError("unsupported block data type %s" % dtype)
+        return out
+    values = numpy.frombuffer(raw, dtype, nb)
+    numpy.subtract(values, offset, out=out)
+    out *= scale
+    out += zero
+    return out
+
+
+def parse_values(line):
+    """float64 array of the comma separated numbers of an ASCII curve,
+    after the response header if any (``:CURVE 1,2,...``)"""
+    if line.startswith(b":"):
+        line = line.partition(b" ")[2]
+    if lib is None:
+        tokens = line.replace(b",", b" ").split()
+        try:
+            return numpy.array(tokens, dtype=numpy.float64)
+        except ValueError:
+            raise ValueError("invalid number in %r" % line[:64])
+    values = numpy.empty(line.count(b",") + 1)
+    consumed = ffi.new("size_t *")
+    nb = 0
+    pos = 0
+    while True:
+        nb += lib.scpi_parse_doubles(
+            ffi.from_buffer(line) + pos,
+            len(line) - pos,
+            ffi.from_buffer("double[]", values) + nb,
+            len(values) - nb,
+            consumed,
+        )
+        pos += consumed[0]
+        if pos == len(line):
+            return values[:nb]
+        if nb < len(values):
+            raise ValueError("invalid number at %r" % line[pos : pos + 64])
+        # separated with spaces
+        values = numpy.concatenate((values, numpy.empty(len(values))))
+
+
+class BlockReader:
+    """Decode an IEEE 488.2 block, definite (``#<n><length><data>``) or
+    indefinite (``#0<data><eol>``), from a RingBuffer as the data is
+    received. Anything before the ``#`` (response header) is skipped, the
+    eol terminating a definite block is consumed with it.
+
+    data is the array of the values, of dtype or float64 with scaling
+    (see :func:`to_double`), it is a view on out when given.
+    """
+
+    def __init__(self, dtype="u1", out=None, scaling=None, eol=b"\n"):
+        self.dtype = numpy.dtype(dtype)
+        self.data = None
+        self.nbytes = None
+        self._out = out
+        self._scaling = scaling
+        self._eol = eol
+        self._ndigits = None
+        self._received = 0
+
+    def feed(self, buffer):
+        """Consume the available bytes of buffer, return True when the
+        block is complete. Raise ValueError on an invalid header"""
+        if self.nbytes is None and not self._read_header(buffer):
+            return False
+        while self._received < self.nbytes and self._decode(buffer):
+            pass
+        if self._received < self.nbytes:
+            return False
+        if self._ndigits and self._eol:
+            # the message terminator
+            if len(buffer) < len(self._eol):
+                return False
+            if buffer.find(self._eol) == 0:
+                buffer.consume(len(self._eol))
+            self._eol = None
+        return True
+
+    def _read_header(self, buffer):
+        if self._ndigits is None:
+            pos = buffer.find(b"#")
+            if pos == -1 or len(buffer) < pos + 2:
+                return False
+            buffer.consume(pos + 1)
+            digit = buffer.read(1)
+            if not digit.isdigit():
+                raise ValueError("invalid block header #%r" % digit)
+            self._ndigits = int(digit)
+        if self._ndigits == 0:
+            # indefinite block, up to the message terminator
+            pos = buffer.find(self._eol)
+            if pos == -1:
+                return False
+            self._allocate(pos)
+            while self._received < self.nbytes and self._decode(buffer):
+                pass
+            buffer.consume(len(self._eol))
+            return True
+        if len(buffer) < self._ndigits:
+            return False
+        length = buffer.read(self._ndigits)
+        if not length.isdigit():
+            raise ValueError("invalid block length %r" % length)
+        self._allocate(int(length))
+        return True
+
+    def _allocate(self, nbytes):
+        self.nbytes = nbytes
+        nb = nbytes // self.dtype.itemsize
+        dtype = self.dtype if self._scaling is None else numpy.dtype(numpy.float64)
+        out = self._out
+        if out is None:
+            out = numpy.empty(nb, dtype)
+        elif len(out) < nb or out.dtype.itemsize != dtype.itemsize:
+            raise ValueError(
+                "output array can't hold %d values of %s, got %d of %s"
+                % (nb, dtype, len(out), out.dtype)
+            )
+        self.data = out[:nb]
+        # bytes of the values, a trailing incomplete value is dropped
+        self._size = nb * self.dtype.itemsize
+        if self._scaling is None:
+            self._raw = self.data.view(numpy.uint8)
+
+    def _decode(self, buffer):
+        """decode from the contiguous data at the head of buffer, return
+        the consumed bytes"""
+        view = buffer.peek()
+        size = min(len(view), self.nbytes - self._received)
+        if self._received >= self._size:
+            buffer.consume(size)  # trailing bytes
+        elif self._scaling is None:
+            size = min(size, self._size - self._received)
+            self._raw[self._received : self._received + size] = view[:size]
+            buffer.consume(size)
+        else:
+            width = self.dtype.itemsize
+            nb = min(size, self._size - self._received) // width
+            first = self._received // width
+            if nb:
+                size = nb * width
+                values = self.data[first : first + nb]
+                to_double(view[:size], self.dtype, values, self._scaling)
+                buffer.consume(size)
+            elif len(buffer) >= width:
+                # a value wraps at the end of the ring
+                size = width
+                values = self.data[first : first + 1]
+                to_double(buffer.read(width), self.dtype, values, self._scaling)
+            else:
+                size = 0
+        self._received += size
+        return size
+
+
+class _Answer:
+    """The buffer API used by BlockReader on a complete answer"""
+
+    def __init__(self, data):
+        self._data = data
+        self._view = memoryview(data)
+        self._start = 0
+
+    def __len__(self):
+        return len(self._view) - self._start
+
+    def find(self, eol, start=0):
+        pos = self._data.find(eol, self._start + start)
+        return pos if pos == -1 else pos - self._start
+
+    def peek(self):
+        return self._view[self._start :]
+
+    def read(self, size=None):
+        end = len(self._view) if size is None else self._start + size
+        msg = bytes(self._view[self._start : end])
+        self.consume(len(msg))
+        return msg
+
+    def consume(self, size):
+        self._start = min(self._start + size, len(self._view))
+
+
+def decode_block(data, dtype="u1", out=None, scaling=None, eol=b"\n"):
+    """Decode the block of a complete answer (bytes or bytearray), see
+    :class:`BlockReader`. The message terminator may have been stripped.
+    Raise ValueError on an invalid or truncated block"""
+    if eol and not data.endswith(eol):
+        data = data + eol
+    reader = BlockReader(dtype, out, scaling, eol)
+    if not reader.feed(_Answer(data)):
+        raise ValueError("truncated block in %r" % data[:64])
+    return reader.data
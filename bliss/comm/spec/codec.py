@@ -0,0 +1,277 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Decoding of the SPEC server protocol stream (see spec_codec.h).
+
+:class:`MessageReader` receives the bytes of a SPEC connection into a ring
+buffer and splits them in (header, payload) messages, the headers of all
+the complete messages are decoded in one call of the native library when
+it is found, in this order:
+
+- the path given by the ``BLISS_SPEC_CODEC_LIBRARY`` environment variable
+- the ``_spec_codec`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_COMM_SPEC_CODEC``) next to this file
+
+otherwise with struct. The payload of a large message is received
+straight into its own buffer, and :func:`decode_array` returns numpy views
+on it: array data is never copied.
+"""
+
+import struct
+from collections import namedtuple
+
+import numpy
+
+from bliss.comm import native
+from bliss.comm.ringbuffer import RingBuffer
+
+ffi, lib = native.load(__file__, "spec_codec", "BLISS_SPEC_CODEC_LIBRARY")
+
+MAGIC_NUMBER = 4277009102
+
+# array data types
+(
+    ARRAY_DOUBLE,
+    ARRAY_FLOAT,
+    ARRAY_LONG,
+    ARRAY_ULONG,
+    ARRAY_SHORT,
+    ARRAY_USHORT,
+    ARRAY_CHAR,
+    ARRAY_UCHAR,
+    ARRAY_STRING,
+    ARRAY_LONG64,
+    ARRAY_ULONG64,
+) = range(5, 16)
+
+ARRAY_DTYPES = {
+    ARRAY_DOUBLE: "f8",
+    ARRAY_FLOAT: "f4",
+    ARRAY_LONG: "i4",
+    ARRAY_ULONG: "u4",
+    ARRAY_SHORT: "i2",
+    ARRAY_USHORT: "u2",
+    ARRAY_CHAR: "i1",
+    ARRAY_UCHAR: "u1",
+    ARRAY_LONG64: "i8",
+    ARRAY_ULONG64: "u8",
+}
+
+_ARRAY_TYPES = {numpy.dtype(v): k for k, v in ARRAY_DTYPES.items()}
+
+Header = namedtuple(
+    "Header",
+    "vers size sn sec usec cmd type rows cols len err flags name "
+    "big_endian header_size",
+)
+
+# header formats by version, without the byte order
+_FORMATS = {2: "IiiiIIiiIII80s", 3: "IiiiIIiiIIIi80s", 4: "IiIIIIiiIIIii80s"}
+
+
+def _py_parse_header(buf):
+    if len(buf) < 8:
+        return None
+    for order in "<>":
+        magic, vers = struct.unpack_from(order + "Ii", buf)
+        if magic == MAGIC_NUMBER:
+            break
+    else:
+        raise ValueError("not a SPEC message header (magic number)")
+    if vers < 2:
+        raise ValueError("unknown SPEC message header version %d" % vers)
+    header_format = order + _FORMATS[min(vers, 4)]
+    header_size = struct.calcsize(header_format)
+    if len(buf) < header_size:
+        return None
+    fields = list(struct.unpack_from(header_format, buf))
+    name = fields.pop()
+    fields += [0] * (14 - len(fields))  # err and flags of the old versions
+    return Header(
+        *fields[1:12],
+        fields[12],
+        name.split(b"\x00", 1)[0].decode(errors="replace"),
+        order == ">",
+        header_size
+    )
+
+
+def _header(cheader):
+    return Header(
+        cheader.vers,
+        cheader.size,
+        cheader.sn,
+        cheader.sec,
+        cheader.usec,
+        cheader.cmd,
+        cheader.type,
+        cheader.rows,
+        cheader.cols,
+        cheader.len,
+        cheader.err,
+        cheader.flags,
+        ffi.string(cheader.name).decode(errors="replace"),
+        bool(cheader.big_endian),
+        cheader.header_size,
+    )
+
+
+def parse_header(buf):
+    """Header at the start of buf, None if buf is too short.
+    Raise ValueError if it is not a SPEC header"""
+    if lib is None:
+        return _py_parse_header(buf)
+    cheader = ffi.new("spec_codec_header *")
+    size = lib.spec_codec_parse(ffi.from_buffer(buf), len(buf), cheader)
+    if size < 0:
+        raise ValueError("not a SPEC message header")
+    return _header(cheader) if size else None
+
+
+def scan(buf, max_messages=64):
+    """Complete messages at the start of buf: a tuple ([(offset, header)],
+    consumed bytes). Raise ValueError if the first header is invalid"""
+    if lib is None:
+        messages = []
+        offset = 0
+        while len(messages) < max_messages:
+            try:
+                header = _py_parse_header(buf[offset:])
+            except ValueError:
+                if messages:
+                    break
+                raise
+            if header is None or len(buf) - offset - header.header_size < header.len:
+                break
+            messages.append((offset, header))
+            offset += header.header_size + header.len
+        return messages, offset
+
+    cheaders = ffi.new("spec_codec_header[]", max_messages)
+    consumed = ffi.new("size_t *")
+    nb = lib.spec_codec_scan(
+        ffi.from_buffer(buf), len(buf), cheaders, max_messages, consumed
+    )
+    if nb < 0:
+        raise ValueError("not a SPEC message header")
+    return [(cheaders[i].offset, _header(cheaders[i])) for i in range(nb)], consumed[0]
+
+
+def is_array_type(datatype):
+    return datatype in ARRAY_DTYPES or datatype == ARRAY_STRING
+
+
+def decode_array(payload, datatype, rows, cols, big_endian=False):
+    """Numpy view on the array data of payload, of shape (rows, cols) or
+    (cols,) for a single row. ARRAY_STRING gives one bytes item per row"""
+    if datatype == ARRAY_STRING:
+        return numpy.frombuffer(payload, "S%d" % max(cols, 1), rows)
+    dtype = numpy.dtype(ARRAY_DTYPES[datatype]).newbyteorder(
+        ">" if big_endian else "<"
+    )
+    data = numpy.frombuffer(payload, dtype, rows * cols)
+    return data if rows <= 1 else data.reshape(rows, cols)
+
+
+def array_type(data):
+    """Array data type of a numpy array, TypeError if SPEC has none"""
+    try:
+        return _ARRAY_TYPES[data.dtype.newbyteorder("<")]
+    except KeyError:
+        raise TypeError("no SPEC array type for %s" % data.dtype)
+
+
+def array_shape(data):
+    """(rows, cols) of a numpy array"""
+    if data.ndim <= 1:
+        return 1, data.size
+    if data.ndim == 2:
+        return data.shape
+    raise ValueError("SPEC arrays have at most 2 dimensions")
+
+
+def encode_array(data, datatype, order="<"):
+    """Array data bytes of a numpy array"""
+    if datatype not in ARRAY_DTYPES:
+        raise TypeError("can't encode SPEC array type %d" % datatype)
+    dtype = numpy.dtype(ARRAY_DTYPES[datatype]).newbyteorder(order)
+    return numpy.ascontiguousarray(data, dtype).tobytes()
+
+
+class MessageReader:
+    """Split the byte stream of a SPEC connection in (header, payload)
+    messages. The payload is a bytes, or a bytearray for a large message"""
+
+    # payload size from which a message is received into its own buffer
+    LARGE_PAYLOAD = 64 * 1024
+
+    def __init__(self):
+        self._buffer = RingBuffer()
+        # (header, payload, received bytes) of the large message in progress
+        self._large = None
+
+    def feed(self, data):
+        """Add received bytes, return the completed messages"""
+        messages = []
+        if self._large is not None:
+            header, payload, received = self._large
+            size = min(len(data), header.len - received)
+            payload[received : received + size] = data[:size]
+            messages += self._received_large(size)
+            data = data[size:]
+        if data:
+            self._buffer.write(data)
+            messages += self._split()
+        return messages
+
+    def recv(self, sock, size=16 * 1024):
+        """Receive once from sock, return the completed messages (may be
+        empty) or None when the connection is closed.
+        Raise ValueError on an invalid message header"""
+        if self._large is not None:
+            header, payload, received = self._large
+            nbytes = sock.recv_into(memoryview(payload)[received:])
+            return self._received_large(nbytes) if nbytes else None
+        nbytes = sock.recv_into(self._buffer.reserve(size))
+        if not nbytes:
+            return None
+        self._buffer.commit(nbytes)
+        return self._split()
+
+    def _received_large(self, nbytes):
+        header, payload, received = self._large
+        received += nbytes
+        if received < header.len:
+            self._large = header, payload, received
+            return []
+        self._large = None
+        return [(header, payload)]
+
+    def _split(self):
+        messages = []
+        while self._buffer:
+            view = self._buffer.peek()
+            found, consumed = scan(view)
+            for offset, header in found:
+                start = offset + header.header_size
+                messages.append((header, bytes(view[start : start + header.len])))
+            if consumed:
+                self._buffer.consume(consumed)
+                continue
+            if len(view) < len(self._buffer):
+                # the message wraps at the end of the ring: make it contiguous
+                self._buffer.write(self._buffer.read())
+                continue
+            header = parse_header(view)
+            if header is not None and header.len >= self.LARGE_PAYLOAD:
+                payload = bytearray(header.len)
+                received = len(view) - header.header_size
+                payload[:received] = view[header.header_size :]
+                self._buffer.consume(len(view))
+                self._large = header, payload, received
+            break
+        return messages
@@ -22,7 +22,7 @@ from bliss import global_map
 from .error import SpecClientNotConnectedError
 from .channel import SpecChannel
 from .message import *
-from .message import message as spec_message
+from .codec import MessageReader
 
 (DISCONNECTED, PORTSCANNING, WAITINGFORHELLO, CONNECTED) = (1, 2, 3, 4)
 (MIN_PORT, MAX_PORT) = (6510, 6530)
@@ -53,12 +53,15 @@ def makeConnection(conn):
                 conn.state = WAITINGFORHELLO
                 conn.socket = s
                 conn.send_msg_hello()
-                m = spec_message(version=None)
-                m.readFromStream(conn.socket.recv(1024))
-                if m.cmd == HELLO_REPLY:
+                reader = MessageReader()
+                messages = []
+                while messages == []:
+                    messages = reader.recv(conn.socket, 1024)
+                m = message_from_stream(*messages[0]) if messages else None
+                if m is not None and m.cmd == HELLO_REPLY:
                     if conn.checkourversion(m.name):
                         conn.serverVersion = m.vers
-                        return gevent.spawn(connectionHandler, conn, s)
+                        return gevent.spawn(connectionHandler, conn, s, reader)
         if conn.scanport:
             conn.port += 1
 
@@ -74,72 +77,49 @@ def try_connect(fu):
     return rfunc
 
 
-def connectionHandler(conn, socket_to_spec):
-    receivedStrings = []
-    message = None
-    serverVersion = None
+def connectionHandler(conn, socket_to_spec, reader=None):
+    if reader is None:
+        reader = MessageReader()
     socket_to_spec.settimeout(None)
     conn.specConnected()
 
     while True:
 
         try:
-            receivedStrings.append(socket_to_spec.recv(4096))
+            messages = reader.recv(socket_to_spec)
+        except ValueError:
+            log_exception(conn, "Invalid message received from server")
+            messages = None
         except BaseException:
-            receivedStrings.append(b"")
+            messages = None
 
-        if receivedStrings[-1] == b"":
+        if messages is None:
             conn.handle_close()
             break
 
-        s = b"".join(receivedStrings)
-        consumedBytes = 0
-        offset = 0
+        for header, payload in messages:
+            message = message_from_stream(header, payload)
 
-        while offset < len(s):
-            if message is None:
-                message = spec_message(version=serverVersion)
-
-            consumedBytes = message.readFromStream(s[offset:])
-
-            if consumedBytes == 0:
-                break
-
-            offset += consumedBytes
-
-            if message.isComplete():
-                try:
+            # dispatch incoming message
+            if message.cmd == REPLY:
+                replyID = message.sn
+                if replyID > 0:
                     try:
-                        # dispatch incoming message
-                        if message.cmd == REPLY:
-                            replyID = message.sn
-                            if replyID > 0:
-                                try:
-                                    reply = conn.registeredReplies[replyID]
-                                except BaseException:
-                                    log_exception(
-                                        conn,
-                                        "Unexpected error while receiving a message from server",
-                                    )
-                                else:
-                                    del conn.registeredReplies[replyID]
-                                    reply.update(
-                                        message.data, message.type == ERROR, message.err
-                                    )
-                        elif message.cmd == EVENT:
-                            try:
-                                channel = conn.registeredChannels[message.name]
-                            except KeyError:
-                                pass
-                            else:
-                                channel.update(message.data, message.flags == DELETED)
+                        reply = conn.registeredReplies[replyID]
                     except BaseException:
-                        receivedStrings = [s[offset:]]
-                        raise
-                finally:
-                    message = None
-
-            receivedStrings = [s[offset:]]
+                        log_exception(
+                            conn, "Unexpected error while receiving a message from server"
+                        )
+                    else:
+                        del conn.registeredReplies[replyID]
+                        reply.update(message.data, message.type == ERROR, message.err)
+            elif message.cmd == EVENT:
+                try:
+                    channel = conn.registeredChannels[message.name]
+                except KeyError:
+                    pass
+                else:
+                    channel.update(message.data, message.flags == DELETED)
 
 
 class SpecConnection:
@@ -14,13 +14,27 @@ It handles the different message versions (headers 2, 3 and 4).
 import struct
 import time
 
-# from SpecClient_gevent import SpecArray
+import numpy
 
 from .reply import SpecReply
+from . import codec
+from .codec import (
+    MAGIC_NUMBER,
+    ARRAY_DOUBLE,
+    ARRAY_FLOAT,
+    ARRAY_LONG,
+    ARRAY_ULONG,
+    ARRAY_SHORT,
+    ARRAY_USHORT,
+    ARRAY_CHAR,
+    ARRAY_UCHAR,
+    ARRAY_STRING,
+    ARRAY_LONG64,
+    ARRAY_ULONG64,
+)
 
 (DOUBLE, STRING, ERROR, ASSOC) = (1, 2, 3, 4)
 
-MAGIC_NUMBER = 4277009102
 NATIVE_HEADER_VERSION = 4
 NULL = "\x00"
 
@@ -78,6 +92,16 @@ def message(*args, **kwargs):
     return m
 
 
+def message_from_stream(header, payload):
+    """Return the SpecMessage object of a (header, payload) message split
+    by codec.MessageReader"""
+    version = 2 if header.vers == 2 else 3 if header.vers == 3 else 4
+    m = message(version=version, order=">" if header.big_endian else "<")
+    m.setHeader(header)
+    m.data = m.readData(payload, m.type)
+    return m
+
+
 def rawtodictonary(rawstring):
     """Transform a list as coming from a SPEC associative array
     to a dictonary - 2dim arrays are transformed top dict with dict
@@ -187,6 +211,21 @@ class SpecMessage:
 
         return consumedBytes
 
+    def setHeader(self, header):
+        """Set the message properties from a codec.Header, the message is
+        then complete but for its data"""
+        self.readheader = False
+        self.bytesToRead = 0
+        self.magic = MAGIC_NUMBER
+        self.vers, self.size, self.sn = header.vers, header.size, header.sn
+        self.sec, self.usec, self.cmd = header.sec, header.usec, header.cmd
+        self.rows, self.cols = header.rows, header.cols
+        self.err, self.flags, self.name = header.err, header.flags, header.name
+        self.time = self.sec + float(self.usec) / 1E6
+        self.type = header.type
+        if self.vers >= 3 and self.err > 0:
+            self.type = ERROR  # change message type to 'ERROR' for further processing
+
     def readHeader(self, rawstring):
         """Read the header of the message coming from stream
         Arguments:
@@ -204,7 +243,17 @@ class SpecMessage:
         Return value:
         the data read
         """
-        data = rawstring[:-1]  # remove last NULL byte
+        if codec.is_array_type(datatype):
+            # a view on rawstring, no copy
+            return codec.decode_array(
+                rawstring,
+                datatype,
+                self.rows,
+                self.cols,
+                self.packedHeaderDataFormat[0] == ">",
+            )
+
+        data = bytes(rawstring[:-1])  # remove last NULL byte
 
         if datatype == ERROR:
             return data
@@ -220,19 +269,19 @@ class SpecMessage:
 
             return data
         elif datatype == ASSOC:
-            return rawtodictonary(rawstring)
-        # elif SpecArray.isArrayType(datatype):  # from SpecClient_gevent
-        # raise TypeError("Unsupported type: array")
+            return rawtodictonary(bytes(rawstring))
         else:
             raise TypeError
 
     def dataType(self, data):
         """Try to guess data type
         Works for obvious cases only
-          - it is a hard job guessing ARRAY_* types, we ignore this case (user has to provide a suitable datatype)
+          - ARRAY_* types are guessed from the numpy arrays dtype
           - we cannot make a difference between ERROR type and STRING type
         """
-        if isinstance(data, (bytes, str)):
+        if isinstance(data, numpy.ndarray):
+            return codec.array_type(data)
+        elif isinstance(data, (bytes, str)):
             return STRING
         elif isinstance(data, dict):
             return ASSOC
@@ -243,7 +292,10 @@ class SpecMessage:
         """Return the string representing the data part of the message."""
         rawstring = ""
 
-        if datatype in (ERROR, STRING, DOUBLE):
+        if codec.is_array_type(datatype):
+            order = self.packedHeaderDataFormat[0]
+            return codec.encode_array(data, datatype, order) + NULL.encode()
+        elif datatype in (ERROR, STRING, DOUBLE):
             rawstring = str(data)
         elif datatype == ASSOC:
             rawstring = dictionarytoraw(data)
@@ -282,6 +334,8 @@ class message2(SpecMessage):
         self.cols = cols
         self.data = data
         self.type = datatype or self.dataType(self.data)
+        if codec.is_array_type(self.type) and not (rows or cols):
+            self.rows, self.cols = codec.array_shape(self.data)
         self.time = time.time()
         self.sec = int(self.time)
         self.usec = int((self.time - self.sec) * 1E6)
@@ -300,7 +354,7 @@ class message2(SpecMessage):
         # self.size, 'cmd=', self.cmd, 'type=', datatype, 'datalen=', datalen,
         # 'err=', self.err, 'name=', str(self.name)
         self.time = self.sec + float(self.usec) / 1E6
-        self.name = name.replace(NULL, "")  # remove padding null bytes
+        self.name = name.decode().replace(NULL, "")  # remove padding null bytes
 
         return (datatype, datalen)
 
@@ -325,7 +379,7 @@ class message2(SpecMessage):
             self.rows,
             self.cols,
             datalen,
-            str(self.name),
+            self.name.encode(),
         )
         # print 'WRITE header', self.magic, 'vers=', self.vers, 'size=', self.size, 'cmd=', self.cmd, 'type=', self.type, 'datalen=', datalen, 'err=', self.err, 'name=', str(self.name)
         # print 'WRITE data', data
@@ -348,6 +402,8 @@ class message3(SpecMessage):
         self.cols = cols
         self.data = data
         self.type = datatype or self.dataType(self.data)
+        if codec.is_array_type(self.type) and not (rows or cols):
+            self.rows, self.cols = codec.array_shape(self.data)
         self.time = time.time()
         self.sec = int(self.time)
         self.usec = int((self.time - self.sec) * 1E6)
@@ -364,7 +420,7 @@ class message3(SpecMessage):
             )
         # print 'READ header', self.magic, 'vers=', self.vers, 'size=', self.size, 'cmd=', self.cmd, 'type=', datatype, 'datalen=', datalen, 'err=', self.err, 'name=', str(self.name)
         self.time = self.sec + float(self.usec) / 1E6
-        self.name = name.replace(NULL, "")  # remove padding null bytes
+        self.name = name.decode().replace(NULL, "")  # remove padding null bytes
 
         if self.err > 0:
             datatype = ERROR  # change message type to 'ERROR' for further processing
@@ -393,7 +449,7 @@ class message3(SpecMessage):
             self.cols,
             datalen,
             self.err,
-            str(self.name),
+            self.name.encode(),
         )
 
         # print 'WRITE header', self.magic, 'vers=', self.vers, 'size=', self.size, 'cmd=', self.cmd, 'type=', self.type, 'datalen=', datalen, 'err=', self.err, 'name=', str(self.name)
@@ -417,6 +473,8 @@ class message4(SpecMessage):
         self.cols = cols
         self.data = data
         self.type = datatype or self.dataType(self.data)
+        if codec.is_array_type(self.type) and not (rows or cols):
+            self.rows, self.cols = codec.array_shape(self.data)
         self.time = time.time()
         self.sec = int(self.time)
         self.usec = int((self.time - self.sec) * 1E6)
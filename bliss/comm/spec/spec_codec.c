@@ -0,0 +1,118 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <string.h>
+#include "spec_codec.h"
+
+#define SPEC_MAGIC_NUMBER 4277009102U
+#define SPEC_NAME_SIZE 80
+
+static unsigned int _get(const unsigned char *p,int big_endian)
+{
+  if(big_endian)
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 |
+      (unsigned int)p[2] << 8 | p[3];
+  return (unsigned int)p[3] << 24 | (unsigned int)p[2] << 16 |
+    (unsigned int)p[1] << 8 | p[0];
+}
+
+/* magic,vers,size,sn,sec,usec,cmd,type,rows,cols,len then
+ * v3: err, v4: err,flags then the name
+ */
+static unsigned int _header_size(int vers)
+{
+  if(vers == 2)
+    return 11 * 4 + SPEC_NAME_SIZE;
+  if(vers == 3)
+    return 12 * 4 + SPEC_NAME_SIZE;
+  return 13 * 4 + SPEC_NAME_SIZE;
+}
+
+int spec_codec_abi_version(void)
+{
+  return SPEC_CODEC_ABI_VERSION;
+}
+
+int spec_codec_parse(const char *buf,size_t len,spec_codec_header *header)
+{
+  const unsigned char *p = (const unsigned char*)buf;
+  unsigned int aHeaderSize,aNameOffset = 44;
+  int aBigEndian;
+
+  if(len < 8)
+    return 0;
+  if(_get(p,0) == SPEC_MAGIC_NUMBER)
+    aBigEndian = 0;
+  else if(_get(p,1) == SPEC_MAGIC_NUMBER)
+    aBigEndian = 1;
+  else
+    return -1;
+  header->vers = (int)_get(p + 4,aBigEndian);
+  if(header->vers < 2)
+    return -1;
+  aHeaderSize = _header_size(header->vers);
+  if(len < aHeaderSize)
+    return 0;
+
+  header->big_endian = aBigEndian;
+  header->header_size = aHeaderSize;
+  header->size = _get(p + 8,aBigEndian);
+  header->sn = _get(p + 12,aBigEndian);
+  header->sec = _get(p + 16,aBigEndian);
+  header->usec = _get(p + 20,aBigEndian);
+  header->cmd = (int)_get(p + 24,aBigEndian);
+  header->type = (int)_get(p + 28,aBigEndian);
+  header->rows = _get(p + 32,aBigEndian);
+  header->cols = _get(p + 36,aBigEndian);
+  header->len = _get(p + 40,aBigEndian);
+  header->err = 0;
+  header->flags = 0;
+  if(header->vers >= 3)
+    {
+      header->err = (int)_get(p + 44,aBigEndian);
+      aNameOffset += 4;
+    }
+  if(header->vers >= 4)
+    {
+      header->flags = (int)_get(p + 48,aBigEndian);
+      aNameOffset += 4;
+    }
+  /* padded with null bytes */
+  memcpy(header->name,p + aNameOffset,SPEC_NAME_SIZE);
+  header->name[SPEC_NAME_SIZE] = '\0';
+  return (int)aHeaderSize;
+}
+
+int spec_codec_scan(const char *buf,size_t len,spec_codec_header *headers,int max,
+		    size_t *consumed)
+{
+  size_t anOffset = 0;
+  int aNbMessages = 0;
+
+  while(aNbMessages < max)
+    {
+      spec_codec_header *aHeader = headers + aNbMessages;
+      int aHeaderSize = spec_codec_parse(buf + anOffset,len - anOffset,aHeader);
+      if(aHeaderSize < 0)
+	{
+	  if(!aNbMessages)
+	    {
+	      *consumed = 0;
+	      return -1;
+	    }
+	  break;
+	}
+      if(!aHeaderSize || len - anOffset - aHeaderSize < aHeader->len)
+	break;
+      aHeader->offset = anOffset;
+      anOffset += aHeaderSize + aHeader->len;
+      ++aNbMessages;
+    }
+  *consumed = anOffset;
+  return aNbMessages;
+}
@@ -0,0 +1,68 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Header codec of the SPEC server protocol (bliss/comm/spec/codec.py).
+ *
+ * A SPEC message is a header followed by len bytes of data. The header
+ * layout depends on its version (2, 3 or 4, the later ones append the
+ * err and flags fields), its byte order is given by the magic number.
+ * spec_codec_scan() locates all the complete messages of a receive
+ * buffer in one call, the data is left in place for the caller to decode
+ * (numpy views for the arrays).
+ *
+ * The part between the CFFI markers is read by cffi (comm/spec/codec.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __SPEC_CODEC
+#define __SPEC_CODEC
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {SPEC_CODEC_ABI_VERSION = 1};
+
+typedef struct
+{
+  int		vers;
+  unsigned int	size;
+  unsigned int	sn;
+  unsigned int	sec,usec;
+  int		cmd;
+  int		type;
+  unsigned int	rows,cols;
+  unsigned int	len;		/* of the data following the header */
+  int		err;		/* version >= 3 */
+  int		flags;		/* version >= 4 */
+  char		name[81];
+  int		big_endian;
+  unsigned int	header_size;
+  size_t	offset;		/* of the header in the scanned buffer */
+} spec_codec_header;
+
+int spec_codec_abi_version(void);
+
+/* decode the header at the start of buf: its size, 0 if buf is too
+ * short, -1 if it is not a SPEC header (magic number or version)
+ */
+int spec_codec_parse(const char *buf,size_t len,spec_codec_header *header);
+
+/* decode the headers of up to max complete messages from the start of
+ * buf: the number of messages, *consumed their total size. -1 if the
+ * first header is invalid, an invalid header after complete messages
+ * stops the scan (it is then first in the next one).
+ */
+int spec_codec_scan(const char *buf,size_t len,spec_codec_header *headers,int max,
+		    size_t *consumed);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -30,13 +30,14 @@ Original source: http://svn.python.org/projects/python/trunk/Demo/rpc/rpc.py
 
 """
 
-import xdrlib
 import socket
 import sys
 import struct
 import functools
 import gevent
 
+from bliss.comm import xdr
+
 RPCVERSION = 2
 
 CALL = 0
@@ -90,7 +91,7 @@ def make_auth_null():
     return b""
 
 
-class Packer(xdrlib.Packer):
+class Packer(xdr.Packer):
     def pack_auth(self, auth):
         flavor, stuff = auth
         self.pack_enum(flavor)
@@ -125,7 +126,7 @@ class Packer(xdrlib.Packer):
         # Caller must add procedure-specific part of reply
 
 
-class Unpacker(xdrlib.Unpacker):
+class Unpacker(xdr.Unpacker):
     def unpack_auth(self):
         flavor = self.unpack_enum()
         stuff = self.unpack_opaque()
@@ -268,29 +269,8 @@ def sendrecord(sock, record):
         sendfrag(sock, 1, record)
 
 
-def recvfrag(sock):
-    header = sock.recv(4)
-    if len(header) < 4:
-        raise EOFError
-    x = struct.unpack(">I", header[0:4])[0]
-    last = (x & 0x80000000) != 0
-    n = int(x & 0x7fffffff)
-    frag = bytearray()
-    while len(frag) < n:
-        buf = sock.recv(n - len(frag))
-        if not buf:
-            raise EOFError
-        frag.extend(buf)
-    return last, frag
-
-
 def recvrecord(sock):
-    record = bytearray()
-    last = 0
-    while not last:
-        last, frag = recvfrag(sock)
-        record.extend(frag)
-    return bytes(record)
+    return bytes(xdr.RecordReader().recv(sock))
 
 
 # Client using TCP to a specific port
@@ -304,15 +284,17 @@ class RawTCPClient(Client):
     def connect(self):
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.sock.connect((self.host, self.port))
+        self.records = xdr.RecordReader()
 
     def close(self):
         self.sock.close()
 
     def do_call(self):
-        call = self.packer.get_buf()
+        call = self.packer.get_view()
         sendrecord(self.sock, call)
         while True:
-            reply = recvrecord(self.sock)
+            # a view on the receive buffer, unpacked before the next call
+            reply = self.records.recv(self.sock)
             u = self.unpacker
             u.reset(reply)
             xid, verf = u.unpack_replyheader()
@@ -750,9 +732,10 @@ class TCPServer(Server):
 
     def session(self, connection):
         sock, (host, port) = connection
+        records = xdr.RecordReader()
         while 1:
             try:
-                call = recvrecord(sock)
+                call = records.recv(sock)
             except EOFError:
                 break
             except socket.error:
@@ -8,7 +8,6 @@ import os
 import enum
 import socket
 import numpy
-import xdrlib
 from collections import namedtuple
 from ..sunrpc import Packer, Unpacker, UDPClient, TCPClient
 
@@ -178,8 +177,6 @@ class _ClientPacker(Packer):
         self.pack_int(0)
         self.pack_array([], self.pack_string)
 
-    # @xdrlib.raise_conversion_error
-
     def pack_dev_int(self, x):
         self.pack_uint(1)
         self.pack_int(x)
@@ -203,31 +200,31 @@ class _ClientPacker(Packer):
         self.pack_uint(1)
         arr = numpy.array(x, dtype=numpy.int8)
         self.pack_uint(len(arr))
-        self._Packer__buf.write(arr.tobytes())
+        self.pack_raw(arr.tobytes())
 
     def pack_dev_shortarr(self, x):
         self.pack_uint(1)
         arr = numpy.array(x, dtype=numpy.int16)
         self.pack_uint(len(arr))
-        self._Packer__buf.write(arr.tobytes())
+        self.pack_raw(arr.tobytes())
 
     def pack_dev_intarr(self, x):
         self.pack_uint(1)
         arr = numpy.array(x, dtype=numpy.int32)
         self.pack_uint(len(arr))
-        self._Packer__buf.write(arr.tobytes())
+        self.pack_raw(arr.tobytes())
 
     def pack_dev_floatarr(self, x):
         self.pack_uint(1)
         arr = numpy.array(x, dtype=numpy.float32)
         self.pack_uint(len(arr))
-        self._Packer__buf.write(arr.tobytes())
+        self.pack_raw(arr.tobytes())
 
     def pack_dev_doublearr(self, x):
         self.pack_uint(1)
         arr = numpy.array(x, dtype=numpy.double)
         self.pack_uint(len(arr))
-        self._Packer__buf.write(arr.tobytes())
+        self.pack_raw(arr.tobytes())
 
     def pack_server_data(self, args):
         """
@@ -350,39 +347,15 @@ class _ClientUnPacker(Unpacker):
 
     def unpack_dev_intarr(self):
         nb = self.unpack_uint()
-        nb_element = self.unpack_uint()
-        i = self.get_position()
-        j = i + nb_element * 4
-        self.set_position(j)
-        buf = self.get_buffer()
-        data = buf[i:j]
-        if len(data) < nb_element * 4:
-            raise EOFError
-        return numpy.frombuffer(data, dtype=">i4")
+        return self.unpack_numbers("i4")
 
     def unpack_dev_floatarr(self):
         nb = self.unpack_uint()
-        nb_element = self.unpack_uint()
-        i = self.get_position()
-        j = i + nb_element * 4
-        self.set_position(j)
-        buf = self.get_buffer()
-        data = buf[i:j]
-        if len(data) < nb_element * 4:
-            raise EOFError
-        return numpy.frombuffer(data, dtype=">f4")
+        return self.unpack_numbers("f4")
 
     def unpack_dev_doublearr(self):
         nb = self.unpack_uint()
-        nb_element = self.unpack_uint()
-        i = self.get_position()
-        j = i + nb_element * 8
-        self.set_position(j)
-        buf = self.get_buffer()
-        data = buf[i:j]
-        if len(data) < nb_element * 8:
-            raise EOFError
-        return numpy.frombuffer(data, dtype=">d")
+        return self.unpack_numbers("f8")
 
     def unpack_client_data_header(self):
         status = self.unpack_int()
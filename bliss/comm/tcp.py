@@ -13,6 +13,7 @@ __all__ = ["Tcp", "Socket", "Command"]
 
 import re
 import errno
+import logging
 import gevent
 from gevent import socket, event, queue, lock
 import time
@@ -21,6 +22,8 @@ from functools import wraps
 from bliss.common.event import send
 
 from .exceptions import CommunicationError, CommunicationTimeout
+from .ringbuffer import RingBuffer
+from .scpi_block import BlockReader
 from ..common.greenlet_utils import KillMask
 
 from bliss.common.cleanup import error_cleanup, capture_exceptions
@@ -88,7 +91,7 @@ class BaseSocket:
         self._timeout = timeout
         self._connected = False
         self._eol = eol
-        self._data = b""
+        self._data = RingBuffer()
         self._event = event.Event()
         self._raw_read_task = None
         self._lock = lock.RLock()
@@ -159,7 +162,7 @@ class BaseSocket:
                 if self._raw_read_task:
                     self._raw_read_task.kill()
                     self._raw_read_task = None
-                self._data = b""
+                self._data.clear()
                 self._connected = False
                 self._socket = None
                 send(self, "connect", False)
@@ -181,12 +184,10 @@ class BaseSocket:
                 if not self._connected:
                     raise socket.error(errno.EPIPE, "Broken pipe")
         if maxsize:
-            msg = self._data[:maxsize]
-            self._data = self._data[maxsize:]
+            msg = self._data.read(maxsize)
             log_debug_data(self, "raw_read", msg)
         else:
-            msg = self._data
-            self._data = b""
+            msg = self._data.read()
             log_debug(self, "raw_read 0 bytes")
         return msg
 
@@ -214,9 +215,8 @@ class BaseSocket:
                             break
                     if not self._connected:
                         raise socket.error(errno.EPIPE, "Broken pipe")
-            msg = self._data[:size]
+            msg = self._data.read(size)
             log_debug_data(self, "read", msg)
-            self._data = self._data[size:]
             return msg
 
     @try_connect_socket
@@ -234,11 +234,13 @@ class BaseSocket:
                     local_eol = local_eol.encode()
                 eol_pos = self._data.find(local_eol)
                 while eol_pos == -1:
+                    # only search the new data
+                    start = max(len(self._data) - len(local_eol) + 1, 0)
                     with capture():
                         self._event.wait()
                         self._event.clear()
 
-                    eol_pos = self._data.find(local_eol)
+                    eol_pos = self._data.find(local_eol, start)
 
                     if capture.failed:
                         other_exc = [
@@ -254,11 +256,39 @@ class BaseSocket:
                     if not self._connected:
                         raise socket.error(errno.EPIPE, "Broken pipe")
 
-            msg = self._data[:eol_pos]
-            self._data = self._data[eol_pos + len(local_eol) :]
+            msg = self._data.read(eol_pos)
+            self._data.consume(len(local_eol))
             log_debug_data(self, "readline", msg)
             return msg
 
+    @try_connect_socket
+    def read_block(self, dtype="u1", out=None, scaling=None, eol=None, timeout=None):
+        """Read an IEEE 488.2 binary block (SCPI waveform data), decoded
+        from the receive buffer as it arrives (see scpi_block.BlockReader).
+
+        dtype -- numpy dtype of the block values, with their byte order
+        out -- optional preallocated array receiving the values
+        scaling -- optional (offset, scale, zero): return the float64
+                   values (value - offset) * scale + zero
+        eol -- message terminator after the block, default to the socket eol
+        """
+        return self._read_block(dtype, out, scaling, eol, timeout)
+
+    def _read_block(self, dtype="u1", out=None, scaling=None, eol=None, timeout=None):
+        local_eol = eol if eol is not None else self._eol
+        if not isinstance(local_eol, bytes):
+            local_eol = local_eol.encode()
+        reader = BlockReader(dtype, out, scaling, local_eol)
+        timeout_errmsg = "timeout on socket(%s, %d)" % (self._host, self._port)
+        with gevent.Timeout(timeout or self._timeout, SocketTimeout(timeout_errmsg)):
+            while not reader.feed(self._data):
+                self._event.wait()
+                self._event.clear()
+                if not self._connected and not reader.feed(self._data):
+                    raise socket.error(errno.EPIPE, "Broken pipe")
+        log_debug(self, "read_block %d bytes", reader.nbytes)
+        return reader.data
+
     @try_connect_socket
     def write(self, msg, timeout=None):
         with self._lock:
@@ -286,6 +316,23 @@ class BaseSocket:
                     write_synchro.notify()
                 return self.readline(eol=eol, timeout=timeout)
 
+    @try_connect_socket
+    def write_read_block(
+        self,
+        msg,
+        dtype="u1",
+        out=None,
+        scaling=None,
+        write_synchro=None,
+        eol=None,
+        timeout=None,
+    ):
+        with self._lock:
+            self._sendall(msg)
+            if write_synchro:
+                write_synchro.notify()
+            return self._read_block(dtype, out, scaling, eol, timeout)
+
     @try_connect_socket
     def write_readlines(
         self, msg, nb_lines, write_synchro=None, eol=None, timeout=None
@@ -315,7 +362,7 @@ class BaseSocket:
                 return str_list
 
     def flush(self):
-        self._data = b""
+        self._data.clear()
         log_debug(self, "flush")
 
     def _sendall(self, data):
@@ -348,11 +395,15 @@ class Socket(BaseSocket):
     @staticmethod
     def _raw_read(sock, fd):
         try:
+            data = sock._data
             while 1:
-                raw_data = fd.recv(16 * 1024)
-                if raw_data:
-                    log_debug_data(sock, "received", raw_data)
-                    sock._data += raw_data
+                # receive into the free space of the buffer
+                view = data.reserve(16 * 1024)
+                nbytes = fd.recv_into(view[: 64 * 1024])
+                if nbytes:
+                    data.commit(nbytes)
+                    if get_logger(sock).isEnabledFor(logging.DEBUG):
+                        log_debug_data(sock, "received", bytes(view[:nbytes]))
                     sock._event.set()
                     # Give the hand to other greenlet in case
                     # of fast stream
@@ -552,15 +603,18 @@ class Command:
             with gevent.Timeout(
                 timeout or self._timeout, CommandTimeout(timeout_errmsg)
             ):
-                ctx.data = b""
-                while len(ctx.data) < size:
-                    read_value = transaction.get()
-                    if isinstance(read_value, socket.error):
-                        raise read_value
-                    ctx.data += read_value
-
-                msg = ctx.data[:size]
-                ctx.data = ctx.data[size:]
+                data = RingBuffer()
+                try:
+                    while len(data) < size:
+                        read_value = transaction.get()
+                        if isinstance(read_value, socket.error):
+                            raise read_value
+                        data.write(read_value)
+
+                    msg = data.read(size)
+                finally:
+                    # the rest goes to the next transaction
+                    ctx.data = data.read()
         log_debug_data(self, "read", msg)
         return msg
 
@@ -574,17 +628,21 @@ class Command:
                 local_eol = eol or self._eol
                 if not isinstance(local_eol, bytes):
                     local_eol = local_eol.encode()
-                ctx.data = b""
+                data = RingBuffer()
                 eol_pos = -1
-                while eol_pos == -1:
-                    read_value = transaction.get()
-                    if isinstance(read_value, socket.error):
-                        raise read_value
-                    ctx.data += read_value
-                    eol_pos = ctx.data.find(local_eol)
-
-                msg = ctx.data[:eol_pos]
-                ctx.data = ctx.data[eol_pos + len(local_eol) :]
+                try:
+                    while eol_pos == -1:
+                        read_value = transaction.get()
+                        if isinstance(read_value, socket.error):
+                            raise read_value
+                        start = max(len(data) - len(local_eol) + 1, 0)
+                        data.write(read_value)
+                        eol_pos = data.find(local_eol, start)
+
+                    msg = data.read(eol_pos)
+                    data.consume(len(local_eol))
+                finally:
+                    ctx.data = data.read()
 
         log_debug_data(self, "readline", msg)
         return msg
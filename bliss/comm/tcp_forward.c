@@ -0,0 +1,259 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "tcp_forward.h"
+
+#define DEFAULT_PIPE_SIZE 65536
+/* on a wake, time given to flush the pipes */
+#define WAKE_FLUSH_MS 100
+
+/* one way of the forwarding: src -> pipe -> dst */
+struct direction
+{
+  int			src,dst;
+  int			pipe[2];
+  size_t		capacity;
+  size_t		in_pipe;
+  int			eof;		/* src closed, flush the pipe then stop */
+  int			failed;		/* dst failed */
+  unsigned long long	forwarded;
+};
+
+static int _open_pipe(struct direction *d,int pipe_size)
+{
+  int aSize;
+  if(pipe2(d->pipe,O_NONBLOCK | O_CLOEXEC))
+    return -errno;
+  aSize = fcntl(d->pipe[1],F_SETPIPE_SZ,pipe_size > 0 ? pipe_size : DEFAULT_PIPE_SIZE);
+  if(aSize <= 0)
+    aSize = fcntl(d->pipe[1],F_GETPIPE_SZ);
+  d->capacity = aSize > 0 ? (size_t)aSize : DEFAULT_PIPE_SIZE;
+  return 0;
+}
+
+static void _close_pipe(struct direction *d)
+{
+  if(d->pipe[0] >= 0)
+    close(d->pipe[0]);
+  if(d->pipe[1] >= 0)
+    close(d->pipe[1]);
+}
+
+static void _drain(struct direction *d)
+{
+  while(d->in_pipe && !d->failed)
+    {
+      ssize_t n = splice(d->pipe[0],NULL,d->dst,NULL,d->in_pipe,
+			 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if(n > 0)
+	{
+	  d->in_pipe -= n;
+	  d->forwarded += n;
+	}
+      else if(n < 0 && errno == EINTR)
+	continue;
+      else
+	{
+	  if(n == 0 || errno != EAGAIN)
+	    d->failed = 1;
+	  break;
+	}
+    }
+}
+
+static void _fill(struct direction *d)
+{
+  while(!d->eof && d->in_pipe < d->capacity)
+    {
+      ssize_t n = splice(d->src,NULL,d->pipe[1],NULL,d->capacity - d->in_pipe,
+			 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if(n > 0)
+	d->in_pipe += n;
+      else if(n < 0 && errno == EINTR)
+	continue;
+      else
+	{
+	  /* a reset or an error ends the src as a close */
+	  if(n == 0 || errno != EAGAIN)
+	    d->eof = 1;
+	  break;
+	}
+    }
+  /* forward now, without waiting for the next epoll round */
+  _drain(d);
+}
+
+static long _now_ms(void)
+{
+  struct timespec aNow;
+  clock_gettime(CLOCK_MONOTONIC,&aNow);
+  return aNow.tv_sec * 1000L + aNow.tv_nsec / 1000000L;
+}
+
+/* events wanted on fd: read for its outgoing direction, write for
+ * its incoming one
+ */
+static unsigned int _interest(const struct direction *out,const struct direction *in,
+			      int waking)
+{
+  unsigned int anEvents = 0;
+  if(!waking && !out->eof && out->in_pipe < out->capacity)
+    anEvents |= EPOLLIN;
+  if(in->in_pipe && !in->failed)
+    anEvents |= EPOLLOUT;
+  return anEvents;
+}
+
+static int _update(int epoll_fd,int fd,unsigned int *current,unsigned int wanted)
+{
+  struct epoll_event anEvent;
+  if(*current == wanted)
+    return 0;
+  anEvent.events = wanted;
+  anEvent.data.fd = fd;
+  if(epoll_ctl(epoll_fd,EPOLL_CTL_MOD,fd,&anEvent))
+    return -errno;
+  *current = wanted;
+  return 0;
+}
+
+int tcp_forward_abi_version(void)
+{
+  return TCP_FORWARD_ABI_VERSION;
+}
+
+int tcp_forward(int client_fd,int dest_fd,const int *wake_fds,int nb_wake_fds,
+		int *ready_fd,int pipe_size,tcp_forward_stats *stats)
+{
+  struct direction aToDest = {client_fd,dest_fd,{-1,-1},0,0,0,0,0};
+  struct direction aToClient = {dest_fd,client_fd,{-1,-1},0,0,0,0,0};
+  unsigned int aClientEvents = EPOLLIN,aDestEvents = EPOLLIN;
+  struct epoll_event anEvent;
+  int anEpoll = -1,aResult = 0,aWakeFd = -1,i;
+  long aWakeDeadline = 0;
+
+  *ready_fd = -1;
+  if((aResult = _open_pipe(&aToDest,pipe_size)) ||
+     (aResult = _open_pipe(&aToClient,pipe_size)))
+    goto end;
+  anEpoll = epoll_create1(EPOLL_CLOEXEC);
+  if(anEpoll < 0)
+    {
+      aResult = -errno;
+      goto end;
+    }
+  anEvent.events = EPOLLIN;
+  anEvent.data.fd = client_fd;
+  if(epoll_ctl(anEpoll,EPOLL_CTL_ADD,client_fd,&anEvent))
+    {
+      aResult = -errno;
+      goto end;
+    }
+  anEvent.data.fd = dest_fd;
+  if(epoll_ctl(anEpoll,EPOLL_CTL_ADD,dest_fd,&anEvent))
+    {
+      aResult = -errno;
+      goto end;
+    }
+  for(i = 0;i < nb_wake_fds;++i)
+    {
+      anEvent.data.fd = wake_fds[i];
+      if(epoll_ctl(anEpoll,EPOLL_CTL_ADD,wake_fds[i],&anEvent))
+	{
+	  aResult = -errno;
+	  goto end;
+	}
+    }
+
+  while(1)
+    {
+      struct epoll_event anEvents[8];
+      int aTimeout = -1,aNbEvents;
+
+      if(aToDest.failed || (aToClient.eof && !aToClient.in_pipe))
+	{
+	  aResult = TCP_FORWARD_DEST_CLOSED;
+	  break;
+	}
+      if(aToClient.failed || (aToDest.eof && !aToDest.in_pipe))
+	{
+	  aResult = TCP_FORWARD_CLIENT_CLOSED;
+	  break;
+	}
+      if(aWakeFd >= 0)
+	{
+	  /* stop reading, flush what is already in the pipes */
+	  long aLeft = aWakeDeadline - _now_ms();
+	  if((!aToDest.in_pipe && !aToClient.in_pipe) || aLeft <= 0)
+	    {
+	      *ready_fd = aWakeFd;
+	      aResult = TCP_FORWARD_WAKE;
+	      break;
+	    }
+	  aTimeout = (int)aLeft;
+	}
+      if((aResult = _update(anEpoll,client_fd,&aClientEvents,
+			    _interest(&aToDest,&aToClient,aWakeFd >= 0))) ||
+	 (aResult = _update(anEpoll,dest_fd,&aDestEvents,
+			    _interest(&aToClient,&aToDest,aWakeFd >= 0))))
+	break;
+
+      aNbEvents = epoll_wait(anEpoll,anEvents,8,aTimeout);
+      if(aNbEvents < 0)
+	{
+	  if(errno == EINTR)
+	    continue;
+	  aResult = -errno;
+	  break;
+	}
+      for(i = 0;i < aNbEvents;++i)
+	{
+	  int aFd = anEvents[i].data.fd;
+	  unsigned int aFlags = anEvents[i].events;
+	  struct direction *anOut,*anIn;
+	  if(aFd != client_fd && aFd != dest_fd)
+	    {
+	      /* a wake fd, level triggered: stop watching them */
+	      if(aWakeFd < 0)
+		{
+		  int j;
+		  aWakeFd = aFd;
+		  aWakeDeadline = _now_ms() + WAKE_FLUSH_MS;
+		  for(j = 0;j < nb_wake_fds;++j)
+		    epoll_ctl(anEpoll,EPOLL_CTL_DEL,wake_fds[j],NULL);
+		}
+	      continue;
+	    }
+	  anOut = aFd == client_fd ? &aToDest : &aToClient;
+	  anIn = aFd == client_fd ? &aToClient : &aToDest;
+	  if(aFlags & (EPOLLOUT | EPOLLERR))
+	    _drain(anIn);
+	  if(aWakeFd < 0 && (aFlags & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+	    _fill(anOut);
+	}
+    }
+
+ end:
+  if(stats)
+    {
+      stats->to_dest = aToDest.forwarded;
+      stats->to_client = aToClient.forwarded;
+    }
+  if(anEpoll >= 0)
+    close(anEpoll);
+  _close_pipe(&aToDest);
+  _close_pipe(&aToClient);
+  return aResult;
+}
+
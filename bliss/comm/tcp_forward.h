@@ -0,0 +1,59 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Forwarding core of the tcp proxy server (bliss/comm/tcp_proxy.py).
+ *
+ * tcp_forward() moves the bytes between the client and the destination
+ * sockets in both directions with splice(2) through a pipe per
+ * direction, the data never goes through user space. It waits with
+ * epoll and returns when a socket is closed or when one of the wake
+ * file descriptors (listening socket, stop pipe) is readable, the caller
+ * then handles that event as before. On a wake the bytes already in the
+ * pipes are flushed first, for at most 100 ms. The sockets may be non
+ * blocking. Linux only.
+ *
+ * The part between the CFFI markers is read by cffi (comm/tcp_forward.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __TCP_FORWARD
+#define __TCP_FORWARD
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {TCP_FORWARD_ABI_VERSION = 1};
+
+enum
+  {
+    TCP_FORWARD_CLIENT_CLOSED = 1,	/* client closed or failed */
+    TCP_FORWARD_DEST_CLOSED = 2,	/* destination closed or failed */
+    TCP_FORWARD_WAKE = 3		/* *ready_fd is readable */
+  };
+
+typedef struct
+{
+  unsigned long long	to_dest;	/* bytes forwarded */
+  unsigned long long	to_client;
+} tcp_forward_stats;
+
+int tcp_forward_abi_version(void);
+
+/* one of the codes above, -errno if the pipes or epoll can't be set up;
+ * pipe_size: size asked for the pipes (0 for the default), stats may be
+ * NULL
+ */
+int tcp_forward(int client_fd,int dest_fd,const int *wake_fds,int nb_wake_fds,
+		int *ready_fd,int pipe_size,tcp_forward_stats *stats);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,52 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Native forwarding core of the tcp proxy server (see tcp_forward.h).
+
+The library is looked up, in this order:
+
+- the path given by the ``BLISS_TCP_FORWARD_LIBRARY`` environment variable
+- the ``_tcp_forward`` library built by setup.py on Linux (opt-in, see
+  ``BLISS_BUILD_COMM_TCP_FORWARD``) next to this file
+
+``lib`` is None when no library is found, the proxy server then forwards
+with select and recv/sendall.
+"""
+
+import os
+
+from . import native
+
+ffi, lib = native.load(__file__, "tcp_forward", "BLISS_TCP_FORWARD_LIBRARY")
+
+# TCP_FORWARD_* codes of tcp_forward.h
+CLIENT_CLOSED, DEST_CLOSED, WAKE = 1, 2, 3
+
+
+def _fileno(fd):
+    return fd if isinstance(fd, int) else fd.fileno()
+
+
+def forward(client, dest, wake, pipe_size=0):
+    """Forward the bytes between the client and dest sockets (or file
+    descriptors) until one is closed or one of wake is readable.
+
+    Blocks without the GIL: run it in a thread (gevent threadpool) to keep
+    the greenlets running. Return a tuple (code, ready_fd, (to_dest,
+    to_client)) where code is CLIENT_CLOSED, DEST_CLOSED or WAKE, ready_fd
+    the readable wake file descriptor and the last item the forwarded
+    bytes.
+    """
+    wake_fds = [_fileno(fd) for fd in wake]
+    ready = ffi.new("int *")
+    stats = ffi.new("tcp_forward_stats *")
+    code = lib.tcp_forward(
+        _fileno(client), _fileno(dest), wake_fds, len(wake_fds), ready, pipe_size, stats
+    )
+    if code < 0:
+        raise OSError(-code, os.strerror(-code))
+    return code, ready[0], (stats.to_dest, stats.to_client)
@@ -11,6 +11,7 @@ import gevent
 from gevent import socket, select, event
 
 from bliss.comm.tcp import Tcp
+from bliss.comm import tcp_forward
 from bliss.config.conductor.client import Lock
 from bliss.config.channels import Channel
 
@@ -140,6 +141,102 @@ class Proxy(object):
             return wait_greenlet
 
 
+def serve(server, host, port, stop_fd, native=True):
+    """Forward the connections accepted on the server socket to host:port,
+    one client at a time (a new client replaces the previous one) and the
+    destination connection kept between clients, until stop_fd is
+    readable.
+
+    The bytes go through the native forwarding core (tcp_forward, splice
+    without copy to user space) when it is available and native is True,
+    else through select and recv/sendall.
+    """
+    native = native and tcp_forward.lib is not None
+    fd_list = [server, stop_fd]
+    client = None
+    dest = None
+    while True:
+        if native and client is not None and dest is not None:
+            try:
+                code, ready, _ = gevent.get_hub().threadpool.apply(
+                    tcp_forward.forward, (client, dest, (server, stop_fd))
+                )
+            except OSError:
+                # pipes or epoll can't be set up, forward from Python
+                native = False
+                continue
+            if code == tcp_forward.WAKE:
+                rlist = [server if ready == server.fileno() else stop_fd]
+            else:
+                if code == tcp_forward.DEST_CLOSED:
+                    dest.close()
+                    fd_list.remove(dest)
+                    dest = None
+                fd_list.remove(client)
+                client.close()
+                client = None
+                continue
+        else:
+            rlist, _, _ = select.select(fd_list, [], [])
+        for s in rlist:
+            if s == server:
+                accept_flag = True
+                try:
+                    if dest is None:
+                        dest = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+                        dest.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                        dest.connect((host, port))
+                        fd_list.append(dest)
+                except:
+                    dest = None
+                    accept_flag = False
+
+                if client is not None:
+                    fd_list.remove(client)
+                    client.close()
+                    client = None
+
+                client, addr = server.accept()
+                if accept_flag:
+                    client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                    fd_list.append(client)
+                else:
+                    client.close()
+                    client = None
+
+            elif s == client:
+                try:
+                    raw_data = client.recv(16 * 1024)
+                except:
+                    raw_data = None
+
+                if raw_data:
+                    dest.sendall(raw_data)
+                else:
+                    fd_list.remove(client)
+                    client.close()
+                    client = None
+            elif s == dest:
+                try:
+                    raw_data = dest.recv(16 * 1024)
+                except:
+                    raw_data = None
+
+                if raw_data:
+                    if client is not None:
+                        client.sendall(raw_data)
+                else:
+                    dest.close()
+                    fd_list.remove(dest)
+                    dest = None
+                    if client is not None:
+                        fd_list.remove(client)
+                        client.close()
+                        client = None
+            elif s == stop_fd:
+                return
+
+
 def main():  # proxy server part
     import signal, os
 
@@ -194,71 +291,8 @@ def main():  # proxy server part
     )
     channel = Channel(channel_name, value=server_url, callback=channel_cbk)
 
-    runFlag = True
-    fd_list = [tcp, pipe_read]
-    global client
-    global dest
-    client = None
-    dest = None
     try:
-        while runFlag:
-            rlist, _, _ = select.select(fd_list, [], [])
-            for s in rlist:
-                if s == tcp:
-                    accept_flag = True
-                    try:
-                        if dest is None:
-                            dest = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-                            dest.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
-                            dest.connect((_options.host, _options.port))
-                            fd_list.append(dest)
-                    except:
-                        dest = None
-                        accept_flag = False
-
-                    if client is not None:
-                        fd_list.remove(client)
-                        client.close()
-                        client = None
-
-                    client, addr = tcp.accept()
-                    if accept_flag:
-                        client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
-                        fd_list.append(client)
-                    else:
-                        client.close()
-                        client = None
-
-                elif s == client:
-                    try:
-                        raw_data = client.recv(16 * 1024)
-                    except:
-                        raw_data = None
-
-                    if raw_data:
-                        dest.sendall(raw_data)
-                    else:
-                        fd_list.remove(client)
-                        client.close()
-                        client = None
-                elif s == dest:
-                    try:
-                        raw_data = dest.recv(16 * 1024)
-                    except:
-                        raw_data = None
-
-                    if raw_data:
-                        client.sendall(raw_data)
-                    else:
-                        dest.close()
-                        fd_list.remove(dest)
-                        dest = None
-                        fd_list.remove(client)
-                        client.close()
-                        client = None
-                elif s == pipe_read:
-                    runFlag = False
-                    break
+        serve(tcp, _options.host, _options.port, pipe_read)
     finally:
         if dont_reset_channel is False:
             channel.value = None
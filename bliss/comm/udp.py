@@ -38,7 +38,7 @@ class Socket(BaseSocket):
                 raw_data = sock.recv(16 * 1024)
                 log_debug_data(bliss_socket, "Rx:", raw_data)
                 if raw_data:
-                    bliss_socket._data += raw_data
+                    bliss_socket._data.write(raw_data)
                     bliss_socket._event.set()
                 else:
                     break
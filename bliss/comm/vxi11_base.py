@@ -737,11 +737,14 @@ class Device(object):
 
         offset = 0
 
+        # blocks are packed from the data without copy
+        view = memoryview(data)
+
         while num > 0:
             if num <= self.max_recv_size:
                 flags |= OP_FLAG_END
 
-            block = data[offset : offset + self.max_recv_size]
+            block = view[offset : offset + self.max_recv_size]
 
             error, size = self.client.device_write(
                 self.link, self._timeout_ms, self._lock_timeout_ms, flags, block
@@ -773,7 +776,8 @@ class Device(object):
             flags = OP_FLAG_TERMCHAR_SET
             term_char = self.term_char
 
-        read_data = bytearray()
+        # the received blocks, joined once at the end
+        chunks = []
 
         while reason & (RX_END | RX_CHR) == 0:
             error, reason, data = self.client.device_read(
@@ -788,7 +792,7 @@ class Device(object):
             if error:
                 raise Vxi11Exception(error, "read")
 
-            read_data.extend(data)
+            chunks.append(data)
 
             if num > 0:
                 num = num - len(data)
@@ -797,7 +801,7 @@ class Device(object):
                 if num < read_len:
                     read_len = num
 
-        return bytes(read_data)
+        return chunks[0] if len(chunks) == 1 else b"".join(chunks)
 
     def ask_raw(self, data, num=-1):
         "Write then read binary data"
@@ -0,0 +1,110 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "xdr.h"
+
+/* record marking: the last fragment flag and the fragment length */
+#define LAST_FRAGMENT 0x80000000u
+#define HEADER_SIZE 4
+
+static int _host_big_endian(void)
+{
+  const uint16_t anOne = 1;
+  return !*(const unsigned char*)&anOne;
+}
+
+#define _SWAP_COPY(UTYPE,SWAP)					\
+  {								\
+    size_t i;							\
+    for(i = 0;i < nb;++i)					\
+      {								\
+	UTYPE aValue;						\
+	memcpy(&aValue,(const char*)src + i * sizeof(UTYPE),	\
+	       sizeof(UTYPE));					\
+	aValue = SWAP(aValue);					\
+	memcpy((char*)dst + i * sizeof(UTYPE),&aValue,		\
+	       sizeof(UTYPE));					\
+      }								\
+    return 0;							\
+  }
+
+int xdr_abi_version(void)
+{
+  return XDR_ABI_VERSION;
+}
+
+int xdr_record_reassemble(unsigned char *buf,xdr_record *rec,size_t max_size)
+{
+  while(1)
+    {
+      size_t anAvailable;
+      uint32_t aHeader;
+
+      if(rec->remaining)
+	{
+	  size_t aSize = rec->length - rec->pos;
+	  if(aSize > rec->remaining)
+	    aSize = rec->remaining;
+	  /* the payload follows the previous one, over its header */
+	  if(aSize && rec->pos != rec->size)
+	    memmove(buf + rec->size,buf + rec->pos,aSize);
+	  rec->size += aSize;
+	  rec->pos += aSize;
+	  rec->remaining -= aSize;
+	  if(rec->remaining)
+	    {
+	      /* all processed: the next bytes are received in place */
+	      rec->pos = rec->length = rec->size;
+	      rec->wanted = rec->remaining + (rec->last ? 0 : HEADER_SIZE);
+	      return 0;
+	    }
+	}
+      if(rec->started && rec->last)
+	{
+	  rec->wanted = 0;
+	  return 1;
+	}
+
+      anAvailable = rec->length - rec->pos;
+      if(anAvailable < HEADER_SIZE)
+	{
+	  if(rec->pos != rec->size)
+	    memmove(buf + rec->size,buf + rec->pos,anAvailable);
+	  rec->pos = rec->size;
+	  rec->length = rec->size + anAvailable;
+	  rec->wanted = HEADER_SIZE - anAvailable;
+	  return 0;
+	}
+      aHeader = ((uint32_t)buf[rec->pos] << 24) | ((uint32_t)buf[rec->pos + 1] << 16) |
+	((uint32_t)buf[rec->pos + 2] << 8) | (uint32_t)buf[rec->pos + 3];
+      rec->pos += HEADER_SIZE;
+      rec->started = 1;
+      rec->last = (aHeader & LAST_FRAGMENT) != 0;
+      rec->remaining = aHeader & ~LAST_FRAGMENT;
+      if(rec->remaining > max_size - rec->size)
+	return -1;
+    }
+}
+
+int xdr_swap_copy(const void *src,size_t nb,int width,void *dst)
+{
+  if(width != 4 && width != 8)
+    return -1;
+  if(_host_big_endian())
+    {
+      if(src != dst)
+	memmove(dst,src,nb * width);
+      return 0;
+    }
+  if(width == 4)
+    _SWAP_COPY(uint32_t,__builtin_bswap32)
+  else
+    _SWAP_COPY(uint64_t,__builtin_bswap64)
+}
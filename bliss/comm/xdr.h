@@ -0,0 +1,62 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* XDR and ONC-RPC record marking (RFC 1831/1832) for bliss/comm/xdr.py.
+ *
+ * xdr_record_reassemble() joins the fragments of a record marked stream
+ * in the receive buffer itself: the fragment headers are dropped and the
+ * payloads end up contiguous at the start of the buffer, the caller
+ * receives exactly the bytes asked for in rec->wanted so a record never
+ * has to be copied or concatenated.
+ * xdr_swap_copy() converts arrays of 4 or 8 bytes items between the XDR
+ * (big endian) and the host byte order.
+ *
+ * The part between the CFFI markers is read by cffi (comm/xdr.py), keep
+ * it free of preprocessor directives.
+ */
+#ifndef __XDR
+#define __XDR
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {XDR_ABI_VERSION = 1};
+
+/* reassembly of a record in a receive buffer, zeroed for a new record */
+typedef struct
+{
+  size_t length;		/* bytes in the buffer */
+  size_t size;			/* record bytes at the start of the buffer */
+  size_t pos;			/* first received byte not processed */
+  size_t remaining;		/* payload bytes of the fragment still to come */
+  size_t wanted;		/* bytes to receive at length next */
+  int last;			/* the fragment is the last of the record */
+  int started;			/* a fragment header was read */
+} xdr_record;
+
+int xdr_abi_version(void);
+
+/* process the received bytes buf[rec->pos:rec->length]: 1 when the record
+ * is complete (buf[0:rec->size]), 0 when rec->wanted more bytes are needed,
+ * -1 when the record gets larger than max_size.
+ */
+int xdr_record_reassemble(unsigned char *buf,xdr_record *rec,size_t max_size);
+
+/* copy nb items of width bytes (4 or 8) from src to dst swapping the byte
+ * order when the host is little endian (src and dst may be the same).
+ * 0, -1 for an unsupported width
+ */
+int xdr_swap_copy(const void *src,size_t nb,int width,void *dst);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,369 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""XDR data representation (RFC 1832) and ONC-RPC record marking
+(RFC 1831) for bliss.comm.sunrpc (see xdr.h).
+
+:class:`Packer` and :class:`Unpacker` have the interface of the xdrlib
+module of the standard library (deprecated), the unpacker decodes from
+any bytes-like object without copying it.
+
+:class:`RecordReader` receives the record marked stream of a TCP
+connection into one buffer, reused from record to record: the fragments
+are joined in place and a record is never concatenated. The record
+reassembly and the number arrays use the native library when it is
+found, in this order:
+
+- the path given by the ``BLISS_XDR_LIBRARY`` environment variable
+- the ``_xdr`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_COMM_XDR``) next to this file
+
+otherwise Python and numpy.
+"""
+
+import struct
+
+import numpy
+
+from . import native
+
+ffi, lib = native.load(__file__, "xdr", "BLISS_XDR_LIBRARY")
+
+# default limit of the size of a received record
+MAX_RECORD_SIZE = 256 * 1024 * 1024
+
+_LAST_FRAGMENT = 0x80000000
+_UINT = struct.Struct(">I")
+_INT = struct.Struct(">i")
+_UHYPER = struct.Struct(">Q")
+_HYPER = struct.Struct(">q")
+_FLOAT = struct.Struct(">f")
+_DOUBLE = struct.Struct(">d")
+
+
+class Error(Exception):
+    pass
+
+
+class ConversionError(Error):
+    pass
+
+
+def _number_dtype(dtype):
+    """host order dtype of the items of an XDR number array"""
+    dtype = numpy.dtype(dtype)
+    if dtype.kind not in "iuf" or dtype.itemsize not in (4, 8):
+        raise TypeError("no XDR array of %s" % dtype)
+    return dtype.newbyteorder("=")
+
+
+class Packer:
+    """Pack various data representations into a buffer"""
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.__buf = bytearray()
+
+    def get_buffer(self):
+        return bytes(self.__buf)
+
+    get_buf = get_buffer
+
+    def get_view(self):
+        """memoryview on the packed data, valid until the next pack or reset"""
+        return memoryview(self.__buf)
+
+    def _pack(self, packer, x):
+        try:
+            self.__buf += packer.pack(x)
+        except struct.error as e:
+            raise ConversionError(e.args[0])
+
+    def pack_uint(self, x):
+        self._pack(_UINT, x)
+
+    def pack_int(self, x):
+        self._pack(_INT, x)
+
+    pack_enum = pack_int
+
+    def pack_bool(self, x):
+        self.__buf += b"\0\0\0\1" if x else b"\0\0\0\0"
+
+    def pack_uhyper(self, x):
+        self._pack(_UHYPER, x)
+
+    def pack_hyper(self, x):
+        self._pack(_HYPER, x)
+
+    def pack_float(self, x):
+        self._pack(_FLOAT, x)
+
+    def pack_double(self, x):
+        self._pack(_DOUBLE, x)
+
+    def pack_fstring(self, n, s):
+        if n < 0:
+            raise ValueError("fstring size must be nonnegative")
+        data = s[:n]
+        self.__buf += data
+        self.__buf += bytes((n + 3) // 4 * 4 - len(data))
+
+    pack_fopaque = pack_fstring
+
+    def pack_string(self, s):
+        n = len(s)
+        self.pack_uint(n)
+        self.pack_fstring(n, s)
+
+    pack_opaque = pack_string
+    pack_bytes = pack_string
+
+    def pack_raw(self, data):
+        """append data as is, without length nor padding"""
+        self.__buf += data
+
+    def pack_list(self, list, pack_item):
+        for item in list:
+            self.pack_uint(1)
+            pack_item(item)
+        self.pack_uint(0)
+
+    def pack_farray(self, n, list, pack_item):
+        if len(list) != n:
+            raise ValueError("wrong array size")
+        for item in list:
+            pack_item(item)
+
+    def pack_array(self, list, pack_item):
+        n = len(list)
+        self.pack_uint(n)
+        self.pack_farray(n, list, pack_item)
+
+    def pack_numbers(self, values, dtype):
+        """pack a variable length array of int, unsigned int, hyper,
+        float or double (dtype i4, u4, i8, u8, f4 or f8) in one go"""
+        dtype = _number_dtype(dtype)
+        values = numpy.ascontiguousarray(values, dtype).reshape(-1)
+        self.pack_uint(len(values))
+        if lib is None:
+            self.__buf += values.astype(dtype.newbyteorder(">")).tobytes()
+            return
+        start = len(self.__buf)
+        self.__buf += bytes(values.nbytes)
+        with ffi.from_buffer(self.__buf) as buf:
+            lib.xdr_swap_copy(
+                ffi.from_buffer(values), len(values), dtype.itemsize, buf + start
+            )
+
+
+class Unpacker:
+    """Unpack various data representations from a bytes-like object"""
+
+    def __init__(self, data):
+        self.reset(data)
+
+    def reset(self, data):
+        self.__buf = data
+        self.__pos = 0
+
+    def get_position(self):
+        return self.__pos
+
+    def set_position(self, position):
+        self.__pos = position
+
+    def get_buffer(self):
+        return bytes(self.__buf)
+
+    def done(self):
+        if self.__pos < len(self.__buf):
+            raise Error("unextracted data remains")
+
+    def _unpack(self, unpacker):
+        i = self.__pos
+        j = i + unpacker.size
+        if j > len(self.__buf):
+            raise EOFError
+        self.__pos = j
+        return unpacker.unpack_from(self.__buf, i)[0]
+
+    def unpack_uint(self):
+        return self._unpack(_UINT)
+
+    def unpack_int(self):
+        return self._unpack(_INT)
+
+    unpack_enum = unpack_int
+
+    def unpack_bool(self):
+        return bool(self._unpack(_INT))
+
+    def unpack_uhyper(self):
+        return self._unpack(_UHYPER)
+
+    def unpack_hyper(self):
+        return self._unpack(_HYPER)
+
+    def unpack_float(self):
+        return self._unpack(_FLOAT)
+
+    def unpack_double(self):
+        return self._unpack(_DOUBLE)
+
+    def unpack_fstring(self, n):
+        if n < 0:
+            raise ValueError("fstring size must be nonnegative")
+        i = self.__pos
+        j = i + (n + 3) // 4 * 4
+        if j > len(self.__buf):
+            raise EOFError
+        self.__pos = j
+        return bytes(self.__buf[i : i + n])
+
+    unpack_fopaque = unpack_fstring
+
+    def unpack_string(self):
+        n = self.unpack_uint()
+        return self.unpack_fstring(n)
+
+    unpack_opaque = unpack_string
+    unpack_bytes = unpack_string
+
+    def unpack_list(self, unpack_item):
+        list = []
+        while True:
+            x = self.unpack_uint()
+            if x == 0:
+                break
+            if x != 1:
+                raise ConversionError("0 or 1 expected, got %r" % (x,))
+            list.append(unpack_item())
+        return list
+
+    def unpack_farray(self, n, unpack_item):
+        return [unpack_item() for i in range(n)]
+
+    def unpack_array(self, unpack_item):
+        n = self.unpack_uint()
+        return self.unpack_farray(n, unpack_item)
+
+    def unpack_numbers(self, dtype, out=None):
+        """unpack a variable length array of numbers (see
+        :meth:`Packer.pack_numbers`) into a host order numpy array, a
+        view on out when given"""
+        dtype = _number_dtype(dtype)
+        n = self.unpack_uint()
+        i = self.__pos
+        j = i + n * dtype.itemsize
+        if j > len(self.__buf):
+            raise EOFError
+        if out is None:
+            out = numpy.empty(n, dtype)
+        elif len(out) < n or out.dtype != dtype or not out.flags.c_contiguous:
+            raise ValueError("output array can't hold %d values of %s" % (n, dtype))
+        out = out[:n]
+        if lib is None:
+            out[:] = numpy.frombuffer(self.__buf, dtype.newbyteorder(">"), n, i)
+        else:
+            lib.xdr_swap_copy(
+                ffi.from_buffer(self.__buf) + i,
+                n,
+                dtype.itemsize,
+                ffi.from_buffer(out, require_writable=True),
+            )
+        self.__pos = j
+        return out
+
+
+class _Record:
+    """xdr_record of xdr.h, for the Python reassembly"""
+
+    def __init__(self):
+        self.length = self.size = self.pos = self.remaining = self.wanted = 0
+        self.last = self.started = False
+
+
+def _py_reassemble(buf, rec, max_size):
+    """xdr_record_reassemble() of xdr.c"""
+    view = memoryview(buf)
+    while True:
+        if rec.remaining:
+            size = min(rec.length - rec.pos, rec.remaining)
+            if size and rec.pos != rec.size:
+                view[rec.size : rec.size + size] = view[rec.pos : rec.pos + size]
+            rec.size += size
+            rec.pos += size
+            rec.remaining -= size
+            if rec.remaining:
+                rec.pos = rec.length = rec.size
+                rec.wanted = rec.remaining + (0 if rec.last else 4)
+                return 0
+        if rec.started and rec.last:
+            rec.wanted = 0
+            return 1
+
+        available = rec.length - rec.pos
+        if available < 4:
+            view[rec.size : rec.size + available] = view[rec.pos : rec.length]
+            rec.pos = rec.size
+            rec.length = rec.size + available
+            rec.wanted = 4 - available
+            return 0
+        header = _UINT.unpack_from(buf, rec.pos)[0]
+        rec.pos += 4
+        rec.started = True
+        rec.last = bool(header & _LAST_FRAGMENT)
+        rec.remaining = header & ~_LAST_FRAGMENT
+        if rec.remaining > max_size - rec.size:
+            return -1
+
+
+class RecordReader:
+    """Receive the records of a record marked stream (ONC-RPC over TCP).
+
+    A record is received into one buffer, reused for the next ones and
+    grown when needed, and only the bytes of the record are read from the
+    socket: several readers can take turns on the same connection.
+    """
+
+    def __init__(self, size=64 * 1024, max_size=MAX_RECORD_SIZE):
+        self._buffer = bytearray(size)
+        self.max_size = max_size
+
+    def recv(self, sock):
+        """Receive the next record: a memoryview on the buffer, valid until
+        the next call. Raise EOFError when the connection is closed"""
+        if lib is None:
+            rec = _Record()
+            reassemble = _py_reassemble
+        else:
+            rec = ffi.new("xdr_record *")
+            reassemble = self._reassemble
+        while True:
+            status = reassemble(self._buffer, rec, self.max_size)
+            if status > 0:
+                return memoryview(self._buffer)[: rec.size]
+            if status < 0:
+                raise Error("record larger than %d bytes" % self.max_size)
+            end = rec.length + rec.wanted
+            if end > len(self._buffer):
+                # a new buffer: the views on the previous records stay valid
+                buffer = bytearray(max(end, 2 * len(self._buffer)))
+                buffer[: rec.length] = memoryview(self._buffer)[: rec.length]
+                self._buffer = buffer
+            nbytes = sock.recv_into(memoryview(self._buffer)[rec.length : end])
+            if not nbytes:
+                raise EOFError
+            rec.length += nbytes
+
+    @staticmethod
+    def _reassemble(buffer, rec, max_size):
+        with ffi.from_buffer(buffer) as buf:
+            return lib.xdr_record_reassemble(buf, rec, max_size)
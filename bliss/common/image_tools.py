@@ -6,10 +6,19 @@
 # Distributed under the GNU LGPLv3. See LICENSE for more info.
 
 
+import io
 import fabio
 import numpy as np
 from PIL import Image
 
+try:
+    from bliss.data.routines.pixmaptools import core as pixmaptools_core
+except Exception:
+    pixmaptools_core = None
+else:
+    if not pixmaptools_core.available():
+        pixmaptools_core = None
+
 NUMPY_MODES = {
     "L": np.uint8,
     "P": np.uint8,
@@ -85,6 +94,33 @@ def array_to_buffer(arry, mode=None):
     return (mode, size, data)
 
 
+def array_to_thumbnail(arry, fmt="png", palette="GREYSCALE", vmin=None, vmax=None):
+    """Colormap a 2D array and encode it as png or jpeg bytes
+
+    The native pixmaptools encoder is used when available (GIL released,
+    fast zlib level), PIL otherwise (greyscale only).
+    """
+    fmt = fmt.lower()
+    if fmt not in ("png", "jpeg", "jpg"):
+        raise ValueError(f"unknown thumbnail format {fmt}")
+    if pixmaptools_core is not None and (fmt == "png" or pixmaptools_core.has_jpeg()):
+        return pixmaptools_core.thumbnail(
+            arry,
+            fmt,
+            palette=pixmaptools_core.PaletteType[palette.upper()],
+            vmin=vmin,
+            vmax=vmax,
+        )
+    arry = np.asarray(arry, dtype=np.float64)
+    lo = np.nanmin(arry) if vmin is None else vmin
+    hi = np.nanmax(arry) if vmax is None else vmax
+    scale = 255. / (hi - lo) if hi > lo else 0.
+    grey = np.clip((np.nan_to_num(arry) - lo) * scale, 0, 255).astype(np.uint8)
+    buffer = io.BytesIO()
+    Image.fromarray(grey, "L").save(buffer, "JPEG" if fmt == "jpg" else fmt.upper())
+    return buffer.getvalue()
+
+
 def pil_to_file(pil, fpath):
     pil.save(fpath)
 
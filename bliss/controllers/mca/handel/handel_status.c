@@ -0,0 +1,159 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include <stddef.h>
+#include "handel_status.h"
+
+struct handel_status_code
+{
+  int		code;
+  const char	*name;
+  const char	*description;
+};
+
+/* HANDEL_STATUS_CODES, sorted by code */
+#include "handel_status_codes.h"
+
+static const struct handel_status_code* _find(int code)
+{
+  int aBegin = 0;
+  int anEnd = sizeof(HANDEL_STATUS_CODES) / sizeof(HANDEL_STATUS_CODES[0]);
+  while(aBegin < anEnd)
+    {
+      int aMiddle = (aBegin + anEnd) / 2;
+      if(HANDEL_STATUS_CODES[aMiddle].code < code)
+	aBegin = aMiddle + 1;
+      else
+	anEnd = aMiddle;
+    }
+  if(aBegin < (int)(sizeof(HANDEL_STATUS_CODES) / sizeof(HANDEL_STATUS_CODES[0])) &&
+     HANDEL_STATUS_CODES[aBegin].code == code)
+    return &HANDEL_STATUS_CODES[aBegin];
+  return NULL;
+}
+
+int handel_status_abi_version(void)
+{
+  return HANDEL_STATUS_ABI_VERSION;
+}
+
+const char* handel_status_name(int code)
+{
+  const struct handel_status_code *anEntry = _find(code);
+  return anEntry ? anEntry->name : NULL;
+}
+
+const char* handel_status_description(int code)
+{
+  const struct handel_status_code *anEntry = _find(code);
+  return anEntry ? anEntry->description : NULL;
+}
+
+/* buffer_full_a, buffer_full_b, buffer_overrun, run_active */
+static int _flag(handel_run_data_fn run_data,int aChannel,char *aName,
+		 int *aValue)
+{
+  unsigned short aResult = 0;
+  int aCode = run_data(aChannel,aName,&aResult);
+  *aValue = aResult;
+  return aCode;
+}
+
+int handel_status_poll(handel_run_data_fn run_data,
+		       const int *masters,int nb_masters,
+		       handel_buffer_status *status,int *error_channel)
+{
+  /* same order as the Python helpers, see interface.synchronized_poll_data */
+  static char *FLAGS[] = {"buffer_full_a","buffer_full_b","buffer_overrun"};
+  int *aValues[3];
+  int i,f,aCode;
+
+  aValues[0] = &status->full_a;
+  aValues[1] = &status->full_b;
+  aValues[2] = &status->overrun;
+  status->current_pixel = 0;
+  *error_channel = -1;
+  for(i = 0;i < nb_masters;++i)
+    {
+      unsigned long aPixel = 0;
+      aCode = run_data(masters[i],"current_pixel",&aPixel);
+      if(aCode)
+	{
+	  *error_channel = masters[i];
+	  return aCode;
+	}
+      if(!i || aPixel > status->current_pixel)
+	status->current_pixel = aPixel;
+    }
+  for(f = 0;f < 3;++f)
+    {
+      /* full: all the masters, overrun: any master */
+      int anAll = f < 2;
+      *aValues[f] = anAll && nb_masters > 0;
+      for(i = 0;i < nb_masters;++i)
+	{
+	  int aValue;
+	  aCode = _flag(run_data,masters[i],FLAGS[f],&aValue);
+	  if(aCode)
+	    {
+	      *error_channel = masters[i];
+	      return aCode;
+	    }
+	  if(anAll ? !aValue : aValue)
+	    {
+	      *aValues[f] = !anAll;
+	      break;
+	    }
+	}
+    }
+  return 0;
+}
+
+int handel_status_buffer_done(handel_run_data_fn run_data,
+			      handel_board_operation_fn board_operation,
+			      const int *masters,int nb_masters,char buffer_id,
+			      int *overrun,int *error_channel)
+{
+  char *anOtherFull = buffer_id == 'a' ? "buffer_full_b" : "buffer_full_a";
+  int i,aCode;
+
+  *overrun = 0;
+  *error_channel = -1;
+  for(i = 0;i < nb_masters;++i)
+    {
+      char aBufferId = buffer_id;
+      int aFull;
+      aCode = board_operation(masters[i],"buffer_done",&aBufferId);
+      if(!aCode)
+	aCode = _flag(run_data,masters[i],anOtherFull,&aFull);
+      if(!aCode && aFull)
+	{
+	  /* bit 0: acquiring */
+	  short aRunning = 0;
+	  aCode = run_data(masters[i],"run_active",&aRunning);
+	  if(aRunning & 0x1)
+	    *overrun = 1;
+	}
+      if(aCode)
+	{
+	  *error_channel = masters[i];
+	  return aCode;
+	}
+    }
+  return 0;
+}
+
+#ifdef _WIN32
+/* setup.py builds this library as a Python extension, which exports an
+ * init function; it is loaded by cffi, never imported
+ */
+void* PyInit__handel_status(void)
+{
+  return NULL;
+}
+#endif
@@ -0,0 +1,68 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Native status checks of the mapping mode buffers: one call polls the
+ * flags of all the master channels through handel, stops at the first
+ * failing call and returns its handel error code (0 on success), the
+ * failing channel in error_channel. Handel itself is loaded by cffi
+ * (handel/_cffi.py) and its entry points are given by the caller.
+ *
+ * The error names and descriptions are generated from handel_errors.h
+ * when the library is built (scripts/handel/parse_error_header.py).
+ *
+ * The part between the CFFI markers is read by cffi (handel/status.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __HANDEL_STATUS
+#define __HANDEL_STATUS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {HANDEL_STATUS_ABI_VERSION = 1};
+
+/* xiaGetRunData, xiaBoardOperation */
+typedef int (*handel_run_data_fn)(int detChan,char *name,void *value);
+typedef int (*handel_board_operation_fn)(int detChan,char *name,void *value);
+
+typedef struct
+{
+  unsigned long	current_pixel;	/* max over the masters */
+  int		full_a;		/* buffer a full on all the masters */
+  int		full_b;
+  int		overrun;	/* hardware overrun on any master */
+} handel_buffer_status;
+
+int handel_status_abi_version(void);
+
+/* NULL for codes not in handel_errors.h, description NULL if it has none */
+const char* handel_status_name(int code);
+const char* handel_status_description(int code);
+
+/* current pixel, buffer full and overrun flags of the masters, the
+ * flags in that order and each one stops at the first master deciding it
+ */
+int handel_status_poll(handel_run_data_fn run_data,
+		       const int *masters,int nb_masters,
+		       handel_buffer_status *status,int *error_channel);
+
+/* flag buffer_id ('a' or 'b') as read on all the masters, overrun tells
+ * whether the other buffer is already full on a running master
+ */
+int handel_status_buffer_done(handel_run_data_fn run_data,
+			      handel_board_operation_fn board_operation,
+			      const int *masters,int nb_masters,char buffer_id,
+			      int *overrun,int *error_channel);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
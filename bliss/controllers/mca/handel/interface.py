@@ -17,6 +17,7 @@ from bliss.config.beacon_object import BeaconObject
 
 from .error import check_error, HandelError
 from ._cffi import handel, ffi
+from . import status
 from .stats import stats_from_normal_mode
 from .parser import parse_xia_ini_file
 from .mapping import parse_mapping_buffer
@@ -517,7 +518,10 @@ def set_all_buffer_done(buffer_id):
     False means no overrun have been detected.
     True means an overrun have been detected.
     """
-    overruns = [set_buffer_done(master, buffer_id) for master in get_master_channels()]
+    masters = get_master_channels()
+    if status.available(handel):
+        return status.buffer_done(handel, masters, to_buffer_id(buffer_id))
+    overruns = [set_buffer_done(master, buffer_id) for master in masters]
     return any(overruns)
 
 
@@ -579,12 +583,17 @@ def synchronized_poll_data(
     overrun_error_hwd = RuntimeError("Buffer overrun (hwd)!")
     overrun_error_soft = RuntimeError("Buffer overrun (soft)!")
     # Get info from hardware
-    current_pixel = get_current_pixel()
+    if status.available(handel):
+        # same readout, all the masters in one native call
+        current_pixel, full, overrun = status.poll(handel, get_master_channels())
+    else:
+        current_pixel = get_current_pixel()
 
-    # put "a" or "b" in "full" if buffer a or buffer b is full.
-    full = {x for x in data if all_buffer_full(x)}  # <- full is a set, not a dict...
+        # put "a" or "b" in "full" if buffer a or buffer b is full.
+        full = {x for x in data if all_buffer_full(x)}  # <- a set, not a dict...
+        overrun = any_buffer_overrun()
     # Check overrun detected by hardware.
-    if any_buffer_overrun():
+    if overrun:
         raise overrun_error_hwd
 
     # FalconX hack
@@ -0,0 +1,99 @@
+"""Native status checks of the mapping buffers (see handel_status.h).
+
+The status library is looked up, in this order:
+
+- the path given by the ``HANDEL_STATUS_LIBRARY`` environment variable
+- the ``_handel_status`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_HANDEL_STATUS``) next to this file
+
+``lib`` is None when no library is found, the callers then fall back
+to one handel call per channel from Python.
+"""
+
+import logging
+
+from bliss.comm import native
+
+from .error import HandelError
+from ._cffi import ffi as handel_ffi
+
+_logger = logging.getLogger(__name__)
+
+ffi, lib = native.load(__file__, "handel_status", "HANDEL_STATUS_LIBRARY")
+
+
+def _entry_points(handel):
+    """xiaGetRunData and xiaBoardOperation of a handel library loaded by
+    cffi (in ABI mode its functions are pointers), None for anything else"""
+    entry_points = []
+    for c_type, name in (
+        ("handel_run_data_fn", "xiaGetRunData"),
+        ("handel_board_operation_fn", "xiaBoardOperation"),
+    ):
+        func = getattr(handel, name, None)
+        if not isinstance(func, handel_ffi.CData):
+            return None
+        address = int(handel_ffi.cast("uintptr_t", func))
+        entry_points.append(ffi.cast(c_type, address))
+    return entry_points
+
+
+def available(handel):
+    """True if the native checks can drive this handel library"""
+    return lib is not None and _entry_points(handel) is not None
+
+
+def error(code):
+    """HandelError of a code, named from the table built in the library"""
+    name = lib.handel_status_name(code)
+    if name == ffi.NULL:
+        return HandelError.from_errno(code)
+    description = lib.handel_status_description(code)
+    return HandelError(
+        code,
+        ffi.string(name).decode(),
+        None if description == ffi.NULL else ffi.string(description).decode(),
+    )
+
+
+def _check(code, error_channel):
+    if code != 0:
+        _logger.debug("handel error %d on channel %d", code, error_channel[0])
+        raise error(code)
+
+
+def poll(handel, masters):
+    """Current pixel (max), full buffers and hardware overrun of the masters.
+
+    Return a tuple (current_pixel, full, overrun) where full is the set of
+    buffer ids ("a", "b") full on all the masters.
+    """
+    run_data, _ = _entry_points(handel)
+    status = ffi.new("handel_buffer_status *")
+    error_channel = ffi.new("int *")
+    code = lib.handel_status_poll(
+        run_data, list(masters), len(masters), status, error_channel
+    )
+    _check(code, error_channel)
+    full = {x for x, flag in (("a", status.full_a), ("b", status.full_b)) if flag}
+    return status.current_pixel, full, bool(status.overrun)
+
+
+def buffer_done(handel, masters, buffer_id):
+    """Flag a buffer as read on all the masters, return the overrun detection
+    (see interface.set_buffer_done)."""
+    run_data, board_operation = _entry_points(handel)
+    overrun = ffi.new("int *")
+    error_channel = ffi.new("int *")
+    bid = buffer_id if isinstance(buffer_id, bytes) else buffer_id.encode()
+    code = lib.handel_status_buffer_done(
+        run_data,
+        board_operation,
+        list(masters),
+        len(masters),
+        bid,
+        overrun,
+        error_channel,
+    )
+    _check(code, error_channel)
+    return bool(overrun[0])
@@ -18,6 +18,7 @@ from bliss.controllers.oscilloscope.base import (
 )
 
 from bliss.comm.util import get_comm
+from bliss.comm import scpi_block
 from ruamel.yaml import YAML
 import gevent
 import numpy
@@ -226,14 +227,21 @@ MEASURE:VOLTAGE:DC?;:MEASURE:CURRENT:DC?
         self.write(":HEADer 1")
 
         head = self.write_read(":WFMOutpre?")
-        datastring = self._comm.write_read(b":CURVE?")  # raw binary comm
         header = self.header_to_dict(head)
         header = header["WFMOUTPRE"]
 
-        raw_data = numpy.frombuffer(datastring, dtype=numpy.int16)[-length:]
-        data = (raw_data.astype(float) - header["YOFF"]) * header["YMULT"] + header[
-            "YZERO"
-        ]
+        # ":CURVE #<n><length><data>" block of 2 bytes MSB first values
+        if hasattr(self._comm, "write_read_block"):
+            raw_data = self._comm.write_read_block(b":CURVE?\n", ">i2")
+        else:
+            # the answer is read at once by the other comms
+            raw_data = scpi_block.decode_block(self._comm.write_read(b":CURVE?"), ">i2")
+        data = scpi_block.to_double(
+            raw_data,
+            raw_data.dtype,
+            numpy.empty(len(raw_data)),
+            (header["YOFF"], header["YMULT"], header["YZERO"]),
+        )
 
         return OscAnalogChanData(length, raw_data, data, header)
 
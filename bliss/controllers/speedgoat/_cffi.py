@@ -14,7 +14,9 @@ ffi = FFI()
 
 _this_dir = os.path.dirname(__file__)
 _api_h_filename = os.path.join(_this_dir, "xpcapi.h")
-_api_dll_filename = os.path.join(_this_dir, "xpcapi.dll")
+_api_dll_filename = os.environ.get(
+    "SPEEDGOAT_XPCAPI_LIBRARY", os.path.join(_this_dir, "xpcapi.dll")
+)
 
 with open(_api_h_filename, "r") as _api_h_file:
     _api_h_text = _api_h_file.read()
@@ -391,10 +391,8 @@ class FastDAQ(object):
 
     def scope_get_data(self):
         signals = self.scope.signal_list
-        data_arr = []
-        for signal in signals:
-            data_arr.append((signal, self.scope.get_data(signal, 0, None, 1)))
-        return data_arr
+        data = self.scope.get_data_block(signals)
+        return [(signal, data[:, i]) for i, signal in enumerate(signals)]
 
 
 class DAQ(object):
@@ -509,18 +507,15 @@ class DAQ(object):
         if read_success:
 
             # print("Speedgoat: Scope get_data", end=" ... ")
-            data = self.scope_get_data()
+            signals = self.scope.signal_list[: len(self._signal_list)]
+            return_data = self.scope.get_data_block(signals, 0, nbpoint)
             # print("Done")
 
-            return_data = np.zeros((len(self._signal_list), nbpoint))
-            for i in range(len(self._signal_list)):
-                return_data[i] = data[i][1]
-
             # print("Speedgoat: readRingBuffer/Value", end=" ... ")
             self.speedgoat.params["readRingBuffer/Value"] = 0
             # print("Done")
 
-            return np.transpose(return_data)
+            return return_data
         else:
             # print("Speedgoat: READ FAILED, RETRY")
             return None
@@ -531,17 +526,8 @@ class DAQ(object):
         if signals is None:
             signals = self.scope.signal_list
 
-        data_arr = []
-        for signal in signals:
-            # print(f"\n{signal}, {first_point}, {decimation}")
-            data_arr.append(
-                (
-                    signal,
-                    self.scope.get_data(signal, first_point, num_samples, decimation),
-                )
-            )
-
-        return data_arr
+        data = self.scope.get_data_block(signals, first_point, num_samples, decimation)
+        return [(signal, data[:, i]) for i, signal in enumerate(signals)]
 
         # return [
         #    (signal, self.scope.get_data(signal, first_point, num_samples, decimation))
@@ -1412,6 +1398,15 @@ class Scope(object):
             self.scope_id, signal_id, first_point, num_samples, decimation
         )
 
+    def get_data_block(
+        self, signals=None, first_point=0, num_samples=None, decimation=1
+    ):
+        """Data of several signals (all by default) in one (points x signals)
+        array, read in a single request to the server"""
+        return self.speedgoat.sc_get_data_block(
+            self.scope_id, signals, first_point, num_samples, decimation
+        )
+
 
 class TargetScope(Scope):
     @property
@@ -7,14 +7,15 @@
 
 from __future__ import absolute_import
 
+import os
 import sys
 import functools
 
 import numpy
 
-if sys.platform == "win32":
+if sys.platform == "win32" or "SPEEDGOAT_XPCAPI_LIBRARY" in os.environ:
     # Import only on Windows (server-side) to avoid
-    # loading of .dll
+    # loading of .dll, or with a stand-in library
     from ._cffi import xpc, ffi
 else:
     xpc = None
@@ -69,7 +70,11 @@ def _discover():
 
     items = {}
     for name in dir(xpc):
-        item = getattr(xpc, name)
+        try:
+            item = getattr(xpc, name)
+        except AttributeError:
+            # not exported by a stand-in library
+            continue
         if name.startswith("xPC") and callable(item):
             name = camelCase_to_snake(name[3:])
             items[name] = _error_handle(item)
@@ -437,6 +442,79 @@ def sc_get_data(
     return values
 
 
+def _block(out, num_points, signals):
+    """(num_points x signals) Fortran ordered array, each signal contiguous"""
+    shape = num_points, len(signals)
+    if out is None:
+        return numpy.empty(shape, order="F")
+    if out.shape != shape or out.dtype != numpy.float64 or not out.flags.f_contiguous:
+        raise ValueError("out must be a {} float64 Fortran array".format(shape))
+    return out
+
+
+def _decimated(num_points, decimation):
+    # points returned by the library for a decimated request
+    return len(range(0, num_points, decimation))
+
+
+def sc_get_data_block(
+    handle,
+    scope_id,
+    signals=None,
+    first_point=0,
+    num_points=None,
+    decimation=1,
+    out=None,
+):
+    """Data of several signals of a scope in one (points x signals) array
+
+    The library writes each signal straight into its column of the result
+    (or of `out`, reused between reads), no intermediate array.
+    """
+    if signals is None:
+        signals = sc_get_signals(handle, scope_id)
+    if num_points is None:
+        num_points = sc_get_num_samples(handle, scope_id) - first_point
+    values = _block(out, num_points, signals)
+    for column, signal_id in enumerate(signals):
+        buff = ffi.cast("double *", values[:, column].ctypes.data)
+        _error(
+            xpc.xPCScGetData(
+                handle, scope_id, signal_id, first_point, num_points, decimation, buff
+            )
+        )
+    return values[: _decimated(num_points, decimation)]
+
+
+# Logging
+
+
+def get_output_log_block(
+    handle, outputs=None, start=0, num_samples=None, decimation=1, out=None
+):
+    """Logged outputs in one (samples x outputs) array, see sc_get_data_block"""
+    if outputs is None:
+        outputs = range(get_num_outputs(handle))
+    if num_samples is None:
+        num_samples = num_log_samples(handle) - start
+    values = _block(out, num_samples, outputs)
+    for column, output_id in enumerate(outputs):
+        buff = ffi.cast("double *", values[:, column].ctypes.data)
+        _error(
+            xpc.xPCGetOutputLog(handle, start, num_samples, decimation, output_id, buff)
+        )
+    return values[: _decimated(num_samples, decimation)]
+
+
+def get_time_log(handle, start=0, num_samples=None, decimation=1):
+    if num_samples is None:
+        num_samples = num_log_samples(handle) - start
+    values = numpy.empty(num_samples)
+    buff = ffi.cast("double *", values.ctypes.data)
+    _error(xpc.xPCGetTimeLog(handle, start, num_samples, decimation, buff))
+    return values[: _decimated(num_samples, decimation)]
+
+
 # Target scope
 
 
@@ -1251,23 +1251,22 @@ class WagoController:
         total_ana_in = len(memory["ANA_IN"])
         total_ana_out = len(memory["ANA_OUT"])
 
-        if total_digi_in > 0:
-            digi_in_reading = self.client_read_coils(0, total_digi_in)
-            value_table["DIGI_IN"] = digi_in_reading
-
-        if total_digi_out > 0:
-            digi_out_reading = self.client_read_coils(0x200, total_digi_out)
-            value_table["DIGI_OUT"] = digi_out_reading
-
-        if total_ana_in > 0:
-            ana_in_reading = self.client_read_input_registers(0, total_ana_in * "H")
-            value_table["ANA_IN"] = ana_in_reading
+        # (memory area, function code, address, count), read in one round trip
+        requests = [
+            ("DIGI_IN", 0x01, 0, total_digi_in),
+            ("DIGI_OUT", 0x01, 0x200, total_digi_out),
+            ("ANA_IN", 0x04, 0, total_ana_in),
+            ("ANA_OUT", 0x04, 0x200, total_ana_out),
+        ]
+        requests = [request for request in requests if request[3] > 0]
+        with self.lock:
+            readings = self.client.read_blocks([request[1:] for request in requests])
 
-        if total_ana_out > 0:
-            ana_out_reading = self.client_read_input_registers(
-                0x200, total_ana_out * "H"
-            )
-            value_table["ANA_OUT"] = ana_out_reading
+        for (area, func_code, _, _), reading in zip(requests, readings):
+            if func_code == 0x04:
+                # words as python integers for the conversions
+                reading = tuple(reading.tolist())
+            value_table[area] = reading
         self.value_table = value_table
 
     def get(self, *logical_names, convert_values=True, flat=True, cached=False):
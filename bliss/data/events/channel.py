@@ -6,11 +6,91 @@
 # Distributed under the GNU LGPLv3. See LICENSE for more info.
 
 
+import struct
 import numpy
 from bliss.config import streaming_events
+from bliss.data.events import channel_batch
 
 
-__all__ = ["ChannelDataEvent"]
+__all__ = ["ChannelDataEvent", "encode_chunk", "decode_chunk", "concatenate_chunks"]
+
+
+# Compact layout of a block of points, as produced by the native
+# ChannelBatcher (bliss.data.events.channel_batch):
+#   "BLCH" | version u8 | dtype u8 | ndim u8 | big endian u8 | npoints u32
+#   | dims u32 * ndim | npoints * point raw bytes
+CHUNK_MAGIC = b"BLCH"
+CHUNK_VERSION = 1
+CHUNK_HEADER_FORMAT = "<4sBBBBI"
+CHUNK_HEADER_SIZE = struct.calcsize(CHUNK_HEADER_FORMAT)
+# channel_batch_dtype order
+CHUNK_DTYPES = channel_batch.DTYPES
+
+
+def encode_chunk(data):
+    """Block of points (npoints, *point_shape) to the compact layout
+
+    :param numpy.ndarray data:
+    :returns bytes:
+    """
+    data = numpy.ascontiguousarray(data)
+    dtype = data.dtype.newbyteorder("=")
+    try:
+        code = CHUNK_DTYPES.index(dtype)
+    except ValueError:
+        raise TypeError(f"dtype {data.dtype} can't be encoded in a chunk")
+    big_endian = data.dtype.byteorder == ">" or (
+        data.dtype.byteorder in "=|" and not numpy.little_endian
+    )
+    shape = data.shape[1:]
+    header = struct.pack(
+        CHUNK_HEADER_FORMAT,
+        CHUNK_MAGIC,
+        CHUNK_VERSION,
+        code,
+        len(shape),
+        big_endian,
+        len(data),
+    )
+    return header + struct.pack(f"<{len(shape)}I", *shape) + data.tobytes()
+
+
+def decode_chunk(raw):
+    """Compact layout to a read-only (npoints, *point_shape) array (no copy)
+
+    :param bytes raw:
+    :returns numpy.ndarray:
+    """
+    magic, version, code, ndim, big_endian, npoints = struct.unpack_from(
+        CHUNK_HEADER_FORMAT, raw
+    )
+    if magic != CHUNK_MAGIC or version != CHUNK_VERSION:
+        raise ValueError("not a channel data chunk")
+    shape = struct.unpack_from(f"<{ndim}I", raw, CHUNK_HEADER_SIZE)
+    dtype = CHUNK_DTYPES[code].newbyteorder(">" if big_endian else "<")
+    offset = CHUNK_HEADER_SIZE + 4 * ndim
+    count = npoints * int(numpy.prod(shape, dtype=numpy.int64))
+    data = numpy.frombuffer(raw, dtype=dtype, count=count, offset=offset)
+    return data.reshape((npoints,) + shape)
+
+
+def concatenate_chunks(chunks):
+    """Points of several chunks in one array, host byte order
+
+    :param list(bytes) chunks: same dtype and point shape
+    :returns numpy.ndarray:
+    :raises ValueError: chunks of different types or shapes
+    """
+    if channel_batch.lib is not None:
+        # sizes summed first, then one copy into the output
+        return channel_batch.concatenate(chunks)
+    arrays = [decode_chunk(chunk) for chunk in chunks]
+    dtypes = {a.dtype for a in arrays}
+    shapes = {a.shape[1:] for a in arrays}
+    if len(dtypes) != 1 or len(shapes) != 1:
+        raise ValueError("chunks of different types or shapes")
+    data = numpy.concatenate(arrays)
+    return data.astype(data.dtype.newbyteorder("="), copy=False)
 
 
 class ChannelDataEvent(streaming_events.StreamEvent):
@@ -18,13 +98,20 @@ class ChannelDataEvent(streaming_events.StreamEvent):
     DATA_KEY = b"__DATA__"
     DESC_KEY = b"__DESC__"
     NPOINTS_KEY = b"__NPOINTS__"
+    FORMAT_KEY = b"__FORMAT__"
+    CHUNK_FORMAT = b"CHUNK"
 
-    def init(self, data, description):
+    def init(self, data, description, chunk=None):
         """
         :param Any data:
         :param dict description:
+        :param bytes chunk: data already in the compact layout
+                            (see `encode_chunk`), published as is
         """
         self.description = description
+        if chunk is not None:
+            data = decode_chunk(chunk)
+        self._chunk = chunk
         self.data = data
 
     @property
@@ -93,14 +180,25 @@ class ChannelDataEvent(streaming_events.StreamEvent):
         raw = super()._encode()
         raw[self.DESC_KEY] = self.generic_encode(self.description)
         raw[self.NPOINTS_KEY] = self.encode_integral(self._npoints)
-        raw[self.DATA_KEY] = self.generic_encode(self._data)
+        if self._chunk is not None:
+            raw[self.FORMAT_KEY] = self.CHUNK_FORMAT
+            raw[self.DATA_KEY] = self._chunk
+        else:
+            raw[self.DATA_KEY] = self.generic_encode(self._data)
         return raw
 
     def _decode(self, raw):
         super()._decode(raw)
         self.description = self.generic_decode(raw[self.DESC_KEY])
         self._npoints = self.decode_npoints(raw)
-        self._data = self.generic_decode(raw[self.DATA_KEY])
+        if raw.get(self.FORMAT_KEY) == self.CHUNK_FORMAT:
+            self._chunk = raw[self.DATA_KEY]
+            self._data = decode_chunk(self._chunk)
+            if self._npoints == 1:
+                self._data = self._data[0]
+        else:
+            self._chunk = None
+            self._data = self.generic_decode(raw[self.DATA_KEY])
 
     @classmethod
     def decode_npoints(cls, raw):
@@ -115,6 +213,9 @@ class ChannelDataEvent(streaming_events.StreamEvent):
         :param list((index, raw)) events:
         :returns ChannelDataEvent:
         """
+        ev = cls._merge_chunks(events)
+        if ev is not None:
+            return ev
         data = []
         description = {}
         dtype = None
@@ -132,6 +233,30 @@ class ChannelDataEvent(streaming_events.StreamEvent):
         description["dtype"] = dtype
         return cls(data, description)
 
+    @classmethod
+    def _merge_chunks(cls, events):
+        """Merge events published in the compact layout without decoding
+        them one by one, None when some are not
+
+        :param list((index, raw)) events:
+        :returns ChannelDataEvent or None:
+        """
+        if not events:
+            return None
+        if any(raw.get(cls.FORMAT_KEY) != cls.CHUNK_FORMAT for _, raw in events):
+            return None
+        chunks = [raw[cls.DATA_KEY] for _, raw in events]
+        try:
+            data = concatenate_chunks(chunks)
+        except ValueError:
+            return None
+        description = cls.generic_decode(events[0][1][cls.DESC_KEY])
+        dtype = description["dtype"]
+        data = data.astype(dtype, copy=False)
+        description["shape"] = data.shape[1:]
+        description["dtype"] = dtype
+        return cls(data, description)
+
     @staticmethod
     def as_array(sequence, dtype):
         """Convert a sequence of sequences to a numpy array.
@@ -0,0 +1,434 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "channel_batch.h"
+
+/* chunk header: magic, version, dtype, ndim, byte order, npoints */
+static const unsigned char CHUNK_MAGIC[4] = {'B','L','C','H'};
+#define CHUNK_FIXED_HEADER 12
+
+typedef struct chunk
+{
+  unsigned char	*data;		/* header and capacity points */
+  size_t	size;		/* header and points copied so far */
+  int		nb_points;
+  long long	first;		/* _now() of the first point */
+  struct chunk	*next;		/* in the ready queue or the free list */
+} chunk;
+
+struct channel_batcher
+{
+  int		dtype;
+  int		nb_dims;
+  int		dims[CHANNEL_BATCH_MAX_DIMS];
+  int		capacity;
+  long long	max_latency;
+  size_t	point_size;
+  size_t	header_size;
+  chunk		*current;
+  chunk		*ready;		/* oldest first */
+  chunk		*ready_last;
+  int		nb_ready;
+  chunk		*free_chunks;
+};
+
+static size_t _dtype_size(int aDtype)
+{
+  /* channel_batch_dtype order */
+  static const size_t aSizes[] = {1,1,2,2,4,4,8,8,4,8};
+  if(aDtype < 0 || aDtype >= (int)(sizeof(aSizes) / sizeof(aSizes[0])))
+    return 0;
+  return aSizes[aDtype];
+}
+
+static int _host_big_endian(void)
+{
+  const uint16_t anOne = 1;
+  return !*(const unsigned char*)&anOne;
+}
+
+static long long _now(void)
+{
+  struct timespec aNow;
+  clock_gettime(CLOCK_MONOTONIC,&aNow);
+  return aNow.tv_sec * 1000000000LL + aNow.tv_nsec;
+}
+
+static inline void _put_le32(unsigned char *buf,uint32_t value)
+{
+  buf[0] = value & 0xff;
+  buf[1] = (value >> 8) & 0xff;
+  buf[2] = (value >> 16) & 0xff;
+  buf[3] = value >> 24;
+}
+
+static inline uint32_t _le32(const unsigned char *buf)
+{
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+    ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void _free_list(chunk *aChunk)
+{
+  while(aChunk)
+    {
+      chunk *aNext = aChunk->next;
+      free(aChunk->data);
+      free(aChunk);
+      aChunk = aNext;
+    }
+}
+
+int channel_batch_abi_version(void)
+{
+  return CHANNEL_BATCH_ABI_VERSION;
+}
+
+channel_batcher* channel_batch_new(int dtype,int ndim,const int *dims,
+				   int capacity,long long max_latency)
+{
+  channel_batcher *aBatcher;
+  size_t aPointSize = _dtype_size(dtype);
+  int i;
+
+  if(!aPointSize || ndim < 0 || ndim > CHANNEL_BATCH_MAX_DIMS ||
+     (ndim && !dims) || capacity < 1)
+    return NULL;
+  for(i = 0;i < ndim;++i)
+    {
+      if(dims[i] < 0)
+	return NULL;
+      aPointSize *= (size_t)dims[i];
+    }
+  /* empty points are not batched, the size of a chunk fits in a size_t */
+  if(!aPointSize || aPointSize > (SIZE_MAX - CHUNK_FIXED_HEADER -
+				  4 * CHANNEL_BATCH_MAX_DIMS) / (size_t)capacity)
+    return NULL;
+
+  aBatcher = calloc(1,sizeof(channel_batcher));
+  if(!aBatcher)
+    return NULL;
+  aBatcher->dtype = dtype;
+  aBatcher->nb_dims = ndim;
+  for(i = 0;i < ndim;++i)
+    aBatcher->dims[i] = dims[i];
+  aBatcher->capacity = capacity;
+  aBatcher->max_latency = max_latency;
+  aBatcher->point_size = aPointSize;
+  aBatcher->header_size = CHUNK_FIXED_HEADER + 4 * (size_t)ndim;
+  return aBatcher;
+}
+
+void channel_batch_free(channel_batcher *batcher)
+{
+  if(!batcher)
+    return;
+  _free_list(batcher->current);
+  _free_list(batcher->ready);
+  _free_list(batcher->free_chunks);
+  free(batcher);
+}
+
+/* an empty chunk with its header, a popped one if any */
+static chunk* _new_chunk(channel_batcher *batcher,long long aNow)
+{
+  chunk *aChunk = batcher->free_chunks;
+  unsigned char *aHeader;
+  int i;
+
+  if(aChunk)
+    batcher->free_chunks = aChunk->next;
+  else
+    {
+      aChunk = malloc(sizeof(chunk));
+      if(!aChunk)
+	return NULL;
+      aChunk->data = malloc(batcher->header_size +
+			    (size_t)batcher->capacity * batcher->point_size);
+      if(!aChunk->data)
+	{
+	  free(aChunk);
+	  return NULL;
+	}
+    }
+  aHeader = aChunk->data;
+  memcpy(aHeader,CHUNK_MAGIC,4);
+  aHeader[4] = CHANNEL_BATCH_VERSION;
+  aHeader[5] = (unsigned char)batcher->dtype;
+  aHeader[6] = (unsigned char)batcher->nb_dims;
+  aHeader[7] = (unsigned char)_host_big_endian();
+  _put_le32(aHeader + 8,0);
+  for(i = 0;i < batcher->nb_dims;++i)
+    _put_le32(aHeader + CHUNK_FIXED_HEADER + 4 * i,(uint32_t)batcher->dims[i]);
+  aChunk->size = batcher->header_size;
+  aChunk->nb_points = 0;
+  aChunk->first = aNow;
+  aChunk->next = NULL;
+  return aChunk;
+}
+
+/* the current chunk to the ready queue */
+static void _seal(channel_batcher *batcher)
+{
+  chunk *aChunk = batcher->current;
+  if(!aChunk->nb_points)
+    return;
+  _put_le32(aChunk->data + 8,(uint32_t)aChunk->nb_points);
+  if(batcher->ready_last)
+    batcher->ready_last->next = aChunk;
+  else
+    batcher->ready = aChunk;
+  batcher->ready_last = aChunk;
+  ++batcher->nb_ready;
+  batcher->current = NULL;
+}
+
+int channel_batch_append(channel_batcher *batcher,const void *data,size_t size)
+{
+  const unsigned char *aSource = data;
+  long long aNow;
+  size_t aNbPoints;
+
+  if(size % batcher->point_size || (size && !data))
+    return -1;
+  aNow = _now();
+  aNbPoints = size / batcher->point_size;
+  while(aNbPoints)
+    {
+      chunk *aChunk = batcher->current;
+      size_t aNbCopy,aNbBytes;
+      if(!aChunk)
+	{
+	  aChunk = batcher->current = _new_chunk(batcher,aNow);
+	  if(!aChunk)
+	    return -1;
+	}
+      aNbCopy = (size_t)(batcher->capacity - aChunk->nb_points);
+      if(aNbCopy > aNbPoints)
+	aNbCopy = aNbPoints;
+      aNbBytes = aNbCopy * batcher->point_size;
+      memcpy(aChunk->data + aChunk->size,aSource,aNbBytes);
+      aChunk->size += aNbBytes;
+      aChunk->nb_points += (int)aNbCopy;
+      aSource += aNbBytes;
+      aNbPoints -= aNbCopy;
+      if(aChunk->nb_points == batcher->capacity)
+	_seal(batcher);
+    }
+  if(batcher->current && aNow - batcher->current->first >= batcher->max_latency)
+    _seal(batcher);
+  return batcher->nb_ready;
+}
+
+int channel_batch_flush(channel_batcher *batcher,int force)
+{
+  if(batcher->current &&
+     (force || _now() - batcher->current->first >= batcher->max_latency))
+    _seal(batcher);
+  return batcher->nb_ready;
+}
+
+const unsigned char* channel_batch_front(const channel_batcher *batcher,size_t *size)
+{
+  if(!batcher->ready)
+    {
+      *size = 0;
+      return NULL;
+    }
+  *size = batcher->ready->size;
+  return batcher->ready->data;
+}
+
+int channel_batch_pop(channel_batcher *batcher)
+{
+  chunk *aChunk = batcher->ready;
+  if(!aChunk)
+    return 0;
+  batcher->ready = aChunk->next;
+  if(!batcher->ready)
+    batcher->ready_last = NULL;
+  --batcher->nb_ready;
+  aChunk->next = batcher->free_chunks;
+  batcher->free_chunks = aChunk;
+  return batcher->nb_ready;
+}
+
+int channel_batch_pending(const channel_batcher *batcher)
+{
+  return batcher->current ? batcher->current->nb_points : 0;
+}
+
+typedef struct
+{
+  int		dtype;
+  int		nb_dims;
+  int		dims[CHANNEL_BATCH_MAX_DIMS];
+  int		big_endian;
+  size_t	nb_points;
+  size_t	header_size;
+  size_t	data_size;
+} chunk_info;
+
+/* parse the header of a chunk, -1 if it is not a valid chunk */
+static int _chunk_info(const unsigned char *aChunk,size_t aSize,chunk_info *anInfo)
+{
+  size_t aPointSize;
+  int i;
+
+  if(!aChunk || aSize < CHUNK_FIXED_HEADER || memcmp(aChunk,CHUNK_MAGIC,4) ||
+     aChunk[4] != CHANNEL_BATCH_VERSION)
+    return -1;
+  anInfo->dtype = aChunk[5];
+  anInfo->nb_dims = aChunk[6];
+  anInfo->big_endian = aChunk[7] != 0;
+  anInfo->nb_points = _le32(aChunk + 8);
+  anInfo->header_size = CHUNK_FIXED_HEADER + 4 * (size_t)anInfo->nb_dims;
+  aPointSize = _dtype_size(anInfo->dtype);
+  if(!aPointSize || anInfo->nb_dims > CHANNEL_BATCH_MAX_DIMS ||
+     aSize < anInfo->header_size)
+    return -1;
+  for(i = 0;i < anInfo->nb_dims;++i)
+    {
+      uint32_t aDim = _le32(aChunk + CHUNK_FIXED_HEADER + 4 * i);
+      if(aDim > INT32_MAX)
+	return -1;
+      anInfo->dims[i] = (int)aDim;
+      if(aDim && aPointSize > SIZE_MAX / aDim)
+	return -1;
+      aPointSize *= aDim;
+    }
+  if(aPointSize && anInfo->nb_points > (aSize - anInfo->header_size) / aPointSize)
+    return -1;
+  anInfo->data_size = anInfo->nb_points * aPointSize;
+  return anInfo->header_size + anInfo->data_size == aSize ? 0 : -1;
+}
+
+/* the info of the first chunk, the points of all, -1 if they differ */
+static long long _chunks_info(const unsigned char *const *chunks,const size_t *sizes,
+			      int nb_chunks,chunk_info *anInfo)
+{
+  long long aNbPoints = 0;
+  int i;
+
+  if(nb_chunks <= 0)
+    return -1;
+  for(i = 0;i < nb_chunks;++i)
+    {
+      chunk_info aChunkInfo;
+      if(_chunk_info(chunks[i],sizes[i],&aChunkInfo))
+	return -1;
+      if(!i)
+	*anInfo = aChunkInfo;
+      else if(aChunkInfo.dtype != anInfo->dtype ||
+	      aChunkInfo.big_endian != anInfo->big_endian ||
+	      aChunkInfo.nb_dims != anInfo->nb_dims ||
+	      memcmp(aChunkInfo.dims,anInfo->dims,sizeof(int) * anInfo->nb_dims))
+	return -1;
+      aNbPoints += (long long)aChunkInfo.nb_points;
+    }
+  return aNbPoints;
+}
+
+long long channel_batch_chunks_info(const unsigned char *const *chunks,
+				    const size_t *sizes,int nb_chunks,
+				    int *dtype,int *ndim,int *dims)
+{
+  chunk_info anInfo;
+  long long aNbPoints = _chunks_info(chunks,sizes,nb_chunks,&anInfo);
+  int i;
+
+  if(aNbPoints < 0)
+    return -1;
+  *dtype = anInfo.dtype;
+  *ndim = anInfo.nb_dims;
+  for(i = 0;i < anInfo.nb_dims;++i)
+    dims[i] = anInfo.dims[i];
+  return aNbPoints;
+}
+
+static void _copy_swapped(unsigned char *dst,const unsigned char *src,size_t size,
+			  size_t item_size)
+{
+  size_t i;
+  switch(item_size)
+    {
+    case 2:
+      for(i = 0;i < size;i += 2)
+	{
+	  uint16_t aValue;
+	  memcpy(&aValue,src + i,2);
+	  aValue = __builtin_bswap16(aValue);
+	  memcpy(dst + i,&aValue,2);
+	}
+      break;
+    case 4:
+      for(i = 0;i < size;i += 4)
+	{
+	  uint32_t aValue;
+	  memcpy(&aValue,src + i,4);
+	  aValue = __builtin_bswap32(aValue);
+	  memcpy(dst + i,&aValue,4);
+	}
+      break;
+    case 8:
+      for(i = 0;i < size;i += 8)
+	{
+	  uint64_t aValue;
+	  memcpy(&aValue,src + i,8);
+	  aValue = __builtin_bswap64(aValue);
+	  memcpy(dst + i,&aValue,8);
+	}
+      break;
+    default:
+      memcpy(dst,src,size);
+      break;
+    }
+}
+
+int channel_batch_concatenate(const unsigned char *const *chunks,
+			      const size_t *sizes,int nb_chunks,
+			      void *dest,size_t dest_size)
+{
+  chunk_info anInfo;
+  unsigned char *aDest = dest;
+  size_t aTotal = 0;
+  int aSwap,i;
+
+  if(_chunks_info(chunks,sizes,nb_chunks,&anInfo) < 0)
+    return -1;
+  /* the sizes first, nothing is written if dest is too small */
+  for(i = 0;i < nb_chunks;++i)
+    {
+      chunk_info aChunkInfo;
+      _chunk_info(chunks[i],sizes[i],&aChunkInfo);
+      if(aChunkInfo.data_size > SIZE_MAX - aTotal)
+	return -1;
+      aTotal += aChunkInfo.data_size;
+    }
+  if(aTotal > dest_size)
+    return -1;
+
+  aSwap = anInfo.big_endian != _host_big_endian();
+  for(i = 0;i < nb_chunks;++i)
+    {
+      chunk_info aChunkInfo;
+      _chunk_info(chunks[i],sizes[i],&aChunkInfo);
+      if(aSwap)
+	_copy_swapped(aDest,chunks[i] + aChunkInfo.header_size,aChunkInfo.data_size,
+		      _dtype_size(anInfo.dtype));
+      else
+	memcpy(aDest,chunks[i] + aChunkInfo.header_size,aChunkInfo.data_size);
+      aDest += aChunkInfo.data_size;
+    }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Batching of the acquisition channel points (bliss/data/events/channel_batch.py).
+ *
+ * A batcher copies the points emitted on a channel into preallocated
+ * chunks of capacity points. A chunk is sealed when full or when its
+ * first point is older than max_latency, it is then published as is:
+ *
+ *   "BLCH" | version u8 | dtype u8 | ndim u8 | big endian u8 |
+ *   npoints u32 | dims u32 * ndim | npoints * point raw bytes
+ *
+ * header integers little endian, dims the shape of one point, points in
+ * the host byte order (see bliss/data/events/channel.py encode_chunk).
+ * Popped chunks are reused. A batcher is not thread safe.
+ * channel_batch_concatenate() reads back a list of chunks in one array,
+ * the sizes are summed first and each chunk is copied once.
+ *
+ * The part between the CFFI markers is read by cffi, keep it free of
+ * preprocessor directives.
+ */
+#ifndef __CHANNEL_BATCH
+#define __CHANNEL_BATCH
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+enum {CHANNEL_BATCH_ABI_VERSION = 2};
+
+/* element type of the points, the dtype of a chunk */
+enum channel_batch_dtype {CHANNEL_BATCH_INT8,CHANNEL_BATCH_UINT8,
+			  CHANNEL_BATCH_INT16,CHANNEL_BATCH_UINT16,
+			  CHANNEL_BATCH_INT32,CHANNEL_BATCH_UINT32,
+			  CHANNEL_BATCH_INT64,CHANNEL_BATCH_UINT64,
+			  CHANNEL_BATCH_FLOAT32,CHANNEL_BATCH_FLOAT64};
+
+enum {CHANNEL_BATCH_MAX_DIMS = 4,CHANNEL_BATCH_VERSION = 1};
+
+typedef struct channel_batcher channel_batcher;
+
+int channel_batch_abi_version(void);
+
+/* points of dtype with the ndim dims shape, chunks of capacity points,
+ * max_latency in nanoseconds; NULL if the arguments are invalid (empty
+ * points included) or the memory can't be allocated
+ */
+channel_batcher* channel_batch_new(int dtype,int ndim,const int *dims,
+				   int capacity,long long max_latency);
+void channel_batch_free(channel_batcher *batcher);
+
+/* copy size bytes of whole points, the number of chunks ready; -1 if
+ * size is not a whole number of points or the memory can't be allocated
+ */
+int channel_batch_append(channel_batcher *batcher,const void *data,size_t size);
+/* seal the current chunk if force or if it is too old, the number of
+ * chunks ready
+ */
+int channel_batch_flush(channel_batcher *batcher,int force);
+/* oldest ready chunk (its size in size), valid until popped, NULL if none */
+const unsigned char* channel_batch_front(const channel_batcher *batcher,size_t *size);
+/* drop the oldest ready chunk, the number of chunks still ready */
+int channel_batch_pop(channel_batcher *batcher);
+/* points not in a ready chunk yet */
+int channel_batch_pending(const channel_batcher *batcher);
+
+/* total points of nb_chunks chunks with the same dtype, byte order and
+ * point shape, their dtype and point shape (dims holds
+ * CHANNEL_BATCH_MAX_DIMS); -1 if they differ or one is invalid
+ */
+long long channel_batch_chunks_info(const unsigned char *const *chunks,
+				    const size_t *sizes,int nb_chunks,
+				    int *dtype,int *ndim,int *dims);
+/* points of the chunks (see channel_batch_chunks_info) in dest, in the
+ * host byte order; -1 if the chunks are invalid or dest is too small
+ */
+int channel_batch_concatenate(const unsigned char *const *chunks,
+			      const size_t *sizes,int nb_chunks,
+			      void *dest,size_t dest_size);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,136 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Native batching of the acquisition channel points (see channel_batch.h).
+
+:class:`ChannelBatcher` coalesces the points emitted on an acquisition
+channel in chunks, in the compact layout of
+:func:`bliss.data.events.channel.encode_chunk`. :func:`concatenate` reads
+chunks back in one preallocated array.
+
+The native library is used when it is found, in this order:
+
+- the path given by the ``BLISS_CHANNEL_BATCH_LIBRARY`` environment variable
+- the ``_channel_batch`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_CHANNEL_BATCH``) next to this file
+
+otherwise lib is None: the points are not batched and
+:func:`bliss.data.events.channel.concatenate_chunks` uses numpy.
+"""
+
+import numpy
+
+from bliss.comm import native
+
+ffi, lib = native.load(__file__, "channel_batch", "BLISS_CHANNEL_BATCH_LIBRARY")
+
+# channel_batch_dtype order, the dtype code of a chunk
+DTYPES = tuple(
+    numpy.dtype(t)
+    for t in (
+        numpy.int8,
+        numpy.uint8,
+        numpy.int16,
+        numpy.uint16,
+        numpy.int32,
+        numpy.uint32,
+        numpy.int64,
+        numpy.uint64,
+        numpy.float32,
+        numpy.float64,
+    )
+)
+
+
+class ChannelBatcher:
+    """Coalesce the points emitted on an acquisition channel.
+
+    Points are copied in preallocated chunks of `capacity` points; a chunk
+    is ready when full or when its first point is older than `max_latency`
+    seconds. Chunks are bytes. Not thread safe.
+    """
+
+    def __init__(self, dtype, shape=(), capacity=1024, max_latency=0.1):
+        if lib is None:
+            raise RuntimeError("no channel_batch library")
+        self.dtype = numpy.dtype(dtype)
+        self.shape = tuple(shape)
+        try:
+            code = DTYPES.index(self.dtype)
+        except ValueError:
+            raise TypeError(f"data type {self.dtype} can't be batched")
+        batcher = lib.channel_batch_new(
+            code,
+            len(self.shape),
+            ffi.new("int[]", list(self.shape) or [0]),
+            capacity,
+            int(max_latency * 1e9),
+        )
+        if batcher == ffi.NULL:
+            raise ValueError(f"can't batch points of shape {self.shape} by {capacity}")
+        self._batcher = ffi.gc(batcher, lib.channel_batch_free)
+        self._size = ffi.new("size_t *")
+
+    def append(self, data) -> int:
+        """Copy one point or a block of points, returns the chunks ready"""
+        data = numpy.ascontiguousarray(data, dtype=self.dtype)
+        ready = lib.channel_batch_append(
+            self._batcher, ffi.from_buffer(data), data.nbytes
+        )
+        if ready < 0:
+            raise ValueError(f"can't append {data.shape} data as {self.shape} points")
+        return ready
+
+    def chunks(self, force=False):
+        """Pop the ready chunks, the current one too when `force` or too old
+
+        :returns list(bytes):
+        """
+        lib.channel_batch_flush(self._batcher, force)
+        chunks = []
+        while True:
+            chunk = lib.channel_batch_front(self._batcher, self._size)
+            if chunk == ffi.NULL:
+                break
+            chunks.append(ffi.unpack(ffi.cast("char *", chunk), self._size[0]))
+            lib.channel_batch_pop(self._batcher)
+        return chunks
+
+    @property
+    def pending(self) -> int:
+        """Points not in a ready chunk yet"""
+        return lib.channel_batch_pending(self._batcher)
+
+
+def concatenate(chunks):
+    """Points of chunks in one array, host byte order
+
+    :param list(bytes) chunks: same dtype and point shape
+    :returns numpy.ndarray: (npoints, *point_shape)
+    :raises ValueError: invalid chunks or chunks of different types or shapes
+    """
+    pointers = ffi.new("unsigned char *[]", [ffi.from_buffer(c) for c in chunks])
+    sizes = ffi.new("size_t[]", [len(c) for c in chunks])
+    dtype = ffi.new("int *")
+    ndim = ffi.new("int *")
+    dims = ffi.new("int[]", lib.CHANNEL_BATCH_MAX_DIMS)
+    npoints = lib.channel_batch_chunks_info(
+        pointers, sizes, len(chunks), dtype, ndim, dims
+    )
+    if npoints < 0:
+        raise ValueError("invalid chunks or chunks of different types or shapes")
+    shape = (npoints,) + tuple(dims[i] for i in range(ndim[0]))
+    data = numpy.empty(shape, dtype=DTYPES[dtype[0]])
+    if lib.channel_batch_concatenate(
+        pointers,
+        sizes,
+        len(chunks),
+        ffi.from_buffer(data, require_writable=True),
+        data.nbytes,
+    ):
+        raise ValueError("can't concatenate the chunks")
+    return data
@@ -24,6 +24,14 @@ try:
 except ImportError:
     h5py = None
 
+try:
+    from bliss.data.routines.pixmaptools import core as pixmaptools_core
+except Exception:
+    pixmaptools_core = None
+else:
+    if not pixmaptools_core.available():
+        pixmaptools_core = None
+
 DATA_HEADER_FORMAT = "<IHHIIHHHHHHHHIIIIIIII"
 DATA_MAGIC = struct.unpack(">I", b"DTAY")[0]
 DATA_HEADER_SIZE = struct.calcsize(DATA_HEADER_FORMAT)
@@ -242,6 +250,10 @@ def decode_devencoded_video(
         data = decode_rgb_data(
             raw_data, image_width, image_height, mode, offset=header_size
         )
+    elif pixmaptools_core is not None and mode.name in NATIVE_VIDEO_MODES:
+        data = decode_native_video_data(
+            raw_data, image_width, image_height, mode, offset=header_size
+        )
     else:
         raise ImageFormatNotSupported(f"Video format {mode} is not supported")
 
@@ -378,6 +390,47 @@ def decode_rgb_data(
     return npbuf
 
 
+NATIVE_VIDEO_MODES = (
+    "RGB555",
+    "RGB565",
+    "BGR32",
+    "BGR24",
+    "BAYER_RG8",
+    "BAYER_RG16",
+    "BAYER_BG8",
+    "BAYER_BG16",
+    "I420",
+    "YUV422PACKED",
+)
+"""Video modes the pixmaptools core library can decode to RGB"""
+
+
+def decode_native_video_data(
+    raw_data: bytes, width: int, height: int, mode: VIDEO_MODES, offset: int = 0
+) -> numpy.ndarray:
+    """
+    Decode an encoded raw data into a RGB numpy array with the pixmaptools
+    core library (no Qt nor OpenCV needed).
+
+    Arguments:
+        raw_data: Encoded raw data
+        offset: Location of the data in the buffer
+        width: width of the output image
+        height: height of the output image
+        mode: LimaCDD video mode
+    """
+    if pixmaptools_core is None:
+        raise ImageFormatNotSupported("pixmaptools core library is not available")
+    image_type = pixmaptools_core.ImageType[mode.name]
+    try:
+        image = pixmaptools_core.raw_video_to_bgra(
+            raw_data, width, height, image_type, offset=offset
+        )
+    except pixmaptools_core.NativeError as e:
+        raise ImageFormatNotSupported(f"Video format {mode}: {e}")
+    return pixmaptools_core.bgra_to_rgb(image)
+
+
 def read_video_last_image(proxy) -> typing.Optional[typing.Tuple[numpy.ndarray, int]]:
     """Read and decode video last image from a Lima detector
 
@@ -440,7 +493,10 @@ def image_from_file(filename, path_in_file, image_index, file_format):
     if file_format.startswith("edf"):
         if file_format == "edfconcat":
             image_index = 0
-        if EdfFile is not None:
+        if pixmaptools_core is not None:
+            # mapped file, the frame index is kept while the file is unchanged
+            return pixmaptools_core.open_edf(filename).data(image_index)
+        elif EdfFile is not None:
             f = EdfFile(filename)
             return f.GetData(image_index)
         else:
@@ -454,3 +510,75 @@ def image_from_file(filename, path_in_file, image_index, file_format):
                 return dataset[image_index]
     else:
         raise RuntimeError("Format not managed yet")
+
+
+PREFETCH_DEPTH = 8
+"""Frames read ahead by :func:`iter_images_from_file`"""
+
+PREFETCH_MEMORY_BUDGET = 256 << 20
+"""Bytes of frames the prefetcher keeps, read ahead or recently read"""
+
+_frame_prefetcher = None
+
+
+def frame_prefetcher():
+    """Native EDF read-ahead shared by the image iterations, None if the
+    pixmaptools core library is not available"""
+    global _frame_prefetcher
+    if _frame_prefetcher is None and pixmaptools_core is not None:
+        _frame_prefetcher = pixmaptools_core.FramePrefetcher(
+            nb_threads=2, memory_budget=PREFETCH_MEMORY_BUDGET
+        )
+    return _frame_prefetcher
+
+
+def _prefetch_key(filename, path_in_file, image_index, file_format):
+    """(filename, frame index) for the native reader, None for other formats"""
+    file_format = file_format.lower()
+    if file_format in ("edf", "edflz4"):
+        return filename, image_index
+    elif file_format == "edfconcat":
+        return filename, 0
+    return None
+
+
+def iter_images_from_file(references, depth=None):
+    """Images of references (see :func:`image_from_file`) in order.
+
+    The next `depth` EDF frames are read by native threads while the
+    current one is processed, other formats are read on demand.
+
+    :param list references: (filename, path_in_file, image_index, file_format)
+    :param int depth: frames read ahead, PREFETCH_DEPTH by default, 0 disables it
+    """
+    references = list(references)
+    if depth is None:
+        depth = PREFETCH_DEPTH
+    prefetcher = frame_prefetcher() if depth > 0 else None
+    if prefetcher is None:
+        for reference in references:
+            yield image_from_file(*reference)
+        return
+
+    keys = [_prefetch_key(*reference) for reference in references]
+    pending = set()
+
+    def request(i):
+        if i < len(keys) and keys[i] is not None and prefetcher.prefetch(*keys[i]):
+            pending.add(keys[i])
+
+    try:
+        for i in range(depth):
+            request(i)
+        for i, reference in enumerate(references):
+            request(i + depth)
+            key = keys[i]
+            if key is None:
+                yield image_from_file(*reference)
+            else:
+                pending.discard(key)
+                yield prefetcher.get(*key)
+    finally:
+        # frames read ahead but never taken are not evicted
+        for key in pending:
+            prefetcher.cancel(*key)
@@ -221,7 +221,11 @@ class ChannelDataNode(_ChannelDataNodeBase):
     def store(self, event_dict, cnx=None):
         """Publish channel data in Redis
         """
-        ev = ChannelDataEvent(event_dict.get("data"), event_dict["description"])
+        ev = ChannelDataEvent(
+            event_dict.get("data"),
+            event_dict["description"],
+            chunk=event_dict.get("chunk"),
+        )
         self._queue.add_event(ev, id=self._last_index, cnx=cnx)
         self._last_index += ev.npoints
 
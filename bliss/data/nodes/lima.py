@@ -203,7 +203,13 @@ class LimaDataView:
     def _image_iter(self, image_nb_iterator):
         """Iterator over images from server or file
         """
-        for image_nb in image_nb_iterator:
+        image_nbs = [int(image_nb) for image_nb in image_nb_iterator]
+        references = self._file_references(image_nbs)
+        if references is not None:
+            # only in files: the next frames are read ahead
+            yield from lima_image.iter_images_from_file(references)
+            return
+        for image_nb in image_nbs:
             try:
                 img = self.get_image(image_nb)
             except IndexError:
@@ -212,6 +218,23 @@ class LimaDataView:
                 break
             yield img
 
+    def _file_references(self, image_nbs):
+        """References of images which can only be read from file,
+        None when some may still be in the server memory or are not saved
+        """
+        if len(image_nbs) < 2 or min(image_nbs) < 0:
+            return None
+        if lima_image.frame_prefetcher() is None:
+            return None
+        self.update()
+        ev = self.status_event
+        try:
+            if ev.proxy is not None and ev.current_lima_acq == ev.lima_acq_nb:
+                return None
+            return ev.image_references(image_nbs, saved=True)
+        except (RuntimeError, IndexError, KeyError, ImageNotSaved):
+            return None
+
     def as_array(self):
         if len(self) == 1:
             # To be consistant with ChannelDataNode
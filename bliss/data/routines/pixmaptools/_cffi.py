@@ -0,0 +1,32 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""CFFI binding of the pixmaptools C ABI (see pixmaptools_capi.h).
+
+The core library is looked up (see :func:`bliss.comm.native.load`), in
+this order:
+
+- the path given by the ``PIXMAPTOOLS_CORE_LIBRARY`` environment variable
+- the ``_pixmaptools_core`` library built by setup.py (opt-in, see
+  ``BLISS_BUILD_PIXMAPTOOLS_CORE``) next to this file
+- ``libpixmaptools_core`` in the system library path
+
+``lib`` is None when no library is found.
+"""
+
+__all__ = ["ffi", "lib"]
+
+from bliss.comm import native
+
+ffi, lib = native.load(
+    __file__,
+    "pixmaptools_core",
+    "PIXMAPTOOLS_CORE_LIBRARY",
+    header="pixmaptools_capi.h",
+    abi="pixmaptools",
+    system=True,
+)
@@ -0,0 +1,459 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/** @brief standalone benchmark of pixmaptools kernels
+ *
+ *  Sweep LUT mapping, raw video conversion and Stat histograms over
+ *  all data types, image types, mapping methods, frame sizes and
+ *  thread counts. Results are written as JSON on stdout, one entry
+ *  per (kernel,type,method,size,threads) with Mpix/s and GB/s.
+ *
+ *  usage: pixmaptools_bench [--quick] [--kernel name] [--size n]
+ *                           [--threads n] [--min-time seconds]
+ */
+
+#include "pixmaptools_lut.h"
+#include "pixmaptools_stat.h"
+#include "pixmaptools_thread.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+struct FrameSize
+{
+  int column,row;
+};
+
+// from 0.3 to 16 Mpix
+static const FrameSize FRAME_SIZES[] = {{640,480},{1024,1024},{2048,2048},{4096,4096}};
+static const int NB_FRAME_SIZES = sizeof(FRAME_SIZES) / sizeof(FrameSize);
+
+struct Options
+{
+  Options() : quick(false),minTime(0.2),size(-1),threads(-1) {}
+  bool		quick;
+  double	minTime;
+  std::string	kernel;
+  int		size;		// index in FRAME_SIZES or -1 for all
+  int		threads;	// -1 for the default sweep
+};
+
+static double _now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** @brief call the task until minTime is spent (at least 3 times)
+ *  @return the best time of one call
+ */
+template<class TASK>
+static double _measure(TASK &aTask,double minTime)
+{
+  aTask();			// warm up
+  double best = -1.;
+  double start = _now();
+  int nbIter = 0;
+  do
+    {
+      double t0 = _now();
+      aTask();
+      double elapsed = _now() - t0;
+      if(best < 0. || elapsed < best) best = elapsed;
+      ++nbIter;
+    }
+  while(nbIter < 3 || _now() - start < minTime);
+  return best;
+}
+
+static bool _first_result = true;
+
+static void _report(const char *kernel,const char *type,const char *meth,
+		    const FrameSize &aSize,int nbThreads,
+		    double time,double nbBytes)
+{
+  double nbPixel = double(aSize.column) * aSize.row;
+  printf("%s\n    {\"kernel\": \"%s\", \"type\": \"%s\", \"meth\": \"%s\", "
+	 "\"column\": %d, \"row\": %d, \"threads\": %d, "
+	 "\"time_s\": %.9f, \"mpix_s\": %.3f, \"gb_s\": %.3f}",
+	 _first_result ? "" : ",",
+	 kernel,type,meth,aSize.column,aSize.row,nbThreads,
+	 time,nbPixel / time * 1e-6,nbBytes / time * 1e-9);
+  _first_result = false;
+  fflush(stdout);
+}
+
+static bool _selected(const Options &opt,const char *kernel)
+{
+  return opt.kernel.empty() || opt.kernel == kernel;
+}
+
+// random data, spread on the full range for integers and on [-1e3,1e6] for floats
+template<class IN>
+static void _fill(std::vector<IN> &data,int nbElem)
+{
+  data.resize(nbElem);
+  unsigned int seed = 0x5eed;
+  for(int i = 0;i < nbElem;++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      unsigned int val = seed >> 8;
+      if(IN(0.5) != IN(0))
+	data[i] = IN(double(val % 1001000) - 1000.);
+      else
+	data[i] = IN(val);
+    }
+}
+
+static void _fill_bytes(std::vector<unsigned char> &data,size_t nbBytes)
+{
+  data.resize(nbBytes);
+  unsigned int seed = 0xb1155;
+  for(size_t i = 0;i < nbBytes;++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (unsigned char)(seed >> 16);
+    }
+}
+
+template<class IN>
+struct _MapMinMax
+{
+  const IN *data;
+  unsigned int *image;
+  FrameSize size;
+  LUT::Palette *palette;
+  LUT::mapping_meth meth;
+  void operator()()
+  {
+    IN dataMin,dataMax;
+    LUT::map_on_min_max_val(data,image,size.column,size.row,*palette,meth,dataMin,dataMax);
+  }
+};
+
+template<class IN>
+struct _MapSigma
+{
+  const IN *data;
+  unsigned int *image;
+  FrameSize size;
+  LUT::Palette *palette;
+  LUT::mapping_meth meth;
+  void operator()()
+  {
+    IN dataMin,dataMax;
+    LUT::map_on_plus_minus_sigma(data,image,size.column,size.row,*palette,meth,3.,
+				 dataMin,dataMax);
+  }
+};
+
+template<class IN>
+struct _Map
+{
+  const IN *data;
+  unsigned int *image;
+  FrameSize size;
+  LUT::Palette *palette;
+  LUT::mapping_meth meth;
+  IN dataMin,dataMax;
+  void operator()()
+  {
+    LUT::map(data,image,size.column,size.row,*palette,meth,dataMin,dataMax);
+  }
+};
+
+template<class IN>
+struct _Histo
+{
+  const IN *data;
+  int nbElem;
+  void operator()()
+  {
+    std::vector<int> Y;
+    std::vector<IN> X;
+    Stat::histo(data,nbElem,Y,X,1000);
+  }
+};
+
+template<class IN>
+struct _HistoLog
+{
+  const IN *data;
+  int nbElem;
+  void operator()()
+  {
+    std::vector<int> Y;
+    std::vector<double> X;
+    Stat::histo_log(data,nbElem,Y,X,1000);
+  }
+};
+
+template<class IN>
+struct _HistoFull
+{
+  const IN *data;
+  int nbElem;
+  void operator()()
+  {
+    std::vector<int> Y;
+    std::vector<IN> X;
+    Stat::histo_full(data,nbElem,Y,X);
+  }
+};
+
+static const char* _meth_name(LUT::mapping_meth aMeth)
+{
+  switch(aMeth)
+    {
+    case LUT::LOG: return "LOG";
+    case LUT::SHIFT_LOG: return "SHIFT_LOG";
+    default: return "LINEAR";
+    }
+}
+
+template<class IN>
+static void _bench_type(const Options &opt,const char *typeName,
+			const FrameSize &aSize,int nbThreads)
+{
+  int nbPixel = aSize.column * aSize.row;
+  std::vector<IN> data;
+  _fill(data,nbPixel);
+  std::vector<unsigned int> image(nbPixel);
+  LUT::Palette aPalette(LUT::Palette::TEMP);
+  double mapBytes = double(nbPixel) * (sizeof(IN) + sizeof(unsigned int));
+
+  static const LUT::mapping_meth meths[] = {LUT::LINEAR,LUT::LOG,LUT::SHIFT_LOG};
+  for(int m = 0;m < 3;++m)
+    {
+      LUT::mapping_meth aMeth = meths[m];
+      if(_selected(opt,"map_on_min_max_val"))
+	{
+	  _MapMinMax<IN> aTask = {&data[0],&image[0],aSize,&aPalette,aMeth};
+	  _report("map_on_min_max_val",typeName,_meth_name(aMeth),aSize,nbThreads,
+		  _measure(aTask,opt.minTime),mapBytes);
+	}
+      if(_selected(opt,"map_on_plus_minus_sigma"))
+	{
+	  _MapSigma<IN> aTask = {&data[0],&image[0],aSize,&aPalette,aMeth};
+	  _report("map_on_plus_minus_sigma",typeName,_meth_name(aMeth),aSize,nbThreads,
+		  _measure(aTask,opt.minTime),mapBytes);
+	}
+      if(_selected(opt,"map"))
+	{
+	  IN dataMin,dataMax;
+	  Stat::_find_min_max(&data[0],nbPixel,dataMin,dataMax);
+	  _Map<IN> aTask = {&data[0],&image[0],aSize,&aPalette,aMeth,
+			    IN(dataMin + (dataMax - dataMin) / 10),
+			    IN(dataMax - (dataMax - dataMin) / 10)};
+	  _report("map",typeName,_meth_name(aMeth),aSize,nbThreads,
+		  _measure(aTask,opt.minTime),mapBytes);
+	}
+    }
+  double histoBytes = double(nbPixel) * sizeof(IN);
+  if(_selected(opt,"histo"))
+    {
+      _Histo<IN> aTask = {&data[0],nbPixel};
+      _report("histo",typeName,"",aSize,nbThreads,_measure(aTask,opt.minTime),histoBytes);
+    }
+  if(_selected(opt,"histo_log"))
+    {
+      _HistoLog<IN> aTask = {&data[0],nbPixel};
+      _report("histo_log",typeName,"",aSize,nbThreads,_measure(aTask,opt.minTime),histoBytes);
+    }
+  if(_selected(opt,"histo_full") && !opt.quick)
+    {
+      _HistoFull<IN> aTask = {&data[0],nbPixel};
+      _report("histo_full",typeName,"",aSize,nbThreads,_measure(aTask,opt.minTime),histoBytes);
+    }
+}
+
+struct VideoType
+{
+  LUT::Scaling::image_type type;
+  const char *name;
+  double bytesPerPixel;
+};
+
+static const VideoType VIDEO_TYPES[] = {
+  {LUT::Scaling::Y8,"Y8",1.},
+  {LUT::Scaling::Y16,"Y16",2.},
+  {LUT::Scaling::Y32,"Y32",4.},
+  {LUT::Scaling::Y64,"Y64",8.},
+  {LUT::Scaling::I420,"I420",1.5},
+  {LUT::Scaling::RGB555,"RGB555",2.},
+  {LUT::Scaling::RGB565,"RGB565",2.},
+  {LUT::Scaling::RGB24,"RGB24",3.},
+  {LUT::Scaling::RGB32,"RGB32",4.},
+  {LUT::Scaling::BGR24,"BGR24",3.},
+  {LUT::Scaling::BGR32,"BGR32",4.},
+  {LUT::Scaling::BAYER_RG8,"BAYER_RG8",1.},
+  {LUT::Scaling::BAYER_RG16,"BAYER_RG16",2.},
+  {LUT::Scaling::BAYER_BG8,"BAYER_BG8",1.},
+  {LUT::Scaling::BAYER_BG16,"BAYER_BG16",2.},
+  {LUT::Scaling::YUV411,"YUV411",1.5},
+  {LUT::Scaling::YUV422,"YUV422",2.},
+  {LUT::Scaling::YUV444,"YUV444",3.},
+  {LUT::Scaling::YUV422PACKED,"YUV422PACKED",2.},
+};
+static const int NB_VIDEO_TYPES = sizeof(VIDEO_TYPES) / sizeof(VideoType);
+
+struct _RawVideo2Image
+{
+  const unsigned char *data;
+  unsigned int *image;
+  FrameSize size;
+  LUT::Scaling::image_type type;
+  LUT::Scaling *scaling;
+  bool supported;
+  void operator()()
+  {
+    supported = LUT::raw_video_2_image(data,image,size.column,size.row,type,*scaling);
+  }
+};
+
+struct _RawVideo2Luma
+{
+  const unsigned char *data;
+  FrameSize size;
+  LUT::Scaling::image_type type;
+  bool supported;
+  void operator()()
+  {
+    unsigned char *luma = LUT::raw_video_2_luma(data,size.column,size.row,type);
+    supported = luma != NULL;
+    free(luma);
+  }
+};
+
+static void _bench_video(const Options &opt,const FrameSize &aSize,int nbThreads)
+{
+  int nbPixel = aSize.column * aSize.row;
+  std::vector<unsigned char> data;
+  _fill_bytes(data,size_t(nbPixel) * 8);
+  std::vector<unsigned int> image(nbPixel);
+
+  static const LUT::Scaling::mode modes[] = {LUT::Scaling::UNACTIVE,
+					     LUT::Scaling::QUICK,
+					     LUT::Scaling::COLOR_MAPPED};
+  static const char *modeNames[] = {"UNACTIVE","QUICK","COLOR_MAPPED"};
+  for(int t = 0;t < NB_VIDEO_TYPES;++t)
+    {
+      const VideoType &aType = VIDEO_TYPES[t];
+      double inBytes = nbPixel * aType.bytesPerPixel;
+      if(_selected(opt,"raw_video_2_image"))
+	{
+	  for(int m = 0;m < 3;++m)
+	    {
+	      // scaling of packed YUV422 is not implemented (and print a TODO)
+	      if(aType.type == LUT::Scaling::YUV422PACKED && modes[m] != LUT::Scaling::UNACTIVE)
+		continue;
+	      LUT::Scaling aScaling;
+	      if(modes[m] != LUT::Scaling::UNACTIVE)
+		aScaling.autoscale_min_max(&data[0],aSize.column,aSize.row,aType.type);
+	      aScaling.set_mode(modes[m]);
+	      _RawVideo2Image aTask = {&data[0],&image[0],aSize,aType.type,&aScaling,false};
+	      aTask();
+	      if(!aTask.supported) break;
+	      _report("raw_video_2_image",aType.name,modeNames[m],aSize,nbThreads,
+		      _measure(aTask,opt.minTime),inBytes + nbPixel * 4.);
+	    }
+	}
+      if(_selected(opt,"raw_video_2_luma"))
+	{
+	  _RawVideo2Luma aTask = {&data[0],aSize,aType.type,false};
+	  aTask();
+	  bool luma16 = (aType.type == LUT::Scaling::Y16 ||
+			 aType.type == LUT::Scaling::BAYER_RG16 ||
+			 aType.type == LUT::Scaling::BAYER_BG16);
+	  if(aTask.supported)
+	    _report("raw_video_2_luma",aType.name,"",aSize,nbThreads,
+		    _measure(aTask,opt.minTime),inBytes + nbPixel * (luma16 ? 2. : 1.));
+	}
+    }
+}
+
+static void _usage(const char *prog)
+{
+  fprintf(stderr,"usage: %s [--quick] [--kernel name] [--size index] "
+	  "[--threads n] [--min-time seconds]\n",prog);
+  exit(1);
+}
+
+int main(int argc,char **argv)
+{
+  Options opt;
+  for(int i = 1;i < argc;++i)
+    {
+      std::string arg = argv[i];
+      if(arg == "--quick")
+	opt.quick = true,opt.minTime = 0.02;
+      else if(arg == "--kernel" && i + 1 < argc)
+	opt.kernel = argv[++i];
+      else if(arg == "--size" && i + 1 < argc)
+	opt.size = atoi(argv[++i]);
+      else if(arg == "--threads" && i + 1 < argc)
+	opt.threads = atoi(argv[++i]);
+      else if(arg == "--min-time" && i + 1 < argc)
+	opt.minTime = atof(argv[++i]);
+      else
+	_usage(argv[0]);
+    }
+  if(opt.size >= NB_FRAME_SIZES) _usage(argv[0]);
+
+  int nbCpu = Parallel::nb_threads();
+  std::vector<int> threads;
+  if(opt.threads > 0)
+    threads.push_back(opt.threads);
+  else if(opt.quick)
+    {
+      threads.push_back(1);
+      if(nbCpu > 1) threads.push_back(nbCpu);
+    }
+  else
+    {
+      for(int n = 1;n < nbCpu;n <<= 1)
+	threads.push_back(n);
+      threads.push_back(nbCpu);
+    }
+
+  char hostname[256] = "";
+  gethostname(hostname,sizeof(hostname) - 1);
+  printf("{\n  \"host\": \"%s\",\n  \"nb_cpu\": %d,\n  \"cpu_level\": \"%s\",\n  \"results\": [",
+	 hostname,nbCpu,Cpu::name(Cpu::current()));
+
+  for(int s = 0;s < NB_FRAME_SIZES;++s)
+    {
+      if(opt.size >= 0 && s != opt.size) continue;
+      if(opt.quick && opt.size < 0 && s != 1) continue;
+      const FrameSize &aSize = FRAME_SIZES[s];
+      for(size_t t = 0;t < threads.size();++t)
+	{
+	  Parallel::set_nb_threads(threads[t]);
+	  _bench_type<char>(opt,"int8",aSize,threads[t]);
+	  _bench_type<unsigned char>(opt,"uint8",aSize,threads[t]);
+	  _bench_type<short>(opt,"int16",aSize,threads[t]);
+	  _bench_type<unsigned short>(opt,"uint16",aSize,threads[t]);
+	  _bench_type<int>(opt,"int32",aSize,threads[t]);
+	  _bench_type<unsigned int>(opt,"uint32",aSize,threads[t]);
+	  _bench_type<long>(opt,"int64",aSize,threads[t]);
+	  _bench_type<unsigned long>(opt,"uint64",aSize,threads[t]);
+	  _bench_type<float>(opt,"float32",aSize,threads[t]);
+	  _bench_type<double>(opt,"float64",aSize,threads[t]);
+	  _bench_video(opt,aSize,threads[t]);
+	}
+    }
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,1046 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Numpy front-end of the Qt-free pixmaptools kernels.
+
+Usable without Qt nor SIP, the kernels are called through the C ABI
+(:mod:`._cffi`). Call :func:`available` before anything else: the core
+library is optional.
+
+Images are returned as 2D uint32 arrays of BGRA pixels (0xAARRGGBB),
+:func:`bgra_to_rgb` converts them to (h, w, 3) uint8 arrays.
+"""
+
+import os
+import enum
+import threading
+import collections
+import numpy
+
+from ._cffi import ffi, lib
+
+
+class PaletteType(enum.IntEnum):
+    GREYSCALE = 0
+    TEMP = 1
+    RED = 2
+    GREEN = 3
+    BLUE = 4
+    REVERSEGREY = 5
+    MANY = 6
+    GEOGRAPHICAL = 7
+    USER = 8
+
+
+class MappingMethod(enum.IntEnum):
+    LINEAR = 0
+    LOG = 1
+    SHIFT_LOG = 2
+
+
+class ScalingMode(enum.IntEnum):
+    UNACTIVE = 0
+    QUICK = 1
+    ACCURATE = 2
+    COLOR_MAPPED = 3
+
+
+class ImageType(enum.IntEnum):
+    """Raw video types of LUT::Scaling (names match Lima video modes)"""
+
+    Y8 = 1
+    Y16 = 2
+    Y32 = 3
+    Y64 = 4
+    I420 = 5
+    RGB555 = 6
+    RGB565 = 7
+    RGB24 = 8
+    RGB32 = 9
+    BGR24 = 10
+    BGR32 = 11
+    BAYER_RG8 = 12
+    BAYER_RG16 = 13
+    BAYER_BG8 = 14
+    BAYER_BG16 = 15
+    YUV411 = 16
+    YUV422 = 17
+    YUV444 = 18
+    YUV422PACKED = 19
+
+
+_DTYPES = {
+    numpy.dtype(numpy.int8): 0,
+    numpy.dtype(numpy.uint8): 1,
+    numpy.dtype(numpy.int16): 2,
+    numpy.dtype(numpy.uint16): 3,
+    numpy.dtype(numpy.int32): 4,
+    numpy.dtype(numpy.uint32): 5,
+    numpy.dtype(numpy.int64): 6,
+    numpy.dtype(numpy.uint64): 7,
+    numpy.dtype(numpy.float32): 8,
+    numpy.dtype(numpy.float64): 9,
+}
+
+
+class NativeError(RuntimeError):
+    """Raised when a pixmaptools kernel reports an error"""
+
+
+def available() -> bool:
+    """True if the core library was found"""
+    return lib is not None
+
+
+def _check(ret):
+    if ret < 0:
+        raise NativeError(ffi.string(lib.pixmaptools_last_error()).decode())
+    return ret
+
+
+def _as_native(data):
+    data = numpy.ascontiguousarray(data)
+    if data.dtype.byteorder not in "=|":
+        data = data.astype(data.dtype.newbyteorder("="))
+    try:
+        dtype = _DTYPES[data.dtype]
+    except KeyError:
+        raise NativeError(f"data type {data.dtype} not supported")
+    return data, dtype
+
+
+def set_nb_threads(nb_threads: int):
+    """Number of threads used by the kernels, <= 0 for the number of cpus"""
+    lib.pixmaptools_set_nb_threads(nb_threads)
+
+
+def nb_threads() -> int:
+    return lib.pixmaptools_nb_threads()
+
+
+class Palette:
+    def __init__(self, palette_type=PaletteType.GREYSCALE):
+        palette = lib.pixmaptools_palette_new(int(palette_type), 1)  # BGRX
+        if palette == ffi.NULL:
+            _check(-1)
+        self._palette = ffi.gc(palette, lib.pixmaptools_palette_free)
+
+    def fill(self, palette_type):
+        _check(lib.pixmaptools_palette_fill(self._palette, int(palette_type)))
+
+    def set_data(self, colors):
+        """colors: 1D uint32 array of 0xAARRGGBB"""
+        colors = numpy.ascontiguousarray(colors, dtype=numpy.uint32)
+        _check(
+            lib.pixmaptools_palette_set_data(
+                self._palette,
+                ffi.from_buffer("unsigned int[]", colors),
+                len(colors),
+            )
+        )
+
+
+def map(
+    data, palette=PaletteType.GREYSCALE, method=MappingMethod.LINEAR, vmin=None, vmax=None
+):
+    """Map a 2D array through a palette.
+
+    Without vmin/vmax the data min/max are used.
+
+    Returns:
+        (image, vmin, vmax) with image a uint32 BGRA array
+    """
+    data, dtype = _as_native(data)
+    if data.ndim != 2:
+        raise ValueError("data must be a 2D array")
+    if not isinstance(palette, Palette):
+        palette = Palette(palette)
+    row, column = data.shape
+    image = numpy.empty((row, column), dtype=numpy.uint32)
+    src = ffi.from_buffer(data)
+    dst = ffi.from_buffer("unsigned int[]", image, require_writable=True)
+    if vmin is None or vmax is None:
+        dmin = ffi.new("double *")
+        dmax = ffi.new("double *")
+        _check(
+            lib.pixmaptools_map_on_min_max_val(
+                src, dtype, dst, column, row, palette._palette, int(method), dmin, dmax
+            )
+        )
+        return image, dmin[0], dmax[0]
+    _check(
+        lib.pixmaptools_map(
+            src, dtype, dst, column, row, palette._palette, int(method), vmin, vmax
+        )
+    )
+    return image, vmin, vmax
+
+
+class Scaling:
+    """Decoding state of a raw video stream (mode, min/max, palette)"""
+
+    def __init__(self, mode=ScalingMode.UNACTIVE):
+        scaling = lib.pixmaptools_scaling_new()
+        if scaling == ffi.NULL:
+            _check(-1)
+        self._scaling = ffi.gc(scaling, lib.pixmaptools_scaling_free)
+        if mode != ScalingMode.UNACTIVE:
+            self.mode = mode
+
+    @property
+    def mode(self):
+        return ScalingMode(_check(lib.pixmaptools_scaling_get_mode(self._scaling)))
+
+    @mode.setter
+    def mode(self, mode):
+        _check(lib.pixmaptools_scaling_set_mode(self._scaling, int(mode)))
+
+    @property
+    def min_max(self):
+        vmin = ffi.new("double *")
+        vmax = ffi.new("double *")
+        _check(lib.pixmaptools_scaling_min_max_mapping(self._scaling, vmin, vmax))
+        return vmin[0], vmax[0]
+
+    def set_custom_mapping(self, vmin, vmax):
+        _check(lib.pixmaptools_scaling_set_custom_mapping(self._scaling, vmin, vmax))
+
+    def fill_palette(self, palette_type):
+        _check(lib.pixmaptools_scaling_fill_palette(self._scaling, int(palette_type)))
+
+    def set_palette_mapping_meth(self, method):
+        _check(
+            lib.pixmaptools_scaling_set_palette_mapping_meth(self._scaling, int(method))
+        )
+
+    def autoscale_min_max(self, raw, width, height, image_type, offset=0):
+        src, size = _raw_buffer(raw, offset)
+        _check(
+            lib.pixmaptools_scaling_autoscale_min_max(
+                self._scaling, src, size, width, height, int(image_type)
+            )
+        )
+
+    def autoscale_plus_minus_sigma(
+        self, raw, width, height, image_type, sigma_factor, offset=0
+    ):
+        src, size = _raw_buffer(raw, offset)
+        _check(
+            lib.pixmaptools_scaling_autoscale_plus_minus_sigma(
+                self._scaling, src, size, width, height, int(image_type), sigma_factor
+            )
+        )
+
+
+def _raw_buffer(raw, offset):
+    if isinstance(raw, numpy.ndarray):
+        raw = numpy.ascontiguousarray(raw)
+    view = memoryview(raw).cast("B")[offset:]
+    return ffi.from_buffer("unsigned char[]", view), len(view)
+
+
+def raw_video_to_bgra(raw, width, height, image_type, scaling=None, offset=0):
+    """Decode a raw video frame to a (height, width) uint32 BGRA array"""
+    if scaling is None:
+        scaling = Scaling()
+    src, size = _raw_buffer(raw, offset)
+    image = numpy.empty((height, width), dtype=numpy.uint32)
+    dst = ffi.from_buffer("unsigned int[]", image, require_writable=True)
+    _check(
+        lib.pixmaptools_raw_video_2_image(
+            src, size, dst, width, height, int(image_type), scaling._scaling
+        )
+    )
+    return image
+
+
+def raw_video_to_luma(raw, width, height, image_type, offset=0):
+    """Luma of a raw video frame, uint8 or uint16 (height, width) array"""
+    src, size = _raw_buffer(raw, offset)
+    luma = numpy.empty((height, width), dtype=numpy.uint16)
+    depth = ffi.new("int *")
+    _check(
+        lib.pixmaptools_raw_video_2_luma(
+            src,
+            size,
+            width,
+            height,
+            int(image_type),
+            ffi.from_buffer(luma, require_writable=True),
+            luma.nbytes,
+            depth,
+        )
+    )
+    if depth[0] == 1:
+        return luma.view(numpy.uint8).ravel()[: width * height].reshape(height, width)
+    return luma
+
+
+class Autoscale(enum.IntEnum):
+    NO_AUTOSCALE = 0
+    MIN_MAX = 1
+    PLUS_MINUS_SIGMA = 2
+
+
+class DisplayWorker:
+    """Decode raw video frames in a native thread, latest frame wins.
+
+    :meth:`push` and :meth:`fetch` never wait for the decoding: frames
+    pushed faster than they are decoded, or decoded faster than they are
+    fetched, are dropped. Call :meth:`push` from one thread and
+    :meth:`fetch` from one thread.
+    """
+
+    def __init__(self, scaling=None):
+        if scaling is None:
+            scaling = Scaling()
+        worker = lib.pixmaptools_display_worker_new(scaling._scaling)
+        if worker == ffi.NULL:
+            _check(-1)
+        self.scaling = scaling
+        # the destructor keeps the scaling alive until the thread is joined
+        self._worker = ffi.gc(
+            worker, lambda w, s=scaling: lib.pixmaptools_display_worker_free(w)
+        )
+
+    def start(self):
+        _check(lib.pixmaptools_display_worker_start(self._worker))
+
+    def stop(self):
+        _check(lib.pixmaptools_display_worker_stop(self._worker))
+
+    def set_autoscale(self, autoscale, sigma_factor=3.0):
+        _check(
+            lib.pixmaptools_display_worker_set_autoscale(
+                self._worker, int(autoscale), sigma_factor
+            )
+        )
+
+    def push(self, raw, width, height, image_type, frame_number=-1, offset=0):
+        src, size = _raw_buffer(raw, offset)
+        _check(
+            lib.pixmaptools_display_worker_push(
+                self._worker, src, size, width, height, int(image_type), frame_number
+            )
+        )
+
+    def fetch(self):
+        """Latest decoded image, None if none since the last call
+
+        Returns:
+            (image, frame_number, latency) with latency in seconds from
+            push to now
+        """
+        info = ffi.new("pixmaptools_frame_info *")
+        if not _check(lib.pixmaptools_display_worker_fetch(self._worker, info)):
+            return None
+        image = numpy.empty((info.row, info.column), dtype=numpy.uint32)
+        _check(
+            lib.pixmaptools_display_worker_copy_image(
+                self._worker,
+                ffi.from_buffer("unsigned int[]", image, require_writable=True),
+                image.nbytes,
+            )
+        )
+        latency = (lib.pixmaptools_timing_now() - info.timestamp) * 1e-9
+        return image, info.frame_number, latency
+
+    @property
+    def counters(self):
+        """{pushed, dropped, decoded, skipped, errors}"""
+        counters = ffi.new("pixmaptools_display_counters *")
+        _check(lib.pixmaptools_display_worker_counters(self._worker, counters))
+        return {
+            key: getattr(counters, key)
+            for key in ("pushed", "dropped", "decoded", "skipped", "errors")
+        }
+
+
+class VideoPipeline:
+    """Native decode -> autoscale -> map chain running in its own thread.
+
+    Configure it once, push raw or DevEncoded frames, fetch the latest
+    finished image. Images are numpy views on the pipeline buffers (no
+    copy), a buffer is reused once its array is garbage collected.
+    """
+
+    STAGES = ("queue", "autoscale", "decode", "total")
+    MAX_IMAGES = 8
+    """Images alive at once (VideoPipeline::MAX_IMAGES), fetched ones included"""
+
+    def __init__(self, mode=ScalingMode.UNACTIVE, palette=None, autoscale=None):
+        pipeline = lib.pixmaptools_pipeline_new()
+        if pipeline == ffi.NULL:
+            _check(-1)
+        self._pipeline = ffi.gc(pipeline, lib.pixmaptools_pipeline_free)
+        if mode != ScalingMode.UNACTIVE:
+            self.set_mode(mode)
+        if palette is not None:
+            self.fill_palette(palette)
+        if autoscale is not None:
+            self.set_autoscale(autoscale)
+
+    def start(self):
+        _check(lib.pixmaptools_pipeline_start(self._pipeline))
+
+    def stop(self):
+        _check(lib.pixmaptools_pipeline_stop(self._pipeline))
+
+    def set_mode(self, mode):
+        _check(lib.pixmaptools_pipeline_set_mode(self._pipeline, int(mode)))
+
+    @property
+    def min_max(self):
+        vmin = ffi.new("double *")
+        vmax = ffi.new("double *")
+        _check(lib.pixmaptools_pipeline_min_max_mapping(self._pipeline, vmin, vmax))
+        return vmin[0], vmax[0]
+
+    def set_custom_mapping(self, vmin, vmax):
+        _check(lib.pixmaptools_pipeline_set_custom_mapping(self._pipeline, vmin, vmax))
+
+    def fill_palette(self, palette_type):
+        _check(lib.pixmaptools_pipeline_fill_palette(self._pipeline, int(palette_type)))
+
+    def set_palette_mapping_meth(self, method):
+        _check(
+            lib.pixmaptools_pipeline_set_palette_mapping_meth(
+                self._pipeline, int(method)
+            )
+        )
+
+    def set_autoscale(self, autoscale, sigma_factor=3.0):
+        _check(
+            lib.pixmaptools_pipeline_set_autoscale(
+                self._pipeline, int(autoscale), sigma_factor
+            )
+        )
+
+    def push(self, raw, width, height, image_type, frame_number=-1, offset=0):
+        src, size = _raw_buffer(raw, offset)
+        _check(
+            lib.pixmaptools_pipeline_push(
+                self._pipeline, src, size, width, height, int(image_type), frame_number
+            )
+        )
+
+    def push_devencoded(self, raw) -> bool:
+        """Push a Lima video_last_image (bytes or ("VIDEO_IMAGE", bytes))
+
+        Returns:
+            False if the camera has no image yet
+        """
+        if isinstance(raw, tuple):
+            raw = raw[1]
+        src, size = _raw_buffer(raw, 0)
+        return bool(
+            _check(lib.pixmaptools_pipeline_push_devencoded(self._pipeline, src, size))
+        )
+
+    def fetch(self):
+        """Latest finished image, None if none since the last call
+
+        Returns:
+            (image, frame_number, latency): image is a read-only (h, w)
+            uint32 BGRA array, latency in seconds from push to now
+        """
+        image = lib.pixmaptools_pipeline_fetch(self._pipeline)
+        if image == ffi.NULL:
+            return None
+        image = ffi.gc(image, lib.pixmaptools_image_release)
+        info = ffi.new("pixmaptools_frame_info *")
+        _check(lib.pixmaptools_image_info(image, info))
+        # the array -> buffer -> data chain holds the image reference
+        data = ffi.gc(
+            lib.pixmaptools_image_data(image), lambda _, image=image: None
+        )
+        array = numpy.frombuffer(
+            ffi.buffer(data, info.row * info.column * 4), dtype=numpy.uint32
+        ).reshape(info.row, info.column)
+        array.flags.writeable = False
+        latency = (lib.pixmaptools_timing_now() - info.timestamp) * 1e-9
+        return array, info.frame_number, latency
+
+    @property
+    def fps(self) -> float:
+        return lib.pixmaptools_pipeline_fps(self._pipeline)
+
+    @property
+    def counters(self):
+        """{pushed, dropped, decoded, skipped, errors}"""
+        counters = ffi.new("pixmaptools_display_counters *")
+        _check(lib.pixmaptools_pipeline_counters(self._pipeline, counters))
+        return {
+            key: getattr(counters, key)
+            for key in ("pushed", "dropped", "decoded", "skipped", "errors")
+        }
+
+    @property
+    def latencies(self):
+        """{stage: {last, mean, max}} in seconds"""
+        latency = ffi.new("pixmaptools_latency *")
+        result = {}
+        for index, stage in enumerate(self.STAGES):
+            _check(lib.pixmaptools_pipeline_latency(self._pipeline, index, latency))
+            result[stage] = {
+                key: getattr(latency, key) * 1e-9 for key in ("last", "mean", "max")
+            }
+        return result
+
+
+_EDF_DTYPES = {value: key for key, value in _DTYPES.items()}
+
+
+class EdfReader:
+    """Memory mapped EDF file, frames are indexed once at open.
+
+    :meth:`data` returns read-only numpy views on the mapping (no copy),
+    except for LZ4 frames which are decompressed. Prefer :func:`open_edf`
+    which keeps the readers of the files recently used.
+    """
+
+    def __init__(self, filename):
+        edf = lib.pixmaptools_edf_open(os.fsencode(filename))
+        if edf == ffi.NULL:
+            _check(-1)
+        self.filename = filename
+        self._edf = ffi.gc(edf, lib.pixmaptools_edf_close)
+        mtime = ffi.new("long long *")
+        size = ffi.new("size_t *")
+        _check(lib.pixmaptools_edf_stat(self._edf, mtime, size))
+        self.mtime_ns, self.size = mtime[0], size[0]
+
+    def __len__(self):
+        return _check(lib.pixmaptools_edf_nb_frames(self._edf))
+
+    def _frame(self, index):
+        if index < 0:
+            index += len(self)
+        frame = ffi.new("pixmaptools_edf_frame *")
+        _check(lib.pixmaptools_edf_frame_info(self._edf, index, frame))
+        return index, frame
+
+    def header(self, index=0) -> dict:
+        """Header keys of a frame, values as strings"""
+        index, _ = self._frame(index)
+        size = ffi.new("size_t *")
+        text = lib.pixmaptools_edf_header(self._edf, index, size)
+        if text == ffi.NULL:
+            _check(-1)
+        header = {}
+        for entry in ffi.unpack(text, size[0]).decode("latin-1").strip("{}").split(";"):
+            key, sep, value = entry.partition("=")
+            if sep:
+                header[key.strip()] = value.strip()
+        return header
+
+    def data(self, index=0):
+        """Frame as a (Dim_2, Dim_1) (or 1D/3D) numpy array"""
+        index, frame = self._frame(index)
+        dtype = _EDF_DTYPES[frame.dtype].newbyteorder(">" if frame.big_endian else "<")
+        shape = tuple(frame.dims[i] for i in reversed(range(frame.nb_dims)))
+        if frame.compressed:
+            array = numpy.empty(shape, dtype=dtype)
+            _check(
+                lib.pixmaptools_edf_decompress(
+                    self._edf,
+                    index,
+                    ffi.from_buffer(array, require_writable=True),
+                    array.nbytes,
+                )
+            )
+            return array
+        data = lib.pixmaptools_edf_data(self._edf, index)
+        if data == ffi.NULL:
+            _check(-1)
+        # the array -> buffer -> data chain holds the mapping
+        data = ffi.gc(ffi.cast("char *", data), lambda _, edf=self._edf: None)
+        array = numpy.frombuffer(
+            ffi.buffer(data, frame.image_size), dtype=dtype
+        ).reshape(shape)
+        array.flags.writeable = False
+        return array
+
+    def changed(self) -> bool:
+        """True if the file was modified since it was opened"""
+        try:
+            stat = os.stat(self.filename)
+        except OSError:
+            return True
+        return stat.st_mtime_ns != self.mtime_ns or stat.st_size != self.size
+
+
+_edf_readers = collections.OrderedDict()
+_edf_readers_lock = threading.Lock()
+EDF_CACHE_SIZE = 8
+
+
+def open_edf(filename) -> EdfReader:
+    """Reader of an EDF file, reused until the file changes (mtime, size)"""
+    key = os.path.abspath(filename)
+    with _edf_readers_lock:
+        reader = _edf_readers.pop(key, None)
+    if reader is None or reader.changed():
+        reader = EdfReader(filename)
+    with _edf_readers_lock:
+        _edf_readers[key] = reader
+        while len(_edf_readers) > EDF_CACHE_SIZE:
+            _edf_readers.popitem(last=False)
+    return reader
+
+
+class FramePrefetcher:
+    """Read-ahead of EDF frames by a pool of native threads.
+
+    :meth:`prefetch` the next frames, then :meth:`get` them one by one:
+    they are read (paged in, LZ4 decompressed, byte swapped) while the
+    current one is processed. Frames are cached within ``memory_budget``
+    bytes; frames prefetched but not taken yet are never evicted, so
+    :meth:`cancel` the ones no longer wanted.
+    """
+
+    COUNTERS = ("hits", "misses", "prefetched", "evicted", "refused", "errors")
+
+    def __init__(self, nb_threads=2, memory_budget=256 << 20):
+        prefetcher = lib.pixmaptools_prefetcher_new(nb_threads, memory_budget)
+        if prefetcher == ffi.NULL:
+            _check(-1)
+        self._prefetcher = ffi.gc(prefetcher, lib.pixmaptools_prefetcher_free)
+
+    def prefetch(self, filename, index) -> bool:
+        """Queue a frame, False if already cached or over the memory budget"""
+        return bool(
+            _check(
+                lib.pixmaptools_prefetcher_prefetch(
+                    self._prefetcher, os.fsencode(filename), index
+                )
+            )
+        )
+
+    def get(self, filename, index):
+        """Frame as a read-only numpy array in the host byte order (no copy),
+        read now if it was not prefetched"""
+        frame = lib.pixmaptools_prefetcher_get(
+            self._prefetcher, os.fsencode(filename), index
+        )
+        if frame == ffi.NULL:
+            _check(-1)
+        frame = ffi.gc(frame, lib.pixmaptools_prefetched_release)
+        info = ffi.new("pixmaptools_edf_frame *")
+        _check(lib.pixmaptools_prefetched_info(frame, info))
+        shape = tuple(info.dims[i] for i in reversed(range(info.nb_dims)))
+        # the array -> buffer -> data chain holds the frame reference
+        data = ffi.gc(
+            ffi.cast("char *", lib.pixmaptools_prefetched_data(frame)),
+            lambda _, frame=frame: None,
+        )
+        array = numpy.frombuffer(
+            ffi.buffer(data, info.image_size), dtype=_EDF_DTYPES[info.dtype]
+        ).reshape(shape)
+        array.flags.writeable = False
+        return array
+
+    def cancel(self, filename, index) -> bool:
+        """Drop a prefetched frame not taken yet"""
+        return bool(
+            _check(
+                lib.pixmaptools_prefetcher_cancel(
+                    self._prefetcher, os.fsencode(filename), index
+                )
+            )
+        )
+
+    def clear(self):
+        """Drop the cache, the queued frames and the open files"""
+        _check(lib.pixmaptools_prefetcher_clear(self._prefetcher))
+
+    @property
+    def counters(self):
+        """{hits, misses, prefetched, evicted, refused, errors,
+        memory_used, memory_budget}"""
+        counters = ffi.new("pixmaptools_prefetch_counters *")
+        _check(lib.pixmaptools_prefetcher_counters(self._prefetcher, counters))
+        return {
+            key: getattr(counters, key)
+            for key in self.COUNTERS + ("memory_used", "memory_budget")
+        }
+
+
+def bgra_to_rgb(image):
+    """(h, w) uint32 BGRA -> (h, w, 3) uint8 RGB"""
+    bgra = image.view(numpy.uint8).reshape(image.shape + (4,))
+    if numpy.little_endian:
+        return numpy.ascontiguousarray(bgra[..., 2::-1])
+    return numpy.ascontiguousarray(bgra[..., 1:])
+
+
+def has_jpeg() -> bool:
+    """True if the core library was built with libjpeg"""
+    return bool(lib.pixmaptools_has_jpeg())
+
+
+def _bgra_image(image):
+    image = numpy.ascontiguousarray(image, dtype=numpy.uint32)
+    if image.ndim != 2:
+        raise ValueError("image must be a 2D uint32 BGRA array")
+    return ffi.from_buffer("unsigned int[]", image), image.shape
+
+
+def _encoded_bytes(buffer):
+    if buffer == ffi.NULL:
+        _check(-1)
+    buffer = ffi.gc(buffer, lib.pixmaptools_buffer_free)
+    size = lib.pixmaptools_buffer_size(buffer)
+    return ffi.buffer(lib.pixmaptools_buffer_data(buffer), size)[:]
+
+
+def encode_png(image, level=1, alpha=False) -> bytes:
+    """PNG of a (h, w) uint32 BGRA image (output of :func:`map`)
+
+    Arguments:
+        level: zlib level, 0 to 9, low levels are much faster
+        alpha: RGBA instead of RGB
+    """
+    src, (row, column) = _bgra_image(image)
+    return _encoded_bytes(
+        lib.pixmaptools_encode_png(src, column, row, level, 1 if alpha else 0)
+    )
+
+
+def encode_jpeg(image, quality=85) -> bytes:
+    """JPEG of a (h, w) uint32 BGRA image, see :func:`has_jpeg`"""
+    src, (row, column) = _bgra_image(image)
+    return _encoded_bytes(lib.pixmaptools_encode_jpeg(src, column, row, quality))
+
+
+def thumbnail(
+    data,
+    format="png",
+    palette=PaletteType.GREYSCALE,
+    method=MappingMethod.LINEAR,
+    vmin=None,
+    vmax=None,
+    **options,
+) -> bytes:
+    """Colormap a 2D array and encode it, the GIL is released meanwhile
+
+    Arguments:
+        format: "png" or "jpeg"
+        options: level and alpha for png, quality for jpeg
+    """
+    image, _, _ = map(data, palette, method, vmin, vmax)
+    if format.lower() == "png":
+        return encode_png(image, **options)
+    if format.lower() in ("jpeg", "jpg"):
+        return encode_jpeg(image, **options)
+    raise ValueError(f"unknown image format {format}")
+
+
+def histo(data, bins=10, lower=0, upper=0, log=False):
+    """Histogram with linear (or log) bins, lower == upper == 0 for data range
+
+    The log bins need 0 < lower <= upper, or positive data for the data
+    range, NativeError is raised otherwise.
+
+    Returns:
+        (counts, edges)
+    """
+    data, dtype = _as_native(data)
+    counts = numpy.zeros(bins, dtype=numpy.intc)
+    edges = numpy.zeros(bins + 1, dtype=numpy.float64)
+    func = lib.pixmaptools_histo_log if log else lib.pixmaptools_histo
+    _check(
+        func(
+            ffi.from_buffer(data),
+            dtype,
+            data.size,
+            bins,
+            lower,
+            upper,
+            ffi.from_buffer("int[]", counts, require_writable=True),
+            ffi.from_buffer("double[]", edges, require_writable=True),
+        )
+    )
+    return counts, edges
+
+
+def histo_edges(data, edges):
+    """Histogram on monotonic edges, the last bin includes its upper edge"""
+    data, dtype = _as_native(data)
+    edges = numpy.ascontiguousarray(edges, dtype=numpy.float64)
+    counts = numpy.zeros(len(edges) - 1, dtype=numpy.intc)
+    _check(
+        lib.pixmaptools_histo_edges(
+            ffi.from_buffer(data),
+            dtype,
+            data.size,
+            ffi.from_buffer("double[]", edges),
+            len(edges),
+            ffi.from_buffer("int[]", counts, require_writable=True),
+        )
+    )
+    return counts
+
+
+class RadialUnit(enum.IntEnum):
+    R_MM = 0
+    TWO_THETA_DEG = 1
+    Q_NM = 2
+
+
+class AzimuthalIntegrator:
+    """Azimuthal/radial integration of 2D frames.
+
+    :meth:`set_geometry` (and :meth:`set_mask`) then :meth:`setup` build a
+    lookup table once, :meth:`integrate` is then a sparse product per frame:
+    a radial profile with one azimuthal bin, a (chi, radial) cake otherwise.
+    Chi bins go from -180 to 180 degrees.
+    """
+
+    def __init__(self):
+        azim = lib.pixmaptools_azim_new()
+        if azim == ffi.NULL:
+            _check(-1)
+        self._azim = ffi.gc(azim, lib.pixmaptools_azim_free)
+
+    def set_geometry(
+        self,
+        width,
+        height,
+        center_x,
+        center_y,
+        pixel_size_x,
+        pixel_size_y,
+        distance,
+        wavelength=0.0,
+    ):
+        """Beam center in pixel, pixel sizes, distance and wavelength in meter"""
+        _check(
+            lib.pixmaptools_azim_set_geometry(
+                self._azim,
+                width,
+                height,
+                center_x,
+                center_y,
+                pixel_size_x,
+                pixel_size_y,
+                distance,
+                wavelength,
+            )
+        )
+
+    def set_mask(self, mask):
+        """Pixels of the (height, width) mask which are not 0 are ignored,
+        None removes the mask"""
+        if mask is None:
+            _check(lib.pixmaptools_azim_set_mask(self._azim, ffi.NULL, 0, 0))
+            return
+        mask = numpy.ascontiguousarray(mask, dtype=numpy.uint8)
+        if mask.ndim != 2:
+            raise NativeError("mask must be a 2D array")
+        _check(
+            lib.pixmaptools_azim_set_mask(
+                self._azim, ffi.from_buffer(mask), mask.shape[1], mask.shape[0]
+            )
+        )
+
+    def setup(
+        self,
+        nb_radial_bins,
+        nb_azimuthal_bins=1,
+        unit=RadialUnit.TWO_THETA_DEG,
+        radial_range=None,
+    ):
+        """Compute the lookup table, radial_range (min, max) defaults to the
+        range of the frame"""
+        radial_min, radial_max = radial_range or (0.0, 0.0)
+        _check(
+            lib.pixmaptools_azim_setup(
+                self._azim,
+                nb_radial_bins,
+                nb_azimuthal_bins,
+                int(unit),
+                radial_min,
+                radial_max,
+            )
+        )
+
+    @property
+    def nb_bins(self):
+        """(nb_radial_bins, nb_azimuthal_bins), 0 before setup"""
+        nb_radial = ffi.new("int *")
+        nb_azimuthal = ffi.new("int *")
+        _check(lib.pixmaptools_azim_nb_bins(self._azim, nb_radial, nb_azimuthal))
+        return nb_radial[0], nb_azimuthal[0]
+
+    def positions(self):
+        """(radial, azimuthal) bin centers, azimuthal in degree"""
+        nb_radial, nb_azimuthal = self.nb_bins
+        radial = numpy.empty(nb_radial, dtype=numpy.float64)
+        azimuthal = numpy.empty(nb_azimuthal, dtype=numpy.float64)
+        _check(
+            lib.pixmaptools_azim_positions(
+                self._azim,
+                ffi.from_buffer("double[]", radial, require_writable=True),
+                nb_radial,
+                ffi.from_buffer("double[]", azimuthal, require_writable=True),
+                nb_azimuthal,
+            )
+        )
+        return radial, azimuthal
+
+    def integrate(self, data):
+        """Mean intensity of each bin, 0 in empty bins: (nb_radial_bins,)
+        or (nb_azimuthal_bins, nb_radial_bins) with several azimuthal bins"""
+        data, dtype = _as_native(data)
+        if data.ndim != 2:
+            raise NativeError("data must be a 2D array")
+        nb_radial, nb_azimuthal = self.nb_bins
+        result = numpy.empty(max(nb_radial * nb_azimuthal, 1), dtype=numpy.float64)
+        nb_radial = ffi.new("int *")
+        nb_azimuthal = ffi.new("int *")
+        _check(
+            lib.pixmaptools_azim_integrate(
+                self._azim,
+                ffi.from_buffer(data),
+                dtype,
+                data.shape[1],
+                data.shape[0],
+                ffi.from_buffer("double[]", result, require_writable=True),
+                result.size,
+                nb_radial,
+                nb_azimuthal,
+            )
+        )
+        result = result[: nb_radial[0] * nb_azimuthal[0]]
+        if nb_azimuthal[0] > 1:
+            return result.reshape(nb_azimuthal[0], nb_radial[0])
+        return result
+
+
+class AccumulatorMode(enum.IntEnum):
+    CUMULATIVE = 0
+    EXPONENTIAL = 1
+
+
+class Statistic(enum.IntEnum):
+    MEAN = 0
+    VARIANCE = 1
+    MIN = 2
+    MAX = 3
+
+
+class PixelAccumulator:
+    """Per pixel statistics over a stream of frames.
+
+    Each added frame updates the mean and the population variance in place,
+    all frames with the same weight (Welford) or with a weight alpha for the
+    new frame (exponential mode). Min and max are held. The statistics are
+    float32 or float64 (dtype) arrays of the frame shape.
+    """
+
+    def __init__(self, dtype=numpy.float64, mode=AccumulatorMode.CUMULATIVE, alpha=0.1):
+        self._dtype = numpy.dtype(dtype)
+        if self._dtype == numpy.float32:
+            precision = 0
+        elif self._dtype == numpy.float64:
+            precision = 1
+        else:
+            raise NativeError(f"accumulator type {self._dtype} not supported")
+        accumulator = lib.pixmaptools_accumulator_new(precision, int(mode), alpha)
+        if accumulator == ffi.NULL:
+            _check(-1)
+        self._accumulator = ffi.gc(accumulator, lib.pixmaptools_accumulator_free)
+
+    @property
+    def dtype(self):
+        return self._dtype
+
+    @property
+    def count(self):
+        """Number of accumulated frames"""
+        return _check(lib.pixmaptools_accumulator_count(self._accumulator))
+
+    def reset(self):
+        """Clear the statistics, the next frame sets the frame shape"""
+        _check(lib.pixmaptools_accumulator_reset(self._accumulator))
+
+    def add(self, frame):
+        """Add a 2D frame, of the shape of the accumulated frames"""
+        frame, dtype = _as_native(frame)
+        if frame.ndim != 2:
+            raise NativeError("frame must be a 2D array")
+        _check(
+            lib.pixmaptools_accumulator_add(
+                self._accumulator,
+                ffi.from_buffer(frame),
+                dtype,
+                frame.shape[1],
+                frame.shape[0],
+            )
+        )
+
+    def snapshot(self, statistic=Statistic.MEAN):
+        """Copy of a statistic, (height, width) or (0, 0) before any frame"""
+        column = ffi.new("int *")
+        row = ffi.new("int *")
+        _check(lib.pixmaptools_accumulator_size(self._accumulator, column, row))
+        result = numpy.zeros((row[0], column[0]), dtype=self._dtype)
+        _check(
+            lib.pixmaptools_accumulator_snapshot(
+                self._accumulator,
+                int(statistic),
+                ffi.from_buffer(result, require_writable=True),
+                column[0],
+                row[0],
+            )
+        )
+        return result
+
+
+def timing_stats(reset=False):
+    """{stage name: {count, total, last, max, p50, p99}}, durations in seconds"""
+    stat = ffi.new("pixmaptools_timing_stat *")
+    stats = {}
+    for stage in range(lib.pixmaptools_timing_nb_stages()):
+        _check(lib.pixmaptools_timing_get(stage, stat))
+        name = ffi.string(lib.pixmaptools_timing_name(stage)).decode()
+        stats[name] = {"count": stat.count}
+        for key in ("total", "last", "max", "p50", "p99"):
+            stats[name][key] = getattr(stat, key) * 1e-9
+    if reset:
+        lib.pixmaptools_timing_reset()
+    return stats
+
+
+def timing_enabled() -> bool:
+    return bool(lib.pixmaptools_timing_enabled())
+
+
+def set_timing_enabled(flag: bool):
+    lib.pixmaptools_timing_set_enabled(1 if flag else 0)
+
+
+def cpu_level() -> str:
+    """Instruction set of the kernels in use (generic, sse2, avx2 or avx512)"""
+    return ffi.string(lib.pixmaptools_cpu_level_name(lib.pixmaptools_cpu_level())).decode()
+
+
+def set_cpu_level(level: str) -> str:
+    """Force the kernels instruction set, clipped to what the cpu supports
+
+    Returns:
+        the level in use
+    """
+    names = ("generic", "sse2", "avx2", "avx512")
+    try:
+        index = names.index(level.lower())
+    except ValueError:
+        raise ValueError(f"unknown cpu level {level}, one of {names}")
+    return ffi.string(
+        lib.pixmaptools_cpu_level_name(lib.pixmaptools_set_cpu_level(index))
+    ).decode()
@@ -0,0 +1,208 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_accumulator.h"
+#include "pixmaptools_thread.h"
+#include <cstring>
+
+template<class ACC>
+struct PixelAccumulator::_Stats
+{
+  std::vector<ACC> mean;
+  std::vector<ACC> m2;		// sum of squared differences (or variance in EXPONENTIAL)
+  std::vector<ACC> min;
+  std::vector<ACC> max;
+
+  void clear()
+  {
+    std::vector<ACC>().swap(mean);
+    std::vector<ACC>().swap(m2);
+    std::vector<ACC>().swap(min);
+    std::vector<ACC>().swap(max);
+  }
+};
+
+PixelAccumulator::PixelAccumulator(precision aPrecision,mode aMode,double alpha) throw(LutError) :
+  _precision(aPrecision),_mode(aMode),_alpha(alpha),
+  _column(0),_row(0),_count(0),
+  _stats32(NULL),_stats64(NULL)
+{
+  if(aMode == EXPONENTIAL && (alpha <= 0. || alpha > 1.))
+    throw LutError("PixelAccumulator : alpha must be in ]0,1]");
+  pthread_mutex_init(&_lock,NULL);
+  if(aPrecision == FLOAT32)
+    _stats32 = new _Stats<float>();
+  else
+    _stats64 = new _Stats<double>();
+}
+
+PixelAccumulator::~PixelAccumulator()
+{
+  delete _stats32;
+  delete _stats64;
+  pthread_mutex_destroy(&_lock);
+}
+
+void PixelAccumulator::reset()
+{
+  _Lock aLock(&_lock);
+  _column = _row = _count = 0;
+  if(_stats32) _stats32->clear();
+  if(_stats64) _stats64->clear();
+}
+
+int PixelAccumulator::count() const
+{
+  _Lock aLock(&_lock);
+  return _count;
+}
+
+template<class IN,class ACC>
+struct _AccumulateTask
+{
+  const IN *data;
+  ACC *mean,*m2,*min,*max;
+  bool first;
+  bool exponential;
+  ACC weight;			// 1/n or alpha
+
+  void operator()(int begin,int end,int)
+  {
+    if(first)
+      {
+	for(int i = begin;i < end;++i)
+	  {
+	    ACC val = ACC(data[i]);
+	    mean[i] = min[i] = max[i] = val;
+	    m2[i] = ACC(0);
+	  }
+      }
+    else if(exponential)
+      {
+	ACC alpha = weight;
+	for(int i = begin;i < end;++i)
+	  {
+	    ACC val = ACC(data[i]);
+	    ACC delta = val - mean[i];
+	    mean[i] += alpha * delta;
+	    m2[i] = (ACC(1) - alpha) * (m2[i] + alpha * delta * delta);
+	    if(val < min[i]) min[i] = val;
+	    if(val > max[i]) max[i] = val;
+	  }
+      }
+    else
+      {
+	ACC invCount = weight;
+	for(int i = begin;i < end;++i)
+	  {
+	    ACC val = ACC(data[i]);
+	    ACC delta = val - mean[i];
+	    mean[i] += delta * invCount;
+	    m2[i] += delta * (val - mean[i]);
+	    if(val < min[i]) min[i] = val;
+	    if(val > max[i]) max[i] = val;
+	  }
+      }
+  }
+};
+
+template<class IN,class ACC>
+void PixelAccumulator::_add(const IN *data,_Stats<ACC> &aStats)
+{
+  int nbPixel = _column * _row;
+  if(int(aStats.mean.size()) != nbPixel)
+    {
+      aStats.mean.resize(nbPixel);
+      aStats.m2.resize(nbPixel);
+      aStats.min.resize(nbPixel);
+      aStats.max.resize(nbPixel);
+    }
+  _AccumulateTask<IN,ACC> aTask;
+  aTask.data = data;
+  aTask.mean = &aStats.mean[0],aTask.m2 = &aStats.m2[0];
+  aTask.min = &aStats.min[0],aTask.max = &aStats.max[0];
+  aTask.first = _count == 0;
+  aTask.exponential = _mode == EXPONENTIAL;
+  aTask.weight = aTask.exponential ? ACC(_alpha) : ACC(1. / (_count + 1));
+  Parallel::run(nbPixel,aTask);
+  ++_count;
+}
+
+template<class IN>
+void PixelAccumulator::add(const IN *data,int column,int row) throw(LutError)
+{
+  if(column <= 0 || row <= 0)
+    throw LutError("add : frame size must be > 0");
+  _Lock aLock(&_lock);
+  if(!_count)
+    _column = column,_row = row;
+  else if(column != _column || row != _row)
+    throw LutError("add : frame size differs from the accumulated frames");
+
+  if(_stats32)
+    _add(data,*_stats32);
+  else
+    _add(data,*_stats64);
+}
+
+template<class ACC>
+void PixelAccumulator::_snapshot(statistic aStat,const _Stats<ACC> &aStats,ACC *dest) const
+{
+  int nbPixel = _column * _row;
+  if(!_count || !nbPixel) return;
+  switch(aStat)
+    {
+    case MEAN:
+      memcpy(dest,&aStats.mean[0],nbPixel * sizeof(ACC));break;
+    case MIN:
+      memcpy(dest,&aStats.min[0],nbPixel * sizeof(ACC));break;
+    case MAX:
+      memcpy(dest,&aStats.max[0],nbPixel * sizeof(ACC));break;
+    case VARIANCE:
+      if(_mode == EXPONENTIAL)
+	memcpy(dest,&aStats.m2[0],nbPixel * sizeof(ACC));
+      else
+	{
+	  ACC invCount = ACC(1. / _count);
+	  const ACC *m2 = &aStats.m2[0];
+	  for(int i = 0;i < nbPixel;++i)
+	    dest[i] = m2[i] * invCount;
+	}
+      break;
+    }
+}
+
+bool PixelAccumulator::snapshot(statistic aStat,void *dest,int column,int row) const
+{
+  _Lock aLock(&_lock);
+  if(column != _column || row != _row)
+    return false;
+  if(_stats32)
+    _snapshot(aStat,*_stats32,(float*)dest);
+  else
+    _snapshot(aStat,*_stats64,(double*)dest);
+  return true;
+}
+
+#define INIT_TEMPLATE(TYPE) \
+  template void PixelAccumulator::add(const TYPE*,int,int);
+
+INIT_TEMPLATE(char)
+INIT_TEMPLATE(unsigned char)
+
+INIT_TEMPLATE(short)
+INIT_TEMPLATE(unsigned short)
+
+INIT_TEMPLATE(int)
+INIT_TEMPLATE(unsigned int)
+
+INIT_TEMPLATE(long)
+INIT_TEMPLATE(unsigned long)
+
+INIT_TEMPLATE(float)
+INIT_TEMPLATE(double)
@@ -0,0 +1,70 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_ACCUMULATOR
+#define __PIXMAPTOOLS_ACCUMULATOR
+
+#include <pthread.h>
+#include <vector>
+#include "pixmaptools_lut.h"
+
+/** @brief per pixel statistics over a stream of frames
+ *
+ *  Frames are added one by one, mean and variance are updated in place
+ *  (Welford or exponentially weighted), min and max are held.
+ *  Statistics can be read at any time, they are copied under lock.
+ */
+class PixelAccumulator
+{
+public:
+  enum precision {FLOAT32,FLOAT64};
+  /// CUMULATIVE: all frames have the same weight, EXPONENTIAL: new frame weight is alpha
+  enum mode {CUMULATIVE,EXPONENTIAL};
+  enum statistic {MEAN,VARIANCE,MIN,MAX};
+
+  explicit PixelAccumulator(precision = FLOAT64,mode = CUMULATIVE,double alpha = 0.1) throw(LutError);
+  ~PixelAccumulator();
+
+  /// @brief clear all statistics, next frame set the frame size
+  void reset();
+
+  int count() const;
+  int column() const {return _column;}
+  int row() const {return _row;}
+  precision get_precision() const {return _precision;}
+
+  /// @brief add a frame, all frames must have the same size
+  template<class IN>
+  void add(const IN *data,int column,int row) throw(LutError);
+
+  /**
+   * @brief copy a statistic
+   * @param dest column * row values of float or double (see precision)
+   * variance is the population variance
+   * @return false if column and row differ from the accumulated frames size
+   */
+  bool snapshot(statistic,void *dest,int column,int row) const;
+
+private:
+  template<class ACC> struct _Stats;
+
+  template<class IN,class ACC>
+  void _add(const IN *data,_Stats<ACC>&);
+  template<class ACC>
+  void _snapshot(statistic,const _Stats<ACC>&,ACC *dest) const;
+
+  precision		_precision;
+  mode			_mode;
+  double		_alpha;
+  int			_column,_row;
+  int			_count;
+  _Stats<float>		*_stats32;
+  _Stats<double>	*_stats64;
+  mutable pthread_mutex_t _lock;
+};
+#endif
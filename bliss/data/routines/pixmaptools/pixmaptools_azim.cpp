@@ -0,0 +1,330 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_azim.h"
+#include "pixmaptools_thread.h"
+#include <cmath>
+#include <algorithm>
+
+struct AzimuthalIntegrator::_Corners
+{
+  double radialMin,radialMax;
+  double chiMin,chiMax;
+};
+
+AzimuthalIntegrator::AzimuthalIntegrator() :
+  _column(0),_row(0),
+  _centerX(0.),_centerY(0.),
+  _pixelSizeX(1.),_pixelSizeY(1.),
+  _distance(1.),_wavelength(0.),
+  _unit(TWO_THETA_DEG),
+  _nbRadialBins(0),_nbAzimuthalBins(0),
+  _radialMin(0.),_radialMax(0.)
+{
+  pthread_mutex_init(&_lock,NULL);
+}
+
+AzimuthalIntegrator::~AzimuthalIntegrator()
+{
+  pthread_mutex_destroy(&_lock);
+}
+
+void AzimuthalIntegrator::set_geometry(int column,int row,
+				       double centerX,double centerY,
+				       double pixelSizeX,double pixelSizeY,
+				       double distance,double wavelength) throw(LutError)
+{
+  if(column <= 0 || row <= 0)
+    throw LutError("set_geometry : frame size must be > 0");
+  if(pixelSizeX <= 0. || pixelSizeY <= 0.)
+    throw LutError("set_geometry : pixel size must be > 0");
+  if(distance <= 0.)
+    throw LutError("set_geometry : distance must be > 0");
+
+  _Lock aLock(&_lock);
+  if(column != _column || row != _row)
+    _mask.clear();
+  _column = column,_row = row;
+  _centerX = centerX,_centerY = centerY;
+  _pixelSizeX = pixelSizeX,_pixelSizeY = pixelSizeY;
+  _distance = distance,_wavelength = wavelength;
+  // lookup table has to be recomputed
+  _nbRadialBins = _nbAzimuthalBins = 0;
+  _indptr.clear(),_indices.clear(),_coefs.clear(),_norm.clear();
+}
+
+void AzimuthalIntegrator::set_mask(const unsigned char *mask,int column,int row) throw(LutError)
+{
+  _Lock aLock(&_lock);
+  if(!mask)
+    {
+      _mask.clear();
+      return;
+    }
+  if(column != _column || row != _row)
+    throw LutError("set_mask : mask size differs from the geometry");
+  _mask.assign(mask,mask + column * row);
+}
+
+double AzimuthalIntegrator::_radial(double x,double y) const
+{
+  double r = sqrt(x * x + y * y);
+  switch(_unit)
+    {
+    case R_MM:
+      return r * 1e3;
+    case Q_NM:
+      return 4 * M_PI / (_wavelength * 1e9) * sin(atan2(r,_distance) / 2.);
+    case TWO_THETA_DEG:
+    default:
+      return atan2(r,_distance) * 180. / M_PI;
+    }
+}
+
+void AzimuthalIntegrator::_pixel_extent(int column,int row,_Corners &aCorners) const
+{
+  double x0 = (column - 0.5 - _centerX) * _pixelSizeX;
+  double x1 = (column + 0.5 - _centerX) * _pixelSizeX;
+  double y0 = (row - 0.5 - _centerY) * _pixelSizeY;
+  double y1 = (row + 0.5 - _centerY) * _pixelSizeY;
+  double xs[4] = {x0,x1,x0,x1};
+  double ys[4] = {y0,y0,y1,y1};
+
+  aCorners.radialMin = aCorners.radialMax = _radial(xs[0],ys[0]);
+  aCorners.chiMin = aCorners.chiMax = atan2(ys[0],xs[0]) * 180. / M_PI;
+  for(int i = 1;i < 4;++i)
+    {
+      double radial = _radial(xs[i],ys[i]);
+      if(radial < aCorners.radialMin) aCorners.radialMin = radial;
+      else if(radial > aCorners.radialMax) aCorners.radialMax = radial;
+
+      double chi = atan2(ys[i],xs[i]) * 180. / M_PI;
+      if(chi < aCorners.chiMin) aCorners.chiMin = chi;
+      else if(chi > aCorners.chiMax) aCorners.chiMax = chi;
+    }
+  bool centerInside = x0 <= 0. && x1 >= 0. && y0 <= 0. && y1 >= 0.;
+  if(centerInside)
+    aCorners.radialMin = _radial(0.,0.);
+  // pixel across the chi discontinuity (or on the center) is not split in chi
+  if(centerInside || aCorners.chiMax - aCorners.chiMin > 180.)
+    aCorners.chiMin = aCorners.chiMax =
+      atan2((row - _centerY) * _pixelSizeY,(column - _centerX) * _pixelSizeX) * 180. / M_PI;
+}
+
+/** @brief first and last bin touched by [low,high]
+ */
+static inline void _bin_range(double low,double high,
+			      double origin,double step,int nbBins,
+			      int &first,int &last)
+{
+  first = int(floor((low - origin) / step));
+  last = int(floor((high - origin) / step));
+  if(first < 0) first = 0;
+  if(last >= nbBins) last = nbBins - 1;
+}
+
+/** @brief fraction of [low,high] which fall in the bin
+ */
+static inline double _overlap(double low,double high,
+			      double origin,double step,int bin)
+{
+  if(high - low <= 0.)
+    return 1.;
+  double binLow = origin + bin * step;
+  double binHigh = binLow + step;
+  if(binLow < low) binLow = low;
+  if(binHigh > high) binHigh = high;
+  double overlap = binHigh - binLow;
+  return overlap > 0. ? overlap / (high - low) : 0.;
+}
+
+void AzimuthalIntegrator::setup(int nbRadialBins,int nbAzimuthalBins,
+				radial_unit unit,
+				double radialMin,double radialMax) throw(LutError)
+{
+  if(nbRadialBins <= 0)
+    throw LutError("setup : number of radial bins must be > 0");
+  if(nbAzimuthalBins <= 0)
+    throw LutError("setup : number of azimuthal bins must be > 0");
+
+  _Lock aLock(&_lock);
+  if(_column <= 0 || _row <= 0)
+    throw LutError("setup : geometry not set");
+  if(unit == Q_NM && _wavelength <= 0.)
+    throw LutError("setup : wavelength must be set to integrate in q");
+  _unit = unit;
+
+  const unsigned char *mask = _mask.empty() ? NULL : &_mask[0];
+  _Corners aCorners;
+  if(radialMin == radialMax)
+    {
+      bool first = true;
+      for(int r = 0;r < _row;++r)
+	for(int c = 0;c < _column;++c)
+	  {
+	    if(mask && mask[r * _column + c]) continue;
+	    _pixel_extent(c,r,aCorners);
+	    if(first || aCorners.radialMin < radialMin) radialMin = aCorners.radialMin;
+	    if(first || aCorners.radialMax > radialMax) radialMax = aCorners.radialMax;
+	    first = false;
+	  }
+      if(first)
+	throw LutError("setup : all pixels are masked");
+    }
+  if(radialMax < radialMin)
+    std::swap(radialMin,radialMax);
+  if(radialMax == radialMin)
+    throw LutError("setup : radial range is empty");
+
+  double radialStep = (radialMax - radialMin) / nbRadialBins;
+  double chiStep = 360. / nbAzimuthalBins;
+  int nbBins = nbRadialBins * nbAzimuthalBins;
+
+  // first pass count the entries of each bins
+  std::vector<int> indptr(nbBins + 1,0);
+  for(int r = 0;r < _row;++r)
+    for(int c = 0;c < _column;++c)
+      {
+	if(mask && mask[r * _column + c]) continue;
+	_pixel_extent(c,r,aCorners);
+	if(aCorners.radialMax < radialMin || aCorners.radialMin > radialMax) continue;
+	int r0,r1,c0 = 0,c1 = 0;
+	_bin_range(aCorners.radialMin,aCorners.radialMax,radialMin,radialStep,nbRadialBins,r0,r1);
+	if(nbAzimuthalBins > 1)
+	  _bin_range(aCorners.chiMin,aCorners.chiMax,-180.,chiStep,nbAzimuthalBins,c0,c1);
+	for(int chiBin = c0;chiBin <= c1;++chiBin)
+	  for(int radialBin = r0;radialBin <= r1;++radialBin)
+	    ++indptr[chiBin * nbRadialBins + radialBin + 1];
+      }
+  for(int i = 0;i < nbBins;++i)
+    indptr[i + 1] += indptr[i];
+
+  // second pass fill the table
+  std::vector<int> indices(indptr[nbBins]);
+  std::vector<float> coefs(indptr[nbBins]);
+  std::vector<int> cursor(indptr.begin(),indptr.end() - 1);
+  for(int r = 0;r < _row;++r)
+    for(int c = 0;c < _column;++c)
+      {
+	int pixel = r * _column + c;
+	if(mask && mask[pixel]) continue;
+	_pixel_extent(c,r,aCorners);
+	if(aCorners.radialMax < radialMin || aCorners.radialMin > radialMax) continue;
+	int r0,r1,c0 = 0,c1 = 0;
+	_bin_range(aCorners.radialMin,aCorners.radialMax,radialMin,radialStep,nbRadialBins,r0,r1);
+	if(nbAzimuthalBins > 1)
+	  _bin_range(aCorners.chiMin,aCorners.chiMax,-180.,chiStep,nbAzimuthalBins,c0,c1);
+	for(int chiBin = c0;chiBin <= c1;++chiBin)
+	  {
+	    double chiFraction = 1.;
+	    if(nbAzimuthalBins > 1)
+	      chiFraction = _overlap(aCorners.chiMin,aCorners.chiMax,-180.,chiStep,chiBin);
+	    for(int radialBin = r0;radialBin <= r1;++radialBin)
+	      {
+		double fraction = chiFraction *
+		  _overlap(aCorners.radialMin,aCorners.radialMax,radialMin,radialStep,radialBin);
+		int &pos = cursor[chiBin * nbRadialBins + radialBin];
+		indices[pos] = pixel;
+		coefs[pos] = float(fraction);
+		++pos;
+	      }
+	  }
+      }
+
+  std::vector<double> norm(nbBins,0.);
+  for(int bin = 0;bin < nbBins;++bin)
+    for(int k = indptr[bin];k < indptr[bin + 1];++k)
+      norm[bin] += coefs[k];
+
+  _indptr.swap(indptr),_indices.swap(indices),_coefs.swap(coefs),_norm.swap(norm);
+  _nbRadialBins = nbRadialBins,_nbAzimuthalBins = nbAzimuthalBins;
+  _radialMin = radialMin,_radialMax = radialMax;
+}
+
+void AzimuthalIntegrator::radial_positions(std::vector<double> &positions) const
+{
+  _Lock aLock(&_lock);
+  positions.resize(_nbRadialBins);
+  if(!_nbRadialBins) return;
+  double step = (_radialMax - _radialMin) / _nbRadialBins;
+  for(int i = 0;i < _nbRadialBins;++i)
+    positions[i] = _radialMin + (i + 0.5) * step;
+}
+
+void AzimuthalIntegrator::azimuthal_positions(std::vector<double> &positions) const
+{
+  _Lock aLock(&_lock);
+  positions.resize(_nbAzimuthalBins);
+  if(!_nbAzimuthalBins) return;
+  double step = 360. / _nbAzimuthalBins;
+  for(int i = 0;i < _nbAzimuthalBins;++i)
+    positions[i] = -180. + (i + 0.5) * step;
+}
+
+template<class IN>
+struct _IntegrateTask
+{
+  const IN	*data;
+  const int	*indptr;
+  const int	*indices;
+  const float	*coefs;
+  const double	*norm;
+  double	*result;
+
+  void operator()(int begin,int end,int)
+  {
+    for(int bin = begin;bin < end;++bin)
+      {
+	double sum = 0.;
+	for(int k = indptr[bin];k < indptr[bin + 1];++k)
+	  sum += coefs[k] * double(data[indices[k]]);
+	result[bin] = norm[bin] > 0. ? sum / norm[bin] : 0.;
+      }
+  }
+};
+
+template<class IN>
+void AzimuthalIntegrator::integrate(const IN *data,int column,int row,
+				    std::vector<double> &result,
+				    int &nbAzimuthalBins) throw(LutError)
+{
+  _Lock aLock(&_lock);
+  if(!_nbRadialBins)
+    throw LutError("integrate : setup has to be called first");
+  if(column != _column || row != _row)
+    throw LutError("integrate : frame size differs from the geometry");
+
+  _IntegrateTask<IN> aTask;
+  aTask.data = data;
+  aTask.indptr = &_indptr[0];
+  aTask.indices = _indices.empty() ? NULL : &_indices[0];
+  aTask.coefs = _coefs.empty() ? NULL : &_coefs[0];
+  aTask.norm = &_norm[0];
+  result.resize(_nbRadialBins * _nbAzimuthalBins);
+  nbAzimuthalBins = _nbAzimuthalBins;
+  aTask.result = &result[0];
+  Parallel::run(_nbRadialBins * _nbAzimuthalBins,aTask,16);
+}
+
+#define INIT_TEMPLATE(TYPE) \
+  template void AzimuthalIntegrator::integrate(const TYPE*,int,int,std::vector<double>&,int&);
+
+INIT_TEMPLATE(char)
+INIT_TEMPLATE(unsigned char)
+
+INIT_TEMPLATE(short)
+INIT_TEMPLATE(unsigned short)
+
+INIT_TEMPLATE(int)
+INIT_TEMPLATE(unsigned int)
+
+INIT_TEMPLATE(long)
+INIT_TEMPLATE(unsigned long)
+
+INIT_TEMPLATE(float)
+INIT_TEMPLATE(double)
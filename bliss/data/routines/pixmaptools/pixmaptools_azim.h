@@ -0,0 +1,107 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_AZIM
+#define __PIXMAPTOOLS_AZIM
+
+#include <pthread.h>
+#include <vector>
+#include "pixmaptools_lut.h"
+
+/** @brief azimuthal/radial integration of 2D diffraction frames
+ *
+ *  The geometry (beam centre, pixel size, sample-detector distance and mask)
+ *  is turned once into a sparse lookup table (CSR, one row per output bin).
+ *  Pixels are split over the bins they overlap (bounding box splitting).
+ *  Each frame integration is then a sparse matrix-vector product
+ *  done in parallel over the output bins.
+ *
+ *  Pixel (column,row) center is at (column,row), beam center is given
+ *  in pixel coordinates, the detector is orthogonal to the beam.
+ */
+class AzimuthalIntegrator
+{
+public:
+  enum radial_unit {R_MM,TWO_THETA_DEG,Q_NM};
+
+  AzimuthalIntegrator();
+  ~AzimuthalIntegrator();
+
+  /**
+   * @brief set the detector geometry
+   * @param column,row frame size
+   * @param centerX,centerY beam center in pixel
+   * @param pixelSizeX,pixelSizeY pixel size in meter
+   * @param distance sample to detector distance in meter
+   * @param wavelength in meter, only needed for Q_NM
+   */
+  void set_geometry(int column,int row,
+		    double centerX,double centerY,
+		    double pixelSizeX,double pixelSizeY,
+		    double distance,double wavelength = 0.) throw(LutError);
+  /// @brief pixel with a non zero mask value are ignored, NULL remove the mask
+  void set_mask(const unsigned char *mask,int column,int row) throw(LutError);
+
+  /**
+   * @brief compute the lookup table
+   * @param nbRadialBins number of radial bins
+   * @param nbAzimuthalBins number of azimuthal (chi) bins, 1 for a radial profile
+   * @param unit radial unit
+   * @param radialMin,radialMax radial range, if equal the full frame range is used
+   */
+  void setup(int nbRadialBins,int nbAzimuthalBins = 1,
+	     radial_unit unit = TWO_THETA_DEG,
+	     double radialMin = 0.,double radialMax = 0.) throw(LutError);
+
+  int nb_radial_bins() const {return _nbRadialBins;}
+  int nb_azimuthal_bins() const {return _nbAzimuthalBins;}
+  int column() const {return _column;}
+  int row() const {return _row;}
+
+  /// @brief center of each radial bins
+  void radial_positions(std::vector<double>&) const;
+  /// @brief center of each azimuthal bins in degree
+  void azimuthal_positions(std::vector<double>&) const;
+
+  /**
+   * @brief integrate one frame
+   * @param data frame of column * row pixels
+   * @param result resized to nb_azimuthal_bins() * nb_radial_bins() values
+   * while setup can't change them, radial bins are contiguous,
+   * empty bins are set to 0
+   * @param nbAzimuthalBins number of azimuthal bins of result
+   */
+  template<class IN>
+  void integrate(const IN *data,int column,int row,
+		 std::vector<double> &result,int &nbAzimuthalBins) throw(LutError);
+
+private:
+  struct _Corners;
+
+  void _pixel_extent(int column,int row,_Corners&) const;
+  double _radial(double x,double y) const;
+
+  int		     _column,_row;
+  double	     _centerX,_centerY;
+  double	     _pixelSizeX,_pixelSizeY;
+  double	     _distance,_wavelength;
+  std::vector<unsigned char> _mask;
+
+  radial_unit	     _unit;
+  int		     _nbRadialBins,_nbAzimuthalBins;
+  double	     _radialMin,_radialMax;
+
+  // CSR lookup table
+  std::vector<int>   _indptr;
+  std::vector<int>   _indices;
+  std::vector<float> _coefs;
+  std::vector<double> _norm;
+
+  mutable pthread_mutex_t _lock;
+};
+#endif
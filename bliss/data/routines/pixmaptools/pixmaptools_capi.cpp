@@ -0,0 +1,1444 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_capi.h"
+#include "pixmaptools_accumulator.h"
+#include "pixmaptools_azim.h"
+#include "pixmaptools_cpu.h"
+#include "pixmaptools_display.h"
+#include "pixmaptools_edf.h"
+#include "pixmaptools_encode.h"
+#include "pixmaptools_pipeline.h"
+#include "pixmaptools_prefetch.h"
+#include "pixmaptools_lut.h"
+#include "pixmaptools_stat.h"
+#include "pixmaptools_thread.h"
+#include "pixmaptools_timing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <new>
+
+struct pixmaptools_palette
+{
+  explicit pixmaptools_palette(LUT::Palette::palette_type aType,LUT::Palette::mode aMode) :
+    palette(aType,aMode) {}
+  LUT::Palette palette;
+};
+
+struct pixmaptools_scaling
+{
+  LUT::Scaling scaling;
+};
+
+struct pixmaptools_pipeline
+{
+  VideoPipeline pipeline;
+};
+
+// pixmaptools_image is never defined, it is a VideoPipeline::Image
+static inline VideoPipeline::Image* _image(const pixmaptools_image *anImage)
+{
+  return (VideoPipeline::Image*)anImage;
+}
+
+struct pixmaptools_buffer
+{
+  std::vector<unsigned char> data;
+};
+
+struct pixmaptools_edf
+{
+  explicit pixmaptools_edf(const char *aFilename) : reader(aFilename) {}
+  EdfReader reader;
+};
+
+struct pixmaptools_prefetcher
+{
+  pixmaptools_prefetcher(int nbThreads,size_t aMemoryBudget) :
+    prefetcher(nbThreads,aMemoryBudget) {}
+  FramePrefetcher prefetcher;
+};
+
+// pixmaptools_prefetched is never defined, it is a FramePrefetcher::Frame
+static inline FramePrefetcher::Frame* _prefetched(const pixmaptools_prefetched *aFrame)
+{
+  return (FramePrefetcher::Frame*)aFrame;
+}
+
+struct pixmaptools_azim
+{
+  AzimuthalIntegrator integrator;
+};
+
+struct pixmaptools_accumulator
+{
+  pixmaptools_accumulator(PixelAccumulator::precision aPrecision,
+			  PixelAccumulator::mode aMode,double alpha) :
+    accumulator(aPrecision,aMode,alpha) {}
+  PixelAccumulator accumulator;
+};
+
+struct pixmaptools_display_worker
+{
+  explicit pixmaptools_display_worker(LUT::Scaling &aScaling) : worker(aScaling) {}
+  DisplayWorker worker;
+};
+
+static __thread char _last_error[256];
+
+static int _error(const char *aMessage)
+{
+  snprintf(_last_error,sizeof(_last_error),"%s",aMessage);
+  return -1;
+}
+
+// integer range clipping of the double arguments
+template<class IN>
+static inline IN _from_double(double val)
+{
+  if(!std::numeric_limits<IN>::is_integer)
+    return IN(val);
+  if(!(val > double(std::numeric_limits<IN>::min())))
+    return std::numeric_limits<IN>::min();
+  if(val >= double(std::numeric_limits<IN>::max()))
+    return std::numeric_limits<IN>::max();
+  return IN(val);
+}
+
+#define DISPATCH_DTYPE(DTYPE,CALL)					\
+  switch(DTYPE)								\
+    {									\
+    case PIXMAPTOOLS_INT8: CALL(char);break;				\
+    case PIXMAPTOOLS_UINT8: CALL(unsigned char);break;			\
+    case PIXMAPTOOLS_INT16: CALL(short);break;				\
+    case PIXMAPTOOLS_UINT16: CALL(unsigned short);break;		\
+    case PIXMAPTOOLS_INT32: CALL(int);break;				\
+    case PIXMAPTOOLS_UINT32: CALL(unsigned int);break;			\
+    case PIXMAPTOOLS_INT64: CALL(long);break;				\
+    case PIXMAPTOOLS_UINT64: CALL(unsigned long);break;			\
+    case PIXMAPTOOLS_FLOAT32: CALL(float);break;			\
+    case PIXMAPTOOLS_FLOAT64: CALL(double);break;			\
+    default: return _error("data type not supported");			\
+    }
+
+static int _check_frame(const void *data,const void *dest,int column,int row)
+{
+  if(!data || !dest)
+    return _error("NULL buffer");
+  if(column <= 0 || row <= 0 || column > std::numeric_limits<int>::max() / row)
+    return _error("invalid frame size");
+  return 0;
+}
+
+static bool _valid_palette_type(int aType)
+{
+  return aType >= LUT::Palette::GREYSCALE && aType <= LUT::Palette::USER;
+}
+
+static bool _valid_mapping_meth(int aMeth)
+{
+  return aMeth >= LUT::LINEAR && aMeth <= LUT::SHIFT_LOG;
+}
+
+/// @brief bytes of a raw video frame, 0 if the type or size is not supported
+static size_t _raw_video_size(int column,int row,int aType)
+{
+  if(aType < LUT::Scaling::Y8 || aType > LUT::Scaling::YUV422PACKED)
+    return 0;
+  return LUT::raw_video_size(column,row,LUT::Scaling::image_type(aType));
+}
+
+static int _check_raw_video(const unsigned char *data,size_t dataSize,
+			    const void *dest,int column,int row,int aType)
+{
+  if(_check_frame(data,dest,column,row)) return -1;
+  size_t aSize = _raw_video_size(column,row,aType);
+  if(!aSize)
+    return _error("image type or size not supported");
+  if(dataSize < aSize)
+    return _error("raw video buffer too small");
+  return 0;
+}
+
+extern "C" {
+
+int pixmaptools_abi_version(void)
+{
+  return PIXMAPTOOLS_ABI_VERSION;
+}
+
+const char* pixmaptools_last_error(void)
+{
+  return _last_error;
+}
+
+int pixmaptools_nb_threads(void)
+{
+  return Parallel::nb_threads();
+}
+
+void pixmaptools_set_nb_threads(int nbThreads)
+{
+  Parallel::set_nb_threads(nbThreads);
+}
+
+/* Palette */
+
+pixmaptools_palette* pixmaptools_palette_new(int aType,int aMode)
+{
+  if(!_valid_palette_type(aType) || (aMode != LUT::Palette::RGBX && aMode != LUT::Palette::BGRX))
+    {
+      _error("invalid palette type or mode");
+      return NULL;
+    }
+  pixmaptools_palette *aPalette = new(std::nothrow) pixmaptools_palette(LUT::Palette::palette_type(aType),
+									  LUT::Palette::mode(aMode));
+  if(!aPalette)
+    _error("can't allocate palette");
+  return aPalette;
+}
+
+void pixmaptools_palette_free(pixmaptools_palette *aPalette)
+{
+  delete aPalette;
+}
+
+int pixmaptools_palette_fill(pixmaptools_palette *aPalette,int aType)
+{
+  if(!aPalette || !_valid_palette_type(aType))
+    return _error("invalid palette or palette type");
+  aPalette->palette.fillPalette(LUT::Palette::palette_type(aType));
+  return 0;
+}
+
+int pixmaptools_palette_set_data(pixmaptools_palette *aPalette,
+				 const unsigned int *data,int aSize)
+{
+  if(!aPalette || !data)
+    return _error("NULL palette or data");
+  try
+    {
+      aPalette->palette.setPaletteData(data,aSize);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+/* Mapping */
+
+int pixmaptools_map(const void *data,int dtype,unsigned int *anImage,
+		    int column,int row,pixmaptools_palette *aPalette,
+		    int aMeth,double dataMin,double dataMax)
+{
+  if(_check_frame(data,anImage,column,row)) return -1;
+  if(!aPalette || !_valid_mapping_meth(aMeth))
+    return _error("invalid palette or mapping method");
+#define MAP(TYPE)							\
+  LUT::map((const TYPE*)data,anImage,column,row,aPalette->palette,	\
+	   LUT::mapping_meth(aMeth),					\
+	   _from_double<TYPE>(dataMin),_from_double<TYPE>(dataMax))
+  DISPATCH_DTYPE(dtype,MAP)
+#undef MAP
+  return 0;
+}
+
+int pixmaptools_map_on_min_max_val(const void *data,int dtype,unsigned int *anImage,
+				   int column,int row,pixmaptools_palette *aPalette,
+				   int aMeth,double *dataMin,double *dataMax)
+{
+  if(_check_frame(data,anImage,column,row)) return -1;
+  if(!aPalette || !_valid_mapping_meth(aMeth))
+    return _error("invalid palette or mapping method");
+#define MAP(TYPE)							\
+  {									\
+    TYPE aMin,aMax;							\
+    LUT::map_on_min_max_val((const TYPE*)data,anImage,column,row,	\
+			    aPalette->palette,LUT::mapping_meth(aMeth),	\
+			    aMin,aMax);					\
+    if(dataMin) *dataMin = double(aMin);				\
+    if(dataMax) *dataMax = double(aMax);				\
+  }
+  DISPATCH_DTYPE(dtype,MAP)
+#undef MAP
+  return 0;
+}
+
+int pixmaptools_map_on_plus_minus_sigma(const void *data,int dtype,unsigned int *anImage,
+					int column,int row,pixmaptools_palette *aPalette,
+					int aMeth,double aSigmaFactor,
+					double *dataMin,double *dataMax)
+{
+  if(_check_frame(data,anImage,column,row)) return -1;
+  if(!aPalette || !_valid_mapping_meth(aMeth))
+    return _error("invalid palette or mapping method");
+#define MAP(TYPE)							\
+  {									\
+    TYPE aMin,aMax;							\
+    LUT::map_on_plus_minus_sigma((const TYPE*)data,anImage,column,row,	\
+				 aPalette->palette,LUT::mapping_meth(aMeth), \
+				 aSigmaFactor,aMin,aMax);		\
+    if(dataMin) *dataMin = double(aMin);				\
+    if(dataMax) *dataMax = double(aMax);				\
+  }
+  DISPATCH_DTYPE(dtype,MAP)
+#undef MAP
+  return 0;
+}
+
+/* Raw video */
+
+pixmaptools_scaling* pixmaptools_scaling_new(void)
+{
+  pixmaptools_scaling *aScaling = new(std::nothrow) pixmaptools_scaling();
+  if(!aScaling)
+    _error("can't allocate scaling");
+  return aScaling;
+}
+
+void pixmaptools_scaling_free(pixmaptools_scaling *aScaling)
+{
+  delete aScaling;
+}
+
+int pixmaptools_scaling_set_mode(pixmaptools_scaling *aScaling,int aMode)
+{
+  if(!aScaling || aMode < LUT::Scaling::UNACTIVE || aMode > LUT::Scaling::COLOR_MAPPED)
+    return _error("invalid scaling or mode");
+  aScaling->scaling.set_mode(LUT::Scaling::mode(aMode));
+  return 0;
+}
+
+int pixmaptools_scaling_get_mode(pixmaptools_scaling *aScaling)
+{
+  if(!aScaling)
+    return _error("NULL scaling");
+  LUT::Scaling::mode aMode;
+  aScaling->scaling.get_mode(aMode);
+  return int(aMode);
+}
+
+int pixmaptools_scaling_set_custom_mapping(pixmaptools_scaling *aScaling,
+					   double minVal,double maxVal)
+{
+  if(!aScaling)
+    return _error("NULL scaling");
+  aScaling->scaling.set_custom_mapping(minVal,maxVal);
+  return 0;
+}
+
+int pixmaptools_scaling_min_max_mapping(pixmaptools_scaling *aScaling,
+					double *minVal,double *maxVal)
+{
+  if(!aScaling || !minVal || !maxVal)
+    return _error("NULL scaling or result");
+  aScaling->scaling.min_max_mapping(*minVal,*maxVal);
+  return 0;
+}
+
+int pixmaptools_scaling_fill_palette(pixmaptools_scaling *aScaling,int aType)
+{
+  if(!aScaling || !_valid_palette_type(aType))
+    return _error("invalid scaling or palette type");
+  aScaling->scaling.fill_palette(LUT::Palette::palette_type(aType));
+  return 0;
+}
+
+int pixmaptools_scaling_set_palette_mapping_meth(pixmaptools_scaling *aScaling,int aMeth)
+{
+  if(!aScaling || !_valid_mapping_meth(aMeth))
+    return _error("invalid scaling or mapping method");
+  aScaling->scaling.set_palette_mapping_meth(LUT::mapping_meth(aMeth));
+  return 0;
+}
+
+size_t pixmaptools_raw_video_size(int column,int row,int aType)
+{
+  return _raw_video_size(column,row,aType);
+}
+
+int pixmaptools_scaling_autoscale_min_max(pixmaptools_scaling *aScaling,
+					  const unsigned char *data,size_t dataSize,
+					  int column,int row,int aType)
+{
+  if(_check_raw_video(data,dataSize,aScaling,column,row,aType)) return -1;
+  aScaling->scaling.autoscale_min_max(data,column,row,LUT::Scaling::image_type(aType));
+  return 0;
+}
+
+int pixmaptools_scaling_autoscale_plus_minus_sigma(pixmaptools_scaling *aScaling,
+						   const unsigned char *data,size_t dataSize,
+						   int column,int row,int aType,
+						   double aSigmaFactor)
+{
+  if(_check_raw_video(data,dataSize,aScaling,column,row,aType)) return -1;
+  aScaling->scaling.autoscale_plus_minus_sigma(data,column,row,LUT::Scaling::image_type(aType),
+					       aSigmaFactor);
+  return 0;
+}
+
+int pixmaptools_raw_video_2_image(const unsigned char *data,size_t dataSize,
+				  unsigned int *anImage,int column,int row,int aType,
+				  pixmaptools_scaling *aScaling)
+{
+  if(_check_raw_video(data,dataSize,anImage,column,row,aType)) return -1;
+  if(!aScaling)
+    return _error("NULL scaling");
+  if(!LUT::raw_video_2_image(data,anImage,column,row,LUT::Scaling::image_type(aType),
+			     aScaling->scaling))
+    return _error("image type not supported");
+  return 0;
+}
+
+int pixmaptools_raw_video_2_luma(const unsigned char *data,size_t dataSize,
+				 int column,int row,int aType,
+				 void *dest,size_t destSize,int *depth)
+{
+  if(_check_raw_video(data,dataSize,dest,column,row,aType)) return -1;
+  int aDepth;
+  switch(aType)
+    {
+    case LUT::Scaling::Y16:
+    case LUT::Scaling::BAYER_RG16:
+    case LUT::Scaling::BAYER_BG16:
+      aDepth = 2;break;
+    default:
+      aDepth = 1;break;
+    }
+  size_t aSize = size_t(column) * row * aDepth;
+  if(destSize < aSize)
+    return _error("destination buffer too small");
+  unsigned char *luma = LUT::raw_video_2_luma(data,column,row,LUT::Scaling::image_type(aType));
+  if(!luma)
+    return _error("image type has no luma");
+  memcpy(dest,luma,aSize);
+  free(luma);
+  if(depth) *depth = aDepth;
+  return 0;
+}
+
+/* Histograms */
+
+int pixmaptools_histo(const void *data,int dtype,int nbElem,int nbBins,
+		      double lower,double upper,int *counts,double *edges)
+{
+  if(!data || !counts || !edges || nbElem < 0 || nbBins <= 0)
+    return _error("invalid histogram arguments");
+  std::vector<int> Y;
+#define HISTO(TYPE)							\
+  {									\
+    std::vector<TYPE> X;						\
+    Stat::histo((const TYPE*)data,nbElem,Y,X,nbBins,			\
+		_from_double<TYPE>(lower),_from_double<TYPE>(upper));	\
+    for(size_t i = 0;i < X.size() && i <= size_t(nbBins);++i)		\
+      edges[i] = double(X[i]);						\
+  }
+  try
+    {
+      DISPATCH_DTYPE(dtype,HISTO)
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate histogram");
+    }
+#undef HISTO
+  for(int i = 0;i < nbBins;++i)
+    counts[i] = i < int(Y.size()) ? Y[i] : 0;
+  return 0;
+}
+
+int pixmaptools_histo_log(const void *data,int dtype,int nbElem,int nbBins,
+			  double lower,double upper,int *counts,double *edges)
+{
+  if(!data || !counts || !edges || nbElem < 0 || nbBins <= 0)
+    return _error("invalid histogram arguments");
+  std::vector<int> Y;
+  std::vector<double> X;
+  bool aValidRange = false;
+#define HISTO(TYPE)							\
+  aValidRange = Stat::histo_log((const TYPE*)data,nbElem,Y,X,nbBins,lower,upper)
+  try
+    {
+      DISPATCH_DTYPE(dtype,HISTO)
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate histogram");
+    }
+#undef HISTO
+  if(!aValidRange)
+    return _error("histogram range not positive (0 < lower <= upper) "
+		  "or no positive data");
+  for(int i = 0;i <= nbBins;++i)
+    edges[i] = i < int(X.size()) ? X[i] : 0.;
+  for(int i = 0;i < nbBins;++i)
+    counts[i] = i < int(Y.size()) ? Y[i] : 0;
+  return 0;
+}
+
+int pixmaptools_histo_edges(const void *data,int dtype,int nbElem,
+			    const double *edges,int nbEdges,int *counts)
+{
+  if(!data || !counts || !edges || nbElem < 0 || nbEdges < 2)
+    return _error("invalid histogram arguments");
+  std::vector<int> Y;
+#define HISTO(TYPE)							\
+  Stat::histo_edges((const TYPE*)data,nbElem,Y,edges,nbEdges)
+  try
+    {
+      DISPATCH_DTYPE(dtype,HISTO)
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate histogram");
+    }
+#undef HISTO
+  for(int i = 0;i < nbEdges - 1;++i)
+    counts[i] = i < int(Y.size()) ? Y[i] : 0;
+  return 0;
+}
+
+/* Azimuthal integration */
+
+pixmaptools_azim* pixmaptools_azim_new(void)
+{
+  pixmaptools_azim *anAzim = new(std::nothrow) pixmaptools_azim;
+  if(!anAzim)
+    _error("can't allocate integrator");
+  return anAzim;
+}
+
+void pixmaptools_azim_free(pixmaptools_azim *anAzim)
+{
+  delete anAzim;
+}
+
+int pixmaptools_azim_set_geometry(pixmaptools_azim *anAzim,int column,int row,
+				  double centerX,double centerY,
+				  double pixelSizeX,double pixelSizeY,
+				  double distance,double wavelength)
+{
+  if(!anAzim)
+    return _error("NULL integrator");
+  try
+    {
+      anAzim->integrator.set_geometry(column,row,centerX,centerY,
+				      pixelSizeX,pixelSizeY,distance,wavelength);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+int pixmaptools_azim_set_mask(pixmaptools_azim *anAzim,const unsigned char *mask,
+			      int column,int row)
+{
+  if(!anAzim)
+    return _error("NULL integrator");
+  try
+    {
+      anAzim->integrator.set_mask(mask,column,row);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate mask");
+    }
+  return 0;
+}
+
+int pixmaptools_azim_setup(pixmaptools_azim *anAzim,int nbRadialBins,
+			   int nbAzimuthalBins,int aUnit,
+			   double radialMin,double radialMax)
+{
+  if(!anAzim)
+    return _error("NULL integrator");
+  if(aUnit < AzimuthalIntegrator::R_MM || aUnit > AzimuthalIntegrator::Q_NM)
+    return _error("invalid radial unit");
+  try
+    {
+      anAzim->integrator.setup(nbRadialBins,nbAzimuthalBins,
+			       AzimuthalIntegrator::radial_unit(aUnit),
+			       radialMin,radialMax);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate lookup table");
+    }
+  return 0;
+}
+
+int pixmaptools_azim_nb_bins(pixmaptools_azim *anAzim,int *nbRadialBins,
+			     int *nbAzimuthalBins)
+{
+  if(!anAzim || !nbRadialBins || !nbAzimuthalBins)
+    return _error("NULL integrator or result");
+  *nbRadialBins = anAzim->integrator.nb_radial_bins();
+  *nbAzimuthalBins = anAzim->integrator.nb_azimuthal_bins();
+  return 0;
+}
+
+int pixmaptools_azim_positions(pixmaptools_azim *anAzim,double *radial,int nbRadial,
+			       double *azimuthal,int nbAzimuthal)
+{
+  if(!anAzim || !radial || !azimuthal)
+    return _error("NULL integrator or result");
+  std::vector<double> aRadial,anAzimuthal;
+  anAzim->integrator.radial_positions(aRadial);
+  anAzim->integrator.azimuthal_positions(anAzimuthal);
+  if(int(aRadial.size()) != nbRadial || int(anAzimuthal.size()) != nbAzimuthal)
+    return _error("number of bins differs from the setup");
+  std::copy(aRadial.begin(),aRadial.end(),radial);
+  std::copy(anAzimuthal.begin(),anAzimuthal.end(),azimuthal);
+  return 0;
+}
+
+int pixmaptools_azim_integrate(pixmaptools_azim *anAzim,const void *data,int dtype,
+			       int column,int row,double *result,size_t aResultSize,
+			       int *nbRadialBins,int *nbAzimuthalBins)
+{
+  if(!anAzim || !nbRadialBins || !nbAzimuthalBins)
+    return _error("NULL integrator or result");
+  if(_check_frame(data,result,column,row)) return -1;
+  std::vector<double> aResult;
+  int nbAzimuthal = 0;
+#define INTEGRATE(TYPE)							\
+  anAzim->integrator.integrate((const TYPE*)data,column,row,aResult,nbAzimuthal)
+  try
+    {
+      DISPATCH_DTYPE(dtype,INTEGRATE)
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate integration result");
+    }
+#undef INTEGRATE
+  *nbAzimuthalBins = nbAzimuthal;
+  *nbRadialBins = int(aResult.size()) / nbAzimuthal;
+  if(aResult.size() > aResultSize)
+    return _error("result too small for the bins");
+  std::copy(aResult.begin(),aResult.end(),result);
+  return 0;
+}
+
+/* Pixel accumulator */
+
+pixmaptools_accumulator* pixmaptools_accumulator_new(int aPrecision,int aMode,double alpha)
+{
+  if(aPrecision < PixelAccumulator::FLOAT32 || aPrecision > PixelAccumulator::FLOAT64 ||
+     aMode < PixelAccumulator::CUMULATIVE || aMode > PixelAccumulator::EXPONENTIAL)
+    {
+      _error("invalid accumulator precision or mode");
+      return NULL;
+    }
+  try
+    {
+      return new pixmaptools_accumulator(PixelAccumulator::precision(aPrecision),
+					 PixelAccumulator::mode(aMode),alpha);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate accumulator");
+    }
+  return NULL;
+}
+
+void pixmaptools_accumulator_free(pixmaptools_accumulator *anAccumulator)
+{
+  delete anAccumulator;
+}
+
+int pixmaptools_accumulator_reset(pixmaptools_accumulator *anAccumulator)
+{
+  if(!anAccumulator)
+    return _error("NULL accumulator");
+  anAccumulator->accumulator.reset();
+  return 0;
+}
+
+int pixmaptools_accumulator_count(pixmaptools_accumulator *anAccumulator)
+{
+  if(!anAccumulator)
+    return _error("NULL accumulator");
+  return anAccumulator->accumulator.count();
+}
+
+int pixmaptools_accumulator_size(pixmaptools_accumulator *anAccumulator,
+				 int *column,int *row)
+{
+  if(!anAccumulator || !column || !row)
+    return _error("NULL accumulator or result");
+  *column = anAccumulator->accumulator.column();
+  *row = anAccumulator->accumulator.row();
+  return 0;
+}
+
+int pixmaptools_accumulator_add(pixmaptools_accumulator *anAccumulator,
+				const void *data,int dtype,int column,int row)
+{
+  if(!anAccumulator)
+    return _error("NULL accumulator");
+  if(!data)
+    return _error("NULL buffer");
+#define ADD(TYPE)							\
+  anAccumulator->accumulator.add((const TYPE*)data,column,row)
+  try
+    {
+      DISPATCH_DTYPE(dtype,ADD)
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      return _error("can't allocate statistics");
+    }
+#undef ADD
+  return 0;
+}
+
+int pixmaptools_accumulator_snapshot(pixmaptools_accumulator *anAccumulator,
+				     int aStatistic,void *dest,int column,int row)
+{
+  if(!anAccumulator)
+    return _error("NULL accumulator");
+  if(aStatistic < PixelAccumulator::MEAN || aStatistic > PixelAccumulator::MAX)
+    return _error("invalid statistic");
+  if(!dest && column > 0 && row > 0)
+    return _error("NULL buffer");
+  if(!anAccumulator->accumulator.snapshot(PixelAccumulator::statistic(aStatistic),
+					  dest,column,row))
+    return _error("frame size differs from the accumulated frames");
+  return 0;
+}
+
+/* Timing */
+
+int pixmaptools_timing_enabled(void)
+{
+  return Timing::enabled() ? 1 : 0;
+}
+
+void pixmaptools_timing_set_enabled(int aFlag)
+{
+  Timing::set_enabled(aFlag != 0);
+}
+
+void pixmaptools_timing_reset(void)
+{
+  Timing::reset();
+}
+
+int pixmaptools_timing_nb_stages(void)
+{
+  return Timing::NB_STAGES;
+}
+
+const char* pixmaptools_timing_name(int aStage)
+{
+  return Timing::name(Timing::stage(aStage));
+}
+
+int pixmaptools_timing_get(int aStage,pixmaptools_timing_stat *aStat)
+{
+  if(!aStat || aStage < 0 || aStage >= Timing::NB_STAGES)
+    return _error("invalid timing stage");
+  Timing::Stat aTimingStat;
+  Timing::get_stat(Timing::stage(aStage),aTimingStat);
+  aStat->count = aTimingStat.count;
+  aStat->total = aTimingStat.total;
+  aStat->last = aTimingStat.last;
+  aStat->max = aTimingStat.max;
+  aStat->p50 = aTimingStat.p50;
+  aStat->p99 = aTimingStat.p99;
+  return 0;
+}
+
+
+long long pixmaptools_timing_now(void)
+{
+  return Timing::now();
+}
+
+/* Display worker */
+
+pixmaptools_display_worker* pixmaptools_display_worker_new(pixmaptools_scaling *aScaling)
+{
+  if(!aScaling)
+    {
+      _error("NULL scaling");
+      return NULL;
+    }
+  try
+    {
+      return new pixmaptools_display_worker(aScaling->scaling);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate display worker");
+    }
+  return NULL;
+}
+
+void pixmaptools_display_worker_free(pixmaptools_display_worker *aWorker)
+{
+  delete aWorker;
+}
+
+int pixmaptools_display_worker_start(pixmaptools_display_worker *aWorker)
+{
+  if(!aWorker)
+    return _error("NULL display worker");
+  try
+    {
+      aWorker->worker.start();
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+int pixmaptools_display_worker_stop(pixmaptools_display_worker *aWorker)
+{
+  if(!aWorker)
+    return _error("NULL display worker");
+  aWorker->worker.stop();
+  return 0;
+}
+
+int pixmaptools_display_worker_set_autoscale(pixmaptools_display_worker *aWorker,
+					     int anAutoscale,double aSigmaFactor)
+{
+  if(!aWorker || anAutoscale < DisplayWorker::NO_AUTOSCALE ||
+     anAutoscale > DisplayWorker::PLUS_MINUS_SIGMA)
+    return _error("invalid display worker or autoscale");
+  aWorker->worker.set_autoscale(DisplayWorker::autoscale(anAutoscale),aSigmaFactor);
+  return 0;
+}
+
+int pixmaptools_display_worker_push(pixmaptools_display_worker *aWorker,
+				    const unsigned char *data,size_t dataSize,
+				    int column,int row,int aType,
+				    long long aFrameNumber)
+{
+  if(_check_raw_video(data,dataSize,aWorker,column,row,aType)) return -1;
+  try
+    {
+      aWorker->worker.push(data,dataSize,column,row,LUT::Scaling::image_type(aType),
+			   aFrameNumber);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+int pixmaptools_display_worker_fetch(pixmaptools_display_worker *aWorker,
+				     pixmaptools_frame_info *anInfo)
+{
+  if(!aWorker)
+    return _error("NULL display worker");
+  if(!aWorker->worker.fetch())
+    return 0;
+  if(anInfo)
+    {
+      const FrameMailbox::Frame &anImage = aWorker->worker.image();
+      anInfo->column = anImage.column,anInfo->row = anImage.row;
+      anInfo->frame_number = anImage.frame_number;
+      anInfo->timestamp = anImage.timestamp;
+    }
+  return 1;
+}
+
+int pixmaptools_display_worker_copy_image(pixmaptools_display_worker *aWorker,
+					  unsigned int *dest,size_t destSize)
+{
+  if(!aWorker || !dest)
+    return _error("NULL display worker or destination");
+  const FrameMailbox::Frame &anImage = aWorker->worker.image();
+  if(!anImage.data)
+    return _error("no image fetched");
+  if(destSize < anImage.size)
+    return _error("destination buffer too small");
+  memcpy(dest,anImage.data,anImage.size);
+  return 0;
+}
+
+int pixmaptools_display_worker_counters(pixmaptools_display_worker *aWorker,
+					pixmaptools_display_counters *aCounters)
+{
+  if(!aWorker || !aCounters)
+    return _error("NULL display worker or counters");
+  aCounters->pushed = aWorker->worker.pushed();
+  aCounters->dropped = aWorker->worker.dropped();
+  aCounters->decoded = aWorker->worker.decoded();
+  aCounters->skipped = aWorker->worker.skipped();
+  aCounters->errors = aWorker->worker.errors();
+  return 0;
+}
+
+/* Video pipeline */
+
+pixmaptools_pipeline* pixmaptools_pipeline_new(void)
+{
+  try
+    {
+      return new pixmaptools_pipeline();
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate video pipeline");
+    }
+  return NULL;
+}
+
+void pixmaptools_pipeline_free(pixmaptools_pipeline *aPipeline)
+{
+  delete aPipeline;
+}
+
+int pixmaptools_pipeline_start(pixmaptools_pipeline *aPipeline)
+{
+  if(!aPipeline)
+    return _error("NULL pipeline");
+  try
+    {
+      aPipeline->pipeline.start();
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+int pixmaptools_pipeline_stop(pixmaptools_pipeline *aPipeline)
+{
+  if(!aPipeline)
+    return _error("NULL pipeline");
+  aPipeline->pipeline.stop();
+  return 0;
+}
+
+int pixmaptools_pipeline_set_mode(pixmaptools_pipeline *aPipeline,int aMode)
+{
+  if(!aPipeline || aMode < LUT::Scaling::UNACTIVE || aMode > LUT::Scaling::COLOR_MAPPED)
+    return _error("invalid pipeline or mode");
+  aPipeline->pipeline.scaling().set_mode(LUT::Scaling::mode(aMode));
+  return 0;
+}
+
+int pixmaptools_pipeline_set_custom_mapping(pixmaptools_pipeline *aPipeline,
+					    double minVal,double maxVal)
+{
+  if(!aPipeline)
+    return _error("NULL pipeline");
+  aPipeline->pipeline.scaling().set_custom_mapping(minVal,maxVal);
+  return 0;
+}
+
+int pixmaptools_pipeline_min_max_mapping(pixmaptools_pipeline *aPipeline,
+					 double *minVal,double *maxVal)
+{
+  if(!aPipeline || !minVal || !maxVal)
+    return _error("NULL pipeline or result");
+  aPipeline->pipeline.scaling().min_max_mapping(*minVal,*maxVal);
+  return 0;
+}
+
+int pixmaptools_pipeline_fill_palette(pixmaptools_pipeline *aPipeline,int aType)
+{
+  if(!aPipeline || !_valid_palette_type(aType))
+    return _error("invalid pipeline or palette type");
+  aPipeline->pipeline.scaling().fill_palette(LUT::Palette::palette_type(aType));
+  return 0;
+}
+
+int pixmaptools_pipeline_set_palette_mapping_meth(pixmaptools_pipeline *aPipeline,int aMeth)
+{
+  if(!aPipeline || !_valid_mapping_meth(aMeth))
+    return _error("invalid pipeline or mapping method");
+  aPipeline->pipeline.scaling().set_palette_mapping_meth(LUT::mapping_meth(aMeth));
+  return 0;
+}
+
+int pixmaptools_pipeline_set_autoscale(pixmaptools_pipeline *aPipeline,
+				       int anAutoscale,double aSigmaFactor)
+{
+  if(!aPipeline || anAutoscale < VideoPipeline::NO_AUTOSCALE ||
+     anAutoscale > VideoPipeline::PLUS_MINUS_SIGMA)
+    return _error("invalid pipeline or autoscale");
+  aPipeline->pipeline.set_autoscale(VideoPipeline::autoscale(anAutoscale),aSigmaFactor);
+  return 0;
+}
+
+int pixmaptools_pipeline_push(pixmaptools_pipeline *aPipeline,
+			      const unsigned char *data,size_t dataSize,
+			      int column,int row,int aType,long long aFrameNumber)
+{
+  if(_check_raw_video(data,dataSize,aPipeline,column,row,aType)) return -1;
+  try
+    {
+      aPipeline->pipeline.push(data,dataSize,column,row,LUT::Scaling::image_type(aType),
+			       aFrameNumber);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+int pixmaptools_pipeline_push_devencoded(pixmaptools_pipeline *aPipeline,
+					 const unsigned char *data,size_t dataSize)
+{
+  if(!aPipeline || !data)
+    return _error("NULL pipeline or data");
+  try
+    {
+      return aPipeline->pipeline.push_devencoded(data,dataSize) ? 1 : 0;
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+}
+
+pixmaptools_image* pixmaptools_pipeline_fetch(pixmaptools_pipeline *aPipeline)
+{
+  if(!aPipeline)
+    {
+      _error("NULL pipeline");
+      return NULL;
+    }
+  return (pixmaptools_image*)aPipeline->pipeline.fetch();
+}
+
+int pixmaptools_pipeline_counters(pixmaptools_pipeline *aPipeline,
+				  pixmaptools_display_counters *aCounters)
+{
+  if(!aPipeline || !aCounters)
+    return _error("NULL pipeline or counters");
+  aCounters->pushed = aPipeline->pipeline.pushed();
+  aCounters->dropped = aPipeline->pipeline.dropped();
+  aCounters->decoded = aPipeline->pipeline.decoded();
+  aCounters->skipped = aPipeline->pipeline.skipped();
+  aCounters->errors = aPipeline->pipeline.errors();
+  return 0;
+}
+
+double pixmaptools_pipeline_fps(pixmaptools_pipeline *aPipeline)
+{
+  return aPipeline ? aPipeline->pipeline.fps() : 0.;
+}
+
+int pixmaptools_pipeline_latency(pixmaptools_pipeline *aPipeline,int aStage,
+				 pixmaptools_latency *aLatency)
+{
+  if(!aPipeline || !aLatency || aStage < 0 || aStage >= VideoPipeline::NB_STAGES)
+    return _error("invalid pipeline, stage or result");
+  VideoPipeline::Latency aPipelineLatency;
+  aPipeline->pipeline.latency(VideoPipeline::stage(aStage),aPipelineLatency);
+  aLatency->last = aPipelineLatency.last;
+  aLatency->mean = aPipelineLatency.mean;
+  aLatency->max = aPipelineLatency.max;
+  return 0;
+}
+
+int pixmaptools_image_info(const pixmaptools_image *anImage,pixmaptools_frame_info *anInfo)
+{
+  if(!anImage || !anInfo)
+    return _error("NULL image or info");
+  const VideoPipeline::Image *aPipelineImage = _image(anImage);
+  anInfo->column = aPipelineImage->column();
+  anInfo->row = aPipelineImage->row();
+  anInfo->frame_number = aPipelineImage->frame_number();
+  anInfo->timestamp = aPipelineImage->timestamp();
+  return 0;
+}
+
+const unsigned int* pixmaptools_image_data(const pixmaptools_image *anImage)
+{
+  return anImage ? _image(anImage)->data() : NULL;
+}
+
+void pixmaptools_image_release(pixmaptools_image *anImage)
+{
+  if(anImage)
+    _image(anImage)->unref();
+}
+
+/* Encoding */
+
+pixmaptools_buffer* pixmaptools_encode_png(const unsigned int *anImage,int column,int row,
+					   int aLevel,int anAlpha)
+{
+  pixmaptools_buffer *aBuffer = new(std::nothrow) pixmaptools_buffer();
+  if(!aBuffer)
+    {
+      _error("can't allocate buffer");
+      return NULL;
+    }
+  try
+    {
+      ImageEncoder::png(anImage,column,row,aBuffer->data,aLevel,anAlpha != 0);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+      delete aBuffer;
+      return NULL;
+    }
+  return aBuffer;
+}
+
+int pixmaptools_has_jpeg(void)
+{
+  return ImageEncoder::has_jpeg();
+}
+
+pixmaptools_buffer* pixmaptools_encode_jpeg(const unsigned int *anImage,int column,int row,
+					    int aQuality)
+{
+  pixmaptools_buffer *aBuffer = new(std::nothrow) pixmaptools_buffer();
+  if(!aBuffer)
+    {
+      _error("can't allocate buffer");
+      return NULL;
+    }
+  try
+    {
+      ImageEncoder::jpeg(anImage,column,row,aBuffer->data,aQuality);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+      delete aBuffer;
+      return NULL;
+    }
+  return aBuffer;
+}
+
+const unsigned char* pixmaptools_buffer_data(const pixmaptools_buffer *aBuffer)
+{
+  return aBuffer && !aBuffer->data.empty() ? &aBuffer->data[0] : NULL;
+}
+
+size_t pixmaptools_buffer_size(const pixmaptools_buffer *aBuffer)
+{
+  return aBuffer ? aBuffer->data.size() : 0;
+}
+
+void pixmaptools_buffer_free(pixmaptools_buffer *aBuffer)
+{
+  delete aBuffer;
+}
+
+/* Edf */
+
+pixmaptools_edf* pixmaptools_edf_open(const char *aFilename)
+{
+  if(!aFilename)
+    {
+      _error("NULL filename");
+      return NULL;
+    }
+  try
+    {
+      return new pixmaptools_edf(aFilename);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate edf index");
+    }
+  return NULL;
+}
+
+void pixmaptools_edf_close(pixmaptools_edf *anEdf)
+{
+  delete anEdf;
+}
+
+int pixmaptools_edf_nb_frames(pixmaptools_edf *anEdf)
+{
+  if(!anEdf)
+    return _error("NULL edf");
+  return anEdf->reader.nb_frames();
+}
+
+int pixmaptools_edf_stat(pixmaptools_edf *anEdf,long long *aMtime,size_t *aSize)
+{
+  if(!anEdf || !aMtime || !aSize)
+    return _error("NULL edf or result");
+  *aMtime = anEdf->reader.mtime();
+  *aSize = anEdf->reader.size();
+  return 0;
+}
+
+int pixmaptools_edf_frame_info(pixmaptools_edf *anEdf,int anIndex,pixmaptools_edf_frame *aFrame)
+{
+  if(!anEdf || !aFrame)
+    return _error("NULL edf or frame");
+  try
+    {
+      const EdfReader::Frame &anEdfFrame = anEdf->reader.frame(anIndex);
+      aFrame->nb_dims = anEdfFrame.nb_dims;
+      for(int i = 0;i < 3;++i)
+	aFrame->dims[i] = anEdfFrame.dims[i];
+      aFrame->dtype = anEdfFrame.type == EdfReader::UNKNOWN ? -1 : int(anEdfFrame.type);
+      aFrame->big_endian = anEdfFrame.big_endian;
+      aFrame->compressed = anEdfFrame.compressed;
+      aFrame->data_size = anEdfFrame.data_size;
+      aFrame->image_size = anEdfFrame.image_size;
+      aFrame->header_offset = anEdfFrame.header_offset;
+      aFrame->data_offset = anEdfFrame.data_offset;
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+const char* pixmaptools_edf_header(pixmaptools_edf *anEdf,int anIndex,size_t *aSize)
+{
+  if(!anEdf || !aSize)
+    {
+      _error("NULL edf or size");
+      return NULL;
+    }
+  try
+    {
+      const EdfReader::Frame &anEdfFrame = anEdf->reader.frame(anIndex);
+      const char *aText = (const char*)anEdf->reader.data(anIndex) - anEdfFrame.header_size;
+      const char *aClose = (const char*)memchr(aText,'}',anEdfFrame.header_size);
+      *aSize = aClose - aText + 1;
+      return aText;
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  return NULL;
+}
+
+const void* pixmaptools_edf_data(pixmaptools_edf *anEdf,int anIndex)
+{
+  if(!anEdf)
+    {
+      _error("NULL edf");
+      return NULL;
+    }
+  try
+    {
+      return anEdf->reader.data(anIndex);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  return NULL;
+}
+
+int pixmaptools_edf_decompress(pixmaptools_edf *anEdf,int anIndex,void *dest,size_t aDestSize)
+{
+  if(!anEdf)
+    return _error("NULL edf");
+  try
+    {
+      anEdf->reader.decompress(anIndex,dest,aDestSize);
+    }
+  catch(LutError &err)
+    {
+      return _error(err.msg());
+    }
+  return 0;
+}
+
+/* Prefetch */
+
+pixmaptools_prefetcher* pixmaptools_prefetcher_new(int nbThreads,size_t aMemoryBudget)
+{
+  try
+    {
+      return new pixmaptools_prefetcher(nbThreads,aMemoryBudget);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate prefetcher");
+    }
+  return NULL;
+}
+
+void pixmaptools_prefetcher_free(pixmaptools_prefetcher *aPrefetcher)
+{
+  delete aPrefetcher;
+}
+
+int pixmaptools_prefetcher_prefetch(pixmaptools_prefetcher *aPrefetcher,
+				    const char *aFilename,int anIndex)
+{
+  if(!aPrefetcher || !aFilename)
+    return _error("NULL prefetcher or filename");
+  return aPrefetcher->prefetcher.prefetch(aFilename,anIndex) ? 1 : 0;
+}
+
+pixmaptools_prefetched* pixmaptools_prefetcher_get(pixmaptools_prefetcher *aPrefetcher,
+						   const char *aFilename,int anIndex)
+{
+  if(!aPrefetcher || !aFilename)
+    {
+      _error("NULL prefetcher or filename");
+      return NULL;
+    }
+  try
+    {
+      return (pixmaptools_prefetched*)aPrefetcher->prefetcher.get(aFilename,anIndex);
+    }
+  catch(LutError &err)
+    {
+      _error(err.msg());
+    }
+  catch(std::bad_alloc&)
+    {
+      _error("can't allocate frame");
+    }
+  return NULL;
+}
+
+int pixmaptools_prefetcher_cancel(pixmaptools_prefetcher *aPrefetcher,
+				  const char *aFilename,int anIndex)
+{
+  if(!aPrefetcher || !aFilename)
+    return _error("NULL prefetcher or filename");
+  return aPrefetcher->prefetcher.cancel(aFilename,anIndex) ? 1 : 0;
+}
+
+int pixmaptools_prefetcher_clear(pixmaptools_prefetcher *aPrefetcher)
+{
+  if(!aPrefetcher)
+    return _error("NULL prefetcher");
+  aPrefetcher->prefetcher.clear();
+  return 0;
+}
+
+int pixmaptools_prefetcher_counters(pixmaptools_prefetcher *aPrefetcher,
+				    pixmaptools_prefetch_counters *aCounters)
+{
+  if(!aPrefetcher || !aCounters)
+    return _error("NULL prefetcher or counters");
+  FramePrefetcher::Counters aPrefetchCounters;
+  aPrefetcher->prefetcher.counters(aPrefetchCounters);
+  aCounters->hits = aPrefetchCounters.hits;
+  aCounters->misses = aPrefetchCounters.misses;
+  aCounters->prefetched = aPrefetchCounters.prefetched;
+  aCounters->evicted = aPrefetchCounters.evicted;
+  aCounters->refused = aPrefetchCounters.refused;
+  aCounters->errors = aPrefetchCounters.errors;
+  aCounters->memory_used = aPrefetcher->prefetcher.memory_used();
+  aCounters->memory_budget = aPrefetcher->prefetcher.memory_budget();
+  return 0;
+}
+
+int pixmaptools_prefetched_info(const pixmaptools_prefetched *aFrame,pixmaptools_edf_frame *anInfo)
+{
+  if(!aFrame || !anInfo)
+    return _error("NULL frame or info");
+  const FramePrefetcher::Frame *aPrefetched = _prefetched(aFrame);
+  memset(anInfo,0,sizeof(*anInfo));
+  anInfo->nb_dims = aPrefetched->nb_dims();
+  for(int i = 0;i < 3;++i)
+    anInfo->dims[i] = aPrefetched->dims()[i];
+  anInfo->dtype = int(aPrefetched->type());
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  anInfo->big_endian = 1;
+#endif
+  anInfo->data_size = anInfo->image_size = aPrefetched->size();
+  return 0;
+}
+
+const void* pixmaptools_prefetched_data(const pixmaptools_prefetched *aFrame)
+{
+  return aFrame ? _prefetched(aFrame)->data() : NULL;
+}
+
+void pixmaptools_prefetched_release(pixmaptools_prefetched *aFrame)
+{
+  if(aFrame)
+    _prefetched(aFrame)->unref();
+}
+
+/* Cpu */
+
+int pixmaptools_cpu_level(void)
+{
+  return Cpu::current();
+}
+
+int pixmaptools_cpu_supported_level(void)
+{
+  return Cpu::supported();
+}
+
+int pixmaptools_set_cpu_level(int aLevel)
+{
+  if(aLevel < Cpu::GENERIC) aLevel = Cpu::GENERIC;
+  else if(aLevel > Cpu::AVX512) aLevel = Cpu::AVX512;
+  return Cpu::set_level(Cpu::level(aLevel));
+}
+
+const char* pixmaptools_cpu_level_name(int aLevel)
+{
+  if(aLevel < Cpu::GENERIC || aLevel > Cpu::AVX512)
+    return "unknown";
+  return Cpu::name(Cpu::level(aLevel));
+}
+
+}
@@ -0,0 +1,342 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* C ABI of the pixmaptools kernels (mapping, video decoding, statistics),
+ * no Qt, no Python. Functions returning int give 0 on success and -1 on
+ * error, pixmaptools_last_error() then describes it (per thread).
+ * Enum values follow LUT, LUT::Palette, LUT::Scaling and Timing.
+ *
+ * The part between the CFFI markers is read by cffi (pixmaptools/_cffi.py),
+ * keep it free of preprocessor directives.
+ */
+#ifndef __PIXMAPTOOLS_CAPI
+#define __PIXMAPTOOLS_CAPI
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CFFI_BEGIN */
+/* bumped whenever functions or types are added, removed or changed */
+enum {PIXMAPTOOLS_ABI_VERSION = 6};
+
+/* element type of data buffers */
+enum pixmaptools_dtype {PIXMAPTOOLS_INT8,PIXMAPTOOLS_UINT8,
+			PIXMAPTOOLS_INT16,PIXMAPTOOLS_UINT16,
+			PIXMAPTOOLS_INT32,PIXMAPTOOLS_UINT32,
+			PIXMAPTOOLS_INT64,PIXMAPTOOLS_UINT64,
+			PIXMAPTOOLS_FLOAT32,PIXMAPTOOLS_FLOAT64};
+
+typedef struct pixmaptools_palette pixmaptools_palette;
+typedef struct pixmaptools_scaling pixmaptools_scaling;
+typedef struct pixmaptools_display_worker pixmaptools_display_worker;
+typedef struct pixmaptools_pipeline pixmaptools_pipeline;
+typedef struct pixmaptools_image pixmaptools_image;
+typedef struct pixmaptools_buffer pixmaptools_buffer;
+typedef struct pixmaptools_edf pixmaptools_edf;
+typedef struct pixmaptools_prefetcher pixmaptools_prefetcher;
+typedef struct pixmaptools_prefetched pixmaptools_prefetched;
+typedef struct pixmaptools_azim pixmaptools_azim;
+typedef struct pixmaptools_accumulator pixmaptools_accumulator;
+
+typedef struct
+{
+  long long count;
+  long long total;		/* nanoseconds */
+  long long last;
+  long long max;
+  long long p50;
+  long long p99;
+} pixmaptools_timing_stat;
+
+int pixmaptools_abi_version(void);
+const char* pixmaptools_last_error(void);
+
+int pixmaptools_nb_threads(void);
+void pixmaptools_set_nb_threads(int nb_threads);
+
+/* palette, images are 32 bits BGRA (or RGBA with mode RGBX) */
+pixmaptools_palette* pixmaptools_palette_new(int palette_type,int mode);
+void pixmaptools_palette_free(pixmaptools_palette *palette);
+int pixmaptools_palette_fill(pixmaptools_palette *palette,int palette_type);
+int pixmaptools_palette_set_data(pixmaptools_palette *palette,
+				 const unsigned int *data,int size);
+
+/* data -> image, image holds column * row pixels */
+int pixmaptools_map(const void *data,int dtype,unsigned int *image,
+		    int column,int row,pixmaptools_palette *palette,
+		    int mapping_meth,double data_min,double data_max);
+int pixmaptools_map_on_min_max_val(const void *data,int dtype,unsigned int *image,
+				   int column,int row,pixmaptools_palette *palette,
+				   int mapping_meth,double *data_min,double *data_max);
+int pixmaptools_map_on_plus_minus_sigma(const void *data,int dtype,unsigned int *image,
+					int column,int row,pixmaptools_palette *palette,
+					int mapping_meth,double sigma_factor,
+					double *data_min,double *data_max);
+
+/* raw video decoding */
+pixmaptools_scaling* pixmaptools_scaling_new(void);
+void pixmaptools_scaling_free(pixmaptools_scaling *scaling);
+int pixmaptools_scaling_set_mode(pixmaptools_scaling *scaling,int mode);
+int pixmaptools_scaling_get_mode(pixmaptools_scaling *scaling);
+int pixmaptools_scaling_set_custom_mapping(pixmaptools_scaling *scaling,
+					   double min_val,double max_val);
+int pixmaptools_scaling_min_max_mapping(pixmaptools_scaling *scaling,
+					double *min_val,double *max_val);
+int pixmaptools_scaling_fill_palette(pixmaptools_scaling *scaling,int palette_type);
+int pixmaptools_scaling_set_palette_mapping_meth(pixmaptools_scaling *scaling,
+						 int mapping_meth);
+/* data_size is checked against the frame size of image_type */
+size_t pixmaptools_raw_video_size(int column,int row,int image_type);
+int pixmaptools_scaling_autoscale_min_max(pixmaptools_scaling *scaling,
+					  const unsigned char *data,size_t data_size,
+					  int column,int row,int image_type);
+int pixmaptools_scaling_autoscale_plus_minus_sigma(pixmaptools_scaling *scaling,
+						   const unsigned char *data,size_t data_size,
+						   int column,int row,int image_type,
+						   double sigma_factor);
+int pixmaptools_raw_video_2_image(const unsigned char *data,size_t data_size,
+				  unsigned int *image,int column,int row,int image_type,
+				  pixmaptools_scaling *scaling);
+/* luma is copied to dest (1 or 2 bytes per pixel, returned in depth) */
+int pixmaptools_raw_video_2_luma(const unsigned char *data,size_t data_size,
+				 int column,int row,int image_type,
+				 void *dest,size_t dest_size,int *depth);
+
+/* histograms, counts has nb_bins entries, edges nb_bins + 1,
+   lower == upper == 0 means data range, positive data only for
+   pixmaptools_histo_log which fails on a range not positive */
+int pixmaptools_histo(const void *data,int dtype,int nb_elem,int nb_bins,
+		      double lower,double upper,int *counts,double *edges);
+int pixmaptools_histo_log(const void *data,int dtype,int nb_elem,int nb_bins,
+			  double lower,double upper,int *counts,double *edges);
+int pixmaptools_histo_edges(const void *data,int dtype,int nb_elem,
+			    const double *edges,int nb_edges,int *counts);
+
+/* azimuthal integration (AzimuthalIntegrator), unit follows radial_unit:
+   0 r (mm), 1 2theta (deg), 2 q (nm^-1) */
+pixmaptools_azim* pixmaptools_azim_new(void);
+void pixmaptools_azim_free(pixmaptools_azim *azim);
+/* center in pixel, pixel sizes, distance and wavelength in meter */
+int pixmaptools_azim_set_geometry(pixmaptools_azim *azim,int column,int row,
+				  double center_x,double center_y,
+				  double pixel_size_x,double pixel_size_y,
+				  double distance,double wavelength);
+/* pixels with a non zero mask are ignored, NULL removes the mask */
+int pixmaptools_azim_set_mask(pixmaptools_azim *azim,const unsigned char *mask,
+			      int column,int row);
+/* radial_min == radial_max means the frame range */
+int pixmaptools_azim_setup(pixmaptools_azim *azim,int nb_radial_bins,
+			   int nb_azimuthal_bins,int unit,
+			   double radial_min,double radial_max);
+int pixmaptools_azim_nb_bins(pixmaptools_azim *azim,int *nb_radial_bins,
+			     int *nb_azimuthal_bins);
+/* bin centers, radial holds nb_radial_bins and azimuthal (deg)
+   nb_azimuthal_bins values */
+int pixmaptools_azim_positions(pixmaptools_azim *azim,double *radial,int nb_radial,
+			       double *azimuthal,int nb_azimuthal);
+/* result holds result_size values, the bins of the integration are
+   returned, an error if the result is too small for them */
+int pixmaptools_azim_integrate(pixmaptools_azim *azim,const void *data,int dtype,
+			       int column,int row,double *result,size_t result_size,
+			       int *nb_radial_bins,int *nb_azimuthal_bins);
+
+/* per pixel statistics of a stream of frames (PixelAccumulator),
+   precision 0 float32, 1 float64, mode 0 cumulative, 1 exponential
+   (alpha is the weight of a new frame), statistic 0 mean, 1 variance,
+   2 min, 3 max */
+pixmaptools_accumulator* pixmaptools_accumulator_new(int precision,int mode,double alpha);
+void pixmaptools_accumulator_free(pixmaptools_accumulator *accumulator);
+int pixmaptools_accumulator_reset(pixmaptools_accumulator *accumulator);
+/* number of accumulated frames */
+int pixmaptools_accumulator_count(pixmaptools_accumulator *accumulator);
+/* frame size of the accumulated frames, 0 before the first frame */
+int pixmaptools_accumulator_size(pixmaptools_accumulator *accumulator,
+				 int *column,int *row);
+int pixmaptools_accumulator_add(pixmaptools_accumulator *accumulator,
+				const void *data,int dtype,int column,int row);
+/* dest holds column * row values of the precision, an error if the
+   accumulated frames have another size */
+int pixmaptools_accumulator_snapshot(pixmaptools_accumulator *accumulator,
+				     int statistic,void *dest,int column,int row);
+
+/* stage timing */
+int pixmaptools_timing_enabled(void);
+void pixmaptools_timing_set_enabled(int flag);
+void pixmaptools_timing_reset(void);
+int pixmaptools_timing_nb_stages(void);
+const char* pixmaptools_timing_name(int stage);
+int pixmaptools_timing_get(int stage,pixmaptools_timing_stat *stat);
+
+/* display worker, raw frames in, latest BGRA image out (DisplayWorker).
+   The scaling must outlive the worker, push and fetch may be called from
+   two different threads */
+typedef struct
+{
+  int column;
+  int row;
+  long long frame_number;
+  long long timestamp;		/* pixmaptools_timing_now() when pushed */
+} pixmaptools_frame_info;
+
+typedef struct
+{
+  long long pushed;
+  long long dropped;		/* raw frames replaced before decoding */
+  long long decoded;
+  long long skipped;		/* images replaced before fetch */
+  long long errors;
+} pixmaptools_display_counters;
+
+pixmaptools_display_worker* pixmaptools_display_worker_new(pixmaptools_scaling *scaling);
+void pixmaptools_display_worker_free(pixmaptools_display_worker *worker);
+int pixmaptools_display_worker_start(pixmaptools_display_worker *worker);
+int pixmaptools_display_worker_stop(pixmaptools_display_worker *worker);
+/* autoscale: 0 none, 1 min max, 2 plus minus sigma */
+int pixmaptools_display_worker_set_autoscale(pixmaptools_display_worker *worker,
+					     int autoscale,double sigma_factor);
+int pixmaptools_display_worker_push(pixmaptools_display_worker *worker,
+				    const unsigned char *data,size_t data_size,
+				    int column,int row,int image_type,
+				    long long frame_number);
+/* 1 if a new image was fetched, 0 if none since last fetch */
+int pixmaptools_display_worker_fetch(pixmaptools_display_worker *worker,
+				     pixmaptools_frame_info *info);
+/* copy the last fetched image, column * row pixels */
+int pixmaptools_display_worker_copy_image(pixmaptools_display_worker *worker,
+					  unsigned int *dest,size_t dest_size);
+int pixmaptools_display_worker_counters(pixmaptools_display_worker *worker,
+					pixmaptools_display_counters *counters);
+long long pixmaptools_timing_now(void);
+
+/* video pipeline (VideoPipeline), owns its scaling, images are handed out
+   without copy and must be released */
+typedef struct
+{
+  long long last;		/* nanoseconds */
+  long long mean;
+  long long max;
+} pixmaptools_latency;
+
+pixmaptools_pipeline* pixmaptools_pipeline_new(void);
+void pixmaptools_pipeline_free(pixmaptools_pipeline *pipeline);
+int pixmaptools_pipeline_start(pixmaptools_pipeline *pipeline);
+int pixmaptools_pipeline_stop(pixmaptools_pipeline *pipeline);
+int pixmaptools_pipeline_set_mode(pixmaptools_pipeline *pipeline,int mode);
+int pixmaptools_pipeline_set_custom_mapping(pixmaptools_pipeline *pipeline,
+					    double min_val,double max_val);
+int pixmaptools_pipeline_min_max_mapping(pixmaptools_pipeline *pipeline,
+					 double *min_val,double *max_val);
+int pixmaptools_pipeline_fill_palette(pixmaptools_pipeline *pipeline,int palette_type);
+int pixmaptools_pipeline_set_palette_mapping_meth(pixmaptools_pipeline *pipeline,
+						  int mapping_meth);
+int pixmaptools_pipeline_set_autoscale(pixmaptools_pipeline *pipeline,
+				       int autoscale,double sigma_factor);
+int pixmaptools_pipeline_push(pixmaptools_pipeline *pipeline,
+			      const unsigned char *data,size_t data_size,
+			      int column,int row,int image_type,long long frame_number);
+/* Lima DevEncoded VIDEO_IMAGE, 1 if pushed, 0 if the camera has no image yet */
+int pixmaptools_pipeline_push_devencoded(pixmaptools_pipeline *pipeline,
+					 const unsigned char *data,size_t data_size);
+/* latest image or NULL if none since last fetch, release it when done */
+pixmaptools_image* pixmaptools_pipeline_fetch(pixmaptools_pipeline *pipeline);
+int pixmaptools_pipeline_counters(pixmaptools_pipeline *pipeline,
+				  pixmaptools_display_counters *counters);
+double pixmaptools_pipeline_fps(pixmaptools_pipeline *pipeline);
+/* stage: 0 queue, 1 autoscale, 2 decode, 3 total */
+int pixmaptools_pipeline_latency(pixmaptools_pipeline *pipeline,int stage,
+				 pixmaptools_latency *latency);
+int pixmaptools_image_info(const pixmaptools_image *image,pixmaptools_frame_info *info);
+const unsigned int* pixmaptools_image_data(const pixmaptools_image *image);
+void pixmaptools_image_release(pixmaptools_image *image);
+
+/* PNG / JPEG encoding of BGRA images (ImageEncoder), NULL on error,
+   the encoded buffer must be freed */
+pixmaptools_buffer* pixmaptools_encode_png(const unsigned int *image,int column,int row,
+					   int level,int alpha);
+int pixmaptools_has_jpeg(void);
+pixmaptools_buffer* pixmaptools_encode_jpeg(const unsigned int *image,int column,int row,
+					    int quality);
+const unsigned char* pixmaptools_buffer_data(const pixmaptools_buffer *buffer);
+size_t pixmaptools_buffer_size(const pixmaptools_buffer *buffer);
+void pixmaptools_buffer_free(pixmaptools_buffer *buffer);
+
+/* memory mapped EDF file (EdfReader), frames are indexed once at open */
+typedef struct
+{
+  int nb_dims;
+  int dims[3];			/* Dim_1 (fastest), Dim_2, Dim_3 */
+  int dtype;			/* pixmaptools_dtype, -1 if unknown */
+  int big_endian;
+  int compressed;		/* LZ4 */
+  size_t data_size;		/* bytes in the file */
+  size_t image_size;		/* bytes of the decompressed image */
+  size_t header_offset;
+  size_t data_offset;
+} pixmaptools_edf_frame;
+
+pixmaptools_edf* pixmaptools_edf_open(const char *filename);
+void pixmaptools_edf_close(pixmaptools_edf *edf);
+int pixmaptools_edf_nb_frames(pixmaptools_edf *edf);
+/* modification time (ns) and size of the file when opened */
+int pixmaptools_edf_stat(pixmaptools_edf *edf,long long *mtime,size_t *size);
+int pixmaptools_edf_frame_info(pixmaptools_edf *edf,int index,pixmaptools_edf_frame *frame);
+/* header text, '{' to '}' included, valid while the file is open */
+const char* pixmaptools_edf_header(pixmaptools_edf *edf,int index,size_t *size);
+/* frame data in the mapping, file byte order, valid while the file is open */
+const void* pixmaptools_edf_data(pixmaptools_edf *edf,int index);
+int pixmaptools_edf_decompress(pixmaptools_edf *edf,int index,void *dest,size_t dest_size);
+
+/* read-ahead of EDF frames (FramePrefetcher), frames are decoded in the
+   host byte order, handed out without copy and must be released */
+typedef struct
+{
+  long long hits;
+  long long misses;
+  long long prefetched;
+  long long evicted;
+  long long refused;
+  long long errors;
+  size_t memory_used;
+  size_t memory_budget;
+} pixmaptools_prefetch_counters;
+
+pixmaptools_prefetcher* pixmaptools_prefetcher_new(int nb_threads,size_t memory_budget);
+void pixmaptools_prefetcher_free(pixmaptools_prefetcher *prefetcher);
+/* 1 if queued, 0 if already cached or over the memory budget */
+int pixmaptools_prefetcher_prefetch(pixmaptools_prefetcher *prefetcher,
+				    const char *filename,int index);
+/* waits for a frame being read, reads it now if it was not prefetched */
+pixmaptools_prefetched* pixmaptools_prefetcher_get(pixmaptools_prefetcher *prefetcher,
+						   const char *filename,int index);
+/* 1 if a frame not taken yet was dropped */
+int pixmaptools_prefetcher_cancel(pixmaptools_prefetcher *prefetcher,
+				  const char *filename,int index);
+int pixmaptools_prefetcher_clear(pixmaptools_prefetcher *prefetcher);
+int pixmaptools_prefetcher_counters(pixmaptools_prefetcher *prefetcher,
+				    pixmaptools_prefetch_counters *counters);
+/* nb_dims, dims, dtype and image_size of the frame (little or big endian
+   as the host, not compressed) */
+int pixmaptools_prefetched_info(const pixmaptools_prefetched *frame,pixmaptools_edf_frame *info);
+const void* pixmaptools_prefetched_data(const pixmaptools_prefetched *frame);
+void pixmaptools_prefetched_release(pixmaptools_prefetched *frame);
+
+/* kernels instruction set: 0 generic, 1 sse2, 2 avx2, 3 avx512 */
+int pixmaptools_cpu_level(void);
+int pixmaptools_cpu_supported_level(void);
+/* clipped to the supported level, returns the level in use */
+int pixmaptools_set_cpu_level(int level);
+const char* pixmaptools_cpu_level_name(int level);
+/* CFFI_END */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
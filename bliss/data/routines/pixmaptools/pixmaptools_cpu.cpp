@@ -0,0 +1,193 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_cpu.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <iostream>
+
+namespace cpu_generic
+{
+#include "pixmaptools_cpu_kernels.h"
+}
+
+// gcc only: clang has no target pragma for a whole region
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__clang__)
+#define PIXMAPTOOLS_CPU_DISPATCH
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace cpu_avx2
+{
+#include "pixmaptools_cpu_kernels.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512vl,avx512dq,avx2,fma,prefer-vector-width=512")
+namespace cpu_avx512
+{
+#include "pixmaptools_cpu_kernels.h"
+}
+#pragma GCC pop_options
+#endif
+
+static const char* _names[] = {"generic","sse2","avx2","avx512"};
+
+static Cpu::level _current = Cpu::GENERIC;
+
+// generic kernels until the level is selected (static init order)
+void (*Cpu::y8_2_image)(const unsigned char*,unsigned int*,int) = &cpu_generic::y8_2_image;
+void (*Cpu::y16_2_image)(const unsigned short*,unsigned int*,int) = &cpu_generic::y16_2_image;
+void (*Cpu::rgb_2_image[2][2])(const unsigned char*,unsigned int*,int,bool,float,float) =
+  {{&cpu_generic::rgb_2_image<3,0>,&cpu_generic::rgb_2_image<4,0>},
+   {&cpu_generic::rgb_2_image<3,2>,&cpu_generic::rgb_2_image<4,2>}};
+
+template<class IN>
+void (*CpuKernels<IN>::min_max)(const IN*,int,IN&,IN&) = &cpu_generic::min_max<IN>;
+template<class IN>
+void (*CpuKernels<IN>::linear_map)(const IN*,unsigned int*,int,
+				   const unsigned int*,double,IN,IN) = &cpu_generic::linear_map<IN>;
+template<class IN>
+void (*CpuKernels<IN>::lut_map)(const IN*,unsigned int*,int,
+				const unsigned int*,int,IN,IN) = NULL;
+
+#define INIT_LUT_MAP(TYPE)						\
+  template<> void (*CpuKernels<TYPE>::lut_map)(const TYPE*,unsigned int*,int, \
+					       const unsigned int*,int,TYPE,TYPE) = \
+    &cpu_generic::lut_map<TYPE>;
+
+INIT_LUT_MAP(char)
+INIT_LUT_MAP(unsigned char)
+INIT_LUT_MAP(short)
+INIT_LUT_MAP(unsigned short)
+
+#define INIT_TEMPLATE(TYPE) \
+  template struct CpuKernels<TYPE>;
+
+INIT_TEMPLATE(char)
+INIT_TEMPLATE(unsigned char)
+
+INIT_TEMPLATE(short)
+INIT_TEMPLATE(unsigned short)
+
+INIT_TEMPLATE(int)
+INIT_TEMPLATE(unsigned int)
+
+INIT_TEMPLATE(long)
+INIT_TEMPLATE(unsigned long)
+
+INIT_TEMPLATE(unsigned long long)
+
+INIT_TEMPLATE(float)
+INIT_TEMPLATE(double)
+
+#define SET_KERNELS(NS,TYPE)						\
+  CpuKernels<TYPE>::min_max = &NS::min_max<TYPE>;			\
+  CpuKernels<TYPE>::linear_map = &NS::linear_map<TYPE>;
+
+#define SET_LUT_KERNELS(NS,TYPE)					\
+  SET_KERNELS(NS,TYPE)							\
+  CpuKernels<TYPE>::lut_map = &NS::lut_map<TYPE>;
+
+#define SET_ALL_KERNELS(NS)						\
+  SET_LUT_KERNELS(NS,char)						\
+  SET_LUT_KERNELS(NS,unsigned char)					\
+  SET_LUT_KERNELS(NS,short)						\
+  SET_LUT_KERNELS(NS,unsigned short)					\
+  SET_KERNELS(NS,int)							\
+  SET_KERNELS(NS,unsigned int)						\
+  SET_KERNELS(NS,long)							\
+  SET_KERNELS(NS,unsigned long)						\
+  SET_KERNELS(NS,unsigned long long)					\
+  SET_KERNELS(NS,float)							\
+  SET_KERNELS(NS,double)						\
+  Cpu::y8_2_image = &NS::y8_2_image;					\
+  Cpu::y16_2_image = &NS::y16_2_image;					\
+  Cpu::rgb_2_image[0][0] = &NS::rgb_2_image<3,0>;			\
+  Cpu::rgb_2_image[0][1] = &NS::rgb_2_image<4,0>;			\
+  Cpu::rgb_2_image[1][0] = &NS::rgb_2_image<3,2>;			\
+  Cpu::rgb_2_image[1][1] = &NS::rgb_2_image<4,2>;
+
+Cpu::level Cpu::supported()
+{
+#ifdef PIXMAPTOOLS_CPU_DISPATCH
+  __builtin_cpu_init();		// may run before libgcc constructors
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+     __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq"))
+    return AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2;
+  if(__builtin_cpu_supports("sse2"))
+    return SSE2;
+#endif
+  return GENERIC;
+}
+
+Cpu::level Cpu::current()
+{
+  return _current;
+}
+
+Cpu::level Cpu::set_level(level aLevel)
+{
+  level aSupported = supported();
+  if(aLevel > aSupported) aLevel = aSupported;
+  if(aLevel < GENERIC) aLevel = GENERIC;
+  switch(aLevel)
+    {
+#ifdef PIXMAPTOOLS_CPU_DISPATCH
+    case AVX512:
+      SET_ALL_KERNELS(cpu_avx512);break;
+    case AVX2:
+      SET_ALL_KERNELS(cpu_avx2);break;
+#endif
+    default:			// baseline build is sse2 on x86
+      SET_ALL_KERNELS(cpu_generic);break;
+    }
+  _current = aLevel;
+  return aLevel;
+}
+
+const char* Cpu::name(level aLevel)
+{
+  return aLevel >= GENERIC && aLevel <= AVX512 ? _names[aLevel] : "unknown";
+}
+
+bool Cpu::from_name(const char *aName,level &aLevel)
+{
+  for(int i = GENERIC;aName && i <= AVX512;++i)
+    if(!strcasecmp(aName,_names[i]))
+      {
+	aLevel = level(i);
+	return true;
+      }
+  return false;
+}
+
+struct _CpuInit
+{
+  _CpuInit()
+  {
+    Cpu::level aLevel = Cpu::supported();
+    const char *anEnv = getenv("PIXMAPTOOLS_CPU_LEVEL");
+    if(anEnv && *anEnv)
+      {
+	Cpu::level aForced;
+	if(!Cpu::from_name(anEnv,aForced))
+	  std::cerr << "PIXMAPTOOLS_CPU_LEVEL: unknown level " << anEnv
+		    << " (generic, sse2, avx2 or avx512)" << std::endl;
+	else if(aForced < aLevel)
+	  aLevel = aForced;
+      }
+    Cpu::set_level(aLevel);
+  }
+};
+
+static _CpuInit theCpuInit;
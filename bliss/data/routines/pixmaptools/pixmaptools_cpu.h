@@ -0,0 +1,56 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_CPU
+#define __PIXMAPTOOLS_CPU
+
+/** @brief instruction set dispatch of the hot kernels
+ *
+ *  The kernels of pixmaptools_cpu_kernels.h are compiled for each level,
+ *  the best one supported by the cpu is selected at load time.
+ *  PIXMAPTOOLS_CPU_LEVEL (generic, sse2, avx2 or avx512) forces a lower
+ *  level, for tests and benchmarks.
+ *  On x86_64 generic and sse2 are the same baseline build, other
+ *  architectures (or clang builds) only have generic.
+ */
+class Cpu
+{
+public:
+  enum level {GENERIC,SSE2,AVX2,AVX512};
+
+  /// @brief best level of this cpu and build
+  static level supported();
+  /// @brief level of the kernels in use
+  static level current();
+  /** @brief select the kernels, clipped to supported().
+   *  not thread safe with running kernels, set it before processing
+   *  @return the level in use
+   */
+  static level set_level(level);
+  static const char* name(level);
+  /// @brief parse a level name, returns false if unknown
+  static bool from_name(const char*,level&);
+
+  static void (*y8_2_image)(const unsigned char*,unsigned int*,int);
+  static void (*y16_2_image)(const unsigned short*,unsigned int*,int);
+  /// [rgb,bgr][3 or 4 bytes per pixel]
+  static void (*rgb_2_image[2][2])(const unsigned char*,unsigned int*,int,
+				   bool scalingFlag,float A,float B);
+};
+
+/// kernels per data type, lut_map is NULL above 16 bits
+template<class IN>
+struct CpuKernels
+{
+  static void (*min_max)(const IN*,int,IN &dataMin,IN &dataMax);
+  static void (*linear_map)(const IN*,unsigned int*,int,
+			    const unsigned int *palette,double A,IN dataMin,IN dataMax);
+  static void (*lut_map)(const IN*,unsigned int*,int,
+			 const unsigned int *lut,int lowIndex,IN dataMin,IN dataMax);
+};
+#endif
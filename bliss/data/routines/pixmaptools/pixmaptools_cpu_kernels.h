@@ -0,0 +1,132 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Kernel bodies of the cpu dispatch, NO include guard:
+ * pixmaptools_cpu.cpp includes this file once per instruction set,
+ * each time in its own namespace under a different target pragma.
+ * Loops are written branch free with independent lanes so that gcc
+ * vectorizes them for the target, results don't depend on the target.
+ */
+
+/// @brief min and max ignoring NaN (as LUT::map_on_min_max_val did)
+template<class IN>
+static void min_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax)
+{
+  enum {LANES = 64 / sizeof(IN)};	// one 512 bits vector
+  if(aNbValue <= 0)
+    {
+      dataMin = dataMax = IN(0);
+      return;
+    }
+  // a NaN as first value would hide all others
+  for(;aNbValue > 1 && *aData != *aData;--aNbValue) ++aData;
+  IN lo[LANES],hi[LANES];
+  for(int j = 0;j < LANES;++j) lo[j] = hi[j] = *aData;
+  int i = 0;
+  for(;i + LANES <= aNbValue;i += LANES)
+    for(int j = 0;j < LANES;++j)
+      {
+	IN val = aData[i + j];
+	lo[j] = val < lo[j] ? val : lo[j];
+	hi[j] = val > hi[j] ? val : hi[j];
+      }
+  for(;i < aNbValue;++i)
+    {
+      IN val = aData[i];
+      lo[0] = val < lo[0] ? val : lo[0];
+      hi[0] = val > hi[0] ? val : hi[0];
+    }
+  dataMin = lo[0],dataMax = hi[0];
+  for(int j = 1;j < LANES;++j)
+    {
+      if(lo[j] < dataMin) dataMin = lo[j];
+      if(hi[j] > dataMax) dataMax = hi[j];
+    }
+}
+
+/// @brief linear mapping of wide types, index A * (val - dataMin) in [0,0xffff]
+template<class IN>
+static void linear_map(const IN *data,unsigned int *anImagePt,int aNbPixel,
+		       const unsigned int *palette,double A,IN dataMin,IN dataMax)
+{
+  double lmin = double(dataMin);
+  for(int i = 0;i < aNbPixel;++i)
+    {
+      IN val = data[i];
+      double pos = A * (double(val) - lmin);
+      pos = pos > 0. ? (pos < 65535. ? pos : 65535.) : 0.; // NaN -> 0
+      int index = int(pos);
+      index = val >= dataMax ? 0xffff : (val > dataMin ? index : 0);
+      anImagePt[i] = palette[index];
+    }
+}
+
+/// @brief mapping of 8/16 bits types through a palette indexed by value
+/// lut[lowIndex] is the bottom color
+template<class IN>
+static void lut_map(const IN *data,unsigned int *anImagePt,int aNbPixel,
+		    const unsigned int *lut,int lowIndex,IN dataMin,IN dataMax)
+{
+  int maxIndex = int(dataMax);
+  for(int i = 0;i < aNbPixel;++i)
+    {
+      IN val = data[i];
+      int index = val >= dataMax ? maxIndex : (val > dataMin ? int(val) : lowIndex);
+      anImagePt[i] = lut[index];
+    }
+}
+
+static void y8_2_image(const unsigned char *data,unsigned int *anImagePt,int aNbPixel)
+{
+  for(int i = 0;i < aNbPixel;++i)
+    {
+      unsigned int val = data[i];
+      anImagePt[i] = 0xff000000 | (val << 16) | (val << 8) | val;
+    }
+}
+
+static void y16_2_image(const unsigned short *data,unsigned int *anImagePt,int aNbPixel)
+{
+  for(int i = 0;i < aNbPixel;++i)
+    {
+      unsigned int val = data[i] >> 8;
+      anImagePt[i] = 0xff000000 | (val << 16) | (val << 8) | val;
+    }
+}
+
+/// @brief packed rgb to BGRA, RED is the offset of red (0 rgb, 2 bgr)
+template<int BANDES,int RED>
+static void rgb_2_image(const unsigned char *data,unsigned int *anImagePt,int aNbPixel,
+			bool scalingFlag,float A,float B)
+{
+  if(scalingFlag)
+    {
+      for(int i = 0;i < aNbPixel;++i)
+	{
+	  const unsigned char *pixel = data + i * BANDES;
+	  float red = pixel[RED] * A + B;
+	  float green = pixel[1] * A + B;
+	  float blue = pixel[2 - RED] * A + B;
+	  // clip before the conversion, same as int() then clip
+	  red = red < 255.f ? (red > 0.f ? red : 0.f) : 255.f;
+	  green = green < 255.f ? (green > 0.f ? green : 0.f) : 255.f;
+	  blue = blue < 255.f ? (blue > 0.f ? blue : 0.f) : 255.f;
+	  anImagePt[i] = 0xff000000 | (unsigned(red) << 16) |
+	    (unsigned(green) << 8) | unsigned(blue);
+	}
+    }
+  else
+    {
+      for(int i = 0;i < aNbPixel;++i)
+	{
+	  const unsigned char *pixel = data + i * BANDES;
+	  anImagePt[i] = 0xff000000 | (unsigned(pixel[RED]) << 16) |
+	    (unsigned(pixel[1]) << 8) | unsigned(pixel[2 - RED]);
+	}
+    }
+}
@@ -0,0 +1,182 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_display.h"
+#include "pixmaptools_timing.h"
+#include <cerrno>
+
+FrameMailbox::FrameMailbox() :
+  _back(0),_published(0),_dropped(0),
+  _middle(1),
+  _front(2),_fetched(0)
+{
+}
+
+FrameMailbox::~FrameMailbox()
+{
+  for(int i = 0;i < 3;++i)
+    free(_slots[i].data);
+}
+
+FrameMailbox::Frame& FrameMailbox::back(size_t aSize) throw(LutError)
+{
+  Frame &aFrame = _slots[_back];
+  if(aSize > aFrame.capacity)
+    {
+      void *aBuffer;
+      if(posix_memalign(&aBuffer,64,aSize))
+	throw LutError("FrameMailbox: can't allocate frame");
+      free(aFrame.data);
+      aFrame.data = (unsigned char*)aBuffer;
+      aFrame.capacity = aSize;
+    }
+  aFrame.size = aSize;
+  return aFrame;
+}
+
+void FrameMailbox::publish()
+{
+  // release: the frame content is visible before its index
+  int aPrevious = __atomic_exchange_n(&_middle,_back | FRESH,__ATOMIC_ACQ_REL);
+  if(aPrevious & FRESH)
+    __atomic_store_n(&_dropped,_dropped + 1,__ATOMIC_RELAXED);
+  __atomic_store_n(&_published,_published + 1,__ATOMIC_RELAXED);
+  _back = aPrevious & ~FRESH;
+}
+
+bool FrameMailbox::fetch()
+{
+  if(!(__atomic_load_n(&_middle,__ATOMIC_RELAXED) & FRESH))
+    return false;
+  // only the producer can change middle meanwhile, it stays FRESH
+  int aLatest = __atomic_exchange_n(&_middle,_front,__ATOMIC_ACQ_REL);
+  _front = aLatest & ~FRESH;
+  __atomic_store_n(&_fetched,_fetched + 1,__ATOMIC_RELAXED);
+  return true;
+}
+
+DisplayWorker::DisplayWorker(LUT::Scaling &aScaling) throw(LutError) :
+  _scaling(aScaling),
+  _running(false),
+  _stop(0),
+  _autoscale(NO_AUTOSCALE),
+  _sigmaFactor(3.),
+  _errors(0)
+{
+  if(sem_init(&_wakeup,0,0))
+    throw LutError("DisplayWorker: can't create semaphore");
+}
+
+DisplayWorker::~DisplayWorker()
+{
+  stop();
+  sem_destroy(&_wakeup);
+}
+
+void DisplayWorker::start() throw(LutError)
+{
+  if(_running) return;
+  __atomic_store_n(&_stop,0,__ATOMIC_RELAXED);
+  if(pthread_create(&_thread,NULL,_run,this))
+    throw LutError("DisplayWorker: can't start thread");
+  _running = true;
+  sem_post(&_wakeup);		// frames pushed while stopped
+}
+
+void DisplayWorker::stop()
+{
+  if(!_running) return;
+  __atomic_store_n(&_stop,1,__ATOMIC_RELEASE);
+  sem_post(&_wakeup);
+  pthread_join(_thread,NULL);
+  _running = false;
+}
+
+void DisplayWorker::set_autoscale(autoscale aMode,double aSigmaFactor)
+{
+  __atomic_store(&_sigmaFactor,&aSigmaFactor,__ATOMIC_RELAXED);
+  __atomic_store_n(&_autoscale,int(aMode),__ATOMIC_RELAXED);
+}
+
+void DisplayWorker::push(const unsigned char *data,size_t aSize,int column,int row,
+			 LUT::Scaling::image_type aType,long long aFrameNumber) throw(LutError)
+{
+  size_t aFrameSize = LUT::raw_video_size(column,row,aType);
+  if(!aFrameSize)
+    throw LutError("DisplayWorker: image type or size not supported");
+  if(aSize < aFrameSize)
+    throw LutError("DisplayWorker: raw video buffer too small");
+
+  FrameMailbox::Frame &aFrame = _input.back(aFrameSize);
+  memcpy(aFrame.data,data,aFrameSize);
+  aFrame.column = column,aFrame.row = row;
+  aFrame.image_type = aType;
+  aFrame.frame_number = aFrameNumber;
+  aFrame.timestamp = Timing::now();
+  _input.publish();
+  sem_post(&_wakeup);
+}
+
+void* DisplayWorker::_run(void *arg)
+{
+  DisplayWorker *aWorker = (DisplayWorker*)arg;
+  while(1)
+    {
+      while(sem_wait(&aWorker->_wakeup) && errno == EINTR);
+      // one decoding for all the frames pushed meanwhile
+      while(!sem_trywait(&aWorker->_wakeup));
+      if(__atomic_load_n(&aWorker->_stop,__ATOMIC_ACQUIRE))
+	break;
+      if(aWorker->_input.fetch())
+	aWorker->_process(aWorker->_input.front());
+    }
+  return NULL;
+}
+
+void DisplayWorker::_process(const FrameMailbox::Frame &aRaw)
+{
+  switch(__atomic_load_n(&_autoscale,__ATOMIC_RELAXED))
+    {
+    case MIN_MAX:
+      _scaling.autoscale_min_max(aRaw.data,aRaw.column,aRaw.row,aRaw.image_type);
+      break;
+    case PLUS_MINUS_SIGMA:
+      {
+	double aSigmaFactor;
+	__atomic_load(&_sigmaFactor,&aSigmaFactor,__ATOMIC_RELAXED);
+	_scaling.autoscale_plus_minus_sigma(aRaw.data,aRaw.column,aRaw.row,
+					    aRaw.image_type,aSigmaFactor);
+      }
+      break;
+    default:
+      break;
+    }
+
+  FrameMailbox::Frame *anImage;
+  try
+    {
+      anImage = &_output.back(size_t(aRaw.column) * aRaw.row * sizeof(unsigned int));
+    }
+  catch(LutError&)
+    {
+      __atomic_store_n(&_errors,_errors + 1,__ATOMIC_RELAXED);
+      return;
+    }
+  if(!LUT::raw_video_2_image(aRaw.data,(unsigned int*)anImage->data,
+			     aRaw.column,aRaw.row,aRaw.image_type,_scaling))
+    {
+      __atomic_store_n(&_errors,_errors + 1,__ATOMIC_RELAXED);
+      return;
+    }
+  anImage->column = aRaw.column,anImage->row = aRaw.row;
+  anImage->frame_number = aRaw.frame_number;
+  anImage->timestamp = aRaw.timestamp;
+  _output.publish();
+  if(Timing::enabled())
+    Timing::record(Timing::DISPLAY,Timing::now() - aRaw.timestamp);
+}
@@ -0,0 +1,140 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_DISPLAY
+#define __PIXMAPTOOLS_DISPLAY
+
+#include <pthread.h>
+#include <semaphore.h>
+#include "pixmaptools_lut.h"
+
+/** @brief latest frame wins mailbox, one producer and one consumer
+ *
+ *  Triple buffer: the producer fills the back slot and swaps it with the
+ *  middle one, the consumer swaps the middle slot with its front one when
+ *  it holds a frame it has not seen. Neither side ever waits for the
+ *  other, a frame published before the previous one was fetched replaces
+ *  it and is counted as dropped.
+ *  Slots keep their buffer, there is no allocation once frames have the
+ *  same size.
+ */
+class FrameMailbox
+{
+public:
+  struct Frame
+  {
+    Frame() : data(NULL),size(0),capacity(0),column(0),row(0),
+	      image_type(LUT::Scaling::UNDEF),frame_number(-1),timestamp(0) {}
+    unsigned char		*data;		///< 64 bytes aligned
+    size_t			size;
+    size_t			capacity;
+    int				column,row;
+    LUT::Scaling::image_type	image_type;	///< raw frames only
+    long long			frame_number;
+    long long			timestamp;	///< Timing::now() when pushed
+  };
+
+  FrameMailbox();
+  ~FrameMailbox();
+
+  /// @brief producer: the slot to fill, with room for size bytes
+  Frame& back(size_t size) throw(LutError);
+  /// @brief producer: make the back slot the latest frame
+  void publish();
+
+  /// @brief consumer: take the latest frame, false if none since last fetch
+  bool fetch();
+  /// @brief consumer: the last fetched frame, valid until the next fetch
+  const Frame& front() const {return _slots[_front];}
+
+  long long published() const {return __atomic_load_n(&_published,__ATOMIC_RELAXED);}
+  long long fetched() const {return __atomic_load_n(&_fetched,__ATOMIC_RELAXED);}
+  /// frames replaced before being fetched
+  long long dropped() const {return __atomic_load_n(&_dropped,__ATOMIC_RELAXED);}
+
+private:
+  enum {FRESH = 4};		// middle holds a frame not fetched yet
+
+  FrameMailbox(const FrameMailbox&);
+  FrameMailbox& operator=(const FrameMailbox&);
+
+  // padding keeps producer, shared and consumer fields on their own cache
+  // lines (no aligned attribute: objects are created with plain new)
+  Frame		_slots[3];
+  int		_back;		// producer only
+  long long	_published,_dropped;
+  char		_pad0[64];
+  int		_middle;	// slot index | FRESH
+  char		_pad1[64];
+  int		_front;		// consumer only
+  long long	_fetched;
+  char		_pad2[64];
+};
+
+/** @brief decodes raw video frames in its own thread
+ *
+ *  The acquisition side pushes raw frames, the worker takes the latest
+ *  one, autoscales it if asked, converts it to BGRA through
+ *  LUT::raw_video_2_image and publishes it for the display side.
+ *  Latency is bounded by one decoding whatever the rates are: frames
+ *  arriving faster than they are decoded or displayed are dropped.
+ *  push() must be called from one thread and fetch() from one thread.
+ *  The Scaling is shared with the caller, it may be changed while running.
+ */
+class DisplayWorker
+{
+public:
+  enum autoscale {NO_AUTOSCALE,MIN_MAX,PLUS_MINUS_SIGMA};
+
+  explicit DisplayWorker(LUT::Scaling&) throw(LutError);
+  ~DisplayWorker();
+
+  void start() throw(LutError);
+  /// @brief wait the end of the current frame, pushed frames are kept
+  void stop();
+  bool running() const {return _running;}
+
+  void set_autoscale(autoscale,double sigmaFactor = 3.);
+
+  /// @brief copy a raw frame, never blocks on the worker
+  void push(const unsigned char *data,size_t size,int column,int row,
+	    LUT::Scaling::image_type,long long frameNumber) throw(LutError);
+
+  /// @brief take the latest BGRA image, false if none since last fetch
+  bool fetch() {return _output.fetch();}
+  /// @brief last fetched image, data holds column * row 32 bits pixels
+  const FrameMailbox::Frame& image() const {return _output.front();}
+
+  long long pushed() const {return _input.published();}
+  /// raw frames replaced before being decoded
+  long long dropped() const {return _input.dropped();}
+  long long decoded() const {return _output.published();}
+  /// images replaced before being fetched
+  long long skipped() const {return _output.dropped();}
+  /// frames not decoded (type not supported)
+  long long errors() const {return __atomic_load_n(&_errors,__ATOMIC_RELAXED);}
+
+private:
+  DisplayWorker(const DisplayWorker&);
+  DisplayWorker& operator=(const DisplayWorker&);
+
+  static void* _run(void*);
+  void _process(const FrameMailbox::Frame&);
+
+  LUT::Scaling		&_scaling;
+  FrameMailbox		_input;
+  FrameMailbox		_output;
+  sem_t			_wakeup;
+  pthread_t		_thread;
+  bool			_running;
+  int			_stop;
+  int			_autoscale;
+  double		_sigmaFactor;
+  long long		_errors;
+};
+#endif
@@ -0,0 +1,381 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_edf.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const unsigned int LZ4_FRAME_MAGIC = 0x184d2204;
+
+struct _EdfType
+{
+  const char		*name;
+  EdfReader::data_type	type;
+};
+
+// EDF DataType spellings (EdfFile, fabio, Lima)
+static const _EdfType _edf_types[] = {
+  {"SignedByte",EdfReader::INT8},{"SignedChar",EdfReader::INT8},
+  {"SignedInteger8",EdfReader::INT8},
+  {"UnsignedByte",EdfReader::UINT8},{"UnsignedChar",EdfReader::UINT8},
+  {"UnsignedInteger8",EdfReader::UINT8},
+  {"SignedShort",EdfReader::INT16},{"SignedShortInteger",EdfReader::INT16},
+  {"SignedInteger16",EdfReader::INT16},
+  {"UnsignedShort",EdfReader::UINT16},{"UnsignedShortInteger",EdfReader::UINT16},
+  {"UnsignedInteger16",EdfReader::UINT16},
+  {"SignedInteger",EdfReader::INT32},{"SignedLong",EdfReader::INT32},
+  {"SignedLongInteger",EdfReader::INT32},{"SignedInteger32",EdfReader::INT32},
+  {"UnsignedInteger",EdfReader::UINT32},{"UnsignedLong",EdfReader::UINT32},
+  {"UnsignedLongInteger",EdfReader::UINT32},{"UnsignedInteger32",EdfReader::UINT32},
+  {"Signed64",EdfReader::INT64},{"SignedInteger64",EdfReader::INT64},
+  {"Unsigned64",EdfReader::UINT64},{"UnsignedInteger64",EdfReader::UINT64},
+  {"FloatValue",EdfReader::FLOAT32},{"Float",EdfReader::FLOAT32},
+  {"Float32",EdfReader::FLOAT32},{"RealValue",EdfReader::FLOAT32},
+  {"DoubleValue",EdfReader::FLOAT64},{"Double",EdfReader::FLOAT64},
+  {"Float64",EdfReader::FLOAT64},
+  {NULL,EdfReader::UNKNOWN}};
+
+static inline unsigned int _le32(const unsigned char *p)
+{
+  return unsigned(p[0]) | (unsigned(p[1]) << 8) | (unsigned(p[2]) << 16) | (unsigned(p[3]) << 24);
+}
+
+/** @brief length of the LZ4 frame at p, 0 if it is not complete
+ *  (descriptor and block headers only, checksums are not verified)
+ */
+static size_t _lz4_frame_size(const unsigned char *p,size_t aSize)
+{
+  if(aSize < 7 || _le32(p) != LZ4_FRAME_MAGIC)
+    return 0;
+  unsigned char aFlags = p[4];
+  if((aFlags >> 6) != 1)	// version
+    return 0;
+  size_t aPos = 6 + (aFlags & 0x8 ? 8 : 0) + (aFlags & 0x1 ? 4 : 0) + 1;
+  while(1)
+    {
+      if(aPos + 4 > aSize) return 0;
+      unsigned int aBlockSize = _le32(p + aPos);
+      aPos += 4;
+      if(!aBlockSize) break;	// end mark, 0x80000000 is an empty block
+      size_t aBlockEnd = size_t(aBlockSize & 0x7fffffff) + (aFlags & 0x10 ? 4 : 0);
+      if(aBlockEnd > aSize - aPos) return 0;
+      aPos += aBlockEnd;
+    }
+  aPos += aFlags & 0x4 ? 4 : 0;	// content checksum
+  return aPos <= aSize ? aPos : 0;
+}
+
+/** @brief decode one LZ4 block after out, matches may reach back to the
+ *  start of the output (linked blocks)
+ *  @return the end of the decoded data, NULL if the block is corrupted
+ */
+static unsigned char* _lz4_block(const unsigned char *ip,const unsigned char *iend,
+				 unsigned char *outStart,unsigned char *op,unsigned char *oend)
+{
+  while(ip < iend)
+    {
+      unsigned int aToken = *ip++;
+      size_t aLength = aToken >> 4;
+      if(aLength == 15)
+	{
+	  unsigned char aByte;
+	  do
+	    {
+	      if(ip >= iend) return NULL;
+	      aByte = *ip++;
+	      aLength += aByte;
+	    }
+	  while(aByte == 255);
+	}
+      if(aLength > size_t(iend - ip) || aLength > size_t(oend - op))
+	return NULL;
+      memcpy(op,ip,aLength);
+      op += aLength,ip += aLength;
+      if(ip == iend)		// the last sequence has only literals
+	break;
+
+      if(iend - ip < 2) return NULL;
+      size_t anOffset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if(!anOffset || anOffset > size_t(op - outStart))
+	return NULL;
+      aLength = aToken & 15;
+      if(aLength == 15)
+	{
+	  unsigned char aByte;
+	  do
+	    {
+	      if(ip >= iend) return NULL;
+	      aByte = *ip++;
+	      aLength += aByte;
+	    }
+	  while(aByte == 255);
+	}
+      aLength += 4;
+      if(aLength > size_t(oend - op))
+	return NULL;
+      const unsigned char *aMatch = op - anOffset;
+      if(anOffset >= aLength)
+	memcpy(op,aMatch,aLength),op += aLength;
+      else			// overlapping copy repeats the pattern
+	for(size_t i = 0;i < aLength;++i)
+	  *op++ = *aMatch++;
+    }
+  return op;
+}
+
+static inline const char* _trim(const char *begin,const char *&end)
+{
+  while(begin < end && isspace((unsigned char)*begin)) ++begin;
+  while(end > begin && isspace((unsigned char)end[-1])) --end;
+  return begin;
+}
+
+static inline bool _is_key(const char *aKey,size_t aKeySize,const char *aName)
+{
+  return strlen(aName) == aKeySize && !strncasecmp(aKey,aName,aKeySize);
+}
+
+EdfReader::EdfReader(const char *filename) throw(LutError) :
+  _map(NULL),_size(0),_mtime(0)
+{
+  int aFd = open(filename,O_RDONLY);
+  if(aFd < 0)
+    throw LutError("EdfReader: can't open file");
+  struct stat aStat;
+  if(fstat(aFd,&aStat))
+    {
+      close(aFd);
+      throw LutError("EdfReader: can't stat file");
+    }
+  _size = aStat.st_size;
+  _mtime = (long long)aStat.st_mtim.tv_sec * 1000000000LL + aStat.st_mtim.tv_nsec;
+  if(_size)
+    {
+      void *aMap = mmap(NULL,_size,PROT_READ,MAP_SHARED,aFd,0);
+      if(aMap == MAP_FAILED)
+	{
+	  close(aFd);
+	  throw LutError("EdfReader: can't map file");
+	}
+      _map = (const unsigned char*)aMap;
+      madvise(aMap,_size,MADV_RANDOM);
+    }
+  close(aFd);			// the mapping stays valid
+
+  try
+    {
+      _index();
+    }
+  catch(...)
+    {
+      if(_map) munmap((void*)_map,_size);
+      throw;
+    }
+}
+
+EdfReader::~EdfReader()
+{
+  if(_map)
+    munmap((void*)_map,_size);
+}
+
+size_t EdfReader::type_size(data_type aType)
+{
+  static const size_t aSizes[] = {1,1,2,2,4,4,8,8,4,8,0};
+  return aType >= INT8 && aType <= UNKNOWN ? aSizes[aType] : 0;
+}
+
+/// @brief header keys of one block, false if it is not an image
+bool EdfReader::_parse_header(const char *begin,const char *end,Frame &aFrame) const
+{
+  long long aSize = -1;
+  const char *aCompression = NULL,*aCompressionEnd = NULL;
+  aFrame.nb_dims = 0;
+  aFrame.dims[0] = aFrame.dims[1] = aFrame.dims[2] = 1;
+  aFrame.type = UNKNOWN;
+  aFrame.big_endian = false;	// LowByteFirst when not given
+
+  while(begin < end)
+    {
+      const char *anEntryEnd = (const char*)memchr(begin,';',end - begin);
+      if(!anEntryEnd) anEntryEnd = end;
+      const char *anEqual = (const char*)memchr(begin,'=',anEntryEnd - begin);
+      if(anEqual)
+	{
+	  const char *aKeyEnd = anEqual;
+	  const char *aKey = _trim(begin,aKeyEnd);
+	  const char *aValueEnd = anEntryEnd;
+	  const char *aValue = _trim(anEqual + 1,aValueEnd);
+	  size_t aKeySize = aKeyEnd - aKey,aValueSize = aValueEnd - aValue;
+	  std::string aValueString(aValue,aValueSize);
+
+	  if(aKeySize == 5 && !strncasecmp(aKey,"Dim_",4) && aKey[4] >= '1' && aKey[4] <= '3')
+	    {
+	      int aDim = aKey[4] - '1';
+	      long aDimValue = strtol(aValueString.c_str(),NULL,10);
+	      if(aDimValue <= 0 || aDimValue > 0x7fffffffL)
+		return false;
+	      aFrame.dims[aDim] = int(aDimValue);
+	      if(aDim + 1 > aFrame.nb_dims) aFrame.nb_dims = aDim + 1;
+	    }
+	  else if(_is_key(aKey,aKeySize,"DataType"))
+	    {
+	      for(const _EdfType *t = _edf_types;t->name;++t)
+		if(!strcasecmp(aValueString.c_str(),t->name))
+		  {
+		    aFrame.type = t->type;
+		    break;
+		  }
+	    }
+	  else if(_is_key(aKey,aKeySize,"ByteOrder"))
+	    aFrame.big_endian = !strcasecmp(aValueString.c_str(),"HighByteFirst");
+	  else if(_is_key(aKey,aKeySize,"Size") || _is_key(aKey,aKeySize,"EDF_BinarySize"))
+	    aSize = strtoll(aValueString.c_str(),NULL,10);
+	  else if(_is_key(aKey,aKeySize,"Compression") ||
+		  _is_key(aKey,aKeySize,"DataCompression"))
+	    aCompression = aValue,aCompressionEnd = aValueEnd;
+	}
+      begin = anEntryEnd + 1;
+    }
+  if(!aFrame.nb_dims || aFrame.type == UNKNOWN)
+    return false;
+
+  aFrame.image_size = type_size(aFrame.type);
+  for(int i = 0;i < aFrame.nb_dims;++i)
+    {
+      if(aFrame.image_size > size_t(-1) / aFrame.dims[i])
+	return false;
+      aFrame.image_size *= aFrame.dims[i];
+    }
+
+  const unsigned char *aData = _map + aFrame.data_offset;
+  size_t anAvailable = _size - aFrame.data_offset;
+  bool aLz4Flag = aCompression &&
+    std::string(aCompression,aCompressionEnd - aCompression).find("LZ4") != std::string::npos;
+  aFrame.compressed = aLz4Flag ||
+    (aSize >= 0 && size_t(aSize) != aFrame.image_size &&
+     anAvailable >= 4 && _le32(aData) == LZ4_FRAME_MAGIC);
+  if(aFrame.compressed)
+    {
+      // Size may be the one of the image, the LZ4 frame tells its own
+      size_t aFrameSize = _lz4_frame_size(aData,anAvailable);
+      if(!aFrameSize)
+	aSize = anAvailable + 1; // not complete yet
+      else if(aSize < 0 || size_t(aSize) < aFrameSize || size_t(aSize) == aFrame.image_size)
+	aSize = aFrameSize;
+    }
+  else if(aSize < 0)
+    aSize = aFrame.image_size;
+  else if(size_t(aSize) < aFrame.image_size)
+    return false;
+  aFrame.data_size = size_t(aSize);
+  return true;
+}
+
+void EdfReader::_index()
+{
+  size_t anOffset = 0;
+  while(anOffset < _size)
+    {
+      const char *aText = (const char*)_map;
+      // blocks may be separated by blanks
+      while(anOffset < _size && isspace((unsigned char)aText[anOffset])) ++anOffset;
+      if(anOffset >= _size || aText[anOffset] != '{')
+	break;
+      const char *aClose = (const char*)memchr(aText + anOffset,'}',_size - anOffset);
+      if(!aClose)
+	break;			// header being written
+      const char *aDataStart = (const char*)memchr(aClose,'\n',aText + _size - aClose);
+      if(!aDataStart)
+	break;
+
+      Frame aFrame;
+      aFrame.header_offset = anOffset;
+      aFrame.data_offset = aDataStart + 1 - aText;
+      aFrame.header_size = aFrame.data_offset - anOffset;
+      if(!_parse_header(aText + anOffset + 1,aClose,aFrame))
+	{
+	  // not an image (general header), it has no data
+	  anOffset = aFrame.data_offset;
+	  continue;
+	}
+      if(aFrame.data_size > _size - aFrame.data_offset)
+	break;			// data being written
+      _frames.push_back(aFrame);
+      anOffset = aFrame.data_offset + aFrame.data_size;
+    }
+}
+
+const EdfReader::Frame& EdfReader::frame(int anIndex) const throw(LutError)
+{
+  if(anIndex < 0 || anIndex >= int(_frames.size()))
+    throw LutError("EdfReader: frame index out of range");
+  return _frames[anIndex];
+}
+
+std::string EdfReader::header(int anIndex) const throw(LutError)
+{
+  const Frame &aFrame = frame(anIndex);
+  const char *aText = (const char*)_map + aFrame.header_offset;
+  const char *aClose = (const char*)memchr(aText,'}',aFrame.header_size);
+  return std::string(aText,aClose - aText + 1);
+}
+
+const void* EdfReader::data(int anIndex) const throw(LutError)
+{
+  return _map + frame(anIndex).data_offset;
+}
+
+void EdfReader::decompress(int anIndex,void *dest,size_t aDestSize) const throw(LutError)
+{
+  const Frame &aFrame = frame(anIndex);
+  if(!aFrame.compressed)
+    throw LutError("EdfReader: frame is not compressed");
+  if(!dest || aDestSize < aFrame.image_size)
+    throw LutError("EdfReader: destination buffer too small");
+
+  const unsigned char *p = _map + aFrame.data_offset;
+  size_t aSize = _lz4_frame_size(p,aFrame.data_size);
+  if(!aSize)
+    throw LutError("EdfReader: invalid LZ4 frame");
+  unsigned char aFlags = p[4];
+  size_t aPos = 6 + (aFlags & 0x8 ? 8 : 0) + (aFlags & 0x1 ? 4 : 0) + 1;
+  unsigned char *anOut = (unsigned char*)dest,*op = anOut;
+  unsigned char *anOutEnd = anOut + aFrame.image_size;
+  while(1)
+    {
+      if(aPos + 4 > aSize)
+	throw LutError("EdfReader: invalid LZ4 frame");
+      unsigned int aBlockSize = _le32(p + aPos);
+      aPos += 4;
+      if(!aBlockSize) break;	// same end mark as _lz4_frame_size
+      bool anUncompressed = aBlockSize & 0x80000000;
+      aBlockSize &= 0x7fffffff;
+      if(size_t(aBlockSize) + (aFlags & 0x10 ? 4 : 0) > aSize - aPos)
+	throw LutError("EdfReader: invalid LZ4 frame");
+      if(anUncompressed)
+	{
+	  if(aBlockSize > size_t(anOutEnd - op))
+	    throw LutError("EdfReader: LZ4 frame larger than the image");
+	  memcpy(op,p + aPos,aBlockSize);
+	  op += aBlockSize;
+	}
+      else if(!(op = _lz4_block(p + aPos,p + aPos + aBlockSize,anOut,op,anOutEnd)))
+	throw LutError("EdfReader: corrupted LZ4 block");
+      aPos += aBlockSize + (aFlags & 0x10 ? 4 : 0);
+    }
+  if(op != anOutEnd)
+    throw LutError("EdfReader: LZ4 frame smaller than the image");
+}
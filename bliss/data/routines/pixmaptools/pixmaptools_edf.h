@@ -0,0 +1,80 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_EDF
+#define __PIXMAPTOOLS_EDF
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "pixmaptools_lut.h"
+
+/** @brief memory mapped EDF file with an index of its frames
+ *
+ *  The file is mapped and its headers parsed once at construction, then
+ *  any frame is reached in constant time and its data is read in place:
+ *  data() points into the mapping, in the byte order of the file.
+ *  A frame still being written (data beyond the end of file) is not
+ *  indexed, open the file again to see it (mtime() and size() tell if it
+ *  changed).
+ *  Frames compressed with LZ4 (Lima EDFLZ4: LZ4 frame format) are
+ *  decompressed by decompress().
+ *  The file must not be truncated while mapped.
+ */
+class EdfReader
+{
+public:
+  /// same order as the C ABI pixmaptools_dtype
+  enum data_type {INT8,UINT8,INT16,UINT16,INT32,UINT32,INT64,UINT64,
+		  FLOAT32,FLOAT64,UNKNOWN};
+
+  struct Frame
+  {
+    size_t	header_offset;	///< '{' of the header block
+    size_t	header_size;	///< up to the data
+    size_t	data_offset;
+    size_t	data_size;	///< bytes in the file, compressed or not
+    size_t	image_size;	///< bytes of the (decompressed) image
+    int		nb_dims;
+    int		dims[3];	///< Dim_1 (fastest), Dim_2, Dim_3
+    data_type	type;
+    bool	big_endian;
+    bool	compressed;	///< LZ4
+  };
+
+  explicit EdfReader(const char *filename) throw(LutError);
+  ~EdfReader();
+
+  int nb_frames() const {return int(_frames.size());}
+  const Frame& frame(int index) const throw(LutError);
+  /// @brief header text of a frame, '{' to '}' included
+  std::string header(int index) const throw(LutError);
+  /// @brief frame data in the mapping (compressed if the frame is)
+  const void* data(int index) const throw(LutError);
+  /// @brief decompress an LZ4 frame, dest holds at least image_size bytes
+  void decompress(int index,void *dest,size_t size) const throw(LutError);
+
+  /// file modification time (ns since epoch) and size when opened
+  long long mtime() const {return _mtime;}
+  size_t size() const {return _size;}
+
+  static size_t type_size(data_type);
+
+private:
+  EdfReader(const EdfReader&);
+  EdfReader& operator=(const EdfReader&);
+
+  void _index();
+  bool _parse_header(const char *begin,const char *end,Frame&) const;
+
+  const unsigned char	*_map;
+  size_t		_size;
+  long long		_mtime;
+  std::vector<Frame>	_frames;
+};
+#endif
@@ -0,0 +1,372 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_encode.h"
+#include "pixmaptools_thread.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <zlib.h>
+
+#ifdef PIXMAPTOOLS_HAVE_JPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+static const unsigned char PNG_SIGNATURE[] = {0x89,'P','N','G','\r','\n',0x1a,'\n'};
+static const size_t BAND_MIN_SIZE = 0x40000;	// filtered bytes per thread
+static const size_t BAND_MAX_SIZE = 0x40000000;	// zlib counts in 32 bits
+
+static inline void _put32(unsigned char *p,unsigned int aValue)
+{
+  p[0] = aValue >> 24,p[1] = aValue >> 16,p[2] = aValue >> 8,p[3] = aValue;
+}
+
+static void _png_chunk(std::vector<unsigned char> &out,const char *aType,
+		       const unsigned char *data,size_t aSize)
+{
+  size_t anOffset = out.size();
+  out.resize(anOffset + 12 + aSize);
+  unsigned char *p = &out[anOffset];
+  _put32(p,(unsigned int)aSize);
+  memcpy(p + 4,aType,4);
+  if(aSize) memcpy(p + 8,data,aSize);
+  _put32(p + 8 + aSize,crc32(crc32(0L,Z_NULL,0),p + 4,(uInt)(aSize + 4)));
+}
+
+// BGRA pixels -> RGB(A) bytes
+static inline void _png_row(const unsigned int *src,unsigned char *dst,int column,bool alpha)
+{
+  if(alpha)
+    for(int i = 0;i < column;++i,dst += 4)
+      {
+	unsigned int aPixel = src[i];
+	dst[0] = aPixel >> 16,dst[1] = aPixel >> 8,dst[2] = aPixel,dst[3] = aPixel >> 24;
+      }
+  else
+    for(int i = 0;i < column;++i,dst += 3)
+      {
+	unsigned int aPixel = src[i];
+	dst[0] = aPixel >> 16,dst[1] = aPixel >> 8,dst[2] = aPixel;
+      }
+}
+
+static inline unsigned char _paeth(int a,int b,int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a),pb = abs(p - b),pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  return pb <= pc ? b : c;
+}
+
+static inline int _cost(unsigned char aByte)
+{
+  return aByte < 128 ? aByte : 256 - aByte;
+}
+
+/** @brief filter one row, the filter with the smallest sum of absolute
+ *  differences wins (libpng heuristic)
+ *  @param cur,prev rows preceded by bpp zero bytes
+ *  @param dst filter byte + filtered row
+ */
+static void _png_filter(const unsigned char *cur,const unsigned char *prev,
+			unsigned char *dst,size_t aSize,int bpp)
+{
+  long aCosts[5] = {0,0,0,0,0};
+  for(size_t i = 0;i < aSize;++i)
+    {
+      int a = cur[i - bpp],b = prev[i],c = prev[i - bpp];
+      aCosts[0] += _cost(cur[i]);
+      aCosts[1] += _cost(cur[i] - a);
+      aCosts[2] += _cost(cur[i] - b);
+      aCosts[3] += _cost(cur[i] - ((a + b) >> 1));
+      aCosts[4] += _cost(cur[i] - _paeth(a,b,c));
+    }
+  int aFilter = 0;
+  for(int f = 1;f < 5;++f)
+    if(aCosts[f] < aCosts[aFilter]) aFilter = f;
+
+  *dst++ = aFilter;
+  for(size_t i = 0;i < aSize;++i)
+    {
+      int a = cur[i - bpp],b = prev[i],c = prev[i - bpp];
+      switch(aFilter)
+	{
+	case 0: dst[i] = cur[i];break;
+	case 1: dst[i] = cur[i] - a;break;
+	case 2: dst[i] = cur[i] - b;break;
+	case 3: dst[i] = cur[i] - ((a + b) >> 1);break;
+	default: dst[i] = cur[i] - _paeth(a,b,c);break;
+	}
+    }
+}
+
+struct _PngBand
+{
+  _PngBand() : begin(0),end(0),adler(0),error(NULL) {}
+  int				begin,end;	// rows
+  std::vector<unsigned char>	deflated;
+  uLong				adler;
+  const char			*error;
+};
+
+/** @brief filter and deflate bands of rows, one zlib stream cut with sync
+ *  flushes: only the last band finishes it
+ */
+struct _PngTask
+{
+  const unsigned int		*image;
+  int				column;
+  int				level;
+  bool				alpha;
+  std::vector<_PngBand>		*bands;
+
+  void operator()(int aBeginBand,int anEndBand,int)
+  {
+    for(int i = aBeginBand;i < anEndBand;++i)
+      {
+	_PngBand &aBand = (*bands)[i];
+	try
+	  {
+	    _encode(aBand,i == int(bands->size()) - 1,i == 0);
+	  }
+	catch(std::bad_alloc&)
+	  {
+	    aBand.error = "ImageEncoder: can't allocate png buffers";
+	  }
+      }
+  }
+
+  void _encode(_PngBand &aBand,bool last,bool first)
+  {
+    int bpp = alpha ? 4 : 3;
+    size_t aRowSize = size_t(column) * bpp;
+    std::vector<unsigned char> aRows(2 * (aRowSize + 4),0);
+    std::vector<unsigned char> filtered((aRowSize + 1) * (aBand.end - aBand.begin));
+    unsigned char *prev = &aRows[4],*cur = &aRows[aRowSize + 8];
+    if(aBand.begin)		// filters look at the previous row
+      _png_row(image + size_t(aBand.begin - 1) * column,prev,column,alpha);
+    unsigned char *dst = &filtered[0];
+    for(int r = aBand.begin;r < aBand.end;++r,dst += aRowSize + 1)
+      {
+	_png_row(image + size_t(r) * column,cur,column,alpha);
+	_png_filter(cur,prev,dst,aRowSize,bpp);
+	std::swap(prev,cur);
+      }
+    aBand.adler = adler32(adler32(0L,Z_NULL,0),&filtered[0],(uInt)filtered.size());
+
+    z_stream aStream;
+    memset(&aStream,0,sizeof(aStream));
+    // raw deflate, the zlib header and adler32 are written by the caller
+    if(deflateInit2(&aStream,level,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+	aBand.error = "ImageEncoder: can't initialize zlib";
+	return;
+      }
+    size_t anOffset = first ? 2 : 0; // room for the zlib header
+    aBand.deflated.resize(anOffset + deflateBound(&aStream,filtered.size()) + 16);
+    aStream.next_in = &filtered[0];
+    aStream.avail_in = (uInt)filtered.size();
+    int aFlush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    while(1)
+      {
+	aStream.next_out = &aBand.deflated[anOffset];
+	aStream.avail_out = (uInt)(aBand.deflated.size() - anOffset);
+	int aReturn = deflate(&aStream,aFlush);
+	anOffset = aBand.deflated.size() - aStream.avail_out;
+	if(aReturn == Z_STREAM_END ||
+	   (!last && aStream.avail_out && (aReturn == Z_OK || aReturn == Z_BUF_ERROR)))
+	  break;
+	if(aReturn != Z_OK && aReturn != Z_BUF_ERROR)
+	  {
+	    aBand.error = "ImageEncoder: deflate failed";
+	    break;
+	  }
+	aBand.deflated.resize(aBand.deflated.size() * 2);
+      }
+    deflateEnd(&aStream);
+    aBand.deflated.resize(anOffset);
+  }
+};
+
+void ImageEncoder::png(const unsigned int *image,int column,int row,
+		       std::vector<unsigned char> &out,
+		       int level,bool alpha) throw(LutError)
+{
+  if(!image || column <= 0 || row <= 0 ||
+     column > (std::numeric_limits<int>::max() - 1) / 4)
+    throw LutError("ImageEncoder: invalid image");
+  if(level < 0 || level > 9)
+    throw LutError("ImageEncoder: png level must be in 0..9");
+
+  size_t aStride = size_t(column) * (alpha ? 4 : 3) + 1;
+  if(aStride > BAND_MAX_SIZE)
+    throw LutError("ImageEncoder: image too wide for png");
+  size_t aBandRows = (row + Parallel::nb_threads() - 1) / Parallel::nb_threads();
+  if(aBandRows * aStride < BAND_MIN_SIZE)
+    aBandRows = (BAND_MIN_SIZE + aStride - 1) / aStride;
+  if(aBandRows * aStride > BAND_MAX_SIZE)
+    aBandRows = BAND_MAX_SIZE / aStride;
+
+  std::vector<_PngBand> bands;
+  try
+    {
+      bands.resize((row + aBandRows - 1) / aBandRows);
+      for(size_t i = 0;i < bands.size();++i)
+	{
+	  bands[i].begin = int(i * aBandRows);
+	  bands[i].end = i == bands.size() - 1 ? row : int((i + 1) * aBandRows);
+	}
+      _PngTask aTask;
+      aTask.image = image,aTask.column = column;
+      aTask.level = level,aTask.alpha = alpha;
+      aTask.bands = &bands;
+      Parallel::run(int(bands.size()),aTask,1);
+
+      uLong anAdler = bands[0].adler;
+      for(size_t i = 0;i < bands.size();++i)
+	{
+	  if(bands[i].error)
+	    throw LutError(bands[i].error);
+	  if(i)
+	    anAdler = adler32_combine(anAdler,bands[i].adler,
+				      z_off_t((bands[i].end - bands[i].begin) * aStride));
+	}
+      // zlib header (32K window, level hint) and trailer
+      unsigned char aFlags = (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+      aFlags += 31 - (0x7800 + aFlags) % 31;
+      bands.front().deflated[0] = 0x78,bands.front().deflated[1] = aFlags;
+      std::vector<unsigned char> &aLast = bands.back().deflated;
+      aLast.resize(aLast.size() + 4);
+      _put32(&aLast[aLast.size() - 4],(unsigned int)anAdler);
+
+      out.assign(PNG_SIGNATURE,PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+      unsigned char aHeader[13];
+      _put32(aHeader,column),_put32(aHeader + 4,row);
+      aHeader[8] = 8;			// bits per channel
+      aHeader[9] = alpha ? 6 : 2;	// RGBA : RGB
+      aHeader[10] = aHeader[11] = aHeader[12] = 0;
+      _png_chunk(out,"IHDR",aHeader,sizeof(aHeader));
+      for(size_t i = 0;i < bands.size();++i)
+	{
+	  _png_chunk(out,"IDAT",&bands[i].deflated[0],bands[i].deflated.size());
+	  std::vector<unsigned char>().swap(bands[i].deflated);
+	}
+      _png_chunk(out,"IEND",NULL,0);
+    }
+  catch(std::bad_alloc&)
+    {
+      throw LutError("ImageEncoder: can't allocate png buffers");
+    }
+}
+
+#ifdef PIXMAPTOOLS_HAVE_JPEG
+struct _JpegError
+{
+  struct jpeg_error_mgr	mgr;
+  jmp_buf		jump;
+  char			message[JMSG_LENGTH_MAX];
+};
+
+// libjpeg default handler exits the process
+static void _jpeg_error_exit(j_common_ptr cinfo)
+{
+  _JpegError *anError = (_JpegError*)cinfo->err;
+  (*cinfo->err->format_message)(cinfo,anError->message);
+  longjmp(anError->jump,1);
+}
+
+bool ImageEncoder::has_jpeg()
+{
+  return true;
+}
+
+void ImageEncoder::jpeg(const unsigned int *image,int column,int row,
+			std::vector<unsigned char> &out,int quality) throw(LutError)
+{
+  if(!image || column <= 0 || row <= 0 || column > JPEG_MAX_DIMENSION || row > JPEG_MAX_DIMENSION)
+    throw LutError("ImageEncoder: invalid image");
+  if(quality < 1 || quality > 100)
+    throw LutError("ImageEncoder: jpeg quality must be in 1..100");
+
+#if defined(JCS_EXTENSIONS) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // libjpeg-turbo reads BGRA pixels as they are
+  unsigned char *aRow = NULL;
+#else
+  unsigned char *aRow = (unsigned char*)malloc(size_t(column) * 3);
+  if(!aRow)
+    throw LutError("ImageEncoder: can't allocate jpeg row");
+#endif
+  struct jpeg_compress_struct cinfo;
+  _JpegError anError;
+  unsigned char *aBuffer = NULL;
+  unsigned long aSize = 0;
+
+  cinfo.err = jpeg_std_error(&anError.mgr);
+  anError.mgr.error_exit = _jpeg_error_exit;
+  if(setjmp(anError.jump))
+    {
+      jpeg_destroy_compress(&cinfo);
+      free(aBuffer);
+      free(aRow);
+      throw LutError(anError.message);
+    }
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo,&aBuffer,&aSize);
+  cinfo.image_width = column;
+  cinfo.image_height = row;
+#if defined(JCS_EXTENSIONS) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  cinfo.input_components = 4;
+  cinfo.in_color_space = JCS_EXT_BGRX;
+#else
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+#endif
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo,quality,TRUE);
+  jpeg_start_compress(&cinfo,TRUE);
+  while(cinfo.next_scanline < cinfo.image_height)
+    {
+      const unsigned int *aSrc = image + size_t(cinfo.next_scanline) * column;
+      JSAMPROW aRowPointer;
+      if(aRow)
+	{
+	  _png_row(aSrc,aRow,column,false);
+	  aRowPointer = aRow;
+	}
+      else
+	aRowPointer = (JSAMPROW)aSrc;
+      jpeg_write_scanlines(&cinfo,&aRowPointer,1);
+    }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  free(aRow);
+  try
+    {
+      out.assign(aBuffer,aBuffer + aSize);
+    }
+  catch(std::bad_alloc&)
+    {
+      free(aBuffer);
+      throw LutError("ImageEncoder: can't allocate jpeg buffer");
+    }
+  free(aBuffer);
+}
+#else
+bool ImageEncoder::has_jpeg()
+{
+  return false;
+}
+
+void ImageEncoder::jpeg(const unsigned int*,int,int,
+			std::vector<unsigned char>&,int) throw(LutError)
+{
+  throw LutError("ImageEncoder: built without jpeg support");
+}
+#endif
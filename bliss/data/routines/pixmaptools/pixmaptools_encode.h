@@ -0,0 +1,42 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_ENCODE
+#define __PIXMAPTOOLS_ENCODE
+
+#include <vector>
+#include "pixmaptools_lut.h"
+
+/** @brief PNG and JPEG encoding of mapped images (thumbnails, web pages)
+ *
+ *  Input is what LUT::map and LUT::raw_video_2_image produce with a BGRX
+ *  palette: column * row 32 bits pixels 0xAARRGGBB, so a colormapped frame
+ *  is encoded without any intermediate conversion.
+ *
+ *  PNG: rows are split in bands, each band is filtered (adaptive filter
+ *  per row, as libpng does) and deflated in its own thread, bands are
+ *  joined with a zlib sync flush and written as one IDAT chunk each.
+ *  Low levels (1 by default) are meant for fast thumbnails.
+ *
+ *  JPEG: needs libjpeg (libjpeg-turbo preferably), the library is built
+ *  with it when PIXMAPTOOLS_HAVE_JPEG is defined, see has_jpeg().
+ */
+class ImageEncoder
+{
+public:
+  /// @brief encoded data replaces the content of out
+  static void png(const unsigned int *image,int column,int row,
+		  std::vector<unsigned char> &out,
+		  int level = 1,bool alpha = false) throw(LutError);
+
+  static bool has_jpeg();
+  /// @param quality 1 to 100
+  static void jpeg(const unsigned int *image,int column,int row,
+		   std::vector<unsigned char> &out,int quality = 85) throw(LutError);
+};
+#endif
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 
 #include <pixmaptools_io.h>
+#include <pixmaptools_timing.h>
 #include "qpainter.h"
 
 #ifdef HAVE_X
@@ -174,6 +175,7 @@ void IO::putImage(QPixmap *dst, const QPoint &offset,
 
 void IO::putImage(QPixmap *dst, int dx, int dy, const QImage *src)
 {
+  Timing::Scope aTiming(Timing::PUT_IMAGE);
 #ifdef HAVE_MITSHM
   int size = src->width() * src->height();
   if (m_bShm && (src->depth() > 1) && (d->bpp > 8) && (size > d->threshold))
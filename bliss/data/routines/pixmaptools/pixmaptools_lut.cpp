@@ -1,5 +1,9 @@
 #include "pixmaptools_lut.h"
+#include "pixmaptools_thread.h"
+#include "pixmaptools_cpu.h"
+#include "pixmaptools_timing.h"
 #include <cmath>
+#include <limits>
 #include <iostream>
 
 template<class IN> static void _find_min_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax);
@@ -35,7 +39,7 @@ template<class IN> static void _log_data_map(const IN *data,
 template<class IN> static void _log_data_map_shift(const IN *data,
     unsigned int *anImagePt,int column,int line,
     unsigned int *aPalette,double A,double B,
-    IN dataMin,IN dataMax,IN shift) throw();
+    IN dataMin,IN dataMax,double shift) throw();
 
 struct LUT::XServer_Info {
   int byte_order;
@@ -327,6 +331,9 @@ void LUT::Palette::_calcPalette(unsigned int palette[],int fmin, int fmax,
   else
     for(int j = fmin;pal <= palend && j <= fmax;++j,++pal)
       *pal = *(_dataPalette + int(A * theLutConfiguration.log(j) + B));
+  // values >= dataMax always get the top of the palette (rounding of A * fmax + B)
+  if(fmax >= 0)
+    *(palette + fmax) = *(_dataPalette + 0xffff);
 }
 
 // LUT TEMPLATE
@@ -381,12 +388,15 @@ template<class IN> void LUT::map_on_plus_minus_sigma(const IN *data,unsigned int
     _find_minpos_max(data,column * row,dataMin,dataMax);
   _get_average_std(data,column * row,anAverage,aStd) ;
   double tmpMin4LookUp = anAverage - aSigmaFactor * aStd;
-  dataMinUse4LookUp = IN(tmpMin4LookUp);
+  double tmpMax4LookUp = anAverage + aSigmaFactor * aStd;
+  // clip before the conversion, out of range conversion is undefined (unsigned)
+  if(tmpMin4LookUp < double(dataMin)) dataMinUse4LookUp = dataMin;
+  else dataMinUse4LookUp = IN(tmpMin4LookUp);
 
-  if(tmpMin4LookUp < 0. && dataMinUse4LookUp > 0) dataMinUse4LookUp = 0; // FOR UNSIGNED
-  if(dataMinUse4LookUp < dataMin) dataMinUse4LookUp = dataMin;
-
-  dataMaxUse4LookUp = IN(anAverage + aSigmaFactor * aStd);
+  if(tmpMax4LookUp > double(std::numeric_limits<IN>::max()))
+    dataMaxUse4LookUp = std::numeric_limits<IN>::max();
+  else
+    dataMaxUse4LookUp = IN(tmpMax4LookUp);
   map(data,anImagePt,column,row,aPalette,aMeth,dataMinUse4LookUp,dataMaxUse4LookUp);
 }
 /** @brief calculate the average and the standard deviation
@@ -454,16 +464,12 @@ static void _get_average_std_min_max(const IN *aData,int aNbValue,
  */
 template<class IN> static void _find_min_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax)
 {
-  dataMax = dataMin = *aData;++aData;
-  for(int i = 1;i < aNbValue;++i,++aData)
-    {
-      if(*aData > dataMax) dataMax = *aData;
-      else if(*aData < dataMin) dataMin = *aData;
-    }
+  CpuKernels<IN>::min_max(aData,aNbValue,dataMin,dataMax);
 }
 
 template<class IN> static void _find_minpos_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax)
 {
+  for(;aNbValue > 1 && *aData != *aData;--aNbValue) ++aData;
   dataMax = *aData;
   if(*aData > 0) dataMin = *aData;
   else dataMin = 0;
@@ -471,7 +477,7 @@ template<class IN> static void _find_minpos_max(const IN *aData,int aNbValue,IN
   for(int i = 1;i < aNbValue;++i,++aData)
     {
       if(*aData > dataMax) dataMax = *aData;
-      else if(*aData > 0. && (*aData < dataMin || dataMin == 0)) dataMin = *aData;
+      if(*aData > 0. && (*aData < dataMin || dataMin == 0)) dataMin = *aData;
     }
 }
 template<class IN> void __attribute__ ((used)) LUT::map(const IN *data,
@@ -480,6 +486,14 @@ template<class IN> void __attribute__ ((used)) LUT::map(const IN *data,
 							LUT::mapping_meth aMeth,
 							IN dataMin,IN dataMax)
 {
+  if(!(dataMin < dataMax))	// empty range (or NaN), only two colors
+    {
+      Timing::Scope aTiming(Timing::MAPPING);
+      unsigned int aBottom = aPalette._dataPalette[0],aTop = aPalette._dataPalette[0xffff];
+      for(const IN *dataEnd = data + column * line;data != dataEnd;++data,++anImagePt)
+	*anImagePt = *data >= dataMax ? aTop : aBottom;
+      return;
+    }
   unsigned int aCachePalette[0x10000];
   unsigned int *aUsePalette;
   if(sizeof(IN) > sizeof(short))
@@ -494,9 +508,11 @@ template<class IN> void __attribute__ ((used)) LUT::map(const IN *data,
 	  aFmin = 0;
 	}
       if(aFmax > 0xffff) aFmax = 0xffff;
+      Timing::Scope aTiming(Timing::PALETTE);
       aPalette._calcPalette(aUsePalette,aFmin,aFmax,aMeth);
       aMeth = LINEAR;
     }
+  Timing::Scope aTiming(Timing::MAPPING);
   _data_map(data,anImagePt,column,line,aMeth,aUsePalette,dataMin,dataMax);
 }
 
@@ -509,8 +525,8 @@ template<class IN> static void _data_map(const IN *data,unsigned int *anImagePt,
 
   double A, B;
   double lmin,lmax;
-  IN shift = 0;
-  if ((dataMax-dataMin) != 0) 
+  double shift = 0.;		// in double, can't overflow IN
+  if (dataMax != dataMin) 
     {
       if (aMeth == LUT::LINEAR)
 	{
@@ -519,29 +535,34 @@ template<class IN> static void _data_map(const IN *data,unsigned int *anImagePt,
 	}
       else if(aMeth == LUT::SHIFT_LOG)
 	{
-
-	  if(dataMin <= 0)
+	  if(dataMin <= 0)	// shifted range start at 1
 	    {
-	      shift = -dataMin;
-	      if(shift < 1e-6) shift += IN(1);
-	      dataMax += shift;
-	      dataMin += shift;
+	      shift = 1. - double(dataMin);
+	      lmin = 0.;
 	    }
-	  lmin = log10(dataMin);
-	  lmax = log10(dataMax);
+	  else
+	    lmin = log10(double(dataMin));
+	  lmax = log10(double(dataMax) + shift);
 	}
       else
 	{
 	  if(dataMin == 0)
 	    dataMin = IN(1);
 	  else if(dataMin <= 0)
-	    dataMin = IN(1e-6);
-
-	  lmin = log10(dataMin);
-	  lmax = log10(dataMax);
+	    {
+	      dataMin = IN(1e-6);
+	      if(dataMin <= 0) dataMin = IN(1); // integer
+	    }
+	  lmin = log10(double(dataMin));
+	  lmax = log10(double(dataMax));
 	}
       A = (mapmax - mapmin) / (lmax - lmin);
-      B = mapmin - ((mapmax - mapmin) * lmin) / (lmax-lmin);
+      B = mapmin - A * lmin;	// no overflow of (mapmax - mapmin) * lmin
+      if(!std::isfinite(lmax - lmin) || !std::isfinite(A) || !std::isfinite(B)) // infinite range
+	{
+	  A = B = 0.;
+	  aMeth = LUT::LINEAR,shift = 0.;
+	}
     }
   else 
     {
@@ -552,7 +573,7 @@ template<class IN> static void _data_map(const IN *data,unsigned int *anImagePt,
     _linear_data_map(data,anImagePt,column,line,aPalette,A,B,dataMin,dataMax);
   else
     {
-      if(shift < 1e-6)
+      if(shift == 0.)
 	_log_data_map(data,anImagePt,column,line,aPalette,A,B,dataMin,dataMax);
       else
 	_log_data_map_shift(data,anImagePt,column,line,aPalette,A,B,dataMin,dataMax,shift);
@@ -562,21 +583,22 @@ template<class IN> static void _data_map(const IN *data,unsigned int *anImagePt,
 // LINEAR MAPPING FCT
 
 template<class IN> static void _linear_data_map(const IN *data,unsigned int *anImagePt,int column,int line,
-						unsigned int *palette,double A,double B,
+						unsigned int *palette,double A,double,
 						IN dataMin,IN dataMax) throw()
 {
-  int aNbPixel = column * line;
-  unsigned int *anImageEnd = anImagePt + aNbPixel;
-    for(;anImagePt != anImageEnd;++anImagePt,++data)
-    {
-       IN val=*data;
-       if (val >= dataMax) 
- 	*anImagePt = *(palette + 0xffff);
-       else if  (val > dataMin)
-	 *anImagePt = *(palette + long(A * val + B));
-       else  
-	 *anImagePt = *palette; 
-    }
+  // A * (val - dataMin) rather than A * val + B, no cancellation on big values
+  CpuKernels<IN>::linear_map(data,anImagePt,column * line,palette,A,dataMin,dataMax);
+}
+
+///@brief 8 and 16 bits types index the palette with the value
+template<class IN> static void _lut_data_map(const IN *data,unsigned int *anImagePt,int column,int line,
+					     unsigned int *palette,IN dataMin,IN dataMax) throw()
+{
+  // the palette is calculated from 0 when dataMin < 0 (@see LUT::map)
+  const unsigned int *lut = palette;
+  int lowIndex = 0;
+  if(dataMin < 0) lut -= dataMin,lowIndex = dataMin;
+  CpuKernels<IN>::lut_map(data,anImagePt,column * line,lut,lowIndex,dataMin,dataMax);
 }
 
 ///@brief opti for unsigned short
@@ -584,17 +606,7 @@ template<> void _linear_data_map(unsigned short const *data,unsigned int *anImag
 					unsigned int *palette,double,double,
 					unsigned short dataMin,unsigned short dataMax) throw()
 {
-  int aNbPixel = column * line;
-  unsigned int *anImageEnd = anImagePt + aNbPixel;
-  for(;anImagePt != anImageEnd;++anImagePt,++data)
-    {
-      if(*data >= dataMax)
-	*anImagePt = *(palette + dataMax);
-      else if(*data > dataMin)
-	*anImagePt = *(palette + *data);
-      else
-	*anImagePt = *palette;
-    }
+  _lut_data_map(data,anImagePt,column,line,palette,dataMin,dataMax);
 }
 
 ///@brief opti for short
@@ -602,18 +614,7 @@ template<> void _linear_data_map(const short *data,unsigned int *anImagePt,int c
 					unsigned int *palette,double,double,
 					short dataMin,short dataMax) throw()
 {
-  palette += long(ceil((dataMax - dataMin) / 2.));
-  int aNbPixel = column * line;
-  unsigned int *anImageEnd = anImagePt + aNbPixel;
-  for(;anImagePt != anImageEnd;++anImagePt,++data)
-    {
-      if(*data >= dataMax)
-	*anImagePt = *(palette + dataMax);
-      else if(*data > dataMin)
-	*anImagePt = *(palette + *data);
-      else
-	*anImagePt = *palette;
-    }
+  _lut_data_map(data,anImagePt,column,line,palette,dataMin,dataMax);
 }
 
 ///@brief opti for char
@@ -621,35 +622,14 @@ template<> void _linear_data_map(const char *data,unsigned int *anImagePt,int co
 					unsigned int *palette,double,double,
 					char dataMin,char dataMax) throw()
 {
-  palette += long(ceil((dataMax - dataMin) / 2.));
-  int aNbPixel = column * line;
-  unsigned int *anImageEnd = anImagePt + aNbPixel;
-  for(;anImagePt != anImageEnd;++anImagePt,++data)
-    {
-      if(*data >= dataMax)
-	*anImagePt = *(palette + dataMax);
-      else if(*data > dataMin)
-	*anImagePt = *(palette + *data);
-      else
-	*anImagePt = *palette;
-    }
+  _lut_data_map(data,anImagePt,column,line,palette,dataMin,dataMax);
 }
 ///@brief opti for unsigned char
 template<> void _linear_data_map(unsigned char const *data,unsigned int *anImagePt,int column,int line,
 					unsigned int *palette,double,double,
 					unsigned char dataMin,unsigned char dataMax) throw()
 {
-  int aNbPixel = column * line;
-  unsigned int *anImageEnd = anImagePt + aNbPixel;
-  for(;anImagePt != anImageEnd;++anImagePt,++data)
-    {
-      if(*data >= dataMax)
-	*anImagePt = *(palette + dataMax);
-      else if(*data > dataMin)
-	*anImagePt = *(palette + *data);
-      else
-	*anImagePt = *palette;
-    }
+  _lut_data_map(data,anImagePt,column,line,palette,dataMin,dataMax);
 }
 template<class IN> static void _log_data_map(const IN *data,unsigned int *anImagePt,int column,int line,
 					     unsigned int *aPalette,double A,double B,
@@ -664,7 +644,10 @@ template<class IN> static void _log_data_map(const IN *data,unsigned int *anImag
       if (val >= dataMax)
 	*anImagePt = *(palette + 0xffff) ;
       else if  (val > dataMin)
-	*anImagePt = *(palette + long(A * log10(val) + B));
+	{
+	  double pos = A * log10(val) + B;
+	  *anImagePt = *(palette + (pos > 0. ? (pos < 65535. ? long(pos) : 0xffff) : 0));
+	}
       else
 	*anImagePt = *palette ;
     }
@@ -672,7 +655,7 @@ template<class IN> static void _log_data_map(const IN *data,unsigned int *anImag
 
 template<class IN> static void _log_data_map_shift(const IN *data,unsigned int *anImagePt,int column,int line,
 						   unsigned int *aPalette,double A,double B,
-						   IN dataMin,IN dataMax,IN shift) throw()
+						   IN dataMin,IN dataMax,double shift) throw()
 {
   int aNbPixel = column * line;
   register unsigned int *anImageEnd = anImagePt + aNbPixel;
@@ -680,11 +663,14 @@ template<class IN> static void _log_data_map_shift(const IN *data,unsigned int *
   for(;anImagePt != anImageEnd;++anImagePt,++data)
     {
       IN val=*data;
-      val += shift;
       if (val >= dataMax)
 	*anImagePt = *(palette + 0xffff) ;
       else if  (val > dataMin)
-	*anImagePt = *(palette + long(A * log10(val) + B));
+	{
+	  // val + shift may be rounded below 1 (or to dataMax + shift)
+	  double pos = A * log10(double(val) + shift) + B;
+	  *anImagePt = *(palette + (pos > 0. ? (pos < 65535. ? long(pos) : 0xffff) : 0));
+	}
       else
 	*anImagePt = *palette;
     }
@@ -854,33 +840,10 @@ inline void _rgb_2_image(const unsigned char *data,
 			 int bandes,
 			 bool scalingFlag)
 {
+  float A = 1.,B = 0.;
   if(scalingFlag)
-    {
-      float A,B;
-      _get_linear_factor(mValue,MValue,0.,219.,A,B);
-      for(int aSize = column * row;aSize;--aSize,data += bandes,++anImagePt)
-	{
-	  int red = int(data[0] * A + B);
-	  int green = int(data[1] * A + B);
-	  int blue = int(data[2] * A + B);
-
-	  if(red > 255) red = 255;
-	  else if(red < 0) red = 0;
-
-	  if(green > 255) green = 255;
-	  else if(green < 0) green = 0;
-
-	  if(blue > 255) blue = 255;
-	  else if(blue < 0) blue = 0;
-
-	  *anImagePt = 0xff000000 | (red << 16) | (green << 8) | blue;
-	}
-    }
-  else
-    {
-      for(int aSize = column * row;aSize;--aSize,data += bandes,++anImagePt)
-	*anImagePt = 0xff000000 | (data[0] << 16) | (data[1] << 16) | data[2] << 8;
-    }
+    _get_linear_factor(mValue,MValue,0.,219.,A,B);
+  Cpu::rgb_2_image[0][bandes == 4](data,anImagePt,column * row,scalingFlag,A,B);
 }
 inline void _bgr_2_luma(const unsigned char *data,unsigned char *luma,
 			int column,int row,int bandes)
@@ -896,33 +859,10 @@ inline void _bgr_2_image(const unsigned char *data,
 			 int bandes,
 			 bool scalingFlag)
 {
+  float A = 1.,B = 0.;
   if(scalingFlag)
-    {
-      float A,B;
-      _get_linear_factor(mValue,MValue,0.,219.,A,B);
-      for(int aSize = column * row;aSize;--aSize,data += bandes,++anImagePt)
-	{
-	  int red = int(data[0] * A + B);
-	  int green = int(data[1] * A + B);
-	  int blue = int(data[2] * A + B);
-
-	  if(red > 255) red = 255;
-	  else if(red < 0) red = 0;
-
-	  if(green > 255) green = 255;
-	  else if(green < 0) green = 0;
-
-	  if(blue > 255) blue = 255;
-	  else if(blue < 0) blue = 0;
-
-	  *anImagePt = 0xff000000 | (red << 16) | (green << 8) | blue;
-	}
-    }
-  else
-    {
-      for(int aSize = column * row;aSize;--aSize,data += bandes,++anImagePt)
-	*anImagePt = 0xff000000 | (data[3] << 16) | (data[1] << 8) | data[0];
-    }
+    _get_linear_factor(mValue,MValue,0.,219.,A,B);
+  Cpu::rgb_2_image[1][bandes == 4](data,anImagePt,column * row,scalingFlag,A,B);
 }
 
 template<class IN>
@@ -932,6 +872,11 @@ inline void _bayer_2_luma(const IN* bayer0,IN* luma,
   int luma_step = column * sizeof(IN);
   int bayer_step = column;
   IN *luma0 = (IN*)luma;
+  if(row < 3 || column < 3)	// only border
+    {
+      memset(luma0,0,luma_step * row);
+      return;
+    }
   memset( luma0, 0, luma_step);
   memset( luma0 + (row - 1)*column, 0, luma_step);
   luma0 += column + 1;
@@ -954,7 +899,7 @@ inline void _bayer_2_luma(const IN* bayer0,IN* luma,
         {
 	  t0 = (bayer[1] + bayer[bayer_step*2+1] + 1) >> 1;
 	  t1 = (bayer[bayer_step] + bayer[bayer_step+2] + 1) >> 1;
-	  if(blue < -1)
+	  if(blue < 0)
 	    *dst = (bayer[bayer_step+1] * 150 + t0 * 29 + t1 * 76) >> 8;
 	  else
 	    *dst = (bayer[bayer_step+1] * 150 + t1 * 29 + t0 * 76) >> 8;
@@ -1039,26 +984,28 @@ inline void _bayer_bg_2_luma(const IN* bayer0,IN* luma,
       T2 = t2 * A + B;				\
       if(T0 > 255 || T1 > 255 || T2 > 255)	\
 	{					\
-	  if(T0 > T1 && T0 > T2)		\
+	  /* highest component before scaling	\
+	     (scaled ones may be rounded equal) */ \
+	  if(t0 > t1 && t0 > t2)		\
 	    {					\
 	      double nA = (255. - B) / t0;	\
 	      T0 = 255;				\
-	      T1 = t1 * nA + B;			\
-	      T2 = t2 * nA + B;			\
+	      T1 = t1 * nA + B + .5;		\
+	      T2 = t2 * nA + B + .5;		\
 	    }					\
-	  else if(T1 > T2)			\
+	  else if(t1 > t2)			\
 	    {					\
 	      double nA = (255. - B) / t1;	\
 	      T1 = 255;				\
-	      T0 = t0 * nA + B;			\
-	      T2 = t2 * nA + B;			\
+	      T0 = t0 * nA + B + .5;		\
+	      T2 = t2 * nA + B + .5;		\
 	    }					\
 	  else					\
 	    {					\
 	      double nA = (255. - B) / t2;	\
 	      T2 = 255;				\
-	      T0 = t0 * nA + B;			\
-	      T1 = t1 * nA + B;			\
+	      T0 = t0 * nA + B + .5;		\
+	      T1 = t1 * nA + B + .5;		\
 	    }					\
 	}					\
       if(T0 < 0) T0 = 0;			\
@@ -1079,8 +1026,15 @@ template<class IN>
   int dst_step = 4 * column;
   int bayer_step = column;
   unsigned char *dst0 = (unsigned char*)anImagePt;
-  memset( dst0, 0, dst_step);
-  memset( dst0 + (row - 1)*dst_step, 0, dst_step);
+  // border pixels are opaque black
+  unsigned int *border = (unsigned int*)anImagePt;
+  if(row < 3 || column < 3)
+    {
+      for(int i = column * row;i;--i,++border) *border = 0xff000000;
+      return;
+    }
+  for(int i = 0;i < column;++i)
+    border[i] = border[(row - 1) * column + i] = 0xff000000;
   dst0 += dst_step + 4 + 1;
   row -= 2;
   column -= 2;
@@ -1092,10 +1046,9 @@ template<class IN>
       unsigned char* dst = dst0;
       const IN* bayer_end = bayer + column;
 
-      dst[2] = ALPHA;
-      dst[-5] = dst[-4] = dst[-3] = dst[dst_step-1] =
-	dst[dst_step] = dst[dst_step+1] = 0;
-      dst[dst_step+2] = ALPHA;
+      dst[-5] = dst[-4] = dst[-3] = dst[4*column-1] =
+	dst[4*column] = dst[4*column+1] = 0;
+      dst[-2] = dst[4*column+2] = ALPHA;
 
       if(column <= 0 )
 	continue;
@@ -1123,7 +1076,7 @@ template<class IN>
 		    bayer[bayer_step*2+2] + 2) >> 2;
 	      t1 = (bayer[1] + bayer[bayer_step] +
 		    bayer[bayer_step+2] + bayer[bayer_step*2+1]+2) >> 2;
-	      t2 = uchar(bayer[bayer_step+1]);
+	      t2 = bayer[bayer_step+1];
 	      SCALE();
 
 	      dst[-1] = uchar(t2); //blue
@@ -1224,8 +1177,9 @@ inline void _bayer_rg_2_image(const IN *bayer0,
 	  IN mValue,MValue;
 	  _find_min_max(bayer0,column * row,mValue,MValue);
 	  int n,nbshift;
-	  for(n = 1,nbshift = 0;n < MValue;n <<= 1,++nbshift);
+	  for(n = 1,nbshift = 0;n <= MValue;n <<= 1,++nbshift);
 	  nbshift -= 8;
+	  if(nbshift < 0) nbshift = 0;
 	  uchar *bayer;
 	  _alloc(bayer,column,row,1);
 	  uchar *endbayer = bayer + (column * row);
@@ -1264,8 +1218,9 @@ inline void _bayer_bg_2_image(const IN *bayer0,
 	  IN mValue,MValue;
 	  _find_min_max(bayer0,column * row,mValue,MValue);
 	  int n,nbshift;
-	  for(n = 1,nbshift = 0;n < MValue;n <<= 1,++nbshift);
+	  for(n = 1,nbshift = 0;n <= MValue;n <<= 1,++nbshift);
 	  nbshift -= 8;
+	  if(nbshift < 0) nbshift = 0;
 	  uchar *bayer;
 	  _alloc(bayer,column,row,1);
 	  uchar *endbayer = bayer + (column * row);
@@ -1417,10 +1372,8 @@ inline void _yuv422_packed_2_image(const unsigned char* data,
     }
     else{
         long nb_iter = column * row / 2;
-        if(nb_iter > 0)
-            --nb_iter;
-
-        for(const unsigned char *src = data ; nb_iter ; --nb_iter,src += 4) {
+        const unsigned char *src = data;
+        for( ; nb_iter ; --nb_iter,src += 4) {
             unsigned char U  = src[0];
             unsigned char y0 = src[1];
             unsigned char V  = src[2];
@@ -1434,12 +1387,15 @@ inline void _yuv422_packed_2_image(const unsigned char* data,
             _YUV422_PACKED_BRGA(y0, anImagePt); ++anImagePt;
             _YUV422_PACKED_BRGA(y1, anImagePt); ++anImagePt;
         }
+        if((column * row) & 1)	// last pixel has no V
+            *anImagePt = 0xff000000 | (src[1] << 16) | (src[1] << 8) | src[1];
     }
 }
 
 inline unsigned char* _calculate_luma(const unsigned char *data,
                                       int column,int row,LUT::Scaling::image_type aType)
 {
+  long long aStart = Timing::enabled() ? Timing::now() : -1;
   unsigned char *lumaPt = NULL;
   //creation of luma data if need
   switch(aType)
@@ -1487,39 +1443,10 @@ inline unsigned char* _calculate_luma(const unsigned char *data,
     default:
       break;
     }
+  if(lumaPt && aStart >= 0)	// only time the frames which need a luma
+    Timing::record(Timing::LUMA,Timing::now() - aStart);
   return lumaPt;
 }
-  //Local lock
-class _Lock
-{
-public:
-  _Lock(pthread_mutex_t *aMutex,bool lockFlag = true) :
-    _mutex(aMutex),_locked(false)
-  {
-    if(lockFlag)
-      lock();
-  }
-  ~_Lock() {unlock();}
-
-  inline void lock() 
-  {
-    if(!_locked)
-      while(pthread_mutex_lock(_mutex));
-    _locked = true;
-  }
-  
-  inline void unlock()
-  {
-    if(_locked)
-      {
-	_locked = false;
-	pthread_mutex_unlock(_mutex);
-      }
-  }
-private:
-  pthread_mutex_t *_mutex;
-  bool		  _locked;
-};
   //Luma class
 struct LUT::Scaling::luma
 {
@@ -1554,6 +1481,7 @@ LUT::Scaling::Scaling() :
 
 LUT::Scaling::~Scaling()
 {
+  delete _Luma;
   pthread_mutex_destroy(&_lock);
 }
 
@@ -1602,6 +1530,7 @@ void LUT::Scaling::set_palette_mapping_meth(LUT::mapping_meth meth)
 void LUT::Scaling::autoscale_min_max(const unsigned char *data,
 				     int column,int row,image_type aType)
 {
+  Timing::Scope aTiming(Timing::AUTOSCALE);
   unsigned char *lumaPt = _calculate_luma(data,column,row,aType);
   //find min max
   int minVal = -1,maxVal = -1;
@@ -1677,6 +1606,7 @@ void LUT::Scaling::autoscale_plus_minus_sigma(const unsigned char *data,int colu
 					      image_type aType,
 					      double aSigmaFactor)
 {
+  Timing::Scope aTiming(Timing::AUTOSCALE);
   unsigned char *lumaPt = _calculate_luma(data,column,row,aType);
   double meanValue = -1.,std = 1.;
   double minVal = 0.,maxVal = 0.;
@@ -1743,6 +1673,46 @@ void LUT::Scaling::_get_minmax_and_mode(double &minVal,double &maxVal,
   minVal = _minValue,maxVal = _maxValue;
   aMode = _mode;
 }
+/** @brief bytes of a raw video frame
+ *  @return 0 if the type or the size is not supported
+ */
+size_t LUT::raw_video_size(int column,int row,LUT::Scaling::image_type aType)
+{
+  if(column <= 0 || row <= 0 || column > std::numeric_limits<int>::max() / row)
+    return 0;
+  size_t aNbPixel = size_t(column) * row;
+  switch(aType)
+    {
+    case LUT::Scaling::Y8:
+    case LUT::Scaling::BAYER_RG8:
+    case LUT::Scaling::BAYER_BG8:
+    case LUT::Scaling::YUV411:	// luma plane only
+    case LUT::Scaling::YUV422:
+    case LUT::Scaling::YUV444:
+      return aNbPixel;
+    case LUT::Scaling::Y16:
+    case LUT::Scaling::RGB555:
+    case LUT::Scaling::RGB565:
+    case LUT::Scaling::BAYER_RG16:
+    case LUT::Scaling::BAYER_BG16:
+    case LUT::Scaling::YUV422PACKED:
+      return aNbPixel * 2;
+    case LUT::Scaling::RGB24:
+    case LUT::Scaling::BGR24:
+      return aNbPixel * 3;
+    case LUT::Scaling::Y32:
+    case LUT::Scaling::RGB32:
+    case LUT::Scaling::BGR32:
+      return aNbPixel * 4;
+    case LUT::Scaling::Y64:
+      return aNbPixel * 8;
+    case LUT::Scaling::I420:	// chroma planes subsampled by 2, even sizes only
+      return (column & 1) || (row & 1) ? 0 : aNbPixel + (aNbPixel >> 1);
+    default:
+      return 0;
+    }
+}
+
 /** @brief tranform raw video image to BGRA image.
  *  Scaling instance has to be set with the same type of data.
  *  @see Scaling::autoscale_min_max
@@ -1753,6 +1723,7 @@ bool LUT::raw_video_2_image(const unsigned char *data,unsigned int *anImagePt,
 			    int column,int row,
 			    LUT::Scaling::image_type anImageType,Scaling &aScaling)
 {
+  Timing::Scope aTiming(Timing::DECODE);
   double minValue,maxValue;
   LUT::Scaling::mode aMode;
   aScaling._get_minmax_and_mode(minValue,maxValue,aMode);
@@ -1762,24 +1733,14 @@ bool LUT::raw_video_2_image(const unsigned char *data,unsigned int *anImagePt,
     {
     case LUT::Scaling::Y8:
       if(aMode == LUT::Scaling::UNACTIVE)
-	{
-	  for(int aNbPixel = column * row;aNbPixel;--aNbPixel,++data,++anImagePt)
-	    *anImagePt = 0xff000000 | (*data << 16) | (*data << 8) | *data;
-	}
+	Cpu::y8_2_image(data,anImagePt,column * row);
       else
 	LUT::map(data,anImagePt,column,row,aScaling._Luma->_palette,
 		 aScaling._Luma->_palette_mapping_meth,uchar(minValue),uchar(maxValue));
       break;
     case LUT::Scaling::Y16:
       if(aMode == LUT::Scaling::UNACTIVE)
-	{
-	  const unsigned short *pixelPt = (const unsigned short*)data;
-	  for(int aNbPixel = column * row;aNbPixel;--aNbPixel,++pixelPt,++anImagePt)
-	    {
-	      int aValue = *pixelPt >> 8;
-	      *anImagePt = 0xff000000 | (aValue << 16) | (aValue << 8) | aValue;
-	    }
-	}
+	Cpu::y16_2_image((const unsigned short*)data,anImagePt,column * row);
       else
 	LUT::map((unsigned short*)data,anImagePt,column,row,aScaling._Luma->_palette,
 		 aScaling._Luma->_palette_mapping_meth,(unsigned short)minValue,(unsigned short)maxValue);
@@ -1797,12 +1758,12 @@ bool LUT::raw_video_2_image(const unsigned char *data,unsigned int *anImagePt,
 	{
 	  unsigned char* data_y = new unsigned char[column * row];
 	  const unsigned char* src = data + 1;
-	  for(int i = 0;i < column * row;++i,src += 2,++data_y){
-              *data_y = *src;
+	  for(int i = 0;i < column * row;++i,src += 2){
+              data_y[i] = *src;
           }
 	  LUT::map(data_y,anImagePt,column,row,aScaling._Luma->_palette,
 		   aScaling._Luma->_palette_mapping_meth,uchar(minValue),uchar(maxValue));
-	  delete data_y;
+	  delete [] data_y;
 	}
       else
 	_yuv422_packed_2_image(data, anImagePt, column, row, minValue, maxValue,
@@ -1,7 +1,11 @@
 #ifndef __PIXMAPTOOLS_LUT
 #define __PIXMAPTOOLS_LUT
 
-#include "qimage.h"
+// no Qt here, the kernels are also built in the C ABI core library
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+typedef unsigned char uchar;	// same typedef as qglobal.h
 
 class LutError
 {
@@ -148,5 +152,7 @@ public:
   static unsigned char* raw_video_2_luma(const unsigned char *data,
 					 int column,int row,
 					 LUT::Scaling::image_type anImageType);
+  static size_t raw_video_size(int column,int row,
+			       LUT::Scaling::image_type anImageType);
 };
 #endif
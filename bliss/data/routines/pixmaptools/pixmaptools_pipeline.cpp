@@ -0,0 +1,297 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_pipeline.h"
+#include "pixmaptools_timing.h"
+#include <cerrno>
+
+// Lima DevEncoded VIDEO_IMAGE header, big endian
+static const unsigned int VIDEO_MAGIC = 0x5644454f; // "VDEO"
+static const size_t VIDEO_HEADER_SIZE = 32;
+
+static inline unsigned int _be16(const unsigned char *p)
+{
+  return (unsigned(p[0]) << 8) | p[1];
+}
+
+static inline unsigned int _be32(const unsigned char *p)
+{
+  return (unsigned(p[0]) << 24) | (unsigned(p[1]) << 16) | (unsigned(p[2]) << 8) | p[3];
+}
+
+VideoPipeline::VideoPipeline() throw(LutError) :
+  _latest(NULL),
+  _running(false),
+  _stop(0),
+  _autoscale(NO_AUTOSCALE),
+  _sigmaFactor(3.),
+  _decoded(0),
+  _skipped(0),
+  _errors(0),
+  _lastDecoded(0),
+  _interval(0)
+{
+  memset(_latencies,0,sizeof(_latencies));
+  if(sem_init(&_wakeup,0,0))
+    throw LutError("VideoPipeline: can't create semaphore");
+}
+
+VideoPipeline::~VideoPipeline()
+{
+  stop();
+  sem_destroy(&_wakeup);
+  if(_latest) _latest->unref();
+  // images still held by the caller live until released
+  for(std::vector<Image*>::iterator i = _images.begin();i != _images.end();++i)
+    (*i)->unref();
+}
+
+void VideoPipeline::set_autoscale(autoscale aMode,double aSigmaFactor)
+{
+  __atomic_store(&_sigmaFactor,&aSigmaFactor,__ATOMIC_RELAXED);
+  __atomic_store_n(&_autoscale,int(aMode),__ATOMIC_RELAXED);
+}
+
+void VideoPipeline::start() throw(LutError)
+{
+  if(_running) return;
+  __atomic_store_n(&_stop,0,__ATOMIC_RELAXED);
+  if(pthread_create(&_thread,NULL,_run,this))
+    throw LutError("VideoPipeline: can't start thread");
+  _running = true;
+  sem_post(&_wakeup);		// frames pushed while stopped
+}
+
+void VideoPipeline::stop()
+{
+  if(!_running) return;
+  __atomic_store_n(&_stop,1,__ATOMIC_RELEASE);
+  sem_post(&_wakeup);
+  pthread_join(_thread,NULL);
+  _running = false;
+}
+
+void VideoPipeline::push(const unsigned char *data,size_t aSize,int column,int row,
+			 LUT::Scaling::image_type aType,long long aFrameNumber) throw(LutError)
+{
+  size_t aFrameSize = LUT::raw_video_size(column,row,aType);
+  if(!aFrameSize)
+    throw LutError("VideoPipeline: image type or size not supported");
+  if(aSize < aFrameSize)
+    throw LutError("VideoPipeline: raw video buffer too small");
+
+  FrameMailbox::Frame &aFrame = _input.back(aFrameSize);
+  memcpy(aFrame.data,data,aFrameSize);
+  aFrame.column = column,aFrame.row = row;
+  aFrame.image_type = aType;
+  aFrame.frame_number = aFrameNumber;
+  aFrame.timestamp = Timing::now();
+  _input.publish();
+  sem_post(&_wakeup);
+}
+
+LUT::Scaling::image_type VideoPipeline::lima_video_mode(int aLimaMode)
+{
+  // Lima VideoMode order (common/include/lima/Constants.h)
+  static const LUT::Scaling::image_type aTypes[] = {
+    LUT::Scaling::Y8,LUT::Scaling::Y16,LUT::Scaling::Y32,LUT::Scaling::Y64,
+    LUT::Scaling::RGB555,LUT::Scaling::RGB565,
+    LUT::Scaling::RGB24,LUT::Scaling::RGB32,
+    LUT::Scaling::BGR24,LUT::Scaling::BGR32,
+    LUT::Scaling::BAYER_RG8,LUT::Scaling::BAYER_RG16,
+    LUT::Scaling::BAYER_BG8,LUT::Scaling::BAYER_BG16,
+    LUT::Scaling::I420,
+    LUT::Scaling::YUV411,LUT::Scaling::YUV422,LUT::Scaling::YUV444,
+    LUT::Scaling::UNDEF,	// YUV411PACKED
+    LUT::Scaling::YUV422PACKED,
+    LUT::Scaling::UNDEF};	// YUV444PACKED
+  if(aLimaMode < 0 || aLimaMode >= int(sizeof(aTypes) / sizeof(aTypes[0])))
+    return LUT::Scaling::UNDEF;
+  return aTypes[aLimaMode];
+}
+
+bool VideoPipeline::push_devencoded(const unsigned char *data,size_t aSize) throw(LutError)
+{
+  if(aSize < VIDEO_HEADER_SIZE)
+    throw LutError("VideoPipeline: image header smaller than the expected size");
+  if(_be32(data) != VIDEO_MAGIC)
+    throw LutError("VideoPipeline: video magic header not supported");
+  if(_be16(data + 4) != 1)
+    throw LutError("VideoPipeline: video header version not supported");
+  unsigned long long aBigEndian = 0;
+  for(int i = 8;i < 16;++i)
+    aBigEndian = (aBigEndian << 8) | data[i];
+  long long aFrameNumber = (long long)aBigEndian;
+  if(aFrameNumber < 0)
+    return false;
+  int column = int(_be32(data + 16)),row = int(_be32(data + 20));
+  if(_be16(data + 24) != 0)
+    throw LutError("VideoPipeline: video endianness not supported");
+  size_t aHeaderSize = _be16(data + 26);
+  if(aHeaderSize < VIDEO_HEADER_SIZE || aHeaderSize > aSize)
+    throw LutError("VideoPipeline: invalid video header size");
+  LUT::Scaling::image_type aType = lima_video_mode(_be16(data + 6));
+  if(aType == LUT::Scaling::UNDEF)
+    throw LutError("VideoPipeline: video mode not supported");
+  push(data + aHeaderSize,aSize - aHeaderSize,column,row,aType,aFrameNumber);
+  return true;
+}
+
+VideoPipeline::Image* VideoPipeline::fetch()
+{
+  // the reference of _latest goes to the caller
+  return __atomic_exchange_n(&_latest,(Image*)NULL,__ATOMIC_ACQ_REL);
+}
+
+double VideoPipeline::fps() const
+{
+  long long aLast = __atomic_load_n(&_lastDecoded,__ATOMIC_RELAXED);
+  long long anInterval = __atomic_load_n(&_interval,__ATOMIC_RELAXED);
+  if(!aLast || anInterval <= 0 || Timing::now() - aLast > 2000000000LL)
+    return 0.;
+  return 1e9 / anInterval;
+}
+
+void VideoPipeline::latency(stage aStage,Latency &aLatency) const
+{
+  if(aStage < 0 || aStage >= NB_STAGES)
+    {
+      aLatency.last = aLatency.mean = aLatency.max = 0;
+      return;
+    }
+  const Latency &aSource = _latencies[aStage];
+  aLatency.last = __atomic_load_n(&aSource.last,__ATOMIC_RELAXED);
+  aLatency.mean = __atomic_load_n(&aSource.mean,__ATOMIC_RELAXED);
+  aLatency.max = __atomic_load_n(&aSource.max,__ATOMIC_RELAXED);
+}
+
+/** @brief clear the latency maxima, counters keep counting
+ */
+void VideoPipeline::reset_statistics()
+{
+  for(int i = 0;i < NB_STAGES;++i)
+    __atomic_store_n(&_latencies[i].max,0LL,__ATOMIC_RELAXED);
+}
+
+void VideoPipeline::_record(stage aStage,long long aDuration)
+{
+  Latency &aLatency = _latencies[aStage];
+  long long aMean = aLatency.mean ? aLatency.mean + (aDuration - aLatency.mean) / 8 : aDuration;
+  __atomic_store_n(&aLatency.last,aDuration,__ATOMIC_RELAXED);
+  __atomic_store_n(&aLatency.mean,aMean,__ATOMIC_RELAXED);
+  // reset_statistics may clear max from another thread
+  long long aMax = __atomic_load_n(&aLatency.max,__ATOMIC_RELAXED);
+  while(aDuration > aMax &&
+	!__atomic_compare_exchange_n(&aLatency.max,&aMax,aDuration,true,
+				     __ATOMIC_RELAXED,__ATOMIC_RELAXED));
+}
+
+void* VideoPipeline::_run(void *arg)
+{
+  VideoPipeline *aPipeline = (VideoPipeline*)arg;
+  while(1)
+    {
+      while(sem_wait(&aPipeline->_wakeup) && errno == EINTR);
+      // one decoding for all the frames pushed meanwhile
+      while(!sem_trywait(&aPipeline->_wakeup));
+      if(__atomic_load_n(&aPipeline->_stop,__ATOMIC_ACQUIRE))
+	break;
+      if(aPipeline->_input.fetch())
+	aPipeline->_process(aPipeline->_input.front());
+    }
+  return NULL;
+}
+
+/** @brief an image only referenced by the pool, NULL if all are in use.
+ */
+VideoPipeline::Image* VideoPipeline::_free_image(size_t aNbPixel)
+{
+  Image *anImage = NULL;
+  for(std::vector<Image*>::iterator i = _images.begin();i != _images.end();++i)
+    if(__atomic_load_n(&(*i)->_refcount,__ATOMIC_ACQUIRE) == 1)
+      {
+	anImage = *i;
+	break;
+      }
+  if(!anImage)
+    {
+      if(_images.size() >= MAX_IMAGES)
+	return NULL;
+      anImage = new Image();
+      _images.push_back(anImage);
+    }
+  if(aNbPixel > anImage->_capacity)
+    {
+      void *aBuffer;
+      if(posix_memalign(&aBuffer,64,aNbPixel * sizeof(unsigned int)))
+	return NULL;
+      free(anImage->_data);
+      anImage->_data = (unsigned int*)aBuffer;
+      anImage->_capacity = aNbPixel;
+    }
+  return anImage;
+}
+
+void VideoPipeline::_process(const FrameMailbox::Frame &aRaw)
+{
+  long long aStart = Timing::now();
+  _record(QUEUE,aStart - aRaw.timestamp);
+
+  int anAutoscale = __atomic_load_n(&_autoscale,__ATOMIC_RELAXED);
+  if(anAutoscale != NO_AUTOSCALE)
+    {
+      if(anAutoscale == MIN_MAX)
+	_scaling.autoscale_min_max(aRaw.data,aRaw.column,aRaw.row,aRaw.image_type);
+      else
+	{
+	  double aSigmaFactor;
+	  __atomic_load(&_sigmaFactor,&aSigmaFactor,__ATOMIC_RELAXED);
+	  _scaling.autoscale_plus_minus_sigma(aRaw.data,aRaw.column,aRaw.row,
+					      aRaw.image_type,aSigmaFactor);
+	}
+      long long anEnd = Timing::now();
+      _record(AUTOSCALE,anEnd - aStart);
+      aStart = anEnd;
+    }
+
+  Image *anImage = _free_image(size_t(aRaw.column) * aRaw.row);
+  if(!anImage ||
+     !LUT::raw_video_2_image(aRaw.data,anImage->_data,aRaw.column,aRaw.row,
+			     aRaw.image_type,_scaling))
+    {
+      _add(_errors);
+      return;
+    }
+  anImage->_column = aRaw.column,anImage->_row = aRaw.row;
+  anImage->_frame_number = aRaw.frame_number;
+  anImage->_timestamp = aRaw.timestamp;
+
+  long long anEnd = Timing::now();
+  _record(DECODE,anEnd - aStart);
+  _record(TOTAL,anEnd - aRaw.timestamp);
+  if(Timing::enabled())
+    Timing::record(Timing::DISPLAY,anEnd - aRaw.timestamp);
+
+  if(_lastDecoded)
+    {
+      long long anInterval = anEnd - _lastDecoded;
+      if(_interval)
+	anInterval = _interval + (anInterval - _interval) / 8;
+      __atomic_store_n(&_interval,anInterval,__ATOMIC_RELAXED);
+    }
+  __atomic_store_n(&_lastDecoded,anEnd,__ATOMIC_RELAXED);
+  _add(_decoded);
+
+  anImage->ref();		// the one of _latest
+  Image *aPrevious = __atomic_exchange_n(&_latest,anImage,__ATOMIC_ACQ_REL);
+  if(aPrevious)
+    {
+      aPrevious->unref();
+      _add(_skipped);
+    }
+}
@@ -0,0 +1,152 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_PIPELINE
+#define __PIXMAPTOOLS_PIPELINE
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <vector>
+#include "pixmaptools_lut.h"
+#include "pixmaptools_display.h"
+
+/** @brief whole video display chain in one native object
+ *
+ *  Configured once (mode, palette, autoscale), then each pushed frame,
+ *  raw or Lima DevEncoded VIDEO_IMAGE, goes through decode, autoscale and
+ *  mapping in the pipeline thread without coming back to the caller.
+ *  Like DisplayWorker the latest frame wins, but finished images are
+ *  reference counted and handed out without copy: an Image stays valid
+ *  until released, the pipeline reuses its buffer afterwards.
+ *  push*() must be called from one thread and fetch() from one thread,
+ *  configuration and statistics from any thread.
+ */
+class VideoPipeline
+{
+public:
+  enum autoscale {NO_AUTOSCALE,MIN_MAX,PLUS_MINUS_SIGMA};
+  enum stage {QUEUE,		// pushed -> taken by the thread
+	      AUTOSCALE,
+	      DECODE,		// LUT::raw_video_2_image
+	      TOTAL,		// pushed -> image ready
+	      NB_STAGES};
+  enum {MAX_IMAGES = 8};	// images alive at once, fetched ones included
+
+  /// durations in nanoseconds, mean is a moving average over ~8 frames
+  struct Latency
+  {
+    long long last;
+    long long mean;
+    long long max;
+  };
+
+  /// @brief a finished BGRA image, column * row 32 bits pixels
+  class Image
+  {
+    friend class VideoPipeline;
+  public:
+    const unsigned int* data() const {return _data;}
+    int column() const {return _column;}
+    int row() const {return _row;}
+    long long frame_number() const {return _frame_number;}
+    /// Timing::now() when the raw frame was pushed
+    long long timestamp() const {return _timestamp;}
+
+    void ref() {__atomic_add_fetch(&_refcount,1,__ATOMIC_RELAXED);}
+    /// @brief release, the last one deletes the image
+    void unref()
+    {
+      if(!__atomic_sub_fetch(&_refcount,1,__ATOMIC_ACQ_REL))
+	delete this;
+    }
+  private:
+    Image() : _refcount(1),_data(NULL),_capacity(0),
+	      _column(0),_row(0),_frame_number(-1),_timestamp(0) {}
+    ~Image() {free(_data);}
+    Image(const Image&);
+    Image& operator=(const Image&);
+
+    int			_refcount;
+    unsigned int	*_data;
+    size_t		_capacity;
+    int			_column,_row;
+    long long		_frame_number;
+    long long		_timestamp;
+  };
+
+  VideoPipeline() throw(LutError);
+  ~VideoPipeline();
+
+  /// @brief shared with the thread, LUT::Scaling is thread safe
+  LUT::Scaling& scaling() {return _scaling;}
+  void set_autoscale(autoscale,double sigmaFactor = 3.);
+
+  void start() throw(LutError);
+  /// @brief wait the end of the current frame, pushed frames are kept
+  void stop();
+  bool running() const {return _running;}
+
+  /// @brief copy a raw frame, never blocks on the pipeline thread
+  void push(const unsigned char *data,size_t size,int column,int row,
+	    LUT::Scaling::image_type,long long frameNumber) throw(LutError);
+  /** @brief push a Lima DevEncoded VIDEO_IMAGE (header + raw frame)
+   *  @return false if the camera has no image yet (frame number < 0)
+   */
+  bool push_devencoded(const unsigned char *data,size_t size) throw(LutError);
+  /// @brief LUT image type of a Lima video mode, UNDEF if not supported
+  static LUT::Scaling::image_type lima_video_mode(int aLimaMode);
+
+  /** @brief the latest image, NULL if none since last fetch
+   *  the caller owns a reference, Image::unref() it when done
+   */
+  Image* fetch();
+
+  long long pushed() const {return _input.published();}
+  /// raw frames replaced before being decoded
+  long long dropped() const {return _input.dropped();}
+  long long decoded() const {return __atomic_load_n(&_decoded,__ATOMIC_RELAXED);}
+  /// images replaced before being fetched
+  long long skipped() const {return __atomic_load_n(&_skipped,__ATOMIC_RELAXED);}
+  /// frames not decoded (type not supported, all images held by the caller)
+  long long errors() const {return __atomic_load_n(&_errors,__ATOMIC_RELAXED);}
+  /// @brief decoded frames per second, 0 when idle for more than 2 s
+  double fps() const;
+  void latency(stage,Latency&) const;
+  void reset_statistics();
+
+private:
+  VideoPipeline(const VideoPipeline&);
+  VideoPipeline& operator=(const VideoPipeline&);
+
+  static void* _run(void*);
+  void _process(const FrameMailbox::Frame&);
+  Image* _free_image(size_t aNbPixel);
+  void _record(stage,long long duration);
+  static void _add(long long &counter)
+  {
+    __atomic_store_n(&counter,counter + 1,__ATOMIC_RELAXED);
+  }
+
+  LUT::Scaling		_scaling;
+  FrameMailbox		_input;
+  std::vector<Image*>	_images;	// thread only, one reference each
+  Image			*_latest;	// shared, one reference
+  sem_t			_wakeup;
+  pthread_t		_thread;
+  bool			_running;
+  int			_stop;
+  int			_autoscale;
+  double		_sigmaFactor;
+  long long		_decoded;
+  long long		_skipped;
+  long long		_errors;
+  long long		_lastDecoded;
+  long long		_interval;	// moving average between decoded frames
+  Latency		_latencies[NB_STAGES];
+};
+#endif
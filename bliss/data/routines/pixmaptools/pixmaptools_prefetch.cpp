@@ -0,0 +1,456 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_prefetch.h"
+#include "pixmaptools_thread.h"
+#include <sys/stat.h>
+#include <cstring>
+#include <limits>
+#include <new>
+
+FramePrefetcher::FramePrefetcher(int nbThreads,size_t memoryBudget) throw(LutError) :
+  _stop(false),
+  _budget(memoryBudget),
+  _used(0),
+  _serial(0)
+{
+  memset(&_counters,0,sizeof(_counters));
+  if(nbThreads < 1) nbThreads = 1;
+  else if(nbThreads > MAX_THREADS) nbThreads = MAX_THREADS;
+
+  pthread_mutex_init(&_lock,NULL);
+  pthread_cond_init(&_queued,NULL);
+  pthread_cond_init(&_done,NULL);
+  for(int i = 0;i < nbThreads;++i)
+    {
+      pthread_t aThread;
+      if(pthread_create(&aThread,NULL,_run,this))
+	break;
+      _threads.push_back(aThread);
+    }
+  if(_threads.empty())
+    {
+      pthread_cond_destroy(&_done);
+      pthread_cond_destroy(&_queued);
+      pthread_mutex_destroy(&_lock);
+      throw LutError("FramePrefetcher: can't start threads");
+    }
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+  _Lock aLock(&_lock);
+  _stop = true;
+  pthread_cond_broadcast(&_queued);
+  aLock.unlock();
+  for(std::vector<pthread_t>::iterator i = _threads.begin();i != _threads.end();++i)
+    pthread_join(*i,NULL);
+
+  clear();
+  pthread_cond_destroy(&_done);
+  pthread_cond_destroy(&_queued);
+  pthread_mutex_destroy(&_lock);
+}
+
+bool FramePrefetcher::prefetch(const char *aFilename,int anIndex)
+{
+  Key aKey(aFilename,anIndex);
+  _Lock aLock(&_lock);
+  if(_cache.count(aKey))
+    return false;
+
+  Reader *aReader;
+  try
+    {
+      aReader = _reader(aLock,aKey.first,anIndex);
+    }
+  catch(LutError&)
+    {
+      return false;		// get() will tell why
+    }
+  size_t aSize = aReader->reader->frame(anIndex).image_size;
+  _release(aReader);
+  // the lock was released to open the file
+  if(_cache.count(aKey))
+    return false;
+  if(!_make_room(aSize))
+    {
+      ++_counters.refused;
+      return false;
+    }
+  Entry &anEntry = _cache[aKey];
+  anEntry.id = ++_serial;
+  anEntry.size = aSize;
+  _used += aSize;
+  _queue.push_back(aKey);
+  pthread_cond_signal(&_queued);
+  return true;
+}
+
+FramePrefetcher::Frame* FramePrefetcher::get(const char *aFilename,int anIndex) throw(LutError)
+{
+  Key aKey(aFilename,anIndex);
+  _Lock aLock(&_lock);
+  Cache::iterator anEntry;
+  while(1)
+    {
+      anEntry = _cache.find(aKey);
+      if(anEntry == _cache.end() || anEntry->second.state == QUEUED)
+	break;
+      Entry &aCached = anEntry->second;
+      if(aCached.state == READY)
+	{
+	  ++_counters.hits;
+	  if(aCached.taken)
+	    _lru.erase(aCached.lru);
+	  aCached.taken = true;
+	  aCached.lru = _lru.insert(_lru.end(),aKey);
+	  aCached.frame->ref();
+	  return aCached.frame;
+	}
+      if(aCached.state == FAILED)
+	{
+	  std::string anError = aCached.error;
+	  _drop(anEntry);
+	  throw LutError(anError.c_str());
+	}
+      pthread_cond_wait(&_done,&_lock);	// READING
+    }
+
+  // not prefetched (or still queued): read it here, the queued request
+  // is skipped by the threads
+  ++_counters.misses;
+  if(anEntry == _cache.end())
+    anEntry = _cache.insert(Cache::value_type(aKey,Entry())).first;
+  unsigned long long anId = anEntry->second.id = ++_serial;
+  anEntry->second.state = READING;
+
+  Frame *aFrame = NULL;
+  std::string anError;
+  try
+    {
+      Reader *aReader = _reader(aLock,aKey.first,anIndex);
+      aLock.unlock();
+      try
+	{
+	  aFrame = _read(*aReader->reader,anIndex);
+	}
+      catch(LutError &anException)
+	{
+	  anError = anException.msg();
+	}
+      aLock.lock();
+      _release(aReader);
+    }
+  catch(LutError &anException)
+    {
+      anError = anException.msg();
+    }
+
+  anEntry = _cache.find(aKey);
+  bool aWanted = anEntry != _cache.end() && anEntry->second.id == anId;
+  if(!aFrame)
+    {
+      ++_counters.errors;
+      if(aWanted)
+	_drop(anEntry);
+      pthread_cond_broadcast(&_done);
+      throw LutError(anError.c_str());
+    }
+  if(aWanted)
+    {
+      Entry &aCached = anEntry->second;
+      _used += aFrame->size() - aCached.size;
+      aCached.size = aFrame->size();
+      aCached.state = READY;
+      aCached.frame = aFrame;
+      aCached.taken = true;
+      aCached.lru = _lru.insert(_lru.end(),aKey);
+      aFrame->ref();		// the one of the cache
+      _make_room(0);
+    }
+  pthread_cond_broadcast(&_done);
+  return aFrame;
+}
+
+bool FramePrefetcher::cancel(const char *aFilename,int anIndex)
+{
+  _Lock aLock(&_lock);
+  Cache::iterator anEntry = _cache.find(Key(aFilename,anIndex));
+  if(anEntry == _cache.end() || anEntry->second.taken)
+    return false;
+  _drop(anEntry);		// a reading in progress drops its frame
+  pthread_cond_broadcast(&_done);
+  return true;
+}
+
+void FramePrefetcher::clear()
+{
+  _Lock aLock(&_lock);
+  // readings in progress find their entry gone and drop their frame
+  while(!_cache.empty())
+    _drop(_cache.begin());
+  _queue.clear();
+  for(std::map<std::string,Reader*>::iterator i = _readers.begin();i != _readers.end();++i)
+    _release(i->second);
+  _readers.clear();
+  pthread_cond_broadcast(&_done);
+}
+
+size_t FramePrefetcher::memory_used() const
+{
+  _Lock aLock(&_lock);
+  return _used;
+}
+
+void FramePrefetcher::counters(Counters &aCounters) const
+{
+  _Lock aLock(&_lock);
+  aCounters = _counters;
+}
+
+void* FramePrefetcher::_run(void *arg)
+{
+  FramePrefetcher *aPrefetcher = (FramePrefetcher*)arg;
+  _Lock aLock(&aPrefetcher->_lock);
+  while(1)
+    {
+      while(!aPrefetcher->_stop && aPrefetcher->_queue.empty())
+	pthread_cond_wait(&aPrefetcher->_queued,&aPrefetcher->_lock);
+      if(aPrefetcher->_stop)
+	break;
+      Key aKey = aPrefetcher->_queue.front();
+      aPrefetcher->_queue.pop_front();
+      Cache::iterator anEntry = aPrefetcher->_cache.find(aKey);
+      if(anEntry == aPrefetcher->_cache.end() || anEntry->second.state != QUEUED)
+	continue;		// cleared or taken by get()
+      unsigned long long anId = anEntry->second.id;
+      anEntry->second.state = READING;
+
+      Frame *aFrame = NULL;
+      std::string anError;
+      try
+	{
+	  Reader *aReader = aPrefetcher->_reader(aLock,aKey.first,aKey.second);
+	  aLock.unlock();
+	  try
+	    {
+	      aFrame = _read(*aReader->reader,aKey.second);
+	    }
+	  catch(LutError &anException)
+	    {
+	      anError = anException.msg();
+	    }
+	  aLock.lock();
+	  aPrefetcher->_release(aReader);
+	}
+      catch(LutError &anException)
+	{
+	  anError = anException.msg();
+	}
+
+      anEntry = aPrefetcher->_cache.find(aKey);
+      if(anEntry == aPrefetcher->_cache.end() || anEntry->second.id != anId)
+	{
+	  if(aFrame) aFrame->unref();
+	}
+      else if(!aFrame)
+	{
+	  ++aPrefetcher->_counters.errors;
+	  anEntry->second.state = FAILED;
+	  anEntry->second.error = anError;
+	}
+      else
+	{
+	  ++aPrefetcher->_counters.prefetched;
+	  anEntry->second.state = READY;
+	  anEntry->second.frame = aFrame;
+	}
+      pthread_cond_broadcast(&aPrefetcher->_done);
+    }
+  return NULL;
+}
+
+template<class T>
+static void _swap(void *aData,size_t aSize);
+
+template<>
+void _swap<unsigned short>(void *aData,size_t aSize)
+{
+  unsigned short *p = (unsigned short*)aData;
+  for(size_t i = 0;i < aSize / 2;++i) p[i] = __builtin_bswap16(p[i]);
+}
+
+template<>
+void _swap<unsigned int>(void *aData,size_t aSize)
+{
+  unsigned int *p = (unsigned int*)aData;
+  for(size_t i = 0;i < aSize / 4;++i) p[i] = __builtin_bswap32(p[i]);
+}
+
+template<>
+void _swap<unsigned long long>(void *aData,size_t aSize)
+{
+  unsigned long long *p = (unsigned long long*)aData;
+  for(size_t i = 0;i < aSize / 8;++i) p[i] = __builtin_bswap64(p[i]);
+}
+
+/** @brief copy (which pages the file in) or decompress a frame in a new
+ *  buffer, in the host byte order. Called without the lock.
+ */
+FramePrefetcher::Frame* FramePrefetcher::_read(const EdfReader &aReader,int anIndex) throw(LutError)
+{
+  const EdfReader::Frame &anEdfFrame = aReader.frame(anIndex);
+  if(anEdfFrame.type == EdfReader::UNKNOWN)
+    throw LutError("FramePrefetcher: EDF data type not supported");
+
+  Frame *aFrame = new(std::nothrow) Frame();
+  void *aBuffer;
+  if(!aFrame || posix_memalign(&aBuffer,64,anEdfFrame.image_size ? anEdfFrame.image_size : 1))
+    {
+      delete aFrame;
+      throw LutError("FramePrefetcher: can't allocate frame");
+    }
+  aFrame->_data = aBuffer;
+  aFrame->_size = anEdfFrame.image_size;
+  aFrame->_nb_dims = anEdfFrame.nb_dims;
+  memcpy(aFrame->_dims,anEdfFrame.dims,sizeof(aFrame->_dims));
+  aFrame->_type = anEdfFrame.type;
+  try
+    {
+      if(anEdfFrame.compressed)
+	aReader.decompress(anIndex,aBuffer,anEdfFrame.image_size);
+      else
+	memcpy(aBuffer,aReader.data(anIndex),anEdfFrame.image_size);
+    }
+  catch(LutError&)
+    {
+      aFrame->unref();
+      throw;
+    }
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  bool aSwap = !anEdfFrame.big_endian;
+#else
+  bool aSwap = anEdfFrame.big_endian;
+#endif
+  if(aSwap)
+    switch(EdfReader::type_size(anEdfFrame.type))
+      {
+      case 2: _swap<unsigned short>(aBuffer,anEdfFrame.image_size);break;
+      case 4: _swap<unsigned int>(aBuffer,anEdfFrame.image_size);break;
+      case 8: _swap<unsigned long long>(aBuffer,anEdfFrame.image_size);break;
+      default: break;
+      }
+  return aFrame;
+}
+
+/** @brief the reader of a file, referenced for the caller. The file is
+ *  opened again if it changed since it was opened (frames appended by an
+ *  acquisition, file overwritten), the lock is released meanwhile.
+ */
+FramePrefetcher::Reader* FramePrefetcher::_reader(_Lock &aLock,const std::string &aFilename,
+						  int anIndex) throw(LutError)
+{
+  std::map<std::string,Reader*>::iterator anOpened = _readers.find(aFilename);
+  if(anOpened != _readers.end())
+    {
+      Reader *aReader = anOpened->second;
+      struct stat aStat;
+      if(stat(aFilename.c_str(),&aStat) ||
+	 (size_t(aStat.st_size) == aReader->reader->size() &&
+	  aStat.st_mtim.tv_sec * 1000000000LL + aStat.st_mtim.tv_nsec == aReader->reader->mtime()))
+	{
+	  aReader->reader->frame(anIndex); // throws if out of range
+	  ++aReader->refcount;
+	  return aReader;
+	}
+    }
+
+  aLock.unlock();
+  EdfReader *anEdf = NULL;
+  try
+    {
+      anEdf = new EdfReader(aFilename.c_str());
+    }
+  catch(LutError&)
+    {
+      aLock.lock();
+      throw;
+    }
+  catch(std::bad_alloc&)
+    {
+      aLock.lock();
+      throw LutError("FramePrefetcher: can't allocate EDF reader");
+    }
+  aLock.lock();
+
+  Reader *aReader = new Reader;
+  aReader->reader = anEdf;
+  aReader->refcount = 2;	// the map's and the caller's
+  anOpened = _readers.find(aFilename);
+  if(anOpened != _readers.end())
+    {
+      _release(anOpened->second);
+      anOpened->second = aReader;
+      // frames taken from the previous content may be stale
+      Cache::iterator anEntry = _cache.lower_bound(Key(aFilename,std::numeric_limits<int>::min()));
+      while(anEntry != _cache.end() && anEntry->first.first == aFilename)
+	{
+	  Cache::iterator aNext = anEntry;
+	  ++aNext;
+	  if(anEntry->second.taken)
+	    _drop(anEntry);
+	  anEntry = aNext;
+	}
+    }
+  else
+    _readers[aFilename] = aReader;
+
+  try
+    {
+      anEdf->frame(anIndex);
+    }
+  catch(LutError&)
+    {
+      _release(aReader);
+      throw;
+    }
+  return aReader;
+}
+
+void FramePrefetcher::_release(Reader *aReader)
+{
+  if(!--aReader->refcount)
+    {
+      delete aReader->reader;
+      delete aReader;
+    }
+}
+
+/** @brief evict taken frames, oldest first, until aSize more bytes fit
+ *  in the budget
+ */
+bool FramePrefetcher::_make_room(size_t aSize)
+{
+  while(_used + aSize > _budget && !_lru.empty())
+    {
+      ++_counters.evicted;
+      _drop(_cache.find(_lru.front()));
+    }
+  return _used + aSize <= _budget;
+}
+
+void FramePrefetcher::_drop(Cache::iterator anEntry)
+{
+  Entry &aCached = anEntry->second;
+  _used -= aCached.size;
+  if(aCached.frame) aCached.frame->unref();
+  if(aCached.taken) _lru.erase(aCached.lru);
+  _cache.erase(anEntry);
+}
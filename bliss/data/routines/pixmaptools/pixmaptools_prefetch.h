@@ -0,0 +1,154 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_PREFETCH
+#define __PIXMAPTOOLS_PREFETCH
+
+#include <pthread.h>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "pixmaptools_lut.h"
+#include "pixmaptools_edf.h"
+
+class _Lock;
+
+/** @brief read-ahead of EDF frames by a pool of threads
+ *
+ *  The consumer asks for the next frames with prefetch() then takes them
+ *  one by one with get(): threads read (page in, LZ4 decompress, byte
+ *  swap to the host order) the frames ahead while the consumer works on
+ *  the current one.
+ *  Frames are kept in a cache limited to memory_budget bytes. Frames
+ *  already handed out are evicted first (oldest first), frames read
+ *  ahead but not yet taken are never evicted: prefetch() refuses new
+ *  requests when they don't fit, cancel() the ones no longer wanted.
+ *  A frame not prefetched is read by get() in the calling thread.
+ *  All methods are thread safe.
+ */
+class FramePrefetcher
+{
+public:
+  enum {MAX_THREADS = 16};
+
+  /// @brief a decoded frame in the host byte order
+  class Frame
+  {
+    friend class FramePrefetcher;
+  public:
+    const void* data() const {return _data;}
+    size_t size() const {return _size;}
+    int nb_dims() const {return _nb_dims;}
+    /// Dim_1 (fastest), Dim_2, Dim_3
+    const int* dims() const {return _dims;}
+    EdfReader::data_type type() const {return _type;}
+
+    void ref() {__atomic_add_fetch(&_refcount,1,__ATOMIC_RELAXED);}
+    /// @brief release, the last one deletes the frame
+    void unref()
+    {
+      if(!__atomic_sub_fetch(&_refcount,1,__ATOMIC_ACQ_REL))
+	delete this;
+    }
+  private:
+    Frame() : _refcount(1),_data(NULL),_size(0),_nb_dims(0),
+	      _type(EdfReader::UNKNOWN) {_dims[0] = _dims[1] = _dims[2] = 1;}
+    ~Frame() {free(_data);}
+    Frame(const Frame&);
+    Frame& operator=(const Frame&);
+
+    int			_refcount;
+    void		*_data;
+    size_t		_size;
+    int			_nb_dims;
+    int			_dims[3];
+    EdfReader::data_type _type;
+  };
+
+  struct Counters
+  {
+    long long hits;		///< get() served from the cache
+    long long misses;		///< get() read in the calling thread
+    long long prefetched;	///< frames read by the threads
+    long long evicted;
+    long long refused;		///< prefetch() over the memory budget
+    long long errors;
+  };
+
+  FramePrefetcher(int nbThreads = 2,size_t memoryBudget = 256 << 20) throw(LutError);
+  ~FramePrefetcher();
+
+  /** @brief queue a frame for the threads
+   *  @return false if it is already cached or queued, or doesn't fit
+   *  in the memory budget
+   */
+  bool prefetch(const char *filename,int index);
+  /** @brief a frame, waits for it if it is being read
+   *  the caller owns a reference, Frame::unref() it when done
+   */
+  Frame* get(const char *filename,int index) throw(LutError);
+  /** @brief drop a prefetched frame not taken yet (iteration abandoned)
+   *  @return false if there was none
+   */
+  bool cancel(const char *filename,int index);
+  /// @brief drop the cache, the queued requests and the open files
+  void clear();
+
+  size_t memory_budget() const {return _budget;}
+  /// bytes held by the cache, frames being read included
+  size_t memory_used() const;
+  void counters(Counters&) const;
+
+private:
+  FramePrefetcher(const FramePrefetcher&);
+  FramePrefetcher& operator=(const FramePrefetcher&);
+
+  typedef std::pair<std::string,int> Key;
+  enum entry_state {QUEUED,READING,READY,FAILED};
+  struct Entry
+  {
+    Entry() : id(0),state(QUEUED),frame(NULL),size(0),taken(false) {}
+    unsigned long long id;	// tells a reading it is still wanted
+    entry_state state;
+    Frame	*frame;		// READY: one reference
+    size_t	size;		// accounted in _used
+    bool	taken;		// handed out by get()
+    std::list<Key>::iterator lru;
+    std::string error;
+  };
+  typedef std::map<Key,Entry> Cache;
+  struct Reader
+  {
+    EdfReader	*reader;
+    int		refcount;	// the map + readings in progress
+  };
+
+  static void* _run(void*);
+  static Frame* _read(const EdfReader&,int index) throw(LutError);
+  Reader* _reader(_Lock&,const std::string &filename,int index) throw(LutError);
+  void _release(Reader*);
+  bool _make_room(size_t aSize);
+  void _drop(Cache::iterator);
+
+  mutable pthread_mutex_t	_lock;
+  pthread_cond_t		_queued;	// threads wait for requests
+  pthread_cond_t		_done;		// get() waits for a reading
+  std::vector<pthread_t>	_threads;
+  bool				_stop;
+  size_t			_budget;
+  size_t			_used;
+  unsigned long long		_serial;
+  Cache				_cache;
+  std::deque<Key>		_queue;
+  std::list<Key>		_lru;		// taken frames, oldest first
+  std::map<std::string,Reader*>	_readers;
+  Counters			_counters;
+};
+#endif
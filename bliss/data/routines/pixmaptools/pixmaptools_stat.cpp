@@ -8,3 +8,488 @@
 
 #include "pixmaptools_stat.h"
 
+#include "pixmaptools_thread.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+struct _PeakCandidate
+{
+  int	pixel;
+  double background;
+};
+
+static inline bool _peak_candidate_before(const _PeakCandidate &a,int pixel)
+{
+  return a.pixel < pixel;
+}
+
+/** @brief count, mean and sum of squared deviations of a set of values
+ *
+ *  updated with Welford formulas when a value is added or removed and
+ *  Chan ones when a whole set is, the variance doesn't suffer the
+ *  cancellation of sum(x^2) / n - mean^2 under a high background.
+ */
+struct _Moments
+{
+  double n,mean,m2;
+
+  _Moments() : n(0.),mean(0.),m2(0.) {}
+
+  void add(double x)
+  {
+    n += 1.;
+    double d = x - mean;
+    mean += d / n;
+    m2 += d * (x - mean);
+  }
+  void remove(double x)
+  {
+    if(n <= 1.)
+      {
+	*this = _Moments();
+	return;
+      }
+    n -= 1.;
+    double d = x - mean;
+    mean -= d / n;
+    m2 -= d * (x - mean);
+  }
+  void add(const _Moments &other)
+  {
+    if(other.n <= 0.) return;
+    double total = n + other.n;
+    double d = other.mean - mean;
+    mean += d * other.n / total;
+    m2 += other.m2 + d * d * n * other.n / total;
+    n = total;
+  }
+  void remove(const _Moments &other)
+  {
+    if(other.n <= 0.) return;
+    double rest = n - other.n;
+    if(rest <= 0.)
+      {
+	*this = _Moments();
+	return;
+      }
+    double restMean = mean + (mean - other.mean) * other.n / rest;
+    double d = other.mean - restMean;
+    m2 -= other.m2 + d * d * rest * other.n / n;
+    mean = restMean,n = rest;
+  }
+  // NaN once the squares overflowed, no pixel is then above
+  double variance() const {return n > 0. && !(m2 < 0.) ? m2 / n : 0.;}
+};
+
+/** @brief select pixels above local background on a band of rows
+ *
+ *  local mean and sigma are computed with a sliding window, the moments
+ *  of each column are updated row by row and the horizontal window
+ *  slides on them. NaN, infinite and excluded pixels are not part of
+ *  the windows; an excluded pixel whose window is empty keeps its
+ *  previous background.
+ */
+template<class IN>
+struct _PeakCandidateTask
+{
+  const IN *data;
+  int column,row;
+  int halfWindow;
+  double sigmaFactor;
+  double threshold;
+  const unsigned char *excluded;	// NULL on the first pass
+  const std::vector<_PeakCandidate> *previous;
+  std::vector<std::vector<_PeakCandidate> > candidates;
+
+  inline bool usable(double val,long pixel) const
+  {
+    return std::isfinite(val) && !(excluded && excluded[pixel]);
+  }
+
+  void operator()(int begin,int end,int chunkId)
+  {
+    std::vector<_PeakCandidate> &aCandidates = candidates[chunkId];
+    std::vector<_Moments> columns(column);
+    int top = begin - halfWindow;
+    if(top < 0) top = 0;
+    int bottom = top - 1;
+    for(int r = begin;r < end;++r)
+      {
+	int wTop = r - halfWindow,wBottom = r + halfWindow;
+	if(wTop < 0) wTop = 0;
+	if(wBottom >= row) wBottom = row - 1;
+	for(;bottom < wBottom;)
+	  {
+	    ++bottom;
+	    long offset = long(bottom) * column;
+	    for(int c = 0;c < column;++c)
+	      {
+		double val = double(data[offset + c]);
+		if(usable(val,offset + c)) columns[c].add(val);
+	      }
+	  }
+	for(;top < wTop;++top)
+	  {
+	    long offset = long(top) * column;
+	    for(int c = 0;c < column;++c)
+	      {
+		double val = double(data[offset + c]);
+		if(usable(val,offset + c)) columns[c].remove(val);
+	      }
+	  }
+	_Moments window;
+	int left = 0,right = -1;
+	long offset = long(r) * column;
+	for(int c = 0;c < column;++c)
+	  {
+	    int wLeft = c - halfWindow,wRight = c + halfWindow;
+	    if(wLeft < 0) wLeft = 0;
+	    if(wRight >= column) wRight = column - 1;
+	    for(;right < wRight;)
+	      window.add(columns[++right]);
+	    for(;left < wLeft;++left)
+	      window.remove(columns[left]);
+
+	    double val = double(data[offset + c]);
+	    if(!std::isfinite(val)) continue;
+	    _PeakCandidate aCandidate;
+	    aCandidate.pixel = int(offset + c);
+	    if(window.n > 0.)
+	      {
+		double sigma = sqrt(window.variance());
+		double above = val - window.mean;
+		if(!(above > sigmaFactor * sigma && above > threshold))
+		  continue;
+		aCandidate.background = window.mean;
+	      }
+	    else
+	      {
+		// only spot pixels around, the pixel was one
+		std::vector<_PeakCandidate>::const_iterator i =
+		  std::lower_bound(previous->begin(),previous->end(),
+				   aCandidate.pixel,_peak_candidate_before);
+		if(i == previous->end() || i->pixel != aCandidate.pixel)
+		  continue;
+		aCandidate.background = i->background;
+	      }
+	    aCandidates.push_back(aCandidate);
+	  }
+      }
+  }
+};
+
+struct _PeakRun
+{
+  int row,first,last;		// columns [first,last]
+  int candidate;		// index of the first candidate
+  int parent;
+};
+
+static int _find_root(std::vector<_PeakRun> &runs,int index)
+{
+  while(runs[index].parent != index)
+    {
+      runs[index].parent = runs[runs[index].parent].parent;
+      index = runs[index].parent;
+    }
+  return index;
+}
+
+static void _union(std::vector<_PeakRun> &runs,int a,int b)
+{
+  a = _find_root(runs,a),b = _find_root(runs,b);
+  if(a < b) runs[b].parent = a;
+  else if(b < a) runs[a].parent = b;
+}
+
+template<class IN>
+void Stat::find_peaks(const IN *data,int column,int row,std::vector<Spot> &spots,
+		      int halfWindow,double sigmaFactor,
+		      double threshold,int minPixels)
+{
+  spots.clear();
+  if(column <= 0 || row <= 0) return;
+  if(halfWindow < 1) halfWindow = 1;
+
+  _PeakCandidateTask<IN> aTask;
+  aTask.data = data;
+  aTask.column = column,aTask.row = row;
+  aTask.halfWindow = halfWindow;
+  aTask.sigmaFactor = sigmaFactor;
+  aTask.threshold = threshold;
+  aTask.excluded = NULL;
+  aTask.previous = NULL;
+  int minRows = 0x10000 / column + 1;
+  aTask.candidates.resize(Parallel::nb_chunks(row,minRows));
+  Parallel::run(row,aTask,minRows);
+
+  // chunks are contiguous bands, so candidates are in raster order
+  std::vector<_PeakCandidate> candidates;
+  for(size_t i = 0;i < aTask.candidates.size();++i)
+    candidates.insert(candidates.end(),
+		      aTask.candidates[i].begin(),aTask.candidates[i].end());
+  if(candidates.empty()) return;
+
+  // second pass, the background without the spot pixels of the first one
+  std::vector<unsigned char> excluded(size_t(column) * row,0);
+  for(size_t i = 0;i < candidates.size();++i)
+    excluded[candidates[i].pixel] = 1;
+  aTask.excluded = &excluded[0];
+  aTask.previous = &candidates;
+  for(size_t i = 0;i < aTask.candidates.size();++i)
+    aTask.candidates[i].clear();
+  Parallel::run(row,aTask,minRows);
+  candidates.clear();
+  for(size_t i = 0;i < aTask.candidates.size();++i)
+    candidates.insert(candidates.end(),
+		      aTask.candidates[i].begin(),aTask.candidates[i].end());
+  if(candidates.empty()) return;
+
+  // group candidates in runs and merge touching runs of consecutive rows
+  std::vector<_PeakRun> runs;
+  for(size_t i = 0;i < candidates.size();++i)
+    {
+      int r = candidates[i].pixel / column,c = candidates[i].pixel % column;
+      if(!runs.empty() && runs.back().row == r && runs.back().last == c - 1)
+	{
+	  runs.back().last = c;
+	  continue;
+	}
+      _PeakRun aRun;
+      aRun.row = r,aRun.first = aRun.last = c;
+      aRun.candidate = int(i);
+      aRun.parent = int(runs.size());
+      runs.push_back(aRun);
+    }
+  // link each run with the touching runs of the previous row
+  for(size_t i = 0,prev = 0;i < runs.size();++i)
+    {
+      int r = runs[i].row;
+      while(prev < i && runs[prev].row < r - 1) ++prev;
+      for(size_t j = prev;j < i && runs[j].row == r - 1;++j)
+	if(runs[j].first <= runs[i].last + 1 && runs[j].last >= runs[i].first - 1)
+	  _union(runs,int(i),int(j));
+    }
+
+  // accumulate each spot on its root run
+  std::vector<int> spotIndex(runs.size(),-1);
+  for(size_t i = 0;i < runs.size();++i)
+    {
+      int root = _find_root(runs,int(i));
+      if(spotIndex[root] < 0)
+	{
+	  spotIndex[root] = int(spots.size());
+	  Spot aSpot;
+	  aSpot.x = aSpot.y = aSpot.intensity = aSpot.background = 0.;
+	  aSpot.max_value = -HUGE_VAL;
+	  aSpot.peak_x = aSpot.peak_y = -1;
+	  aSpot.nb_pixels = 0;
+	  spots.push_back(aSpot);
+	}
+      Spot &aSpot = spots[spotIndex[root]];
+      int r = runs[i].row;
+      for(int c = runs[i].first,k = runs[i].candidate;c <= runs[i].last;++c,++k)
+	{
+	  double val = double(data[long(r) * column + c]);
+	  double weight = val - candidates[k].background;
+	  aSpot.x += weight * c,aSpot.y += weight * r;
+	  aSpot.intensity += weight;
+	  aSpot.background += candidates[k].background;
+	  if(val > aSpot.max_value)
+	    aSpot.max_value = val,aSpot.peak_x = c,aSpot.peak_y = r;
+	  ++aSpot.nb_pixels;
+	}
+    }
+
+  std::vector<Spot>::iterator j = spots.begin();
+  for(std::vector<Spot>::iterator i = spots.begin();i != spots.end();++i)
+    {
+      if(i->nb_pixels < minPixels) continue;
+      if(i->intensity > 0.)
+	i->x /= i->intensity,i->y /= i->intensity;
+      else
+	i->x = i->peak_x,i->y = i->peak_y;
+      i->background /= i->nb_pixels;
+      *j = *i,++j;
+    }
+  spots.erase(j,spots.end());
+}
+
+// UNIQUE COUNT
+
+static const int RADIX_BITS = 11;
+static const int RADIX_SIZE = 1 << RADIX_BITS;
+
+/** @brief bits of a float ordered as unsigned integers
+ *
+ *  the sign bit is flipped on positive values and all bits on negative
+ *  ones, -0 is mapped as 0 and every NaN on the max key.
+ */
+template<class IN>
+struct _UniqueKey
+{
+  typedef typename _FloatBits<IN>::type KEY;
+  static const KEY SIGN = KEY(1) << (sizeof(KEY) * 8 - 1);
+
+  static inline KEY from(IN val)
+  {
+    if(val != val) return ~KEY(0);
+    if(val == IN(0)) return SIGN;
+    KEY bits;
+    memcpy(&bits,&val,sizeof(bits));
+    return (bits & SIGN) ? ~bits : bits | SIGN;
+  }
+  static inline IN to(KEY key)
+  {
+    if(key == ~KEY(0)) return std::numeric_limits<IN>::quiet_NaN();
+    KEY bits = (key & SIGN) ? key ^ SIGN : ~key;
+    IN val;
+    memcpy(&val,&bits,sizeof(val));
+    return val;
+  }
+};
+
+/** @brief one pass of the radix sort on a range of chunks
+ *
+ *  the chunks are fixed by the sort, Parallel::run only spreads them
+ *  on the threads. mode COUNT fills the digit counts of each chunk,
+ *  SCATTER moves the keys of each chunk from their digit offsets.
+ *  The first count also converts the data to keys.
+ */
+template<class IN>
+struct _RadixTask
+{
+  typedef typename _FloatBits<IN>::type KEY;
+  enum Mode {CONVERT,COUNT,SCATTER};
+
+  Mode mode;
+  const IN *data;
+  const KEY *src;
+  KEY *dst;
+  int shift;
+  const std::vector<int> *bounds;
+  std::vector<std::vector<int> > *counts;
+
+  void operator()(int beginChunk,int endChunk,int)
+  {
+    for(int chunk = beginChunk;chunk < endChunk;++chunk)
+      {
+	int begin = (*bounds)[chunk],end = (*bounds)[chunk + 1];
+	std::vector<int> &aCount = (*counts)[chunk];
+	if(mode == SCATTER)
+	  {
+	    for(int i = begin;i < end;++i)
+	      dst[aCount[(src[i] >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+	    continue;
+	  }
+	if(mode == CONVERT)
+	  for(int i = begin;i < end;++i)
+	    dst[i] = _UniqueKey<IN>::from(data[i]);
+	const KEY *keys = mode == CONVERT ? dst : src;
+	aCount.assign(RADIX_SIZE,0);
+	for(int i = begin;i < end;++i)
+	  ++aCount[(keys[i] >> shift) & (RADIX_SIZE - 1)];
+      }
+  }
+};
+
+template<class IN>
+Stat::UniqueCount<IN>::UniqueCount(const IN *data,int nbElem) :
+  _nbUnique(0)
+{
+  if(nbElem <= 0) return;
+
+  int nbChunk = Parallel::nb_chunks(nbElem);
+  std::vector<int> bounds(nbChunk + 1);
+  for(int chunk = 0;chunk < nbChunk;++chunk)
+    bounds[chunk] = chunk * (nbElem / nbChunk);
+  bounds[nbChunk] = nbElem;
+  std::vector<std::vector<int> > counts(nbChunk);
+
+  std::vector<KEY> aBuffer(nbElem);
+  _keys.resize(nbElem);
+
+  _RadixTask<IN> aTask;
+  aTask.mode = _RadixTask<IN>::CONVERT;
+  aTask.data = data;
+  aTask.src = &_keys[0];
+  aTask.dst = &_keys[0];
+  aTask.bounds = &bounds;
+  aTask.counts = &counts;
+  for(int shift = 0;shift < int(sizeof(KEY) * 8);shift += RADIX_BITS)
+    {
+      aTask.shift = shift;
+      if(shift)
+	{
+	  aTask.mode = _RadixTask<IN>::COUNT;
+	  aTask.src = &_keys[0];
+	}
+      Parallel::run(nbChunk,aTask,1);
+
+      // digit offsets of each chunk, skip the pass if one digit has them all
+      bool aSingleDigit = false;
+      int anOffset = 0;
+      for(int digit = 0;digit < RADIX_SIZE && !aSingleDigit;++digit)
+	for(int chunk = 0;chunk < nbChunk;++chunk)
+	  {
+	    int aCount = counts[chunk][digit];
+	    if(aCount == nbElem) aSingleDigit = true;
+	    counts[chunk][digit] = anOffset;
+	    anOffset += aCount;
+	  }
+      if(aSingleDigit) continue;
+
+      aTask.mode = _RadixTask<IN>::SCATTER;
+      aTask.src = &_keys[0];
+      aTask.dst = &aBuffer[0];
+      Parallel::run(nbChunk,aTask,1);
+      _keys.swap(aBuffer);
+    }
+
+  _nbUnique = 1;
+  for(int i = 1;i < nbElem;++i)
+    if(_keys[i] != _keys[i - 1]) ++_nbUnique;
+}
+
+template<class IN>
+void Stat::UniqueCount<IN>::fill(int *Y,IN *X) const
+{
+  if(_keys.empty()) return;
+  KEY aLastKey = _keys[0];
+  int aCount = 0;
+  for(typename std::vector<KEY>::const_iterator i = _keys.begin();
+      i != _keys.end();++i)
+    {
+      if(*i != aLastKey)
+	{
+	  *Y++ = aCount,*X++ = _UniqueKey<IN>::to(aLastKey);
+	  aLastKey = *i,aCount = 0;
+	}
+      ++aCount;
+    }
+  *Y = aCount,*X = _UniqueKey<IN>::to(aLastKey);
+}
+
+template class Stat::UniqueCount<float>;
+template class Stat::UniqueCount<double>;
+
+#define INIT_TEMPLATE(TYPE) \
+  template void Stat::find_peaks(const TYPE*,int,int,std::vector<Stat::Spot>&, \
+				 int,double,double,int);
+
+INIT_TEMPLATE(char)
+INIT_TEMPLATE(unsigned char)
+
+INIT_TEMPLATE(short)
+INIT_TEMPLATE(unsigned short)
+
+INIT_TEMPLATE(int)
+INIT_TEMPLATE(unsigned int)
+
+INIT_TEMPLATE(long)
+INIT_TEMPLATE(unsigned long)
+
+INIT_TEMPLATE(float)
+INIT_TEMPLATE(double)
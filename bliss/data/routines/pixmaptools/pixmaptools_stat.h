@@ -2,20 +2,45 @@
 #define __PIXMAPTOOLS_HISTO
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "pixmaptools_thread.h"
+#include "pixmaptools_cpu.h"
+
+/// @brief unsigned integer holding the bits of a float type
+template<class IN> struct _FloatBits;
+template<> struct _FloatBits<float> {typedef unsigned int type;};
+template<> struct _FloatBits<double> {typedef unsigned long long type;};
 
 class Stat
 {
 public:
+  /// @brief a diffraction spot found by find_peaks
+  struct Spot
+  {
+    double x,y;			// centroid weighted by intensity above background
+    double intensity;		// integrated intensity above background
+    double background;		// mean local background
+    double max_value;
+    int peak_x,peak_y;		// position of the max
+    int nb_pixels;
+  };
   /**
    * @brief get a full histogram
    * @param data the imput data
    * @param nbElem the number of element of the input data
    * @param Y result array data of histogram
    * @param X result array data of histogram 
+   *
+   * float and double go through UniqueCount, their NaN are one value
+   * at the end of X.
    */
   template<class IN>
   static void histo_full(const IN *data,int nbElem,std::vector<int> &Y,std::vector<IN> &X)
   {
+    if(nbElem <= 0) return;
+    if(_unique_count(data,nbElem,Y,X)) return;
     std::vector<IN> __data(data,data + nbElem);
     std::sort(__data.begin(),__data.end());
     typename std::vector<IN>::iterator i(__data.begin());
@@ -35,15 +60,34 @@ public:
 	  }
       }
   }
+
+  /**
+   * @brief distinct values of float data and their counts
+   *
+   * parallel LSD radix sort of the IEEE bit patterns followed by a run
+   * length count. -0 is counted as 0 and all the NaN as one value,
+   * after +inf. The number of values is known once constructed so the
+   * caller can allocate the outputs before fill().
+   */
+  template<class IN>
+  class UniqueCount
+  {
+  public:
+    UniqueCount(const IN *data,int nbElem);
+    /// @brief number of distinct values
+    int size() const {return _nbUnique;}
+    /// @brief write the size() values in increasing order to X, their counts to Y
+    void fill(int *Y,IN *X) const;
+  private:
+    typedef typename _FloatBits<IN>::type KEY;
+    std::vector<KEY> _keys;	// sorted, see _UniqueKey
+    int _nbUnique;
+  };
+
   template<class IN>
   static void _find_min_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax)
   {
-    dataMax = dataMin = *aData;++aData;
-    for(int i = 1;i < aNbValue;++i,++aData)
-      {
-	if(*aData > dataMax) dataMax = *aData;
-	else if(*aData < dataMin) dataMin = *aData;
-      }
+    CpuKernels<IN>::min_max(aData,aNbValue,dataMin,dataMax);
   }
 
   template<class IN>
@@ -53,26 +97,269 @@ public:
     if(lower == upper && lower == 0)
 	_find_min_max(data,nbElem,lower,upper);
 
-    double step = double(upper - lower) / binsNumber;
-    double firstValue = lower;
-    for(int i = binsNumber + 1;i;--i)
-      {
-	X.push_back(IN(firstValue));
-	firstValue += step;
-      }
+    double step = (double(upper) - double(lower)) / binsNumber;
+    for(int i = 0;i < binsNumber;++i)
+      X.push_back(_saturate<IN>(double(lower) + step * i));
+    X.push_back(upper);
     double invStep = 0.;
-    if(step > 1e-6)
+    if(step > 1e-6 && std::isfinite(step))
       invStep = 1. / step;
-    Y = std::vector<int>(binsNumber + 1,0);
-    const IN *aEndData = data + nbElem;
-    IN maxVal = upper,minVal = lower;
-    for(;data != aEndData;++data)
+    _LinearBucket<IN> aBucket;
+    aBucket.minVal = lower,aBucket.maxVal = upper;
+    aBucket.invStep = invStep;
+    _histo(data,nbElem,binsNumber + 1,aBucket,Y);
+  }
+
+  /**
+   * @brief histogram with logarithmic spaced bins
+   * @param X the binsNumber + 1 bin edges
+   * @param lower,upper histogram range (0 < lower <= upper), if both 0
+   * the range is the positive min and the max of the data
+   * @return false, with Y and X empty, if the range is not positive
+   * or the data have no positive value
+   */
+  template<class IN>
+  static bool histo_log(const IN *data,int nbElem,std::vector<int> &Y,std::vector<double> &X,
+			int binsNumber = 10,double lower = 0.,double upper = 0.)
+  {
+    if(lower == upper && lower == 0.)
+      {
+	IN dataMin,dataMax;
+	_find_minpos_max(data,nbElem,dataMin,dataMax);
+	lower = double(dataMin),upper = double(dataMax);
+      }
+    if(!(lower > 0. && upper >= lower))
+      {
+	Y.clear(),X.clear();
+	return false;
+      }
+    X.resize(binsNumber + 1);
+    double logLower = log2(lower),logUpper = log2(upper);
+    for(int i = 0;i <= binsNumber;++i)
       {
-	IN val = *data;
-	if(val > maxVal || val < minVal) continue;
-	else ++(Y[int((val - minVal) * invStep)]);
+	X[i] = exp2(logLower + (logUpper - logLower) * i / binsNumber);
+	if(X[i] > upper) X[i] = upper; // rounding of exp2
+	else if(X[i] < lower) X[i] = lower;
       }
+    X[0] = lower,X[binsNumber] = upper;
+
+    _LogBucket<IN> aBucket;
+    aBucket.edges = &X[0];
+    aBucket.nbBins = binsNumber;
+    aBucket.logLower = logLower;
+    aBucket.invStep = logUpper > logLower ? binsNumber / (logUpper - logLower) : 0.;
+    _histo(data,nbElem,binsNumber,aBucket,Y);
+    return true;
   }
 
+  /**
+   * @brief histogram on user bins
+   * @param edges monotonic increasing bin edges, the last bin include its upper edge
+   * @param nbEdges number of edges (number of bins + 1)
+   */
+  template<class IN>
+  static void histo_edges(const IN *data,int nbElem,std::vector<int> &Y,
+			  const double *edges,int nbEdges)
+  {
+    if(nbEdges < 2)
+      {
+	Y.clear();
+	return;
+      }
+    _EdgesBucket<IN> aBucket;
+    aBucket.edges = edges;
+    aBucket.nbEdges = nbEdges;
+    _histo(data,nbElem,nbEdges - 1,aBucket,Y);
+  }
+
+  template<class IN>
+  static void _find_minpos_max(const IN *aData,int aNbValue,IN &dataMin,IN &dataMax)
+  {
+    if(aNbValue <= 0)
+      {
+	dataMin = dataMax = IN(0);
+	return;
+      }
+    for(;aNbValue > 1 && *aData != *aData;--aNbValue) ++aData;
+    dataMax = *aData;
+    if(*aData > 0) dataMin = *aData;
+    else dataMin = 0;
+    ++aData;
+    for(int i = 1;i < aNbValue;++i,++aData)
+      {
+	if(*aData > dataMax) dataMax = *aData;
+	if(*aData > 0 && (*aData < dataMin || dataMin == 0)) dataMin = *aData;
+      }
+  }
+
+private:
+  /// @brief histo_full of float types, false for the others
+  template<class IN>
+  static bool _unique_count(const IN*,int,std::vector<int>&,std::vector<IN>&)
+  {
+    return false;
+  }
+  template<class IN>
+  static bool _unique_count_fill(const IN *data,int nbElem,std::vector<int> &Y,
+				 std::vector<IN> &X)
+  {
+    UniqueCount<IN> aCount(data,nbElem);
+    if(!aCount.size()) return true;
+    size_t anYOffset = Y.size(),anXOffset = X.size();
+    Y.resize(anYOffset + aCount.size());
+    X.resize(anXOffset + aCount.size());
+    aCount.fill(&Y[anYOffset],&X[anXOffset]);
+    return true;
+  }
+  static bool _unique_count(const float *data,int nbElem,std::vector<int> &Y,
+			    std::vector<float> &X)
+  {
+    return _unique_count_fill(data,nbElem,Y,X);
+  }
+  static bool _unique_count(const double *data,int nbElem,std::vector<int> &Y,
+			    std::vector<double> &X)
+  {
+    return _unique_count_fill(data,nbElem,Y,X);
+  }
+
+  /// @brief bucket return the bin of a value or -1 if out of range
+  template<class IN>
+  struct _LinearBucket
+  {
+    IN minVal,maxVal;
+    double invStep;
+    inline int operator()(IN val) const
+    {
+      if(!(val <= maxVal && val >= minVal)) return -1; // NaN too
+      double pos = (double(val) - double(minVal)) * invStep;
+      return pos > 0. ? int(pos) : 0; // pos is NaN on infinite range
+    }
+  };
+
+  /// @brief double to IN, integers are clipped to their range
+  template<class IN>
+  static inline IN _saturate(double val)
+  {
+    if(std::numeric_limits<IN>::is_integer)
+      {
+	if(val >= double(std::numeric_limits<IN>::max())) return std::numeric_limits<IN>::max();
+	if(val <= double(std::numeric_limits<IN>::min())) return std::numeric_limits<IN>::min();
+      }
+    return IN(val);
+  }
+
+  /// @brief log2 from the exponent and a 2nd order mantissa fit (+-0.01)
+  static inline double _fast_log2(double val)
+  {
+    unsigned long long bits;
+    memcpy(&bits,&val,sizeof(bits));
+    int exponent = int((bits >> 52) & 0x7ff) - 1023;
+    bits = (bits & 0xfffffffffffffULL) | 0x3ff0000000000000ULL;
+    double mantissa;
+    memcpy(&mantissa,&bits,sizeof(mantissa));
+    mantissa -= 1.;
+    return exponent + mantissa * (1.3465553 - 0.3465553 * mantissa);
+  }
+
+  template<class IN>
+  struct _LogBucket
+  {
+    const double *edges;
+    int nbBins;
+    double logLower;
+    double invStep;
+    inline int operator()(IN val) const
+    {
+      double value = double(val);
+      if(!(value >= edges[0] && value <= edges[nbBins])) return -1;
+      double pos = (_fast_log2(value) - logLower) * invStep;
+      int bin = pos > 0. ? (pos < double(nbBins) ? int(pos) : nbBins - 1) : 0;
+      // fix approximation on edges
+      while(bin > 0 && value < edges[bin]) --bin;
+      while(bin < nbBins - 1 && value >= edges[bin + 1]) ++bin;
+      return bin;
+    }
+  };
+
+  template<class IN>
+  struct _EdgesBucket
+  {
+    const double *edges;
+    int nbEdges;
+    inline int operator()(IN val) const
+    {
+      double value = double(val);
+      if(!(value >= edges[0] && value <= edges[nbEdges - 1])) return -1;
+      // branchless binary search of the last edge <= value
+      const double *base = edges;
+      int n = nbEdges - 1;
+      while(n > 1)
+	{
+	  int half = n >> 1;
+	  base = (base[half] <= value) ? base + half : base;
+	  n -= half;
+	}
+      int bin = int(base - edges);
+      return bin < nbEdges - 1 ? bin : nbEdges - 2;
+    }
+  };
+
+  template<class IN,class BUCKET>
+  struct _HistoTask
+  {
+    const IN *data;
+    const BUCKET *bucket;
+    int nbBins;
+    std::vector<std::vector<int> > Ys;
+
+    void operator()(int begin,int end,int chunkId)
+    {
+      std::vector<int> &Y = Ys[chunkId];
+      Y.assign(nbBins,0);
+      for(const IN *pt = data + begin,*endPt = data + end;pt != endPt;++pt)
+	{
+	  int bin = (*bucket)(*pt);
+	  if(bin >= 0) ++Y[bin];
+	}
+    }
+  };
+
+  /// @brief parallel bucketing kernel shared by all histograms
+  template<class IN,class BUCKET>
+  static void _histo(const IN *data,int nbElem,int nbBins,
+		     const BUCKET &aBucket,std::vector<int> &Y)
+  {
+    _HistoTask<IN,BUCKET> aTask;
+    aTask.data = data;
+    aTask.bucket = &aBucket;
+    aTask.nbBins = nbBins;
+    aTask.Ys.resize(Parallel::nb_chunks(nbElem));
+    Parallel::run(nbElem,aTask);
+
+    Y.swap(aTask.Ys[0]);
+    for(size_t chunk = 1;chunk < aTask.Ys.size();++chunk)
+      for(int bin = 0;bin < nbBins;++bin)
+	Y[bin] += aTask.Ys[chunk][bin];
+  }
+
+public:
+  /**
+   * @brief find the spots of a frame
+   *
+   * a pixel is part of a spot if it's above the local background
+   * (mean of the (2 * halfWindow + 1)^2 window around) by more than
+   * sigmaFactor times the local standard deviation and by more than
+   * threshold. The spot pixels of a first pass are then left out of the
+   * windows of a second one, which gives the spots. NaN and infinite
+   * pixels are ignored. Connected pixels (8-connectivity) make one spot.
+   * @param data the input frame
+   * @param column,row frame size
+   * @param spots result spots, in raster order of their first pixel
+   * @param minPixels spots smaller than that are ignored
+   */
+  template<class IN>
+  static void find_peaks(const IN *data,int column,int row,std::vector<Spot> &spots,
+			 int halfWindow = 5,double sigmaFactor = 3.,
+			 double threshold = 0.,int minPixels = 1);
 };
 #endif
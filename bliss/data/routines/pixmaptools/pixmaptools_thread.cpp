@@ -0,0 +1,29 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_thread.h"
+#include <unistd.h>
+
+static int _nb_threads = 0;
+
+static int _default_nb_threads()
+{
+  long nbCpu = sysconf(_SC_NPROCESSORS_ONLN);
+  return nbCpu > 0 ? int(nbCpu) : 1;
+}
+
+int Parallel::nb_threads()
+{
+  int nbThreads = __atomic_load_n(&_nb_threads,__ATOMIC_RELAXED);
+  return nbThreads > 0 ? nbThreads : _default_nb_threads();
+}
+
+void Parallel::set_nb_threads(int nbThreads)
+{
+  __atomic_store_n(&_nb_threads,nbThreads > 0 ? nbThreads : 0,__ATOMIC_RELAXED);
+}
@@ -0,0 +1,119 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_THREAD
+#define __PIXMAPTOOLS_THREAD
+
+#include <pthread.h>
+#include <vector>
+
+  //Local lock
+class _Lock
+{
+public:
+  _Lock(pthread_mutex_t *aMutex,bool lockFlag = true) :
+    _mutex(aMutex),_locked(false)
+  {
+    if(lockFlag)
+      lock();
+  }
+  ~_Lock() {unlock();}
+
+  inline void lock()
+  {
+    if(!_locked)
+      while(pthread_mutex_lock(_mutex));
+    _locked = true;
+  }
+
+  inline void unlock()
+  {
+    if(_locked)
+      {
+	_locked = false;
+	pthread_mutex_unlock(_mutex);
+      }
+  }
+private:
+  pthread_mutex_t *_mutex;
+  bool		  _locked;
+};
+
+/** @brief split a loop over several threads.
+ *
+ *  A task is any object with an operator()(int begin,int end,int chunkId),
+ *  each chunk [begin,end) is processed by one thread, the first one
+ *  in the calling thread.
+ */
+class Parallel
+{
+public:
+  /// @brief number of threads used by kernels (default: online cpus)
+  static int  nb_threads();
+  /// @brief set the number of threads, <= 0 restore the default
+  static void set_nb_threads(int);
+
+  /// @brief number of chunks run() will use for nbElem elements
+  static int nb_chunks(int nbElem,int minChunkSize = 0x10000)
+  {
+    int nbChunk = nb_threads();
+    if(minChunkSize < 1) minChunkSize = 1;
+    if(nbElem / minChunkSize < nbChunk)
+      nbChunk = nbElem / minChunkSize;
+    if(nbChunk < 1) nbChunk = 1;
+    return nbChunk;
+  }
+
+  template<class TASK>
+  static void run(int nbElem,TASK &aTask,int minChunkSize = 0x10000)
+  {
+    int nbChunk = nb_chunks(nbElem,minChunkSize);
+    if(nbChunk == 1)
+      {
+	aTask(0,nbElem,0);
+	return;
+      }
+    std::vector<_Chunk<TASK> > chunks(nbChunk);
+    std::vector<pthread_t> threads(nbChunk);
+    std::vector<bool> started(nbChunk,false);
+    int chunkSize = nbElem / nbChunk;
+    for(int i = 0;i < nbChunk;++i)
+      {
+	chunks[i].task = &aTask;
+	chunks[i].begin = i * chunkSize;
+	chunks[i].end = (i == nbChunk - 1) ? nbElem : (i + 1) * chunkSize;
+	chunks[i].id = i;
+      }
+    for(int i = 1;i < nbChunk;++i)
+      started[i] = !pthread_create(&threads[i],NULL,_run_chunk<TASK>,&chunks[i]);
+
+    aTask(chunks[0].begin,chunks[0].end,0);
+    for(int i = 1;i < nbChunk;++i)
+      {
+	if(started[i])
+	  pthread_join(threads[i],NULL);
+	else			// can't create thread, do it here
+	  aTask(chunks[i].begin,chunks[i].end,i);
+      }
+  }
+private:
+  template<class TASK>
+  struct _Chunk
+  {
+    TASK *task;
+    int  begin,end,id;
+  };
+  template<class TASK>
+  static void* _run_chunk(void *arg)
+  {
+    _Chunk<TASK> *aChunk = (_Chunk<TASK>*)arg;
+    (*aChunk->task)(aChunk->begin,aChunk->end,aChunk->id);
+    return NULL;
+  }
+};
+#endif
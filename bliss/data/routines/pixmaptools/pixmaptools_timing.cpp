@@ -0,0 +1,97 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#include "pixmaptools_timing.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+int Timing::_enabled = 1;
+
+struct _StageRing
+{
+  unsigned long head;		// next sample position, never wraps back
+  long long total;
+  long long last;
+  long long max;
+  long long samples[Timing::RING_SIZE];
+} __attribute__ ((aligned(64)));	// one cache line set per stage
+
+static _StageRing _rings[Timing::NB_STAGES];
+
+static const char* _names[Timing::NB_STAGES] = {"decode","luma","autoscale",
+						"palette","mapping","put_image",
+						"display"};
+
+void Timing::set_enabled(bool aFlag)
+{
+  __atomic_store_n(&_enabled,aFlag ? 1 : 0,__ATOMIC_RELAXED);
+}
+
+/** @brief clear all stages.
+ *  samples recorded concurrently may be lost or kept
+ */
+void Timing::reset()
+{
+  for(int i = 0;i < NB_STAGES;++i)
+    {
+      _StageRing &aRing = _rings[i];
+      __atomic_store_n(&aRing.head,0UL,__ATOMIC_RELAXED);
+      __atomic_store_n(&aRing.total,0LL,__ATOMIC_RELAXED);
+      __atomic_store_n(&aRing.last,0LL,__ATOMIC_RELAXED);
+      __atomic_store_n(&aRing.max,0LL,__ATOMIC_RELAXED);
+    }
+}
+
+const char* Timing::name(stage aStage)
+{
+  return aStage >= 0 && aStage < NB_STAGES ? _names[aStage] : "unknown";
+}
+
+void Timing::record(stage aStage,long long duration)
+{
+  _StageRing &aRing = _rings[aStage];
+  unsigned long pos = __atomic_fetch_add(&aRing.head,1UL,__ATOMIC_RELAXED);
+  __atomic_store_n(&aRing.samples[pos & (RING_SIZE - 1)],duration,__ATOMIC_RELAXED);
+  __atomic_fetch_add(&aRing.total,duration,__ATOMIC_RELAXED);
+  __atomic_store_n(&aRing.last,duration,__ATOMIC_RELAXED);
+  long long aMax = __atomic_load_n(&aRing.max,__ATOMIC_RELAXED);
+  while(duration > aMax &&
+	!__atomic_compare_exchange_n(&aRing.max,&aMax,duration,true,
+				     __ATOMIC_RELAXED,__ATOMIC_RELAXED));
+}
+
+/** @brief read a stage statistics.
+ *  percentiles are nearest rank over the samples in the ring,
+ *  a sample being written may be read as its previous value
+ */
+void Timing::get_stat(stage aStage,Stat &aStat)
+{
+  memset(&aStat,0,sizeof(Stat));
+  if(aStage < 0 || aStage >= NB_STAGES) return;
+
+  _StageRing &aRing = _rings[aStage];
+  unsigned long head = __atomic_load_n(&aRing.head,__ATOMIC_RELAXED);
+  aStat.count = (long long)head;
+  aStat.total = __atomic_load_n(&aRing.total,__ATOMIC_RELAXED);
+  aStat.last = __atomic_load_n(&aRing.last,__ATOMIC_RELAXED);
+  aStat.max = __atomic_load_n(&aRing.max,__ATOMIC_RELAXED);
+
+  int nbSamples = head < (unsigned long)RING_SIZE ? int(head) : RING_SIZE;
+  if(!nbSamples) return;
+  std::vector<long long> samples(nbSamples);
+  for(int i = 0;i < nbSamples;++i)
+    samples[i] = __atomic_load_n(&aRing.samples[i],__ATOMIC_RELAXED);
+
+  int p50 = (nbSamples * 50 + 99) / 100 - 1;
+  int p99 = (nbSamples * 99 + 99) / 100 - 1;
+  std::nth_element(samples.begin(),samples.begin() + p50,samples.end());
+  aStat.p50 = samples[p50];
+  std::nth_element(samples.begin() + p50,samples.begin() + p99,samples.end());
+  aStat.p99 = samples[p99];
+}
@@ -0,0 +1,81 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_TIMING
+#define __PIXMAPTOOLS_TIMING
+
+#include <time.h>
+
+/** @brief per stage timers of the video display pipeline
+ *
+ *  Each stage keeps a lock-free ring of its last RING_SIZE durations
+ *  plus running totals, kernels record into it from any thread.
+ *  Stages may nest: DECODE covers the whole raw_video_2_image call,
+ *  so it includes LUMA, PALETTE and MAPPING of COLOR_MAPPED frames.
+ *  Timing is on by default, when disabled a Scope costs one relaxed load.
+ */
+class Timing
+{
+public:
+  enum stage {DECODE,		// LUT::raw_video_2_image
+	      LUMA,		// luma computation of color/bayer frames
+	      AUTOSCALE,	// Scaling::autoscale_*
+	      PALETTE,		// palette derivation in LUT::map
+	      MAPPING,		// data -> palette index in LUT::map
+	      PUT_IMAGE,	// IO::putImage
+	      DISPLAY,		// DisplayWorker, raw frame pushed -> image ready
+	      NB_STAGES};
+  enum {RING_SIZE = 1024};	// power of 2
+
+  /// durations in nanoseconds, percentiles over the samples still in the ring
+  struct Stat
+  {
+    long long count;		///< number of calls since last reset
+    long long total;
+    long long last;
+    long long max;
+    long long p50;
+    long long p99;
+  };
+
+  static inline bool enabled() {return __atomic_load_n(&_enabled,__ATOMIC_RELAXED);}
+  static void set_enabled(bool);
+  /// @brief clear all stages
+  static void reset();
+
+  static const char* name(stage);
+  static void get_stat(stage,Stat&);
+
+  /// @brief monotonic clock in nanoseconds (vDSO, TSC backed on x86)
+  static inline long long now()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+  }
+  static void record(stage,long long duration);
+
+  /// @brief time the enclosing block
+  class Scope
+  {
+  public:
+    explicit Scope(stage aStage) :
+      _stage(aStage),_start(enabled() ? now() : -1) {}
+    ~Scope()
+    {
+      if(_start >= 0)
+	record(_stage,now() - _start);
+    }
+  private:
+    stage	_stage;
+    long long	_start;
+  };
+private:
+  static int _enabled;
+};
+#endif
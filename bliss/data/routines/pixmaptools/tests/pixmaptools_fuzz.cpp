@@ -0,0 +1,681 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/** @brief differential fuzzing of the LUT and Stat kernels
+ *
+ *  Each case is decoded from a few bytes: kernel, data type, frame size
+ *  (odd and degenerated sizes included), value distribution (extreme
+ *  values, NaN, infinities, negative ranges...), mapping method and
+ *  number of threads. The optimized kernel result is compared to the
+ *  naive one of pixmaptools_reference.h, the first difference aborts.
+ *
+ *  Built as a standalone program it runs random cases:
+ *    pixmaptools_fuzz [--iterations n] [--seed s]
+ *  Built with -DPIXMAPTOOLS_LIBFUZZER it's a libFuzzer target.
+ */
+
+#include "pixmaptools_lut.h"
+#include "pixmaptools_stat.h"
+#include "pixmaptools_thread.h"
+#include "pixmaptools_reference.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// @brief parameters of a case are read from the fuzzer bytes (0 when exhausted)
+class FuzzInput
+{
+public:
+  FuzzInput(const uint8_t *data,size_t size) : _data(data),_size(size),_pos(0) {}
+
+  unsigned int byte() {return _pos < _size ? _data[_pos++] : 0;}
+  unsigned int u32()
+  {
+    unsigned int val = 0;
+    for(int i = 0;i < 4;++i) val = (val << 8) | byte();
+    return val;
+  }
+  unsigned int choice(unsigned int nb) {return byte() % nb;}
+private:
+  const uint8_t *_data;
+  size_t	_size;
+  size_t	_pos;
+};
+
+/// @brief xorshift, pixel values are generated from a seed of the case
+class Random
+{
+public:
+  explicit Random(unsigned long long seed) : _state(seed * 2654435761ULL + 0x9e3779b97f4a7c15ULL) {}
+  unsigned long long next()
+  {
+    _state ^= _state << 13;
+    _state ^= _state >> 7;
+    _state ^= _state << 17;
+    return _state;
+  }
+private:
+  unsigned long long _state;
+};
+
+static const char *_kernel_name = "";
+static std::string _case;
+
+static void _fail(const char *what,long index,double got,double expected)
+{
+  fprintf(stderr,"MISMATCH %s [%s] %s at %ld: got %.17g expected %.17g\n",
+	  _kernel_name,_case.c_str(),what,index,got,expected);
+  abort();
+}
+
+template<class IN>
+static bool _same(IN a,IN b)
+{
+  return a == b || (a != a && b != b);
+}
+
+enum Distribution {UNIFORM_BITS,NARROW,EXTREMES,CONSTANT,CENTERED,SPRINKLED,NB_DISTRIBUTIONS};
+static const char *DISTRIBUTION_NAMES[] = {"bits","narrow","extremes","constant","centered","sprinkled"};
+
+template<class IN>
+static IN _extreme(unsigned long long r)
+{
+  typedef std::numeric_limits<IN> lim;
+  switch(r % 11)
+    {
+    case 0: return lim::max();
+    case 1: return lim::min();	// smallest positive for floats
+    case 2: return lim::is_integer ? lim::min() : -lim::max();
+    case 3: return IN(0);
+    case 4: return IN(1);
+    case 5: return lim::is_signed ? IN(-1) : IN(2);
+    case 6: return lim::has_quiet_NaN ? lim::quiet_NaN() : IN(lim::max() - 1);
+    case 7: return lim::has_infinity ? lim::infinity() : IN(lim::max() / 2);
+    case 8: return lim::has_infinity ? IN(-lim::infinity()) : IN(lim::min() + 1);
+    case 9: return lim::has_denorm ? lim::denorm_min() : IN(3);
+    default: return lim::epsilon();
+    }
+}
+
+template<class IN>
+static IN _random_bits(Random &aRandom)
+{
+  unsigned long long bits = aRandom.next();
+  IN val;
+  memcpy(&val,&bits,sizeof(IN));
+  return val;
+}
+
+template<class IN>
+static void _fill(std::vector<IN> &data,int nbElem,Distribution dist,Random &aRandom)
+{
+  data.resize(nbElem);
+  IN offset = _random_bits<IN>(aRandom);
+  if(offset != offset) offset = IN(0);
+  if(!std::numeric_limits<IN>::is_integer && !(std::fabs(double(offset)) < 1e30))
+    offset = IN(1e3);
+  for(int i = 0;i < nbElem;++i)
+    {
+      unsigned long long r = aRandom.next();
+      switch(dist)
+	{
+	case UNIFORM_BITS: data[i] = _random_bits<IN>(aRandom);break;
+	case NARROW:
+	  {
+	    IN delta = IN(r % 16);
+	    data[i] = offset <= std::numeric_limits<IN>::max() - delta ? IN(offset + delta) : offset;
+	  }
+	  break;
+	case EXTREMES: data[i] = _extreme<IN>(r);break;
+	case CONSTANT: data[i] = offset;break;
+	case CENTERED:
+	  if(std::numeric_limits<IN>::is_signed)
+	    {
+	      long span = sizeof(IN) == 1 ? 100 : 1000;
+	      data[i] = IN(double(long(r % (2 * span + 1)) - span) / (std::numeric_limits<IN>::is_integer ? 1. : 7.));
+	    }
+	  else
+	    data[i] = IN(r % 200);
+	  break;
+	default:		// SPRINKLED
+	  data[i] = (r & 0x3f) ? IN(r % 1000) : _extreme<IN>(r >> 8);
+	  break;
+	}
+    }
+}
+
+// MAP
+
+static LUT::Palette& _identity_palette()
+{
+  static LUT::Palette *aPalette = NULL;
+  if(!aPalette)
+    {
+      std::vector<unsigned int> identity(0x10000);
+      for(int i = 0;i < 0x10000;++i) identity[i] = i;
+      aPalette = new LUT::Palette(LUT::Palette::USER);
+      aPalette->setPaletteData(&identity[0],sizeof(unsigned int) * 0x10000);
+    }
+  return *aPalette;
+}
+
+template<class IN>
+static void _check_map(const IN *data,const std::vector<unsigned int> &image,int nbElem,
+		       LUT::mapping_meth meth,IN dataMin,IN dataMax)
+{
+  for(int i = 0;i < nbElem;++i)
+    {
+      double tolerance;
+      int expected = Reference::map_index(data[i],dataMin,dataMax,meth,&tolerance);
+      int got = int(image[i]);
+      // optimized paths may round the other way or lose precision on narrow ranges
+      if(fabs(double(got - expected)) > tolerance)
+	{
+	  fprintf(stderr,"value %.17g dataMin %.17g dataMax %.17g\n",
+		  double(data[i]),double(dataMin),double(dataMax));
+	  _fail("palette index",i,got,expected);
+	}
+    }
+}
+
+enum Kernel {K_MAP,K_MAP_MIN_MAX,K_MAP_SIGMA,K_HISTO,K_HISTO_LOG,K_HISTO_EDGES,K_HISTO_FULL,
+	     K_FIND_PEAKS,K_RAW_VIDEO_2_IMAGE,K_RAW_VIDEO_2_LUMA,NB_KERNELS};
+static const char *KERNEL_NAMES[] = {"map","map_on_min_max_val","map_on_plus_minus_sigma",
+				     "histo","histo_log","histo_edges","histo_full","find_peaks",
+				     "raw_video_2_image","raw_video_2_luma"};
+
+template<class IN>
+static void _fuzz_type(FuzzInput &anInput,Kernel aKernel,int column,int row,Random &aRandom)
+{
+  int nbElem = column * row;
+  Distribution dist = Distribution(anInput.choice(NB_DISTRIBUTIONS));
+  _case += std::string(" dist=") + DISTRIBUTION_NAMES[dist];
+  std::vector<IN> data;
+  _fill(data,nbElem,dist,aRandom);
+
+  static const LUT::mapping_meth meths[] = {LUT::LINEAR,LUT::LOG,LUT::SHIFT_LOG};
+  static const char *methNames[] = {"LINEAR","LOG","SHIFT_LOG"};
+  int methId = anInput.choice(3);
+  LUT::mapping_meth meth = meths[methId];
+
+  switch(aKernel)
+    {
+    case K_MAP:
+      {
+	_case += std::string(" meth=") + methNames[methId];
+	IN dataMin,dataMax;
+	if(anInput.choice(2))
+	  Reference::find_min_max(&data[0],nbElem,dataMin,dataMax,meth == LUT::LOG);
+	else
+	  {
+	    dataMin = data[anInput.u32() % nbElem],dataMax = data[anInput.u32() % nbElem];
+	    if(dataMax < dataMin && anInput.choice(4)) std::swap(dataMin,dataMax);
+	  }
+	std::vector<unsigned int> image(nbElem);
+	LUT::map(&data[0],&image[0],column,row,_identity_palette(),meth,dataMin,dataMax);
+	_check_map(&data[0],image,nbElem,meth,dataMin,dataMax);
+      }
+      break;
+    case K_MAP_MIN_MAX:
+      {
+	_case += std::string(" meth=") + methNames[methId];
+	std::vector<unsigned int> image(nbElem);
+	IN dataMin,dataMax,refMin,refMax;
+	LUT::map_on_min_max_val(&data[0],&image[0],column,row,_identity_palette(),meth,
+				dataMin,dataMax);
+	Reference::find_min_max(&data[0],nbElem,refMin,refMax,meth == LUT::LOG);
+	if(!_same(dataMin,refMin)) _fail("dataMin",-1,dataMin,refMin);
+	if(!_same(dataMax,refMax)) _fail("dataMax",-1,dataMax,refMax);
+	_check_map(&data[0],image,nbElem,meth,dataMin,dataMax);
+      }
+      break;
+    case K_MAP_SIGMA:
+      {
+	_case += std::string(" meth=") + methNames[methId];
+	double sigma = 0.5 * (1 + anInput.choice(8));
+	std::vector<unsigned int> image(nbElem);
+	IN dataMin,dataMax,refMin,refMax;
+	LUT::map_on_plus_minus_sigma(&data[0],&image[0],column,row,_identity_palette(),meth,
+				     sigma,dataMin,dataMax);
+	Reference::sigma_range(&data[0],nbElem,meth,sigma,refMin,refMax);
+	if(!_same(dataMin,refMin)) _fail("dataMinUse4LookUp",-1,dataMin,refMin);
+	if(!_same(dataMax,refMax)) _fail("dataMaxUse4LookUp",-1,dataMax,refMax);
+	_check_map(&data[0],image,nbElem,meth,dataMin,dataMax);
+      }
+      break;
+    case K_HISTO:
+      {
+	int bins = 1 + anInput.choice(300);
+	IN lower = IN(0),upper = IN(0);
+	if(anInput.choice(2))
+	  {
+	    lower = data[anInput.u32() % nbElem],upper = data[anInput.u32() % nbElem];
+	    if(upper < lower) std::swap(lower,upper);
+	  }
+	std::vector<int> Y,refY;
+	std::vector<IN> X,refX;
+	Stat::histo(&data[0],nbElem,Y,X,bins,lower,upper);
+	Reference::histo(&data[0],nbElem,refY,refX,bins,lower,upper);
+	if(Y.size() != refY.size()) _fail("nb bins",-1,Y.size(),refY.size());
+	if(X.size() != refX.size()) _fail("nb edges",-1,X.size(),refX.size());
+	for(size_t i = 0;i < Y.size();++i)
+	  if(Y[i] != refY[i]) _fail("count",i,Y[i],refY[i]);
+	for(size_t i = 0;i < X.size();++i)
+	  if(!_same(X[i],refX[i])) _fail("edge",i,X[i],refX[i]);
+      }
+      break;
+    case K_HISTO_LOG:
+      {
+	int bins = 1 + anInput.choice(300);
+	double lower = 0.,upper = 0.;
+	if(anInput.choice(2))
+	  {
+	    lower = double(data[anInput.u32() % nbElem]),upper = double(data[anInput.u32() % nbElem]);
+	    if(upper < lower) std::swap(lower,upper);
+	  }
+	bool aValidRange;
+	if(lower == upper && lower == 0.)
+	  {
+	    aValidRange = false;
+	    for(int i = 0;i < nbElem && !aValidRange;++i)
+	      aValidRange = data[i] > 0;
+	  }
+	else
+	  aValidRange = lower > 0. && upper >= lower;
+	std::vector<int> Y,refY;
+	std::vector<double> X;
+	if(Stat::histo_log(&data[0],nbElem,Y,X,bins,lower,upper) != aValidRange)
+	  _fail("valid range",-1,!aValidRange,aValidRange);
+	if(!aValidRange)
+	  {
+	    if(!Y.empty() || !X.empty()) _fail("nb edges",-1,X.size(),0);
+	    break;
+	  }
+	if(int(X.size()) != bins + 1) _fail("nb edges",-1,X.size(),bins + 1);
+	for(int i = 1;i <= bins;++i)
+	  if(X[i] < X[i - 1]) _fail("edges order",i,X[i],X[i - 1]);
+	Reference::histo_edges(&data[0],nbElem,refY,&X[0],int(X.size()));
+	if(Y.size() != refY.size()) _fail("nb bins",-1,Y.size(),refY.size());
+	for(size_t i = 0;i < Y.size();++i)
+	  if(Y[i] != refY[i]) _fail("count",i,Y[i],refY[i]);
+      }
+      break;
+    case K_HISTO_EDGES:
+      {
+	int nbEdges = anInput.choice(40);
+	std::vector<double> edges(nbEdges);
+	for(int i = 0;i < nbEdges;++i)
+	  {
+	    edges[i] = double(data[aRandom.next() % nbElem]);
+	    if(edges[i] != edges[i]) edges[i] = 0.;
+	  }
+	std::sort(edges.begin(),edges.end());
+	std::vector<int> Y,refY;
+	Stat::histo_edges(&data[0],nbElem,Y,nbEdges ? &edges[0] : NULL,nbEdges);
+	Reference::histo_edges(&data[0],nbElem,refY,nbEdges ? &edges[0] : NULL,nbEdges);
+	if(Y.size() != refY.size()) _fail("nb bins",-1,Y.size(),refY.size());
+	for(size_t i = 0;i < Y.size();++i)
+	  if(Y[i] != refY[i]) _fail("count",i,Y[i],refY[i]);
+      }
+      break;
+    case K_HISTO_FULL:
+      {
+	std::vector<int> Y,refY;
+	std::vector<IN> X,refX;
+	Stat::histo_full(&data[0],nbElem,Y,X);
+	Reference::histo_full(&data[0],nbElem,refY,refX);
+	if(Y.size() != refY.size()) _fail("nb values",-1,Y.size(),refY.size());
+	for(size_t i = 0;i < Y.size();++i)
+	  {
+	    if(Y[i] != refY[i]) _fail("count",i,Y[i],refY[i]);
+	    if(!_same(X[i],refX[i])) _fail("value",i,X[i],refX[i]);
+	  }
+      }
+      break;
+    case K_FIND_PEAKS:
+      {
+	static const double thresholds[] = {0.,0.5,3.,100.};
+	int halfWindow = 1 + anInput.choice(6);
+	double sigmaFactor = 0.5 * (1 + anInput.choice(8));
+	double threshold = thresholds[anInput.choice(4)];
+	int minPixels = 1 + anInput.choice(3);
+	char buffer[96];
+	snprintf(buffer,sizeof(buffer)," window=%d sigma=%g threshold=%g min=%d",
+		 halfWindow,sigmaFactor,threshold,minPixels);
+	_case += buffer;
+	std::vector<Stat::Spot> spots,refSpots;
+	double scale;
+	if(!Reference::find_peaks(&data[0],column,row,refSpots,
+				  halfWindow,sigmaFactor,threshold,minPixels,scale))
+	  break;		// a pixel on the detection limit
+	Stat::find_peaks(&data[0],column,row,spots,halfWindow,sigmaFactor,threshold,minPixels);
+	if(spots.size() != refSpots.size()) _fail("nb spots",-1,spots.size(),refSpots.size());
+	double tolerance = 1e-6 * scale;
+	for(size_t i = 0;i < spots.size();++i)
+	  {
+	    const Stat::Spot &aSpot = spots[i],&aRefSpot = refSpots[i];
+	    if(aSpot.nb_pixels != aRefSpot.nb_pixels)
+	      _fail("nb pixels",i,aSpot.nb_pixels,aRefSpot.nb_pixels);
+	    if(aSpot.peak_x != aRefSpot.peak_x) _fail("peak x",i,aSpot.peak_x,aRefSpot.peak_x);
+	    if(aSpot.peak_y != aRefSpot.peak_y) _fail("peak y",i,aSpot.peak_y,aRefSpot.peak_y);
+	    if(aSpot.max_value != aRefSpot.max_value)
+	      _fail("max",i,aSpot.max_value,aRefSpot.max_value);
+	    if(!(fabs(aSpot.background - aRefSpot.background) <= tolerance))
+	      _fail("background",i,aSpot.background,aRefSpot.background);
+	    double intensityTolerance = tolerance * aSpot.nb_pixels;
+	    if(!(fabs(aSpot.intensity - aRefSpot.intensity) <= intensityTolerance))
+	      _fail("intensity",i,aSpot.intensity,aRefSpot.intensity);
+	    // centroid weights are off by the background error at most
+	    double xyTolerance = 1e-9;
+	    if(aRefSpot.intensity > intensityTolerance)
+	      xyTolerance += (column + row) * intensityTolerance /
+		(aRefSpot.intensity - intensityTolerance);
+	    else
+	      xyTolerance = column + row;
+	    if(!(fabs(aSpot.x - aRefSpot.x) <= xyTolerance)) _fail("x",i,aSpot.x,aRefSpot.x);
+	    if(!(fabs(aSpot.y - aRefSpot.y) <= xyTolerance)) _fail("y",i,aSpot.y,aRefSpot.y);
+	  }
+      }
+      break;
+    default:
+      break;
+    }
+}
+
+// RAW VIDEO
+
+struct VideoType
+{
+  LUT::Scaling::image_type type;
+  const char *name;
+  int bytesPerPixel2;		// bytes per 2 pixels
+};
+
+static const VideoType VIDEO_TYPES[] = {
+  {LUT::Scaling::Y8,"Y8",2},
+  {LUT::Scaling::Y16,"Y16",4},
+  {LUT::Scaling::Y32,"Y32",8},
+  {LUT::Scaling::I420,"I420",3},
+  {LUT::Scaling::RGB555,"RGB555",4},
+  {LUT::Scaling::RGB565,"RGB565",4},
+  {LUT::Scaling::RGB24,"RGB24",6},
+  {LUT::Scaling::RGB32,"RGB32",8},
+  {LUT::Scaling::BGR24,"BGR24",6},
+  {LUT::Scaling::BGR32,"BGR32",8},
+  {LUT::Scaling::BAYER_RG8,"BAYER_RG8",2},
+  {LUT::Scaling::BAYER_RG16,"BAYER_RG16",4},
+  {LUT::Scaling::BAYER_BG8,"BAYER_BG8",2},
+  {LUT::Scaling::BAYER_BG16,"BAYER_BG16",4},
+  {LUT::Scaling::YUV422,"YUV422",4},
+  {LUT::Scaling::YUV422PACKED,"YUV422PACKED",4},
+};
+static const int NB_VIDEO_TYPES = sizeof(VIDEO_TYPES) / sizeof(VideoType);
+
+static void _check_image(const std::vector<unsigned int> &image,
+			 const std::vector<unsigned int> &expected)
+{
+  for(size_t i = 0;i < expected.size();++i)
+    if(image[i] != expected[i])
+      _fail("pixel",i,image[i],expected[i]);
+}
+
+/// @brief expected color of the luma mapped on the greyscale palette
+template<class IN>
+static void _check_color_mapped(const std::vector<unsigned int> &image,const IN *luma,int nbElem,
+				IN dataMin,IN dataMax)
+{
+  static unsigned int *grey = NULL;
+  if(!grey)
+    {
+      int aSize;
+      LUT::Palette(LUT::Palette::GREYSCALE).getPaletteData(grey,aSize);
+    }
+  for(int i = 0;i < nbElem;++i)
+    {
+      int index = Reference::map_index(luma[i],dataMin,dataMax,LUT::LINEAR);
+      bool ok = image[i] == grey[index] ||
+	(index > 0 && image[i] == grey[index - 1]) ||
+	(index < 0xffff && image[i] == grey[index + 1]);
+      if(!ok) _fail("color mapped pixel",i,image[i],grey[index]);
+    }
+}
+
+static void _fuzz_video(FuzzInput &anInput,Kernel aKernel,int column,int row,Random &aRandom)
+{
+  const VideoType &aType = VIDEO_TYPES[anInput.choice(NB_VIDEO_TYPES)];
+  LUT::Scaling::image_type type = aType.type;
+  if(type == LUT::Scaling::I420)	// 2x2 chroma blocks
+    column = (column + 1) & ~1,row = (row + 1) & ~1;
+  int nbPixel = column * row;
+  _case += std::string(" type=") + aType.name;
+
+  Distribution dist = Distribution(anInput.choice(NB_DISTRIBUTIONS));
+  _case += std::string(" dist=") + DISTRIBUTION_NAMES[dist];
+  std::vector<unsigned char> data;
+  _fill(data,(nbPixel * aType.bytesPerPixel2 + 1) / 2,dist,aRandom);
+  bool is16 = Reference::is_16bits(type);
+  if(is16)			// 16 bits samples
+    {
+      std::vector<unsigned short> samples;
+      _fill(samples,nbPixel,dist,aRandom);
+      memcpy(&data[0],&samples[0],nbPixel * 2);
+    }
+
+  if(aKernel == K_RAW_VIDEO_2_LUMA)
+    {
+      unsigned char *luma = LUT::raw_video_2_luma(&data[0],column,row,type);
+      std::vector<unsigned char> expected;
+      Reference::raw_video_2_luma(&data[0],expected,column,row,type);
+      if(!luma != expected.empty()) _fail("supported",-1,luma != NULL,!expected.empty());
+      for(size_t i = 0;i < expected.size();++i)
+	if(luma[i] != expected[i]) _fail("luma",i,luma[i],expected[i]);
+      free(luma);
+      return;
+    }
+
+  static const LUT::Scaling::mode modes[] = {LUT::Scaling::UNACTIVE,LUT::Scaling::QUICK,
+					     LUT::Scaling::COLOR_MAPPED};
+  static const char *modeNames[] = {"UNACTIVE","QUICK","COLOR_MAPPED"};
+  int modeId = anInput.choice(3);
+  LUT::Scaling::mode aMode = modes[modeId];
+  if(type == LUT::Scaling::YUV422PACKED && aMode == LUT::Scaling::QUICK) // not implemented
+    aMode = LUT::Scaling::UNACTIVE,modeId = 0;
+  _case += std::string(" mode=") + modeNames[modeId];
+
+  // mapping must be in the range of the samples
+  double range = is16 ? 65535. : 255.;
+  double minValue = anInput.choice(4) ? double(anInput.u32() % (unsigned int)(range + 1)) : 0.;
+  double maxValue = double(anInput.u32() % (unsigned int)(range + 1));
+  if(maxValue < minValue) std::swap(minValue,maxValue);
+  LUT::Scaling aScaling;
+  aScaling.set_custom_mapping(minValue,maxValue);
+  aScaling.set_mode(aMode);
+
+  std::vector<unsigned int> image(nbPixel);
+  bool supported = LUT::raw_video_2_image(&data[0],&image[0],column,row,type,aScaling);
+  bool scaled = aMode != LUT::Scaling::UNACTIVE;
+  std::vector<unsigned int> expected;
+  switch(type)
+    {
+    case LUT::Scaling::Y8:
+      if(scaled)
+	_check_color_mapped(image,&data[0],nbPixel,uchar(minValue),uchar(maxValue));
+      else
+	{
+	  for(int i = 0;i < nbPixel;++i)
+	    expected.push_back(Reference::bgra(data[i],data[i],data[i]));
+	  _check_image(image,expected);
+	}
+      break;
+    case LUT::Scaling::Y16:
+      {
+	const unsigned short *samples = (const unsigned short*)&data[0];
+	if(scaled)
+	  _check_color_mapped(image,samples,nbPixel,
+			      (unsigned short)minValue,(unsigned short)maxValue);
+	else
+	  {
+	    for(int i = 0;i < nbPixel;++i)
+	      expected.push_back(Reference::bgra(samples[i] >> 8,samples[i] >> 8,samples[i] >> 8));
+	    _check_image(image,expected);
+	  }
+      }
+      break;
+    case LUT::Scaling::I420:
+      if(aMode == LUT::Scaling::COLOR_MAPPED)
+	_check_color_mapped(image,&data[0],nbPixel,uchar(minValue),uchar(maxValue));
+      else
+	{
+	  Reference::i420_2_image(&data[0],expected,column,row,scaled,minValue,maxValue);
+	  _check_image(image,expected);
+	}
+      break;
+    case LUT::Scaling::YUV422PACKED:
+      if(aMode == LUT::Scaling::COLOR_MAPPED)
+	{
+	  std::vector<unsigned char> luma(nbPixel);
+	  for(int i = 0;i < nbPixel;++i) luma[i] = data[2 * i + 1];
+	  _check_color_mapped(image,&luma[0],nbPixel,uchar(minValue),uchar(maxValue));
+	}
+      else
+	{
+	  Reference::yuv422_packed_2_image(&data[0],expected,column,row);
+	  _check_image(image,expected);
+	}
+      break;
+    case LUT::Scaling::BAYER_RG8:
+    case LUT::Scaling::BAYER_BG8:
+      if(aMode == LUT::Scaling::COLOR_MAPPED)
+	{
+	  std::vector<unsigned char> luma;
+	  Reference::bayer_2_luma(&data[0],luma,column,row,type);
+	  _check_color_mapped(image,&luma[0],nbPixel,uchar(minValue),uchar(maxValue));
+	}
+      else
+	{
+	  Reference::bayer_2_image(&data[0],expected,column,row,type,scaled,minValue,maxValue);
+	  _check_image(image,expected);
+	}
+      break;
+    case LUT::Scaling::BAYER_RG16:
+    case LUT::Scaling::BAYER_BG16:
+      {
+	const unsigned short *samples = (const unsigned short*)&data[0];
+	if(aMode == LUT::Scaling::COLOR_MAPPED)
+	  {
+	    std::vector<unsigned short> luma;
+	    Reference::bayer_2_luma(samples,luma,column,row,type);
+	    _check_color_mapped(image,&luma[0],nbPixel,
+				(unsigned short)minValue,(unsigned short)maxValue);
+	  }
+	else
+	  {
+	    Reference::bayer_2_image(samples,expected,column,row,type,scaled,minValue,maxValue);
+	    _check_image(image,expected);
+	  }
+      }
+      break;
+    default:
+      if(Reference::is_rgb(type))
+	{
+	  Reference::rgb_2_image(&data[0],expected,column,row,type,scaled,minValue,maxValue);
+	  _check_image(image,expected);
+	}
+      else if(supported)
+	_fail("supported",-1,supported,false);
+      break;
+    }
+}
+
+static void _run_case(const uint8_t *bytes,size_t size)
+{
+  FuzzInput anInput(bytes,size);
+  Kernel aKernel = Kernel(anInput.choice(NB_KERNELS));
+  _kernel_name = KERNEL_NAMES[aKernel];
+
+  // odd, single line/column and (1 / 8) frames big enough for several threads chunks
+  int column,row;
+  if(anInput.choice(8))
+    column = 1 + anInput.choice(48),row = 1 + anInput.choice(48);
+  else
+    column = 1 + anInput.u32() % 700,row = 1 + anInput.u32() % 300;
+  int nbThreads = 1 + anInput.choice(4);
+  Parallel::set_nb_threads(nbThreads);
+  Random aRandom(anInput.u32());
+
+  char buffer[64];
+  snprintf(buffer,sizeof(buffer),"%dx%d threads=%d",column,row,nbThreads);
+  _case = buffer;
+
+  if(aKernel == K_RAW_VIDEO_2_IMAGE || aKernel == K_RAW_VIDEO_2_LUMA)
+    {
+      _fuzz_video(anInput,aKernel,column,row,aRandom);
+      return;
+    }
+  static const char *typeNames[] = {"int8","uint8","int16","uint16","int32","uint32",
+				    "int64","uint64","float32","float64"};
+  int typeId = anInput.choice(10);
+  _case += std::string(" type=") + typeNames[typeId];
+  switch(typeId)
+    {
+    case 0: _fuzz_type<char>(anInput,aKernel,column,row,aRandom);break;
+    case 1: _fuzz_type<unsigned char>(anInput,aKernel,column,row,aRandom);break;
+    case 2: _fuzz_type<short>(anInput,aKernel,column,row,aRandom);break;
+    case 3: _fuzz_type<unsigned short>(anInput,aKernel,column,row,aRandom);break;
+    case 4: _fuzz_type<int>(anInput,aKernel,column,row,aRandom);break;
+    case 5: _fuzz_type<unsigned int>(anInput,aKernel,column,row,aRandom);break;
+    case 6: _fuzz_type<long>(anInput,aKernel,column,row,aRandom);break;
+    case 7: _fuzz_type<unsigned long>(anInput,aKernel,column,row,aRandom);break;
+    case 8: _fuzz_type<float>(anInput,aKernel,column,row,aRandom);break;
+    default: _fuzz_type<double>(anInput,aKernel,column,row,aRandom);break;
+    }
+}
+
+#ifdef PIXMAPTOOLS_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data,size_t size)
+{
+  _run_case(data,size);
+  return 0;
+}
+#else
+int main(int argc,char **argv)
+{
+  long nbIterations = 2000;
+  unsigned long long seed = 1;
+  for(int i = 1;i < argc;++i)
+    {
+      std::string arg = argv[i];
+      if(arg == "--iterations" && i + 1 < argc)
+	nbIterations = atol(argv[++i]);
+      else if(arg == "--seed" && i + 1 < argc)
+	seed = strtoull(argv[++i],NULL,0);
+      else
+	{
+	  fprintf(stderr,"usage: %s [--iterations n] [--seed s]\n",argv[0]);
+	  return 1;
+	}
+    }
+  Random aRandom(seed);
+  uint8_t bytes[32];
+  for(long i = 0;i < nbIterations;++i)
+    {
+      for(size_t b = 0;b < sizeof(bytes);++b)
+	bytes[b] = uint8_t(aRandom.next() >> 24);
+      _run_case(bytes,sizeof(bytes));
+    }
+  printf("%ld cases OK (seed %llu)\n",nbIterations,seed);
+  return 0;
+}
+#endif
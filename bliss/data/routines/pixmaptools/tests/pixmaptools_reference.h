@@ -0,0 +1,703 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+#ifndef __PIXMAPTOOLS_REFERENCE
+#define __PIXMAPTOOLS_REFERENCE
+
+/** @brief naive implementations of the LUT and Stat kernels
+ *
+ *  One pixel at a time, no cache, no thread, no pointer tricks:
+ *  they define what the optimized kernels must return.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+#include "pixmaptools_lut.h"
+#include "pixmaptools_stat.h"
+
+namespace Reference
+{
+  static const int TOP = 0xffff;
+
+  template<class IN>
+  inline bool is_small_integer()
+  {
+    return std::numeric_limits<IN>::is_integer && sizeof(IN) <= sizeof(short);
+  }
+
+  template<class IN>
+  inline bool is_nan(IN val) {return val != val;}
+
+  /// @brief min and max, NaN are ignored (NaN if all values are NaN)
+  template<class IN>
+  void find_min_max(const IN *data,int nbElem,IN &dataMin,IN &dataMax,bool positive = false)
+  {
+    bool found = false;
+    dataMin = dataMax = IN(0);
+    for(int i = 0;i < nbElem;++i)
+      {
+	IN val = data[i];
+	if(is_nan(val)) continue;
+	if(!found) dataMax = val;
+	else if(val > dataMax) dataMax = val;
+	if(!positive || val > 0)
+	  {
+	    if(!found || (positive && dataMin == 0) || val < dataMin) dataMin = val;
+	  }
+	found = true;
+      }
+    if(!found && nbElem) dataMin = dataMax = data[0];
+  }
+
+  /**
+   * @brief palette index of a value for LUT::map
+   *
+   * dataMin maps to 0 and dataMax to 0xffff. For 8 and 16 bits integers
+   * the lookup table is built on [dataMin,dataMax] shifted to 0 if
+   * dataMin < 0, and for LOG and SHIFT_LOG its first entry is clipped to 1.
+   * For other types SHIFT_LOG shift a range starting <= 0 to start at 1 and
+   * LOG clip the range start to 1 (or 1e-6 for floats).
+   * @param tolerance if not NULL, the index error of a double calculation
+   * (for ranges narrow compared to the values)
+   */
+  template<class IN>
+  int map_index(IN val,IN dataMin,IN dataMax,LUT::mapping_meth meth,double *tolerance = NULL)
+  {
+    if(tolerance) *tolerance = 1.;
+    if(!(dataMin < dataMax)) return val >= dataMax ? TOP : 0;
+    if(val >= dataMax) return TOP;
+    if(!(val > dataMin)) return 0;
+
+    double x = double(val),lo = double(dataMin),hi = double(dataMax);
+    if(is_small_integer<IN>())
+      {
+	if(lo < 0.) x -= lo,hi -= lo,lo = 0.;
+	if(meth != LUT::LINEAR && lo < 1.) lo = 1.;
+      }
+    else if(meth == LUT::SHIFT_LOG)
+      {
+	if(lo <= 0.)
+	  {
+	    double shift = 1. - lo;
+	    x += shift,hi += shift,lo = 1.;
+	  }
+      }
+    else if(meth == LUT::LOG && dataMin <= 0)
+      {
+	IN newMin = dataMin == 0 ? IN(1) : IN(1e-6);
+	if(newMin <= 0) newMin = IN(1);
+	if(!(val > newMin)) return 0;
+	lo = double(newMin);
+      }
+
+    double ratio,error;
+    static const double EPS = 8 * std::numeric_limits<double>::epsilon();
+    if(meth == LUT::LINEAR)
+      {
+	ratio = (x - lo) / (hi - lo);
+	error = EPS * (fabs(x) + fabs(lo)) / (hi - lo);
+      }
+    else
+      {
+	ratio = (log10(x) - log10(lo)) / (log10(hi) - log10(lo));
+	error = EPS * (fabs(log10(x)) + fabs(log10(lo)) + 1.) / (log10(hi) - log10(lo));
+      }
+    if(tolerance && std::isfinite(error)) *tolerance += error * TOP;
+    if(!std::isfinite(ratio) || !std::isfinite(hi - lo)) return 0;
+    double index = floor(ratio * TOP);
+    if(index < 0.) return 0;
+    if(index > TOP) return TOP;
+    return int(index);
+  }
+
+  template<class IN>
+  void map(const IN *data,std::vector<int> &indexes,int nbElem,
+	   LUT::mapping_meth meth,IN dataMin,IN dataMax)
+  {
+    indexes.resize(nbElem);
+    for(int i = 0;i < nbElem;++i)
+      indexes[i] = map_index(data[i],dataMin,dataMax,meth);
+  }
+
+  /// @brief range used by map_on_plus_minus_sigma
+  template<class IN>
+  void sigma_range(const IN *data,int nbElem,LUT::mapping_meth meth,double sigmaFactor,
+		   IN &dataMin,IN &dataMax)
+  {
+    IN minVal,maxVal;
+    find_min_max(data,nbElem,minVal,maxVal,meth == LUT::LOG);
+    double sum = 0.;
+    for(int i = 0;i < nbElem;++i) sum += data[i];
+    double average = sum / nbElem;
+    double sum2 = 0.;
+    for(int i = 0;i < nbElem;++i)
+      sum2 += (data[i] - average) * (data[i] - average);
+    double std = sqrt(sum2 / nbElem);
+
+    double low = average - sigmaFactor * std,high = average + sigmaFactor * std;
+    dataMin = low < double(minVal) ? minVal : IN(low);
+    dataMax = high > double(std::numeric_limits<IN>::max()) ?
+      std::numeric_limits<IN>::max() : IN(high);
+  }
+
+  // HISTOGRAMS
+
+  template<class IN>
+  inline IN saturate(double val)
+  {
+    if(std::numeric_limits<IN>::is_integer)
+      {
+	if(val >= double(std::numeric_limits<IN>::max())) return std::numeric_limits<IN>::max();
+	if(val <= double(std::numeric_limits<IN>::min())) return std::numeric_limits<IN>::min();
+      }
+    return IN(val);
+  }
+
+  /// @brief binsNumber + 1 bins of width (upper - lower) / binsNumber, upper in the last one
+  template<class IN>
+  void histo(const IN *data,int nbElem,std::vector<int> &Y,std::vector<IN> &X,
+	     int binsNumber,IN lower,IN upper)
+  {
+    if(lower == upper && lower == 0)
+      find_min_max(data,nbElem,lower,upper);
+    double step = (double(upper) - double(lower)) / binsNumber;
+    X.clear();
+    for(int i = 0;i < binsNumber;++i)
+      X.push_back(saturate<IN>(double(lower) + step * i));
+    X.push_back(upper);
+
+    double invStep = step > 1e-6 && std::isfinite(step) ? 1. / step : 0.;
+    Y.assign(binsNumber + 1,0);
+    for(int i = 0;i < nbElem;++i)
+      {
+	IN val = data[i];
+	if(!(val >= lower && val <= upper)) continue; // NaN too
+	double pos = (double(val) - double(lower)) * invStep;
+	int bin = pos > 0. ? int(pos) : 0;
+	++Y[bin];
+      }
+  }
+
+  /// @brief bin of each value by linear search in the edges
+  template<class IN>
+  void histo_edges(const IN *data,int nbElem,std::vector<int> &Y,
+		   const double *edges,int nbEdges)
+  {
+    Y.clear();
+    if(nbEdges < 2) return;
+    Y.assign(nbEdges - 1,0);
+    for(int i = 0;i < nbElem;++i)
+      {
+	double val = double(data[i]);
+	if(!(val >= edges[0] && val <= edges[nbEdges - 1])) continue;
+	int bin = 0;
+	for(int e = 1;e < nbEdges - 1;++e)
+	  if(edges[e] <= val) bin = e;
+	++Y[bin];
+      }
+  }
+
+  /// @brief count of each distinct value, the NaN last as one value
+  template<class IN>
+  void histo_full(const IN *data,int nbElem,std::vector<int> &Y,std::vector<IN> &X)
+  {
+    std::map<IN,int> counts;
+    int nbNan = 0;
+    for(int i = 0;i < nbElem;++i)
+      if(is_nan(data[i])) ++nbNan;
+      else ++counts[data[i]];
+    Y.clear(),X.clear();
+    for(typename std::map<IN,int>::const_iterator i = counts.begin();i != counts.end();++i)
+      X.push_back(i->first),Y.push_back(i->second);
+    if(nbNan)
+      X.push_back(std::numeric_limits<IN>::quiet_NaN()),Y.push_back(nbNan);
+  }
+
+  // SPOTS
+
+  /**
+   * @brief mean and standard deviation (two-pass) of the finite pixels of
+   * the window around (x,y) which are not excluded, as Stat::find_peaks
+   * @return the number of pixels used
+   */
+  template<class IN>
+  int window_stat(const IN *data,int column,int row,int x,int y,int halfWindow,
+		  const std::vector<unsigned char> &excluded,double &mean,double &sigma)
+  {
+    int top = std::max(y - halfWindow,0),bottom = std::min(y + halfWindow,row - 1);
+    int left = std::max(x - halfWindow,0),right = std::min(x + halfWindow,column - 1);
+    int nb = 0;
+    double sum = 0.;
+    for(int r = top;r <= bottom;++r)
+      for(int c = left;c <= right;++c)
+	{
+	  double val = double(data[r * column + c]);
+	  if(std::isfinite(val) && !excluded[r * column + c])
+	    sum += val,++nb;
+	}
+    mean = sigma = 0.;
+    if(!nb) return 0;
+    mean = sum / nb;
+    double sum2 = 0.;
+    for(int r = top;r <= bottom;++r)
+      for(int c = left;c <= right;++c)
+	{
+	  double val = double(data[r * column + c]);
+	  if(std::isfinite(val) && !excluded[r * column + c])
+	    sum2 += (val - mean) * (val - mean);
+	}
+    sigma = sqrt(sum2 / nb);
+    return nb;
+  }
+
+  /**
+   * @brief spots of Stat::find_peaks, pixel by pixel then one flood fill
+   * per spot
+   *
+   * The kernel slides its windows, so its mean and sigma are off by a few
+   * ulps of the largest values which went through them: a pixel closer
+   * than that to the detection limit may be decided either way.
+   * @param scale largest finite value of the frame (at least 1)
+   * @return false if a pixel is that close, the spots are then undefined
+   */
+  template<class IN>
+  bool find_peaks(const IN *data,int column,int row,std::vector<Stat::Spot> &spots,
+		  int halfWindow,double sigmaFactor,double threshold,int minPixels,
+		  double &scale)
+  {
+    int nbPixels = column * row;
+    if(halfWindow < 1) halfWindow = 1;
+    spots.clear();
+
+    // largest finite value of the rows and columns up to each pixel,
+    // which went through the sliding windows of the kernel before it
+    std::vector<double> seenMax(nbPixels);
+    scale = 1.;
+    for(int i = 0;i < nbPixels;++i)
+      {
+	double val = double(data[i]);
+	double magnitude = std::isfinite(val) ? std::fabs(val) : 0.;
+	if(i >= column) magnitude = std::max(magnitude,seenMax[i - column]);
+	seenMax[i] = magnitude;
+	scale = std::max(scale,magnitude);
+      }
+    for(int i = 0;i < nbPixels;++i)
+      if(i % column)
+	seenMax[i] = std::max(seenMax[i],seenMax[i - 1]);
+
+    std::vector<unsigned char> excluded(nbPixels,0),selected(nbPixels,0);
+    std::vector<double> background(nbPixels,0.);
+    for(int pass = 0;pass < 2;++pass)
+      {
+	bool found = false;
+	for(int y = 0;y < row;++y)
+	  for(int x = 0;x < column;++x)
+	    {
+	      int i = y * column + x;
+	      double val = double(data[i]);
+	      selected[i] = 0;
+	      if(!std::isfinite(val)) continue;
+	      double mean,sigma;
+	      if(!window_stat(data,column,row,x,y,halfWindow,excluded,mean,sigma))
+		{
+		  // only spot pixels around, keeps its first background
+		  selected[i] = excluded[i];
+		  found = found || selected[i];
+		  continue;
+		}
+	      double limit = std::max(sigmaFactor * sigma,threshold);
+	      int bottom = std::min(y + halfWindow,row - 1);
+	      int right = std::min(x + halfWindow,column - 1);
+	      double seen = std::max(1.,seenMax[bottom * column + right]);
+	      if(std::fabs(val - mean - limit) <= 1e-7 * seen * (1. + sigmaFactor))
+		return false;
+	      selected[i] = val - mean > limit;
+	      found = found || selected[i];
+	      background[i] = mean;
+	    }
+	if(!found) return true;
+	excluded = selected;
+      }
+
+    // spots in raster order of their first pixel
+    std::vector<int> label(nbPixels,-1);
+    for(int first = 0;first < nbPixels;++first)
+      {
+	if(!selected[first] || label[first] >= 0) continue;
+	int spot = int(spots.size());
+	spots.push_back(Stat::Spot());
+	std::vector<int> stack(1,first);
+	label[first] = spot;
+	while(!stack.empty())
+	  {
+	    int i = stack.back();
+	    stack.pop_back();
+	    int x = i % column,y = i / column;
+	    for(int dy = -1;dy <= 1;++dy)
+	      for(int dx = -1;dx <= 1;++dx)
+		{
+		  int nx = x + dx,ny = y + dy;
+		  if(nx < 0 || nx >= column || ny < 0 || ny >= row) continue;
+		  int j = ny * column + nx;
+		  if(selected[j] && label[j] < 0)
+		    label[j] = spot,stack.push_back(j);
+		}
+	  }
+      }
+    for(size_t s = 0;s < spots.size();++s)
+      {
+	Stat::Spot &aSpot = spots[s];
+	aSpot.x = aSpot.y = aSpot.intensity = aSpot.background = 0.;
+	aSpot.max_value = -HUGE_VAL;
+	aSpot.peak_x = aSpot.peak_y = -1;
+	aSpot.nb_pixels = 0;
+      }
+    for(int i = 0;i < nbPixels;++i)
+      {
+	if(label[i] < 0) continue;
+	Stat::Spot &aSpot = spots[label[i]];
+	int x = i % column,y = i / column;
+	double val = double(data[i]);
+	double weight = val - background[i];
+	aSpot.x += weight * x,aSpot.y += weight * y;
+	aSpot.intensity += weight;
+	aSpot.background += background[i];
+	if(val > aSpot.max_value)
+	  aSpot.max_value = val,aSpot.peak_x = x,aSpot.peak_y = y;
+	++aSpot.nb_pixels;
+      }
+    std::vector<Stat::Spot> kept;
+    for(size_t s = 0;s < spots.size();++s)
+      {
+	Stat::Spot aSpot = spots[s];
+	if(aSpot.nb_pixels < minPixels) continue;
+	if(aSpot.intensity > 0.)
+	  aSpot.x /= aSpot.intensity,aSpot.y /= aSpot.intensity;
+	else
+	  aSpot.x = aSpot.peak_x,aSpot.y = aSpot.peak_y;
+	aSpot.background /= aSpot.nb_pixels;
+	kept.push_back(aSpot);
+      }
+    spots.swap(kept);
+    return true;
+  }
+
+  // RAW VIDEO
+
+  inline unsigned int bgra(int red,int green,int blue)
+  {
+    return 0xff000000 | (red << 16) | (green << 8) | blue;
+  }
+
+  inline int clip(int val)
+  {
+    return val < 0 ? 0 : (val > 255 ? 255 : val);
+  }
+
+  /// @brief linear scaling of a pixel component (float as the kernels)
+  struct Scale
+  {
+    Scale(float minValue,float maxValue,float mapmax)
+    {
+      if(int(maxValue) - int(minValue))
+	{
+	  A = mapmax / (maxValue - minValue);
+	  B = -(mapmax * minValue) / (maxValue - minValue);
+	}
+      else
+	A = 1.f,B = 0.f;
+    }
+    float A,B;
+  };
+
+  inline unsigned char luma(int red,int green,int blue)
+  {
+    return ((66 * red + 129 * green + 25 * blue) + 128) >> 8;
+  }
+
+  /**
+   * @brief red,green and blue of a pixel of a packed rgb format
+   * 5 bits components of RGB555 and RGB565 are not expanded to 8 bits
+   */
+  inline void rgb_components(const unsigned char *data,LUT::Scaling::image_type type,
+			     int pixel,int &red,int &green,int &blue)
+  {
+    const unsigned char *p;
+    switch(type)
+      {
+      case LUT::Scaling::RGB555:
+	p = data + 2 * pixel;
+	red = (p[0] >> 2) & 0x1f,green = ((p[0] & 0x03) << 3) | (p[1] >> 5),blue = p[1] & 0x1f;
+	break;
+      case LUT::Scaling::RGB565:
+	p = data + 2 * pixel;
+	red = p[0] >> 3,green = ((p[0] & 0x07) << 3) | (p[1] >> 5),blue = p[1] & 0x1f;
+	break;
+      case LUT::Scaling::RGB24:
+	p = data + 3 * pixel;red = p[0],green = p[1],blue = p[2];break;
+      case LUT::Scaling::RGB32:
+	p = data + 4 * pixel;red = p[0],green = p[1],blue = p[2];break;
+      case LUT::Scaling::BGR24:
+	p = data + 3 * pixel;blue = p[0],green = p[1],red = p[2];break;
+      case LUT::Scaling::BGR32:
+	p = data + 4 * pixel;blue = p[0],green = p[1],red = p[2];break;
+      default:
+	red = green = blue = 0;break;
+      }
+  }
+
+  inline bool is_rgb(LUT::Scaling::image_type type)
+  {
+    return type >= LUT::Scaling::RGB555 && type <= LUT::Scaling::BGR32;
+  }
+
+  inline bool is_bayer(LUT::Scaling::image_type type)
+  {
+    return type >= LUT::Scaling::BAYER_RG8 && type <= LUT::Scaling::BAYER_BG16;
+  }
+
+  inline bool is_16bits(LUT::Scaling::image_type type)
+  {
+    return type == LUT::Scaling::Y16 || type == LUT::Scaling::BAYER_RG16 ||
+      type == LUT::Scaling::BAYER_BG16;
+  }
+
+  inline void rgb_2_image(const unsigned char *data,std::vector<unsigned int> &image,
+		   int column,int row,LUT::Scaling::image_type type,
+		   bool scaled,float minValue,float maxValue)
+  {
+    Scale aScale(minValue,maxValue,219.f);
+    image.resize(column * row);
+    for(int i = 0;i < column * row;++i)
+      {
+	int red,green,blue;
+	rgb_components(data,type,i,red,green,blue);
+	if(scaled)
+	  {
+	    red = clip(int(red * aScale.A + aScale.B));
+	    green = clip(int(green * aScale.A + aScale.B));
+	    blue = clip(int(blue * aScale.A + aScale.B));
+	  }
+	image[i] = bgra(red,green,blue);
+      }
+  }
+
+  /**
+   * @brief color of a bayer pixel
+   * @return 0 red, 1 green, 2 blue
+   */
+  inline int bayer_color(LUT::Scaling::image_type type,int x,int y)
+  {
+    bool rg = type == LUT::Scaling::BAYER_RG8 || type == LUT::Scaling::BAYER_RG16;
+    if((x + y) & 1) return 1;
+    bool first = !(y & 1);	// color of (0,0) on even rows
+    return (first == rg) ? 0 : 2;
+  }
+
+  /**
+   * @brief bilinear demosaicing of an interior pixel
+   *
+   * same integer rounding as the kernels: the 4 diagonal or 4 cross
+   * neighbours are averaged with +2 >> 2, 2 neighbours with +1 >> 1.
+   */
+  template<class IN>
+  void bayer_rgb(const IN *bayer,int column,LUT::Scaling::image_type type,
+		 int x,int y,int rgb[3])
+  {
+#define PIX(dx,dy) int(bayer[(y + (dy)) * column + x + (dx)])
+    int color = bayer_color(type,x,y);
+    if(color != 1)
+      {
+	rgb[color] = PIX(0,0);
+	rgb[1] = (PIX(0,-1) + PIX(-1,0) + PIX(1,0) + PIX(0,1) + 2) >> 2;
+	rgb[2 - color] = (PIX(-1,-1) + PIX(1,-1) + PIX(-1,1) + PIX(1,1) + 2) >> 2;
+      }
+    else
+      {
+	rgb[1] = PIX(0,0);
+	rgb[bayer_color(type,x,y - 1)] = (PIX(0,-1) + PIX(0,1) + 1) >> 1;
+	rgb[bayer_color(type,x - 1,y)] = (PIX(-1,0) + PIX(1,0) + 1) >> 1;
+      }
+#undef PIX
+  }
+
+  /// @brief luma of a bayer image, border pixels are 0
+  template<class IN>
+  void bayer_2_luma(const IN *bayer,std::vector<IN> &luma,int column,int row,
+		    LUT::Scaling::image_type type)
+  {
+    luma.assign(column * row,IN(0));
+    for(int y = 1;y < row - 1;++y)
+      for(int x = 1;x < column - 1;++x)
+	{
+	  int rgb[3];
+	  bayer_rgb(bayer,column,type,x,y,rgb);
+	  luma[y * column + x] = IN((rgb[0] * 76 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+	}
+  }
+
+  /**
+   * @brief scaling of a demosaiced pixel
+   * if a component is saturated, all components are scaled down to keep the hue
+   * (the highest goes to 255, equal components stay equal)
+   */
+  inline void bayer_scale(int rgb[3],float A,float B)
+  {
+    int T[3];
+    for(int i = 0;i < 3;++i) T[i] = rgb[i] * A + B;
+    if(T[0] > 255 || T[1] > 255 || T[2] > 255)
+      {
+	int maxId = 0;
+	for(int i = 1;i < 3;++i)
+	  if(rgb[i] > rgb[maxId]) maxId = i;
+	double nA = (255. - B) / rgb[maxId];
+	for(int i = 0;i < 3;++i)
+	  T[i] = i == maxId ? 255 : int(rgb[i] * nA + B + .5);
+      }
+    for(int i = 0;i < 3;++i)
+      rgb[i] = T[i] < 0 ? 0 : T[i];
+  }
+
+  /// @brief bayer image to BGRA, border pixels are opaque black
+  template<class IN>
+  void bayer_2_image(const IN *bayer,std::vector<unsigned int> &image,int column,int row,
+		     LUT::Scaling::image_type type,bool scaled,float minValue,float maxValue)
+  {
+    image.assign(column * row,0xff000000);
+    std::vector<IN> shrunk;
+    if(!scaled && sizeof(IN) > 1)
+      {
+	// UNACTIVE: 16 bits data are shifted to fit the max in 8 bits
+	IN minVal,maxVal;
+	find_min_max(bayer,column * row,minVal,maxVal);
+	int nbshift = 0;
+	while((1LL << nbshift) <= (long long)maxVal) ++nbshift;
+	nbshift = nbshift > 8 ? nbshift - 8 : 0;
+	shrunk.resize(column * row);
+	for(int i = 0;i < column * row;++i)
+	  shrunk[i] = IN((unsigned char)(bayer[i] >> nbshift));
+	bayer = &shrunk[0];
+      }
+    Scale aScale(minValue,maxValue,255.f);
+    for(int y = 1;y < row - 1;++y)
+      for(int x = 1;x < column - 1;++x)
+	{
+	  int rgb[3];
+	  bayer_rgb(bayer,column,type,x,y,rgb);
+	  if(scaled) bayer_scale(rgb,aScale.A,aScale.B);
+	  image[y * column + x] = bgra(rgb[0] & 0xff,rgb[1] & 0xff,rgb[2] & 0xff);
+	}
+  }
+
+  /// @brief YUV to BGRA, chroma computed in float as the kernels
+  inline unsigned int yuv(int y,int U,int V)
+  {
+    int redChro = 1.403f * (V - 128);
+    int greenChro = -0.714f * (V - 128) - 0.344f * (U - 128);
+    int blueChro = 1.773f * (U - 128);
+    return bgra(clip(y + redChro),clip(y + greenChro),clip(y + blueChro));
+  }
+
+  /// @brief I420 planes (Y then U and V subsampled by 2), even sizes only
+  inline void i420_2_image(const unsigned char *data,std::vector<unsigned int> &image,
+		    int column,int row,bool scaled,float minValue,float maxValue)
+  {
+    const unsigned char *U = data + column * row;
+    const unsigned char *V = U + column * row / 4;
+    float A = 1.f,B = 0.f;
+    if(maxValue - minValue)
+      {
+	A = (235 - 16) / (maxValue - minValue);
+	B = 16 - ((235 - 16) * minValue) / (maxValue - minValue);
+      }
+    image.resize(column * row);
+    for(int y = 0;y < row;++y)
+      for(int x = 0;x < column;++x)
+	{
+	  int chroma = (y / 2) * (column / 2) + x / 2;
+	  int luma = data[y * column + x];
+	  if(scaled)
+	    {
+	      int scaledLuma = A * luma + B;
+	      luma = clip(scaledLuma);
+	    }
+	  image[y * column + x] = yuv(luma,U[chroma],V[chroma]);
+	}
+  }
+
+  /// @brief U Y0 V Y1 macro pixels, last pixel of an odd frame is grey
+  inline void yuv422_packed_2_image(const unsigned char *data,std::vector<unsigned int> &image,
+			     int column,int row)
+  {
+    int nbPixel = column * row;
+    image.resize(nbPixel);
+    for(int i = 0;i < nbPixel;++i)
+      {
+	const unsigned char *macro = data + (i / 2) * 4;
+	int y = macro[(i & 1) ? 3 : 1];
+	if((i | 1) < nbPixel)
+	  image[i] = yuv(y,macro[0],macro[2]);
+	else
+	  image[i] = bgra(y,y,y);
+      }
+  }
+
+  /// @brief luma of raw video, NULL (empty) if not supported
+  inline void raw_video_2_luma(const unsigned char *data,std::vector<unsigned char> &luma,
+			int column,int row,LUT::Scaling::image_type type)
+  {
+    int nbPixel = column * row;
+    luma.clear();
+    switch(type)
+      {
+      case LUT::Scaling::Y8:
+      case LUT::Scaling::I420:
+      case LUT::Scaling::YUV411:
+      case LUT::Scaling::YUV422:
+      case LUT::Scaling::YUV444:
+	luma.assign(data,data + nbPixel);
+	break;
+      case LUT::Scaling::Y16:
+	luma.assign(data,data + 2 * nbPixel);
+	break;
+      case LUT::Scaling::BAYER_RG8:
+      case LUT::Scaling::BAYER_BG8:
+	{
+	  std::vector<unsigned char> aLuma;
+	  bayer_2_luma(data,aLuma,column,row,type);
+	  luma.swap(aLuma);
+	}
+	break;
+      case LUT::Scaling::BAYER_RG16:
+      case LUT::Scaling::BAYER_BG16:
+	{
+	  std::vector<unsigned short> aLuma;
+	  bayer_2_luma((const unsigned short*)data,aLuma,column,row,type);
+	  const unsigned char *raw = (const unsigned char*)&aLuma[0];
+	  luma.assign(raw,raw + 2 * nbPixel);
+	}
+	break;
+      default:
+	if(is_rgb(type))
+	  {
+	    luma.resize(nbPixel);
+	    for(int i = 0;i < nbPixel;++i)
+	      {
+		int red,green,blue;
+		rgb_components(data,type,i,red,green,blue);
+		luma[i] = Reference::luma(red,green,blue);
+	      }
+	  }
+	break;
+      }
+  }
+}
+#endif
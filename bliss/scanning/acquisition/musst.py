@@ -211,7 +211,9 @@ class _MusstAcquisitionSlave(AcquisitionSlave):
         store_list = store_list if store_list is not None else list()
         self.channels.extend(
             (
-                AcquisitionChannel(f"{self.name}:{name}", numpy.int32, ())
+                AcquisitionChannel(
+                    f"{self.name}:{name}", numpy.int32, (), batch_size=4096
+                )
                 for name in store_list
             )
         )
@@ -290,6 +292,7 @@ class _MusstAcquisitionSlave(AcquisitionSlave):
                 last_read_event = new_read_event
             gevent.sleep(0.1)
         self._send_data(last_read_event)  # final send
+        self.channels.flush()
 
     def _send_data(self, last_read_event):
         data = self.musst.get_data(len(self.channels), last_read_event)
@@ -888,6 +888,8 @@ class AcquisitionChainIter:
             acq_obj_iter.acq_wait_reading()
             if isinstance(acq_obj_iter.acquisition_object, AcquisitionMaster):
                 acq_obj_iter.wait_slaves()
+            # points still batched by the channels
+            acq_obj_iter.acquisition_object.channels.flush()
             dispatcher.send("end", acq_obj_iter.acquisition_object)
 
     def stop(self):
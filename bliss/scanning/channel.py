@@ -6,8 +6,11 @@
 # Distributed under the GNU LGPLv3. See LICENSE for more info.
 
 import functools
+import gevent
 from bliss.common.event import dispatcher
 from bliss import global_map
+from bliss.data.events import channel_batch
+from bliss.data.events.channel import decode_chunk
 import numpy
 
 
@@ -33,6 +36,11 @@ class AcquisitionChannelList(list):
         for i, channel in enumerate(self):
             channel.emit(array[:, i])
 
+    def flush(self):
+        """Emit the points batched by the channels"""
+        for channel in self:
+            channel.flush()
+
 
 class AcquisitionChannel:
     def __init__(
@@ -44,7 +52,14 @@ class AcquisitionChannel:
         reference=False,
         unit=None,
         data_node_type="channel",
+        batch_size=0,
+        batch_latency=0.1,
     ):
+        """
+        :param int batch_size: when > 0, points are coalesced natively and
+                               emitted by blocks of this size, or when the
+                               oldest one waited `batch_latency` seconds
+        """
         self.__name = name
         self.__dtype = dtype
         self.__shape = shape
@@ -53,6 +68,10 @@ class AcquisitionChannel:
         self.__description = {"reference": reference}
         self.__data_node_type = data_node_type
         self.__node = None
+        self.__batch_size = batch_size
+        self.__batch_latency = batch_latency
+        self.__batcher = None
+        self.__batch_timer = None
 
         if isinstance(description, dict):
             self.__description.update(description)
@@ -114,6 +133,8 @@ class AcquisitionChannel:
 
     @dtype.setter
     def dtype(self, value):
+        self.flush()
+        self.__batcher = None
         self.__dtype = value
 
     @property
@@ -122,6 +143,8 @@ class AcquisitionChannel:
 
     @shape.setter
     def shape(self, value):
+        self.flush()
+        self.__batcher = None
         self.__shape = value
 
     @property
@@ -138,9 +161,16 @@ class AcquisitionChannel:
 
     def emit(self, data):
         if not self.reference:
+            batcher = self._batcher()
+            if batcher is not None:
+                self._emit_batched(batcher, data)
+                return
             data = self._check_and_reshape(data)
             if data.size == 0:
                 return
+        self._send(data)
+
+    def _send(self, data, chunk=None):
         self.__description["dtype"] = self.dtype
         self.__description["shape"] = self.shape
         self.__description["unit"] = self.unit
@@ -149,8 +179,53 @@ class AcquisitionChannel:
             "description": self.__description,
             "data": data,
         }
+        if chunk is not None:
+            # already encoded, published as is
+            data_dct["chunk"] = chunk
         dispatcher.send("new_data", self, data_dct)
 
+    def _batcher(self):
+        """Native batcher of the points, None when batching is off
+        or not possible for this dtype
+        """
+        if self.__batcher is None:
+            if self.__batch_size <= 0 or channel_batch.lib is None:
+                return None
+            try:
+                self.__batcher = channel_batch.ChannelBatcher(
+                    self.dtype, self.shape, self.__batch_size, self.__batch_latency
+                )
+            except (TypeError, ValueError):
+                self.__batch_size = 0
+                return None
+        return self.__batcher
+
+    def _emit_batched(self, batcher, data):
+        if not (isinstance(data, numpy.ndarray) and data.dtype == batcher.dtype):
+            data = self._check_and_reshape(data)
+        if batcher.append(data):
+            self._send_chunks(batcher.chunks())
+        if batcher.pending and self.__batch_timer is None:
+            self.__batch_timer = gevent.spawn_later(
+                self.__batch_latency, self._flush_on_timeout
+            )
+
+    def _send_chunks(self, chunks):
+        for chunk in chunks:
+            self._send(decode_chunk(chunk), chunk=chunk)
+
+    def _flush_on_timeout(self):
+        self.__batch_timer = None
+        self.flush()
+
+    def flush(self):
+        """Emit the points batched so far"""
+        timer, self.__batch_timer = self.__batch_timer, None
+        if timer is not None and timer is not gevent.getcurrent():
+            timer.kill(block=False)
+        if self.__batcher is not None:
+            self._send_chunks(self.__batcher.chunks(force=True))
+
     def _check_and_reshape(self, data):
         ndim = len(self.shape)
         data = numpy.array(data, dtype=self.dtype)
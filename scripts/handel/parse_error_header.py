@@ -1,4 +1,8 @@
-"""Generate error dict from the handel error header."""
+"""Generate error dict from the handel error header.
+
+With ``--c-header OUTPUT``, write the table compiled in the native status
+layer (bliss/controllers/mca/handel/handel_status.c) instead.
+"""
 
 import re
 import sys
@@ -21,12 +25,45 @@ def parse(filename="handel_errors.h"):
     return error_dct
 
 
+def _c_string(value):
+    if value is None:
+        return "NULL"
+    return '"{}"'.format(value.replace("\\", "\\\\").replace('"', '\\"'))
+
+
+def c_header(error_dct):
+    """C table of the error codes sorted by code, see handel_status.c"""
+    lines = [
+        "/* Generated by scripts/handel/parse_error_header.py"
+        " from handel_errors.h, do not edit */",
+        "static const struct handel_status_code HANDEL_STATUS_CODES[] = {",
+    ]
+    for code, (name, description) in sorted(error_dct.items()):
+        lines.append(
+            "  {{{}, {}, {}}},".format(code, _c_string(name), _c_string(description))
+        )
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def write_c_header(filename, output):
+    text = c_header(parse(filename))
+    with open(output, "w") as f:
+        f.write(text)
+
+
 def main(args=None):
-    if args is None or len(args) < 2:
-        dct = parse()
+    args = list(args[1:]) if args else []
+    output = None
+    if "--c-header" in args:
+        index = args.index("--c-header")
+        output = args[index + 1]
+        del args[index : index + 2]
+    filename = args[0] if args else "handel_errors.h"
+    if output is not None:
+        write_c_header(filename, output)
     else:
-        dct = parse(args[1])
-    pprint.pprint(dct)
+        pprint.pprint(parse(filename))
 
 
 if __name__ == "__main__":
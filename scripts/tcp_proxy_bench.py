@@ -0,0 +1,167 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+"""Loopback benchmark of the tcp proxy forwarding (bliss.comm.tcp_proxy).
+
+An echo server and the proxy servers run in their own processes, the
+client measures the round trip of small messages (latency) and the echo
+of a bulk transfer (throughput), directly and through the proxy with the
+Python (select) and the native (splice) forwarding::
+
+    python scripts/tcp_proxy_bench.py [--rounds 5000] [--size-mb 256]
+
+The native forwarding needs the library, see bliss/comm/tcp_forward.py.
+"""
+
+import os
+import sys
+import time
+import socket
+import argparse
+import threading
+import subprocess
+
+CHUNK = 256 * 1024
+
+
+def _echo_connection(conn):
+    with conn:
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        while True:
+            data = conn.recv(CHUNK)
+            if not data:
+                return
+            conn.sendall(data)
+
+
+def run_echo():
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.bind(("127.0.0.1", 0))
+    server.listen(16)
+    print(server.getsockname()[1], flush=True)
+    # stops when the benchmark closes stdin
+    threading.Thread(
+        target=lambda: (sys.stdin.read(), os._exit(0)), daemon=True
+    ).start()
+    while True:
+        conn, _ = server.accept()
+        threading.Thread(target=_echo_connection, args=(conn,), daemon=True).start()
+
+
+def run_proxy(port, native):
+    from gevent import socket as gsocket
+    from bliss.comm.tcp_proxy import serve
+
+    server = gsocket.socket(gsocket.AF_INET, gsocket.SOCK_STREAM)
+    server.bind(("127.0.0.1", 0))
+    server.listen(16)
+    print(server.getsockname()[1], flush=True)
+    # stops when the benchmark closes stdin
+    serve(server, "127.0.0.1", port, sys.stdin.fileno(), native=native)
+
+
+def _start(*args):
+    process = subprocess.Popen(
+        [sys.executable, os.path.abspath(__file__)] + list(args),
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+    )
+    return process, int(process.stdout.readline())
+
+
+def _recv_exactly(sock, size):
+    view = memoryview(bytearray(size))
+    while size:
+        nbytes = sock.recv_into(view[-size:])
+        if not nbytes:
+            raise ConnectionError("connection closed")
+        size -= nbytes
+
+
+def latency(port, rounds, size=64):
+    """round trip times in us, sorted"""
+    message = b"x" * size
+    times = []
+    with socket.create_connection(("127.0.0.1", port)) as sock:
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        for i in range(rounds + rounds // 10):
+            start = time.perf_counter()
+            sock.sendall(message)
+            _recv_exactly(sock, size)
+            if i >= rounds // 10:  # warm up
+                times.append((time.perf_counter() - start) * 1e6)
+    return sorted(times)
+
+
+def throughput(port, size):
+    """echoed MB/s"""
+    chunk = b"\0" * CHUNK
+    with socket.create_connection(("127.0.0.1", port)) as sock:
+
+        def send():
+            for _ in range(size // CHUNK):
+                sock.sendall(chunk)
+
+        sender = threading.Thread(target=send)
+        start = time.perf_counter()
+        sender.start()
+        _recv_exactly(sock, size // CHUNK * CHUNK)
+        elapsed = time.perf_counter() - start
+        sender.join()
+    return size / elapsed / 1e6
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--rounds", type=int, default=5000, help="latency rounds")
+    parser.add_argument("--size-mb", type=int, default=256, help="bulk transfer size")
+    parser.add_argument("--echo", action="store_true", help=argparse.SUPPRESS)
+    parser.add_argument("--proxy", type=int, help=argparse.SUPPRESS)
+    parser.add_argument("--select", action="store_true", help=argparse.SUPPRESS)
+    options = parser.parse_args()
+
+    if options.echo:
+        return run_echo()
+    if options.proxy:
+        return run_proxy(options.proxy, native=not options.select)
+
+    from bliss.comm import tcp_forward
+
+    processes = []
+    try:
+        echo, echo_port = _start("--echo")
+        processes.append(echo)
+        targets = [("direct", echo_port)]
+        proxy, port = _start("--proxy", str(echo_port), "--select")
+        processes.append(proxy)
+        targets.append(("proxy select", port))
+        if tcp_forward.lib is not None:
+            proxy, port = _start("--proxy", str(echo_port))
+            processes.append(proxy)
+            targets.append(("proxy native", port))
+        else:
+            print("native forwarding not available (see bliss/comm/tcp_forward.py)")
+
+        print(
+            "%-14s %12s %12s %12s"
+            % ("", "median (us)", "p99 (us)", "echo (MB/s)")
+        )
+        for name, port in targets:
+            times = latency(port, options.rounds)
+            rate = throughput(port, options.size_mb * 1024 * 1024)
+            print(
+                "%-14s %12.1f %12.1f %12.0f"
+                % (name, times[len(times) // 2], times[len(times) * 99 // 100], rate)
+            )
+    finally:
+        for process in reversed(processes):
+            process.stdin.close()
+            process.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -6,6 +6,7 @@
 # Distributed under the GNU LGPLv3. See LICENSE for more info.
 
 import os
+import re
 import sys
 import inspect
 import subprocess
@@ -38,6 +39,130 @@ if build_flint:
     )
     extensions.append(poll_patch)
 
+# Qt-free pixmaptools kernels with a C ABI, loaded with cffi
+# (bliss.data.routines.pixmaptools.core), opt-in as it needs a C++ compiler
+build_pixmaptools_core = os.environ.get("BLISS_BUILD_PIXMAPTOOLS_CORE") == "1"
+
+if build_pixmaptools_core:
+    pixmaptools_dir = "bliss/data/routines/pixmaptools"
+    # jpeg thumbnails need libjpeg(-turbo): BLISS_PIXMAPTOOLS_JPEG=0 disables them
+    pixmaptools_jpeg = os.environ.get("BLISS_PIXMAPTOOLS_JPEG") != "0" and any(
+        os.path.exists(os.path.join(prefix, "include", "jpeglib.h"))
+        for prefix in filter(None, (conda_base, "/usr", "/usr/local"))
+    )
+    pixmaptools_core = Extension(
+        "bliss.data.routines.pixmaptools._pixmaptools_core",
+        sources=[
+            os.path.join(pixmaptools_dir, name)
+            for name in (
+                "pixmaptools_accumulator.cpp",
+                "pixmaptools_azim.cpp",
+                "pixmaptools_capi.cpp",
+                "pixmaptools_cpu.cpp",
+                "pixmaptools_display.cpp",
+                "pixmaptools_edf.cpp",
+                "pixmaptools_encode.cpp",
+                "pixmaptools_lut.cpp",
+                "pixmaptools_pipeline.cpp",
+                "pixmaptools_prefetch.cpp",
+                "pixmaptools_stat.cpp",
+                "pixmaptools_thread.cpp",
+                "pixmaptools_timing.cpp",
+            )
+        ],
+        include_dirs=[pixmaptools_dir],
+        language="c++",
+        extra_compile_args=["-std=gnu++11", "-pthread"],
+        define_macros=[("PIXMAPTOOLS_HAVE_JPEG", None)] if pixmaptools_jpeg else [],
+        libraries=["pthread", "z"] + (["jpeg"] if pixmaptools_jpeg else []),
+    )
+    extensions.append(pixmaptools_core)
+
+
+def cffi_library(name, source, include_dirs=()):
+    """Extension of a native library loaded with cffi (see bliss.comm.native):
+    the C ABI is exported, not a Python module. The exported functions are
+    the ones declared for cffi in the header next to source"""
+    with open(os.path.splitext(source)[0] + ".h", "r") as h_file:
+        cdef = re.search(r"/\* CFFI_BEGIN \*/(.*)/\* CFFI_END \*/", h_file.read(), re.S)
+    declarations = re.sub(r"/\*.*?\*/", "", cdef.group(1), flags=re.S)
+    return Extension(
+        name,
+        sources=[source],
+        include_dirs=[os.path.dirname(source)] + list(include_dirs),
+        export_symbols=re.findall(r"(\w+)\s*\([^()]*\)\s*;", declarations),
+    )
+
+
+# native status checks of the handel mapping buffers
+# (bliss.controllers.mca.handel.status), the error table is generated
+# from handel_errors.h
+if os.environ.get("BLISS_BUILD_HANDEL_STATUS") == "1":
+    sys.path.insert(0, os.path.join("scripts", "handel"))
+    import parse_error_header
+
+    del sys.path[0]
+    handel_generated_dir = os.path.join("build", "handel_status")
+    os.makedirs(handel_generated_dir, exist_ok=True)
+    parse_error_header.write_c_header(
+        os.path.join("scripts", "handel", "handel_errors.h"),
+        os.path.join(handel_generated_dir, "handel_status_codes.h"),
+    )
+    extensions.append(
+        cffi_library(
+            "bliss.controllers.mca.handel._handel_status",
+            "bliss/controllers/mca/handel/handel_status.c",
+            include_dirs=[handel_generated_dir],
+        )
+    )
+
+# native receive ring buffer of the tcp sockets (bliss.comm.ringbuffer), a
+# bytearray is used without it
+if os.environ.get("BLISS_BUILD_COMM_RINGBUFFER") == "1":
+    extensions.append(cffi_library("bliss.comm._ringbuffer", "bliss/comm/ringbuffer.c"))
+
+# splice forwarding core of the tcp proxy server (bliss.comm.tcp_forward),
+# Linux only
+build_comm_tcp_forward = os.environ.get("BLISS_BUILD_COMM_TCP_FORWARD") == "1"
+
+if build_comm_tcp_forward and sys.platform.startswith("linux"):
+    extensions.append(
+        cffi_library("bliss.comm._tcp_forward", "bliss/comm/tcp_forward.c")
+    )
+
+# decoding of the scpi waveform blocks and ascii curves
+# (bliss.comm.scpi_block), numpy is used without it
+if os.environ.get("BLISS_BUILD_COMM_SCPI_BLOCK") == "1":
+    extensions.append(cffi_library("bliss.comm._scpi_block", "bliss/comm/scpi_block.c"))
+
+# xdr record marking and number arrays (bliss.comm.xdr), Python and numpy
+# are used without it
+if os.environ.get("BLISS_BUILD_COMM_XDR") == "1":
+    extensions.append(cffi_library("bliss.comm._xdr", "bliss/comm/xdr.c"))
+
+# modbus tcp framing and register decoding (bliss.comm.modbus_codec),
+# struct and numpy are used without it
+if os.environ.get("BLISS_BUILD_COMM_MODBUS_CODEC") == "1":
+    extensions.append(
+        cffi_library("bliss.comm._modbus_codec", "bliss/comm/modbus_codec.c")
+    )
+
+# header codec of the spec server protocol (bliss.comm.spec.codec), struct
+# is used without it
+if os.environ.get("BLISS_BUILD_COMM_SPEC_CODEC") == "1":
+    extensions.append(
+        cffi_library("bliss.comm.spec._spec_codec", "bliss/comm/spec/spec_codec.c")
+    )
+
+# batching of the acquisition channel points (bliss.data.events.channel_batch),
+# the points are not batched without it
+if os.environ.get("BLISS_BUILD_CHANNEL_BATCH") == "1":
+    extensions.append(
+        cffi_library(
+            "bliss.data.events._channel_batch", "bliss/data/events/channel_batch.c"
+        )
+    )
+
 
 def abspath(*path):
     """A method to determine absolute path for a given relative path to the
@@ -219,6 +344,16 @@ def main():
         setup_requires += ["pytest-runner"]
 
     package_data = {
+        "bliss.data.routines.pixmaptools": ["pixmaptools_capi.h"],
+        "bliss.comm": [
+            "ringbuffer.h",
+            "tcp_forward.h",
+            "scpi_block.h",
+            "xdr.h",
+            "modbus_codec.h",
+        ],
+        "bliss.comm.spec": ["spec_codec.h"],
+        "bliss.controllers.mca.handel": ["handel_status.h"],
         "bliss.controllers.regulation.temperature.eurotherm": ["*.txt"],
         "bliss.config.redis": ["*.conf"],
         "bliss.config.plugins": ["*.html"],
@@ -1,6 +1,13 @@
-from bliss.comm.modbus import ModbusTcp
-from random import randint, random
 import struct
+from random import randint, random
+
+import numpy
+import pytest
+from gevent.server import StreamServer
+
+from bliss.comm import modbus_codec
+from bliss.comm.modbus import ModbusTcp
+from ..conftest import native_library_fixtures
 
 
 def test_modbus_boolean_registers(modbus_tcp_server):
@@ -35,3 +42,121 @@ def test_modbus_float_values(modbus_tcp_server):
     assert f"{reg1:016b}{reg2:016b}" == "{:032b}".format(
         struct.unpack("!i", struct.pack("!f", num))[0]
     )
+
+
+REGISTERS = numpy.arange(0x1000, dtype=numpy.uint16) * 7
+COILS = (numpy.arange(0x1000) % 3 == 0).astype(numpy.uint8)
+
+
+native_library, codec_lib = native_library_fixtures(
+    modbus_codec, "modbus_codec", "BLISS_MODBUS_CODEC_LIBRARY"
+)
+
+
+def _answer(func, address, count):
+    if func in (0x03, 0x04):
+        data = REGISTERS[address : address + count].astype(">u2").tobytes()
+    else:
+        bits = COILS[address : address + count]
+        data = numpy.packbits(bits, bitorder="little").tobytes()
+    return bytes([func, len(data)]) + data
+
+
+@pytest.fixture
+def pipelined_server():
+    """modbus tcp stand-in, answers the requests received together in the
+    reverse order"""
+    batches = []
+
+    def handle(sock, address):
+        while True:
+            data = sock.recv(64 * 1024)
+            if not data:
+                return
+            answers = []
+            for i in range(0, len(data), 12):
+                tid, _, _, unit, func, address, count = struct.unpack(
+                    ">HHHBBHH", data[i : i + 12]
+                )
+                pdu = _answer(func, address, count)
+                answers.append(struct.pack(">HHHB", tid, 0, len(pdu) + 1, unit) + pdu)
+            batches.append(len(answers))
+            sock.sendall(b"".join(reversed(answers)))
+
+    server = StreamServer(("127.0.0.1", 0), handle)
+    server.start()
+    yield server.address[1], batches
+    server.stop()
+
+
+def test_merge_ranges():
+    requests = [(0x04, 10, 5), (0x01, 0, 8), (0x04, 0, 10), (0x04, 12, 2)]
+    requests.append((0x03, 15, 1))
+    spans, blocks, placements = modbus_codec.merge_ranges(requests)
+    assert spans == [(0x01, 0, 8), (0x03, 15, 1), (0x04, 0, 15)]
+    assert [request for request, _ in blocks] == spans
+    assert placements == [(2, 10), (0, 0), (2, 0), (2, 12), (1, 0)]
+
+    spans, blocks, placements = modbus_codec.merge_ranges([(0x03, 100, 300)])
+    assert [request for request, _ in blocks] == [
+        (0x03, 100, 125),
+        (0x03, 225, 125),
+        (0x03, 350, 50),
+    ]
+    assert [place for _, place in blocks] == [(0, 0), (0, 125), (0, 250)]
+    with pytest.raises(ValueError):
+        modbus_codec.merge_ranges([(0x05, 0, 1)])
+
+
+def test_codec(codec_lib):
+    requests = [(0x03, 1, 2), (0x01, 0xFFFF, 1)]
+    data = modbus_codec.pack_reads([7, 0xFFFF], 9, requests)
+    assert data == struct.pack(">HHHBBHH", 7, 0, 6, 9, 3, 1, 2) + struct.pack(
+        ">HHHBBHH", 0xFFFF, 0, 6, 9, 1, 0xFFFF, 1
+    )
+    answers = [_answer(0x04, 5, 3), _answer(0x02, 1, 11), bytes([0x84, 0x02])]
+    stream = b"".join(
+        struct.pack(">HHHB", tid, 0, len(pdu) + 1, 1) + pdu
+        for tid, pdu in enumerate(answers)
+    )
+    frames, consumed = modbus_codec.scan(stream + stream[:9])
+    assert consumed == len(stream)
+    assert [frame[:3] for frame in frames] == [(0, 1, 0x04), (1, 1, 0x02), (2, 1, 0x84)]
+    tid, unit, func, offset, size = frames[0]
+    registers = modbus_codec.decode_registers(stream[offset + 1 : offset + size])
+    numpy.testing.assert_array_equal(registers, REGISTERS[5:8])
+    tid, unit, func, offset, size = frames[1]
+    out = numpy.zeros(20, numpy.uint8)
+    bits = modbus_codec.decode_bits(stream[offset + 1 : offset + size], 11, out)
+    assert bits.base is out
+    numpy.testing.assert_array_equal(bits, COILS[1:12])
+    with pytest.raises(ValueError):
+        modbus_codec.scan(b"\x00\x01\x00\x05" + b"\x00" * 10)
+
+
+def test_read_blocks(codec_lib, pipelined_server):
+    port, batches = pipelined_server
+    client = ModbusTcp("127.0.0.1", port=port, unit=1)
+    try:
+        requests = [
+            (0x01, 0, 14),
+            (0x01, 0x200, 10),
+            (0x04, 0, 300),
+            (0x04, 0x200, 2),
+            (0x03, 20, 5),
+            (0x03, 22, 6),
+        ]
+        results = client.read_blocks(requests)
+        # one round trip: coils, 3 blocks of input registers, holding registers
+        assert batches == [7]
+        for (func, address, count), result in zip(requests, results):
+            if func == 0x01:
+                assert result.dtype == numpy.uint8
+                expected = COILS[address : address + count]
+            else:
+                assert result.dtype == numpy.uint16
+                expected = REGISTERS[address : address + count]
+            numpy.testing.assert_array_equal(result, expected)
+        numpy.testing.assert_array_equal(client.read_coils(3, 5), COILS[3:8])
+    finally:
+        client.close()
@@ -5,11 +5,16 @@
 # Copyright (c) 2015-2020 Beamline Control Unit, ESRF
 # Distributed under the GNU LGPLv3. See LICENSE for more info.
 
+import os
+import sys
+
 import pytest
 import gevent
 from gevent.server import StreamServer
 
-from bliss.comm.tcp_proxy import Proxy
+from bliss.comm import tcp_forward
+from bliss.comm.tcp_proxy import Proxy, serve
+from ..conftest import native_library_fixtures
 
 
 def echo(socket, address):
@@ -57,3 +62,46 @@ def test_proxy(beacon, echo_server):
     assert client_socket.recv(1024) == b"HELLO PROXY\n"
 
     proxy.close()
+
+
+native_library, _ = native_library_fixtures(
+    tcp_forward, "tcp_forward", "BLISS_TCP_FORWARD_LIBRARY"
+)
+
+
+@pytest.mark.parametrize("native", [False, True], ids=["select", "native"])
+def test_proxy_serve(echo_server, native, request):
+    if native:
+        if not sys.platform.startswith("linux"):
+            pytest.skip("the splice forwarding is Linux only")
+        assert request.getfixturevalue("native_library") is not None
+    server = gevent.socket.socket()
+    server.bind(("127.0.0.1", 0))
+    server.listen(16)
+    stop_read, stop_write = os.pipe()
+    serve_task = gevent.spawn(
+        serve, server, "127.0.0.1", echo_server.address[1], stop_read, native=native
+    )
+    try:
+        client_socket = gevent.socket.create_connection(server.getsockname())
+        client_socket.sendall(b"HELLO PROXY\n")
+        assert client_socket.recv(1024) == b"HELLO PROXY\n"
+        # bulk, both ways at once
+        data = b"x" * (4 * 1024 * 1024 - 1) + b"\n"
+        sender = gevent.spawn(client_socket.sendall, data)
+        received = b""
+        while len(received) < len(data):
+            received += client_socket.recv(1024 * 1024)
+        sender.get()
+        assert received == data
+
+        # a new client replaces the previous one
+        other_socket = gevent.socket.create_connection(server.getsockname())
+        other_socket.sendall(b"OTHER\n")
+        assert other_socket.recv(1024) == b"OTHER\n"
+        assert client_socket.recv(1024) == b""
+    finally:
+        os.close(stop_write)
+        serve_task.get(timeout=3)
+        os.close(stop_read)
+        server.close()
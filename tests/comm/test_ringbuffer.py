@@ -0,0 +1,107 @@
+import pytest
+
+from bliss.comm import ringbuffer, tcp
+from ..conftest import native_library_fixtures
+
+
+native_library, implementation = native_library_fixtures(
+    ringbuffer, "ringbuffer", "BLISS_RINGBUFFER_LIBRARY"
+)
+
+
+@pytest.fixture
+def buffer_class(implementation):
+    if implementation == "native":
+        return ringbuffer.NativeRingBuffer
+    return ringbuffer.PyRingBuffer
+
+
+def _receive(buffer, data, min_size=4):
+    """write data through reserve/commit, as the socket reader does"""
+    while data:
+        view = buffer.reserve(min_size)
+        size = min(len(view), len(data))
+        view[:size] = data[:size]
+        buffer.commit(size)
+        data = data[size:]
+
+
+def test_read_write(buffer_class):
+    buffer = buffer_class(8)
+    assert not buffer
+    buffer.write(b"hello ")
+    _receive(buffer, b"world")
+    assert len(buffer) == 11
+    assert buffer.read(5) == b"hello"
+    buffer.consume(1)
+    assert buffer.read(100) == b"world"
+    assert buffer.read() == b""
+
+
+def test_wrap_and_grow(buffer_class):
+    buffer = buffer_class(16)
+    expected = b""
+    for i in range(200):
+        chunk = bytes([i]) * (i % 13 + 1)
+        _receive(buffer, chunk, min_size=1)
+        expected += chunk
+        if i % 3:
+            size = i % 7
+            assert buffer.read(size) == expected[:size]
+            expected = expected[size:]
+        assert len(buffer) == len(expected)
+    assert buffer.read() == expected
+
+
+def test_find(buffer_class):
+    buffer = buffer_class(16)
+    # the data wraps at the end of the memory, between \r and \n
+    _receive(buffer, b"x" * 12)
+    buffer.consume(11)
+    _receive(buffer, b"abc\r", min_size=1)
+    _receive(buffer, b"\ndef\r\nghi", min_size=1)
+    buffer.consume(1)
+    assert buffer.find(b"\r\n") == 3
+    assert buffer.find(b"\r\n", 4) == 8
+    assert buffer.find(b"\r\n", 9) == -1
+    assert buffer.find(b"ghij") == -1
+    assert buffer.find(b"\n") == 4
+    assert buffer.read(3) == b"abc"
+    buffer.consume(2)
+    assert buffer.find(b"\r\n") == 3
+    assert buffer.read() == b"def\r\nghi"
+
+
+def test_clear_while_receiving(buffer_class):
+    buffer = buffer_class(16)
+    buffer.write(b"old")
+    view = buffer.reserve(4)
+    buffer.clear()
+    view[:3] = b"new"
+    buffer.commit(3)
+    assert buffer.read() == b"new"
+
+
+def test_peek(buffer_class):
+    buffer = buffer_class(16)
+    buffer.write(b"0123456789")
+    assert bytes(buffer.peek()) == b"0123456789"
+    assert len(buffer) == 10
+
+
+def test_native_loaded(native_library):
+    assert ringbuffer.RingBuffer is ringbuffer.NativeRingBuffer
+
+
+def test_socket_bulk_read(buffer_class, server_port, monkeypatch):
+    monkeypatch.setattr(tcp, "RingBuffer", buffer_class)
+    sock = tcp.Socket("127.0.0.1", server_port)
+    try:
+        data = bytes(range(256)) * 4096
+        sock.write(data)
+        assert sock.read(len(data), timeout=5) == data
+        sock.write(b"first\r\nsecond\r\n")
+        assert sock.readline(eol=b"\r\n") == b"first"
+        assert sock.readline(eol=b"\r\n") == b"second"
+    finally:
+        sock.close()
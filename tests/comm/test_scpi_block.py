@@ -0,0 +1,147 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+
+import numpy
+import pytest
+import gevent
+from gevent.server import StreamServer
+
+from bliss.comm import scpi_block, tcp
+from bliss.comm.ringbuffer import PyRingBuffer
+from ..conftest import native_library_fixtures
+
+CURVE = (numpy.sin(numpy.arange(200000) / 1000.) * 30000).astype(">i2")
+YOFF, YMULT, YZERO = 12., 1.5e-4, -0.25
+
+
+def _block(data, header=b":CURVE "):
+    length = b"%d" % len(data)
+    return header + b"#%d" % len(length) + length + data + b"\n"
+
+
+def _instrument(sock, address):
+    """stand-in oscilloscope, sends its answers in pieces"""
+    rfile = sock.makefile(mode="rb")
+    while True:
+        line = rfile.readline().strip()
+        if not line:
+            break
+        if line == b":CURVE?":
+            answer = _block(CURVE.tobytes())
+        elif line == b"CURVE:LE?":
+            answer = _block(CURVE.astype("<f4").tobytes(), b"")
+        elif line == b"CURVE:INDEF?":
+            answer = b"#0" + numpy.arange(5, dtype="u1").tobytes() + b"\n"
+        elif line == b"CURVE:ASCII?":
+            answer = b":CURVE " + b",".join(b"%d" % v for v in CURVE[:5000]) + b"\n"
+        else:
+            answer = b"#X\n"
+        for i in range(0, len(answer), 7777):
+            sock.sendall(answer[i : i + 7777])
+            gevent.sleep(0)
+
+
+@pytest.fixture
+def instrument():
+    server = StreamServer(("127.0.0.1", 0), _instrument)
+    server.start()
+    yield server.address[1]
+    server.stop()
+
+
+native_library, decoder = native_library_fixtures(
+    scpi_block, "scpi_block", "BLISS_SCPI_BLOCK_LIBRARY"
+)
+
+
+@pytest.mark.parametrize("dtype", ["<i2", ">i2", ">u4", "<i8", ">f4", "<f8", "i1"])
+def test_to_double(decoder, dtype):
+    values = (numpy.arange(-50, 50) * 3).astype(dtype)
+    out = numpy.empty(len(values))
+    scpi_block.to_double(values.tobytes(), dtype, out, (YOFF, YMULT, YZERO))
+    expected = (values.astype(float) - YOFF) * YMULT + YZERO
+    numpy.testing.assert_allclose(out, expected, rtol=1e-15)
+
+
+def test_parse_values(decoder):
+    numbers = [b"1", b"-2.5", b"+3e-3", b"0.000125", b"9.91E37", b"12345678901234567"]
+    numbers += [b"-0.1", b"1.7976931348623157e308", b"4.9e-324", b"NaN", b"1e-30"]
+    values = scpi_block.parse_values(b":CURV " + b", ".join(numbers))
+    expected = [float(n) for n in numbers]
+    numpy.testing.assert_array_equal(values, expected)
+    numpy.testing.assert_array_equal(scpi_block.parse_values(b"1 2\t3"), [1, 2, 3])
+    assert len(scpi_block.parse_values(b"")) == 0
+    with pytest.raises(ValueError):
+        scpi_block.parse_values(b"1,2,abc,4")
+
+
+def test_parse_values_rounding(decoder):
+    scales = 10.0 ** numpy.arange(-10, 10).repeat(100)
+    values = numpy.random.default_rng(0).standard_normal(len(scales)) * scales
+    text = ",".join("%r,%.6g" % (v, v) for v in values.tolist())
+    expected = [float(v) for v in text.split(",")]
+    numpy.testing.assert_array_equal(scpi_block.parse_values(text.encode()), expected)
+
+
+def test_block_reader_pieces(decoder):
+    buffer = PyRingBuffer()
+    reader = scpi_block.BlockReader(">i2", scaling=(YOFF, YMULT, YZERO))
+    data = _block(CURVE[:1001].tobytes()) + b"next"
+    # odd sized pieces split the values and the header
+    for i in range(0, len(data), 3):
+        buffer.write(data[i : i + 3])
+        if reader.feed(buffer):
+            break
+    expected = (CURVE[:1001].astype(float) - YOFF) * YMULT + YZERO
+    numpy.testing.assert_allclose(reader.data, expected, rtol=1e-15)
+    assert buffer.read() + data[i + 3 :] == b"next"
+    with pytest.raises(ValueError):
+        buffer.write(b"#A")
+        scpi_block.BlockReader().feed(buffer)
+
+
+def test_decode_block(decoder):
+    # as read by the comms without receive buffer, eol stripped or not
+    raw = scpi_block.decode_block(_block(CURVE.tobytes()), ">i2")
+    numpy.testing.assert_array_equal(raw, CURVE)
+    volts = scpi_block.decode_block(
+        _block(CURVE[:1001].tobytes())[:-1], ">i2", scaling=(YOFF, YMULT, YZERO)
+    )
+    expected = (CURVE[:1001].astype(float) - YOFF) * YMULT + YZERO
+    numpy.testing.assert_allclose(volts, expected, rtol=1e-15)
+    values = scpi_block.decode_block(b"#0" + bytes(range(5)))
+    numpy.testing.assert_array_equal(values, numpy.arange(5))
+    with pytest.raises(ValueError):
+        scpi_block.decode_block(_block(CURVE.tobytes())[:-10], ">i2")
+
+
+def test_socket_read_block(decoder, instrument):
+    sock = tcp.Socket("127.0.0.1", instrument)
+    try:
+        raw = sock.write_read_block(b":CURVE?\n", ">i2", timeout=5)
+        numpy.testing.assert_array_equal(raw, CURVE)
+
+        out = numpy.zeros(len(CURVE) + 10)
+        volts = sock.write_read_block(
+            b":CURVE?\n", ">i2", out=out, scaling=(YOFF, YMULT, YZERO), timeout=5
+        )
+        assert volts.base is out
+        expected = (CURVE.astype(float) - YOFF) * YMULT + YZERO
+        numpy.testing.assert_allclose(volts, expected, rtol=1e-15)
+
+        values = sock.write_read_block(b"CURVE:LE?\n", "<f4", timeout=5)
+        numpy.testing.assert_array_equal(values, CURVE)
+
+        values = sock.write_read_block(b"CURVE:INDEF?\n", timeout=5)
+        numpy.testing.assert_array_equal(values, numpy.arange(5))
+
+        # the block terminator was consumed
+        line = sock.write_readline(b"CURVE:ASCII?\n", timeout=5)
+        numpy.testing.assert_array_equal(scpi_block.parse_values(line), CURVE[:5000])
+    finally:
+        sock.close()
@@ -0,0 +1,196 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+
+import numpy
+import pytest
+import gevent
+import gevent.event
+from gevent.server import StreamServer
+
+from bliss.comm.spec import codec, message
+from bliss.comm.spec.connection import SpecConnection
+from ..conftest import native_library_fixtures
+
+VALUES = {
+    "var/image": numpy.arange(512 * 300, dtype=numpy.float64).reshape(512, 300),
+    "var/counts": numpy.arange(10, dtype=numpy.int32) * -3,
+    "var/assoc": {"a": "1", "b": {"x": "2", None: "3"}},
+}
+
+
+native_library, codec_lib = native_library_fixtures(
+    codec, "spec_codec", "BLISS_SPEC_CODEC_LIBRARY"
+)
+
+
+def _answer(m, version, order):
+    if m.cmd == message.HELLO:
+        return message.msg_hello_reply(m.sn, "fake", version=version, order=order)
+    if m.cmd == message.CHAN_READ:
+        return message.reply_message(
+            m.sn, m.name, VALUES[m.name], version=version, order=order
+        )
+    if m.cmd == message.CMD_WITH_RETURN:
+        if m.data == b"error":
+            return message.error_message(
+                m.sn, "", "failed", version=version, order=order
+            )
+        return message.reply_message(m.sn, "", m.data, version=version, order=order)
+    if m.cmd == message.REGISTER and m.name in VALUES:
+        return message.msg_event(m.name, VALUES[m.name], version=version, order=order)
+    if m.cmd == message.CHAN_SEND:
+        # echo the written value as an update event
+        return message.msg_event(m.name, m.data, version=version, order=order)
+
+
+@pytest.fixture(params=[(4, "<"), (4, ">"), (3, "<"), (2, ">")], ids=str)
+def fake_spec(request):
+    version, order = request.param
+
+    def handle(sock, address):
+        reader = codec.MessageReader()
+        while True:
+            messages = reader.recv(sock)
+            if messages is None:
+                return
+            for header, payload in messages:
+                m = message.message_from_stream(header, payload)
+                answer = _answer(m, version, order)
+                if answer is None:
+                    continue
+                data = answer.sendingString()
+                # in small chunks, the client gets partial messages
+                for i in range(0, len(data), 50000):
+                    sock.sendall(data[i : i + 50000])
+                    gevent.sleep(0)
+
+    server = StreamServer(("127.0.0.1", 0), handle)
+    server.start()
+    yield server.address[1], version
+    server.stop()
+
+
+def _message_bytes(version, order):
+    m = message.message(7, message.REPLY, "var/x", "12", version=version, order=order)
+    return m.sendingString()
+
+
+@pytest.mark.parametrize("version", [2, 3, 4])
+@pytest.mark.parametrize("order", ["<", ">"])
+def test_parse_header(codec_lib, version, order):
+    m = message.message(7, message.EVENT, "var/x", "12", version=version, order=order)
+    m.err, m.flags = 0, message.DELETED
+    data = m.sendingString()
+    assert codec.parse_header(data[:20]) is None
+    header = codec.parse_header(data)
+    assert header.vers == version
+    assert header.big_endian == (order == ">")
+    assert (header.sn, header.cmd, header.type) == (7, message.EVENT, message.STRING)
+    assert header.name == "var/x"
+    assert header.header_size == m.headerLength
+    assert header.len == 3
+    assert header.flags == (message.DELETED if version >= 4 else 0)
+    decoded = message.message_from_stream(header, data[header.header_size :])
+    assert decoded.data == 12
+    assert decoded.name == "var/x"
+    with pytest.raises(ValueError):
+        codec.parse_header(b"\x01" * 200)
+
+
+def test_scan(codec_lib):
+    stream = b"".join(_message_bytes(v, o) for v in (2, 3, 4) for o in "<>")
+    messages, consumed = codec.scan(stream + stream[:100])
+    assert consumed == len(stream)
+    assert [h.vers for _, h in messages] == [2, 2, 3, 3, 4, 4]
+    offset, header = messages[3]
+    start = offset + header.header_size
+    assert stream[start : start + header.len] == b"12\x00"
+    messages, consumed = codec.scan(stream, max_messages=2)
+    assert len(messages) == 2
+    # an invalid header stops the scan after the complete messages
+    messages, consumed = codec.scan(stream + b"\x01" * 200)
+    assert consumed == len(stream)
+    with pytest.raises(ValueError):
+        codec.scan(b"\x01" * 200)
+
+
+def test_reader_partial(codec_lib):
+    image = VALUES["var/image"]
+    stream = b"".join(
+        message.msg_event(name, VALUES[name], order=order).sendingString()
+        for name in ("var/counts", "var/image", "var/assoc")
+        for order in "<>"
+    )
+    reader = codec.MessageReader()
+    messages = []
+    for i in range(0, len(stream), 4093):
+        messages += reader.feed(stream[i : i + 4093])
+    values = [message.message_from_stream(*m).data for m in messages]
+    assert len(values) == 6
+    numpy.testing.assert_array_equal(values[0], VALUES["var/counts"])
+    numpy.testing.assert_array_equal(values[1], VALUES["var/counts"])
+    for value in values[2:4]:
+        assert value.shape == image.shape
+        numpy.testing.assert_array_equal(value, image)
+    assert values[4] == values[5] == VALUES["var/assoc"]
+
+
+def test_array_views():
+    data = numpy.arange(6, dtype=">u2").reshape(2, 3)
+    payload = data.tobytes() + b"\x00"
+    view = codec.decode_array(payload, codec.ARRAY_USHORT, 2, 3, big_endian=True)
+    numpy.testing.assert_array_equal(view, data)
+    # no copy of the payload
+    assert not view.flags.owndata
+    assert view.base is not None
+    strings = codec.decode_array(b"ab\x00cd\x00", codec.ARRAY_STRING, 2, 3)
+    assert list(strings) == [b"ab", b"cd"]
+    with pytest.raises(TypeError):
+        codec.array_type(numpy.zeros(3, dtype=numpy.complex64))
+
+
+def _reply(method, *args):
+    done = gevent.event.Event()
+    reply = method(*args, callback=lambda reply: done.set())
+    done.wait(timeout=5)
+    return reply
+
+
+def _wait_events(events, nb):
+    with gevent.Timeout(5):
+        while len(events) < nb:
+            gevent.sleep(0.01)
+
+
+def test_connection(codec_lib, fake_spec):
+    port, version = fake_spec
+    conn = SpecConnection("127.0.0.1:%d" % port)
+    try:
+        reply = _reply(conn.send_msg_chan_read, "var/image")
+        assert conn.serverVersion == version
+        assert isinstance(reply.data, numpy.ndarray)
+        numpy.testing.assert_array_equal(reply.data, VALUES["var/image"])
+
+        reply = _reply(conn.send_msg_chan_read, "var/assoc")
+        assert reply.data == VALUES["var/assoc"]
+
+        reply = _reply(conn.send_msg_cmd_with_return, "error")
+        assert reply.error
+        assert reply.data == b"failed"
+
+        events = []
+        conn.registerChannel("var/counts", lambda value: events.append(value[0]))
+        _wait_events(events, 1)
+        numpy.testing.assert_array_equal(events[0], VALUES["var/counts"])
+
+        conn.send_msg_chan_send("var/counts", numpy.ones((2, 4), dtype=numpy.int64))
+        _wait_events(events, 2)
+        assert events[1].dtype.str[1:] == "i8"
+        numpy.testing.assert_array_equal(events[1], numpy.ones((2, 4)))
+    finally:
+        conn.disconnect()
@@ -0,0 +1,222 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+import struct
+import socket
+
+import numpy
+import pytest
+import gevent
+
+from bliss.comm import xdr, sunrpc, vxi11_base
+from ..conftest import native_library_fixtures
+
+# fragments of the replies of the stand-in instrument
+FRAGMENT_SIZE = 100000
+CURVE = numpy.random.default_rng(0).integers(0, 256, 1000003, dtype="u1").tobytes()
+
+
+native_library, xdr_lib = native_library_fixtures(xdr, "xdr", "BLISS_XDR_LIBRARY")
+
+
+def _fragments(record, size):
+    """record marked fragments of record"""
+    data = b""
+    for i in range(0, len(record), size):
+        last = i + size >= len(record)
+        fragment = record[i : i + size]
+        data += struct.pack(">I", len(fragment) | (0x80000000 if last else 0))
+        data += fragment
+    return data
+
+
+def _send_pieces(sock, data, size):
+    for i in range(0, len(data), size):
+        sock.sendall(data[i : i + size])
+        gevent.sleep(0)
+
+
+class Instrument(sunrpc.TCPServer):
+    """loopback stand-in of the core channel of a VXI-11 instrument, the
+    answer to a query is read in several device_read"""
+
+    def __init__(self):
+        super().__init__(
+            "127.0.0.1",
+            vxi11_base.DEVICE_CORE_PROG,
+            vxi11_base.DEVICE_CORE_VERS,
+            0,
+        )
+        self.written = []
+        self.answer = b""
+
+    def addpackers(self):
+        self.packer = vxi11_base.Packer()
+        self.unpacker = vxi11_base.Unpacker("")
+
+    def session(self, connection):
+        sock, _ = connection
+        records = xdr.RecordReader()
+        while True:
+            try:
+                call = records.recv(sock)
+            except (EOFError, OSError):
+                return
+            reply = self.handle(call)
+            # the replies come in fragments and in odd sized pieces
+            _send_pieces(sock, _fragments(reply, FRAGMENT_SIZE), 77777)
+
+    def serve(self):
+        try:
+            self.loop()
+        except OSError:
+            pass  # closed
+
+    def handle_10(self):  # create_link
+        self.unpacker.unpack_create_link_parms()
+        self.turn_around()
+        self.packer.pack_create_link_resp((0, 1, 0, 4 * 1024 * 1024))
+
+    def handle_11(self):  # device_write
+        link, timeout, lock_timeout, flags, data = (
+            self.unpacker.unpack_device_write_parms()
+        )
+        self.written.append(data)
+        if data == b"CURVE?":
+            self.answer = CURVE
+        self.turn_around()
+        self.packer.pack_device_write_resp((0, len(data)))
+
+    def handle_12(self):  # device_read
+        link, request_size = self.unpacker.unpack_device_read_parms()[:2]
+        self.turn_around()
+        data, self.answer = self.answer[:request_size], self.answer[request_size:]
+        reason = vxi11_base.RX_REQCNT if self.answer else vxi11_base.RX_END
+        self.packer.pack_device_read_resp((0, reason, data))
+
+    def handle_23(self):  # destroy_link
+        self.unpacker.unpack_device_link()
+        self.turn_around()
+        self.packer.pack_device_error(0)
+
+
+@pytest.fixture
+def instrument():
+    server = Instrument()
+    server.sock.listen(0)
+    serving = gevent.spawn(server.serve)
+    yield server
+    server.sock.close()
+    serving.kill()
+
+
+def test_pack_unpack(xdr_lib):
+    p = xdr.Packer()
+    p.pack_uint(0xFFFFFFFF)
+    p.pack_int(-2)
+    p.pack_bool(True)
+    p.pack_hyper(-(2 ** 40))
+    p.pack_double(0.5)
+    p.pack_opaque(b"abcde")
+    p.pack_fstring(2, b"xyz")
+    p.pack_array([1, 2], p.pack_uint)
+    p.pack_list([3], p.pack_int)
+    p.pack_numbers([1.5, -2.0], "f4")
+    expected = struct.pack(">IiIqd", 0xFFFFFFFF, -2, 1, -(2 ** 40), 0.5)
+    expected += struct.pack(">I", 5) + b"abcde\0\0\0" + b"xy\0\0"
+    expected += struct.pack(">III", 2, 1, 2) + struct.pack(">IiI", 1, 3, 0)
+    expected += struct.pack(">Iff", 2, 1.5, -2.0)
+    assert p.get_buffer() == expected
+    with pytest.raises(xdr.ConversionError):
+        p.pack_uint(-1)
+
+    u = xdr.Unpacker(memoryview(bytearray(expected)))
+    assert u.unpack_uint() == 0xFFFFFFFF
+    assert u.unpack_int() == -2
+    assert u.unpack_bool() is True
+    assert u.unpack_hyper() == -(2 ** 40)
+    assert u.unpack_double() == 0.5
+    assert u.unpack_opaque() == b"abcde"
+    assert u.unpack_fstring(2) == b"xy"
+    assert u.unpack_array(u.unpack_uint) == [1, 2]
+    assert u.unpack_list(u.unpack_int) == [3]
+    numbers = u.unpack_numbers("f4")
+    assert numbers.dtype.isnative
+    numpy.testing.assert_array_equal(numbers, [1.5, -2.0])
+    u.done()
+    u.reset(expected[:10])
+    u.unpack_uint()
+    with pytest.raises(EOFError):
+        u.unpack_hyper()
+    with pytest.raises(xdr.Error):
+        u.done()
+
+
+@pytest.mark.parametrize("dtype", ["i4", "u4", "i8", "u8", "f4", "f8"])
+def test_numbers(xdr_lib, dtype):
+    values = (numpy.arange(-500, 500) * 1001).astype(dtype)
+    p = xdr.Packer()
+    p.pack_numbers(values, dtype)
+    raw = p.get_buffer()
+    assert raw[4:] == values.astype(">" + dtype).tobytes()
+    out = numpy.zeros(len(values) + 10, dtype)
+    u = xdr.Unpacker(raw)
+    numbers = u.unpack_numbers(dtype, out=out)
+    assert numbers.base is out
+    numpy.testing.assert_array_equal(numbers, values)
+
+
+def test_record_reader(xdr_lib):
+    first = bytes(range(256)) * 1000
+    second = b"second record"
+    stream = _fragments(first, 70001) + _fragments(second, 5)
+    # an empty last fragment
+    stream += struct.pack(">I", 3) + b"end" + struct.pack(">I", 0x80000000)
+    a, b = socket.socketpair()
+    b.settimeout(5)
+    sender = gevent.spawn(_send_pieces, a, stream, 3333)
+    try:
+        reader = xdr.RecordReader(size=1024)
+        assert reader.recv(b) == first
+        assert reader.recv(b) == second
+        assert reader.recv(b) == b"end"
+        sender.get(timeout=5)
+        a.close()
+        with pytest.raises(EOFError):
+            reader.recv(b)
+    finally:
+        a.close()
+        b.close()
+
+    a, b = socket.socketpair()
+    b.settimeout(5)
+    try:
+        a.sendall(_fragments(b"x" * 100, 50))
+        with pytest.raises(xdr.Error):
+            xdr.RecordReader(max_size=64).recv(b)
+    finally:
+        a.close()
+        b.close()
+
+
+def test_vxi11_device(xdr_lib, instrument):
+    device = vxi11_base.Device("127.0.0.1")
+    device.client = vxi11_base.CoreClient("127.0.0.1", instrument.port)
+    try:
+        device.open()
+        block = bytes(range(256)) * 5000
+        device.write_raw(block)
+        # in blocks of max_recv_size
+        assert len(instrument.written) == 2
+        assert b"".join(instrument.written) == block
+
+        # several device_read of several fragments
+        device.max_read_len = 300000
+        assert device.ask_raw(b"CURVE?") == CURVE
+        assert instrument.written[-1] == b"CURVE?"
+    finally:
+        device.close()
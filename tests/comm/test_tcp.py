@@ -8,6 +8,8 @@
 import time
 import pytest
 import gevent
+from gevent.server import StreamServer
+from bliss.comm import tcp
 from bliss.common.event import connect, disconnect
 
 
@@ -79,6 +81,32 @@ def test_concurency(command):
         t.get(3)
 
 
+def test_pipelined_transactions():
+    # the reply of the first request arrives in two parts, the second
+    # request is sent in between
+    def handle(sock, address):
+        f = sock.makefile("rb")
+        assert f.readline() == b"1\n"
+        sock.sendall(b"AAAA")
+        assert f.readline() == b"2\n"
+        sock.sendall(b"BBBB\nCCCC\n")
+        f.read()
+
+    server = StreamServer(("", 0), handle=handle)
+    server.start()
+    command = tcp.Command("127.0.0.1", server.address[1])
+    try:
+        command.connect()
+        first = gevent.spawn(command.write_readline, b"1\n")
+        gevent.sleep(0.1)
+        second = gevent.spawn(command.write_readline, b"2\n")
+        assert first.get(timeout=3) == b"AAAABBBB"
+        assert second.get(timeout=3) == b"CCCC"
+    finally:
+        command.close()
+        server.stop()
+
+
 def test_connect_socket(socket):
     assert socket.connect() is True
 
@@ -14,6 +14,7 @@ import gc
 import gevent
 from gevent import Greenlet
 import subprocess
+import importlib
 import signal
 import logging
 import json
@@ -147,6 +148,69 @@ def clean_louie():
     disp.reset()
 
 
+@pytest.fixture(scope="session")
+def build_native_library(tmp_path_factory):
+    """Build a shared library from C sources, skip the test without C compiler:
+    build_native_library(name, sources, include_dirs=()) returns its path"""
+    compiler = shutil.which("cc") or shutil.which("gcc")
+
+    def build(name, sources, include_dirs=()):
+        if compiler is None:
+            pytest.skip(f"no C compiler to build the {name} library")
+        library = str(tmp_path_factory.mktemp(name) / f"lib{name}.so")
+        command = [compiler, "-O2", "-shared", "-fPIC"]
+        command += [f"-I{path}" for path in include_dirs]
+        subprocess.check_call(command + ["-o", library] + list(sources))
+        return library
+
+    return build
+
+
+@contextmanager
+def native_library_context(env_var, library, *modules):
+    """Reload modules with env_var set to the path of their native library,
+    reload them without it on exit"""
+    os.environ[env_var] = library
+    try:
+        for module in modules:
+            importlib.reload(module)
+        yield
+    finally:
+        del os.environ[env_var]
+        for module in modules:
+            importlib.reload(module)
+
+
+def native_library_fixtures(module, name, env_var):
+    """Fixtures of the tests of a module loading its native library with
+    bliss.comm.native, to assign to the names native_library and the
+    implementation to test::
+
+        native_library, impl = native_library_fixtures(xdr, "xdr", "BLISS_XDR_LIBRARY")
+
+    native_library (module scope) builds the library from the name.c source
+    next to the module and reloads the module with it. The implementation is
+    "native" then "python", with lib set to None.
+    """
+
+    @pytest.fixture(scope="module")
+    def native_library(build_native_library):
+        source = os.path.join(os.path.dirname(module.__file__), name + ".c")
+        library = build_native_library(name, [source])
+        with native_library_context(env_var, library, module):
+            yield module.lib
+
+    @pytest.fixture(params=["native", "python"])
+    def implementation(request, monkeypatch):
+        if request.param == "native":
+            request.getfixturevalue("native_library")
+        else:
+            monkeypatch.setattr(module, "lib", None)
+        return request.param
+
+    return native_library, implementation
+
+
 class ResourcesContext:
     """
     This context ensure that every resource created during its execution
@@ -0,0 +1,92 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+import os
+import sys
+import pytest
+import numpy
+
+from bliss.controllers.speedgoat import xpc, speedgoat_server
+from bliss.controllers.speedgoat.speedgoat_client import Scope
+from ..conftest import native_library_context
+
+
+@pytest.fixture(scope="module")
+def standin(build_native_library):
+    """xpc bound to the stand-in library built from xpcapi_standin.c"""
+    source = os.path.join(os.path.dirname(__file__), "xpcapi_standin.c")
+    library = build_native_library("xpcapi_standin", [source])
+    # _cffi loads the library when imported
+    sys.modules.pop("bliss.controllers.speedgoat._cffi", None)
+    with native_library_context(
+        "SPEEDGOAT_XPCAPI_LIBRARY", library, xpc, speedgoat_server
+    ):
+        yield xpc
+
+
+@pytest.fixture
+def scope(standin):
+    handle = standin.tcp_connect("localhost", 22222)
+    signals = [3, 7, 11]
+    for signal in signals:
+        standin.sc_add_signal(handle, 2, signal)
+    standin.sc_set_num_samples(handle, 2, 50)
+    yield handle, 2, signals
+    for signal in signals:
+        standin.sc_rem_signal(handle, 2, signal)
+
+
+def test_sc_get_data_block(standin, scope):
+    handle, scope_id, signals = scope
+    data = standin.sc_get_data_block(handle, scope_id)
+    assert data.shape == (50, 3) and data.flags.f_contiguous
+    expected = numpy.array(signals) * 1000 + numpy.arange(50)[:, None]
+    numpy.testing.assert_array_equal(data, expected)
+    for column, signal in enumerate(signals):
+        numpy.testing.assert_array_equal(
+            data[:, column], standin.sc_get_data(handle, scope_id, signal)
+        )
+
+    data = standin.sc_get_data_block(handle, scope_id, [11, 3], 10, 20, 3)
+    numpy.testing.assert_array_equal(data[:, 0], 11000 + numpy.arange(10, 30, 3))
+    numpy.testing.assert_array_equal(data[:, 1], 3000 + numpy.arange(10, 30, 3))
+
+    out = numpy.empty((50, 3), order="F")
+    assert standin.sc_get_data_block(handle, scope_id, out=out).base is out
+    numpy.testing.assert_array_equal(out, expected)
+    with pytest.raises(ValueError):
+        standin.sc_get_data_block(handle, scope_id, out=numpy.empty((50, 3)))
+    with pytest.raises(standin.SimulinkError):
+        standin.sc_get_data_block(handle, scope_id, [3, 4])
+    with pytest.raises(standin.SimulinkError):
+        standin.sc_get_data_block(handle, scope_id, None, 40, 20)
+
+
+def test_output_log_block(standin):
+    handle = standin.tcp_connect("localhost", 22222)
+    data = standin.get_output_log_block(handle)
+    assert data.shape == (100, 4)
+    numpy.testing.assert_array_equal(
+        data, -(numpy.arange(4) * 1000 + numpy.arange(100)[:, None])
+    )
+    data = standin.get_output_log_block(handle, [2], 5, 10, 2)
+    numpy.testing.assert_array_equal(data[:, 0], -(2000 + numpy.arange(5, 15, 2)))
+    numpy.testing.assert_allclose(
+        standin.get_time_log(handle, 5, 10, 2), numpy.arange(5, 15, 2) * 1e-4
+    )
+    with pytest.raises(standin.SimulinkError):
+        standin.get_output_log_block(handle, [4])
+
+
+def test_scope_get_data_block_through_server(standin, scope):
+    _, scope_id, signals = scope
+    server = speedgoat_server.Speedgoat("localhost")
+    data = Scope(server, scope_id).get_data_block(signals[:2], 0, 30)
+    assert data.shape == (30, 2)
+    numpy.testing.assert_array_equal(
+        data, numpy.array(signals[:2]) * 1000 + numpy.arange(30)[:, None]
+    )
@@ -0,0 +1,216 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Stand-in for the xPC Target library (xpcapi.dll), the subset of
+ * xpcapi.h used by the speedgoat readout, backed by synthetic data:
+ *
+ *   signal s, point i   -> s * 1000 + i
+ *   output o, sample i  -> -(o * 1000 + i), at time i * SAMPLE_TIME
+ *
+ * Built by tests/controllers_sw/test_speedgoat_xpc.py.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#define NB_SIGNALS      50
+#define NB_SCOPES       12
+#define MAX_SCOPE_SIGNALS 20
+#define NB_OUTPUTS      4
+#define NB_LOG_SAMPLES  100
+#define SAMPLE_TIME     1e-4
+
+enum {ENOERR = 0,EINVPORT = 1,EINVNUMSAMP = 36,EINVDECIMATION = 37,
+      EINVLOGID = 39,EINVSCIDX = 47,EINVSIGIDX = 49,ETOOMANYSIGNALS = 64};
+
+static int last_error = ENOERR;
+static int scope_signals[NB_SCOPES][MAX_SCOPE_SIGNALS];
+static int scope_nb_signals[NB_SCOPES];
+static int scope_nb_samples[NB_SCOPES];
+
+/* every call starts by this, clears the error of the previous one */
+static int check_port(int port)
+{
+  last_error = port == 1 ? ENOERR : EINVPORT;
+  return last_error == ENOERR;
+}
+
+static int check_scope(int port,int scNum)
+{
+  if(!check_port(port))
+    return 0;
+  if(scNum < 0 || scNum >= NB_SCOPES)
+    {
+      last_error = EINVSCIDX;
+      return 0;
+    }
+  return 1;
+}
+
+static int check_range(int start,int numsamples,int decimation,int size)
+{
+  if(decimation < 1)
+    {
+      last_error = EINVDECIMATION;
+      return 0;
+    }
+  if(start < 0 || numsamples < 0 || start + numsamples > size)
+    {
+      last_error = EINVNUMSAMP;
+      return 0;
+    }
+  return 1;
+}
+
+/* Connection */
+int xPCOpenTcpIpPort(const char *address,const char *port) {return 1;}
+void xPCClosePort(int port) {}
+void xPCOpenConnection(int port) {check_port(port);}
+void xPCCloseConnection(int port) {}
+
+/* Error handling */
+int xPCGetLastError(void) {return last_error;}
+void xPCSetLastError(int error) {last_error = error;}
+const char * xPCErrorMsg(int errorno,char *errmsg)
+{
+  sprintf(errmsg,"stand-in error %d",errorno);
+  return errmsg;
+}
+const char * xPCGetAPIVersion(void) {return "stand-in";}
+
+/* Signals */
+int xPCGetNumSignals(int port) {return check_port(port) ? NB_SIGNALS : -1;}
+
+double xPCGetSignal(int port,int sigNum)
+{
+  if(!check_port(port))
+    return 0.;
+  if(sigNum < 0 || sigNum >= NB_SIGNALS)
+    {
+      last_error = EINVSIGIDX;
+      return 0.;
+    }
+  return sigNum * 1000.;
+}
+
+int xPCGetSignals(int port,int numSignals,const int *signals,double *values)
+{
+  int i;
+  if(!check_port(port))
+    return -1;
+  for(i = 0;i < numSignals;++i)
+    {
+      if(signals[i] < 0 || signals[i] >= NB_SIGNALS)
+	{
+	  last_error = EINVSIGIDX;
+	  return -1;
+	}
+      values[i] = signals[i] * 1000.;
+    }
+  return 0;
+}
+
+/* Scopes */
+int xPCScGetNumSignals(int port,int scNum)
+{
+  return check_scope(port,scNum) ? scope_nb_signals[scNum] : -1;
+}
+
+void xPCScGetSignals(int port,int scNum,int *data)
+{
+  if(!check_scope(port,scNum))
+    return;
+  memcpy(data,scope_signals[scNum],scope_nb_signals[scNum] * sizeof(int));
+  data[scope_nb_signals[scNum]] = -1;
+}
+
+void xPCScAddSignal(int port,int scNum,int sigNum)
+{
+  if(!check_scope(port,scNum))
+    return;
+  if(sigNum < 0 || sigNum >= NB_SIGNALS)
+    last_error = EINVSIGIDX;
+  else if(scope_nb_signals[scNum] == MAX_SCOPE_SIGNALS)
+    last_error = ETOOMANYSIGNALS;
+  else
+    scope_signals[scNum][scope_nb_signals[scNum]++] = sigNum;
+}
+
+void xPCScRemSignal(int port,int scNum,int sigNum)
+{
+  int i;
+  if(!check_scope(port,scNum))
+    return;
+  for(i = 0;i < scope_nb_signals[scNum];++i)
+    if(scope_signals[scNum][i] == sigNum)
+      {
+	memmove(scope_signals[scNum] + i,scope_signals[scNum] + i + 1,
+		(scope_nb_signals[scNum] - i - 1) * sizeof(int));
+	--scope_nb_signals[scNum];
+	return;
+      }
+  last_error = EINVSIGIDX;
+}
+
+int xPCScGetNumSamples(int port,int scNum)
+{
+  return check_scope(port,scNum) ? scope_nb_samples[scNum] : -1;
+}
+
+void xPCScSetNumSamples(int port,int scNum,int samples)
+{
+  if(check_scope(port,scNum))
+    scope_nb_samples[scNum] = samples;
+}
+
+void xPCScGetData(int port,int scNum,int signal_id,int start,
+		  int numsamples,int decimation,double *data)
+{
+  int i,found = 0;
+  if(!check_scope(port,scNum) ||
+     !check_range(start,numsamples,decimation,scope_nb_samples[scNum]))
+    return;
+  for(i = 0;i < scope_nb_signals[scNum];++i)
+    found |= scope_signals[scNum][i] == signal_id;
+  if(!found)
+    {
+      last_error = EINVSIGIDX;
+      return;
+    }
+  for(i = 0;i < numsamples;i += decimation)
+    *data++ = signal_id * 1000. + start + i;
+}
+
+/* Logging */
+int xPCGetNumOutputs(int port) {return check_port(port) ? NB_OUTPUTS : -1;}
+int xPCNumLogSamples(int port) {return check_port(port) ? NB_LOG_SAMPLES : -1;}
+
+void xPCGetOutputLog(int port,int start,int numsamples,
+		     int decimation,int output_id,double *data)
+{
+  int i;
+  if(!check_port(port) || !check_range(start,numsamples,decimation,NB_LOG_SAMPLES))
+    return;
+  if(output_id < 0 || output_id >= NB_OUTPUTS)
+    {
+      last_error = EINVLOGID;
+      return;
+    }
+  for(i = 0;i < numsamples;i += decimation)
+    *data++ = -(output_id * 1000. + start + i);
+}
+
+void xPCGetTimeLog(int port,int start,int numsamples,
+		   int decimation,double *data)
+{
+  int i;
+  if(!check_port(port) || !check_range(start,numsamples,decimation,NB_LOG_SAMPLES))
+    return;
+  for(i = 0;i < numsamples;i += decimation)
+    *data++ = (start + i) * SAMPLE_TIME;
+}
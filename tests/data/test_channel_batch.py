@@ -0,0 +1,145 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+import pytest
+import numpy
+
+from bliss.common import event
+from bliss.data.events import channel_batch
+from bliss.data.events.channel import (
+    ChannelDataEvent,
+    concatenate_chunks,
+    decode_chunk,
+    encode_chunk,
+)
+from bliss.scanning.channel import AcquisitionChannel
+from ..conftest import native_library_fixtures
+
+
+native_library, implementation = native_library_fixtures(
+    channel_batch, "channel_batch", "BLISS_CHANNEL_BATCH_LIBRARY"
+)
+
+
+def test_channel_batcher(native_library):
+    batcher = channel_batch.ChannelBatcher(
+        numpy.float32, (2,), capacity=4, max_latency=60
+    )
+    points = numpy.arange(20, dtype=numpy.float32).reshape(10, 2)
+    assert batcher.append(points[0]) == 0
+    assert batcher.pending == 1
+    assert batcher.append(points[1:6]) == 1  # split over chunks
+    chunks = batcher.chunks()
+    assert len(chunks) == 1 and batcher.pending == 2
+    numpy.testing.assert_array_equal(decode_chunk(chunks[0]), points[:4])
+    assert chunks[0] == encode_chunk(points[:4])
+    batcher.append(points[6:])
+    chunks = batcher.chunks(force=True)
+    assert [len(decode_chunk(chunk)) for chunk in chunks] == [4, 2]
+    numpy.testing.assert_array_equal(
+        numpy.concatenate([decode_chunk(chunk) for chunk in chunks]), points[4:]
+    )
+    assert batcher.pending == 0 and batcher.chunks(force=True) == []
+    with pytest.raises(ValueError):
+        batcher.append(numpy.zeros(3, numpy.float32))  # not whole points
+
+    batcher = channel_batch.ChannelBatcher(numpy.int32, (), capacity=100, max_latency=0)
+    batcher.append(numpy.int32(7))  # too old at once
+    (chunk,) = batcher.chunks()
+    assert decode_chunk(chunk).tolist() == [7]
+
+    with pytest.raises(TypeError):
+        channel_batch.ChannelBatcher(numpy.complex64)
+    with pytest.raises(ValueError):
+        channel_batch.ChannelBatcher(numpy.int32, (0, 3))  # empty points
+    with pytest.raises(ValueError):
+        channel_batch.ChannelBatcher(numpy.int32, capacity=0)
+
+
+def test_acquisition_channel_batching(implementation):
+    chan = AcquisitionChannel(
+        "test:batched", numpy.float64, (), batch_size=100, batch_latency=60
+    )
+    received = []
+
+    def on_data(data_dct, sender=None, signal=None):
+        received.append(data_dct)
+
+    event.connect(chan, "new_data", on_data)
+    try:
+        for i in range(250):
+            chan.emit(float(i))
+        chan.emit(numpy.arange(250, 260, dtype=numpy.float64))
+        if implementation == "native":
+            assert [len(d["data"]) for d in received] == [100, 100]
+            chan.flush()
+            assert [len(d["data"]) for d in received] == [100, 100, 60]
+            assert all("chunk" in d for d in received)
+        else:
+            # no batching without the library
+            assert len(received) == 251
+            chan.flush()
+            assert len(received) == 251
+            assert not any("chunk" in d for d in received)
+        numpy.testing.assert_array_equal(
+            numpy.concatenate([d["data"] for d in received]), numpy.arange(260)
+        )
+    finally:
+        event.disconnect(chan, "new_data", on_data)
+
+
+def test_channel_data_event_chunk():
+    description = {"dtype": numpy.uint16, "shape": (3,)}
+    data = numpy.arange(12, dtype=">u2").reshape(4, 3)
+    ev = ChannelDataEvent(None, description, chunk=encode_chunk(data))
+    raw = ev.encode()
+    assert raw[ev.DATA_KEY] == encode_chunk(data)
+    ev = ChannelDataEvent(raw=raw)
+    assert ev.npoints == 4
+    numpy.testing.assert_array_equal(ev.data, data)
+    ev = ChannelDataEvent(None, description, chunk=encode_chunk(data[:1]))
+    ev = ChannelDataEvent(raw=ev.encode())
+    assert ev.npoints == 1
+    numpy.testing.assert_array_equal(ev.data, data[0])
+
+
+def test_concatenate_chunks(implementation):
+    data = numpy.arange(30, dtype=numpy.int32).reshape(10, 3)
+    chunks = [encode_chunk(data[:4]), encode_chunk(data[4:5]), encode_chunk(data[5:])]
+    result = concatenate_chunks(chunks)
+    assert result.dtype == numpy.int32 and result.dtype.isnative
+    numpy.testing.assert_array_equal(result, data)
+    swapped = [
+        encode_chunk(data[:6].astype(">f8")),
+        encode_chunk(data[6:].astype(">f8")),
+    ]
+    result = concatenate_chunks(swapped)
+    assert result.dtype == numpy.float64 and result.dtype.isnative
+    numpy.testing.assert_array_equal(result, data)
+    with pytest.raises(ValueError):
+        concatenate_chunks([chunks[0], encode_chunk(data[:, :2])])
+    with pytest.raises(ValueError):
+        concatenate_chunks([chunks[0], swapped[0]])
+    with pytest.raises(ValueError):
+        concatenate_chunks([chunks[0][:-1]])
+
+
+def test_channel_data_event_merge_chunks(implementation):
+    description = {"dtype": numpy.uint16, "shape": (3,)}
+    data = numpy.arange(30, dtype=numpy.uint16).reshape(10, 3)
+    events = []
+    for i, points in enumerate((data[:4], data[4:5], data[5:])):
+        chunk = encode_chunk(points)
+        events.append((i, ChannelDataEvent(None, description, chunk=chunk).encode()))
+    ev = ChannelDataEvent.merge(events)
+    assert ev.npoints == 10
+    assert ev.description["shape"] == (3,)
+    numpy.testing.assert_array_equal(ev.data, data)
+    # pickled events are still merged
+    events.append((3, ChannelDataEvent(data[:2], description).encode()))
+    ev = ChannelDataEvent.merge(events)
+    numpy.testing.assert_array_equal(ev.data, numpy.concatenate([data, data[:2]]))
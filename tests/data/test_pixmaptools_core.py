@@ -0,0 +1,758 @@
+# -*- coding: utf-8 -*-
+#
+# This file is part of the bliss project
+#
+# Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+# Distributed under the GNU LGPLv3. See LICENSE for more info.
+
+import os
+import time
+import zlib
+import struct
+import shutil
+import subprocess
+import importlib
+import pytest
+import numpy
+
+from bliss.data import lima_image
+from bliss.data.routines import pixmaptools
+from bliss.data.routines.pixmaptools import _cffi, core
+
+SOURCES = (
+    "pixmaptools_accumulator.cpp",
+    "pixmaptools_azim.cpp",
+    "pixmaptools_capi.cpp",
+    "pixmaptools_cpu.cpp",
+    "pixmaptools_display.cpp",
+    "pixmaptools_edf.cpp",
+    "pixmaptools_encode.cpp",
+    "pixmaptools_lut.cpp",
+    "pixmaptools_pipeline.cpp",
+    "pixmaptools_prefetch.cpp",
+    "pixmaptools_stat.cpp",
+    "pixmaptools_thread.cpp",
+    "pixmaptools_timing.cpp",
+)
+
+
+@pytest.fixture(scope="module")
+def native(tmp_path_factory):
+    """The core module, the library is built here when setup.py did not"""
+    if core.available():
+        yield core
+        return
+    compiler = shutil.which("c++") or shutil.which("g++")
+    if compiler is None:
+        pytest.skip("pixmaptools core library not built and no C++ compiler")
+    src_dir = os.path.dirname(pixmaptools.__file__)
+    library = str(tmp_path_factory.mktemp("pixmaptools") / "libpixmaptools_core.so")
+    command = (
+        [compiler, "-std=gnu++11", "-O1", "-shared", "-fPIC", "-pthread"]
+        + ["-I", src_dir, "-o", library]
+        + [os.path.join(src_dir, name) for name in SOURCES]
+        + ["-lz"]
+    )
+    try:
+        subprocess.check_call(command + ["-DPIXMAPTOOLS_HAVE_JPEG", "-ljpeg"])
+    except subprocess.CalledProcessError:
+        subprocess.check_call(command)  # no libjpeg
+    os.environ["PIXMAPTOOLS_CORE_LIBRARY"] = library
+    try:
+        importlib.reload(_cffi)
+        importlib.reload(core)
+        yield core
+    finally:
+        del os.environ["PIXMAPTOOLS_CORE_LIBRARY"]
+
+
+def test_map_greyscale(native):
+    data = numpy.arange(20, dtype=numpy.uint16).reshape(4, 5) * 100
+    image, vmin, vmax = native.map(data)
+    assert (vmin, vmax) == (0, 1900)
+    grey = image & 0xFF
+    assert grey[0, 0] == 0 and grey[-1, -1] == 0xFF
+    assert numpy.all(numpy.diff(grey.ravel().astype(int)) >= 0)
+    assert numpy.all(image >> 24 == 0xFF)
+
+
+def test_map_explicit_range(native):
+    data = numpy.array([[-1.0, 0.0, 0.5, 1.0, 2.0]])
+    image, _, _ = native.map(data, vmin=0.0, vmax=1.0)
+    grey = image & 0xFF
+    assert list(grey[0, [0, 1, 3, 4]]) == [0, 0, 0xFF, 0xFF]
+    assert 0x70 < grey[0, 2] < 0x90
+
+
+def test_histo(native):
+    data = numpy.random.RandomState(0).randint(0, 1000, size=10000).astype(numpy.int32)
+    counts, edges = native.histo(data, bins=10, lower=0, upper=1000)
+    ref_counts, ref_edges = numpy.histogram(data, bins=10, range=(0, 1000))
+    numpy.testing.assert_array_equal(counts, ref_counts)
+    numpy.testing.assert_allclose(edges, ref_edges)
+    counts = native.histo_edges(data, [0, 10, 500, 999])
+    assert list(counts) == [
+        numpy.count_nonzero(data < 10),
+        numpy.count_nonzero((data >= 10) & (data < 500)),
+        numpy.count_nonzero(data >= 500),
+    ]
+
+
+def test_histo_log(native):
+    data = numpy.arange(-10, 1001, dtype=numpy.int32)
+    counts, edges = native.histo(data, bins=3, log=True)
+    # the data range is the positive min and the max
+    numpy.testing.assert_allclose(edges, [1, 10, 100, 1000])
+    numpy.testing.assert_array_equal(counts, numpy.histogram(data, edges)[0])
+    counts, edges = native.histo(data, bins=2, lower=10, upper=1000, log=True)
+    numpy.testing.assert_allclose(edges, [10, 100, 1000])
+    # no silent change of a range not positive
+    for lower, upper in ((0, 100), (-1, 100), (100, 10)):
+        with pytest.raises(native.NativeError):
+            native.histo(data, bins=2, lower=lower, upper=upper, log=True)
+    with pytest.raises(native.NativeError):
+        native.histo(-numpy.abs(data), bins=2, log=True)
+
+
+# 80x64 frame, 0.1 mm pixels, beam off center, radial bins of 0.1 mm
+AZIM_SHAPE = (64, 80)
+AZIM_CENTER = (40.0, 31.0)
+
+
+@pytest.fixture
+def azim(native):
+    azim = native.AzimuthalIntegrator()
+    azim.set_geometry(*AZIM_SHAPE[::-1], *AZIM_CENTER, 1e-4, 1e-4, 0.1)
+    return azim
+
+
+def _azim_coordinates():
+    """radius (mm) and chi (deg) of the pixel centers"""
+    y, x = numpy.mgrid[0 : AZIM_SHAPE[0], 0 : AZIM_SHAPE[1]]
+    x, y = x - AZIM_CENTER[0], y - AZIM_CENTER[1]
+    return numpy.hypot(x, y) * 0.1, numpy.degrees(numpy.arctan2(y, x))
+
+
+def test_azimuthal_constant_image(native, azim):
+    azim.setup(30, 1, native.RadialUnit.R_MM, (0.0, 3.0))
+    for dtype in (numpy.uint16, numpy.int32, numpy.float32):
+        profile = azim.integrate(numpy.full(AZIM_SHAPE, 7, dtype))
+        assert profile.shape == (30,)
+        numpy.testing.assert_allclose(profile, 7)
+    with pytest.raises(native.NativeError):
+        azim.integrate(numpy.ones((3, 3)))
+    with pytest.raises(native.NativeError):
+        native.AzimuthalIntegrator().integrate(numpy.ones(AZIM_SHAPE))
+
+
+def test_azimuthal_radial_profile(native, azim):
+    radius, _ = _azim_coordinates()
+    azim.setup(30, 1, native.RadialUnit.R_MM, (0.0, 3.0))
+    positions, chi = azim.positions()
+    numpy.testing.assert_allclose(positions, numpy.arange(30) * 0.1 + 0.05)
+    assert azim.nb_bins == (30, 1) and len(chi) == 1
+    profile = azim.integrate(radius)
+    # pixels split over bins vs pixel centers binned, off near the center
+    counts = numpy.histogram(radius, 30, (0.0, 3.0))[0]
+    sums = numpy.histogram(radius, 30, (0.0, 3.0), weights=radius)[0]
+    numpy.testing.assert_allclose(profile[3:], (sums / counts)[3:], atol=0.05)
+    numpy.testing.assert_allclose(profile, positions, atol=0.05)
+
+
+def test_azimuthal_cake_uniform_in_chi(native, azim):
+    radius, _ = _azim_coordinates()
+    azim.setup(30, 8, native.RadialUnit.R_MM, (0.0, 3.0))
+    _, chi = azim.positions()
+    numpy.testing.assert_allclose(chi, numpy.arange(-180, 180, 45) + 22.5)
+    cake = azim.integrate(radius)
+    assert cake.shape == (8, 30) and azim.nb_bins == (30, 8)
+    azim.setup(30, 1, native.RadialUnit.R_MM, (0.0, 3.0))
+    profile = azim.integrate(radius)
+    # the first bins hold too few pixels to compare
+    numpy.testing.assert_allclose(
+        cake[:, 3:], numpy.tile(profile[3:], (8, 1)), atol=0.01
+    )
+
+
+def test_azimuthal_mask(native, azim):
+    _, chi = _azim_coordinates()
+    data = numpy.full(AZIM_SHAPE, 5.0)
+    mask = numpy.zeros(AZIM_SHAPE, numpy.uint8)
+    mask[::7, ::5] = 1
+    data[mask != 0] = 1e6
+    azim.set_mask(mask)
+    azim.setup(30, 1, native.RadialUnit.R_MM, (0.0, 3.0))
+    numpy.testing.assert_allclose(azim.integrate(data), 5.0)
+
+    # the -180..-90 quadrant masked: no chi bin sees it, the first is empty
+    quadrant = chi < -90
+    data = numpy.where(quadrant, 1e6, 5.0)
+    azim.set_mask(quadrant)
+    azim.setup(30, 8, native.RadialUnit.R_MM, (0.0, 3.0))
+    cake = azim.integrate(data)
+    assert cake.max() <= 5.0 + 1e-9
+    assert not cake[0, 5:].any()
+    numpy.testing.assert_allclose(cake[2:, 5:], 5.0)
+
+    azim.set_mask(None)
+    azim.setup(30, 8, native.RadialUnit.R_MM, (0.0, 3.0))
+    assert cake.max() < azim.integrate(data).max()
+    with pytest.raises(native.NativeError):
+        azim.set_mask(numpy.zeros((3, 3)))
+
+
+def _accumulator_frames(dtype=numpy.uint16):
+    # a large offset and a small spread, the naive sum of squares loses it
+    rng = numpy.random.RandomState(1)
+    return (60000 + rng.randint(0, 20, size=(25, 6, 7))).astype(dtype)
+
+
+@pytest.mark.parametrize("dtype", [numpy.float32, numpy.float64])
+def test_accumulator_welford(native, dtype):
+    frames = _accumulator_frames()
+    acc = native.PixelAccumulator(dtype)
+    assert acc.snapshot().shape == (0, 0)
+    for frame in frames:
+        acc.add(frame)
+    assert acc.count == len(frames)
+    rtol = 1e-5 if dtype == numpy.float32 else 1e-12
+    mean = acc.snapshot(native.Statistic.MEAN)
+    assert mean.dtype == dtype and mean.shape == frames.shape[1:]
+    numpy.testing.assert_allclose(mean, frames.mean(axis=0), rtol=rtol)
+    variance = acc.snapshot(native.Statistic.VARIANCE)
+    assert variance.dtype == dtype
+    numpy.testing.assert_allclose(variance, frames.var(axis=0), rtol=rtol * 100)
+    numpy.testing.assert_array_equal(
+        acc.snapshot(native.Statistic.MIN), frames.min(axis=0)
+    )
+    numpy.testing.assert_array_equal(
+        acc.snapshot(native.Statistic.MAX), frames.max(axis=0)
+    )
+
+
+def test_accumulator_exponential(native):
+    frames = _accumulator_frames(numpy.float64)
+    alpha = 0.2
+    acc = native.PixelAccumulator(mode=native.AccumulatorMode.EXPONENTIAL, alpha=alpha)
+    mean, variance = frames[0].copy(), numpy.zeros(frames.shape[1:])
+    acc.add(frames[0])
+    for frame in frames[1:]:
+        acc.add(frame)
+        delta = frame - mean
+        mean += alpha * delta
+        variance = (1 - alpha) * (variance + alpha * delta ** 2)
+    numpy.testing.assert_allclose(acc.snapshot(native.Statistic.MEAN), mean)
+    numpy.testing.assert_allclose(acc.snapshot(native.Statistic.VARIANCE), variance)
+    with pytest.raises(native.NativeError):
+        native.PixelAccumulator(mode=native.AccumulatorMode.EXPONENTIAL, alpha=0)
+
+
+def test_accumulator_frame_size(native):
+    acc = native.PixelAccumulator()
+    acc.add(numpy.ones((4, 5), numpy.int32))
+    with pytest.raises(native.NativeError):
+        acc.add(numpy.ones((5, 4), numpy.int32))
+    with pytest.raises(native.NativeError):
+        acc.add(numpy.ones(20, numpy.int32))
+    assert acc.count == 1
+    # a reset lets the next frame set another size
+    acc.reset()
+    assert acc.count == 0
+    acc.add(numpy.full((5, 4), 3, numpy.int8))
+    numpy.testing.assert_array_equal(acc.snapshot(), numpy.full((5, 4), 3.0))
+    with pytest.raises(native.NativeError):
+        native.PixelAccumulator(numpy.int32)
+
+
+def test_raw_video_rgb24(native):
+    rgb = numpy.array([[[255, 0, 0], [0, 255, 0]], [[0, 0, 255], [1, 2, 3]]], numpy.uint8)
+    image = native.raw_video_to_bgra(rgb.tobytes(), 2, 2, native.ImageType.RGB24)
+    numpy.testing.assert_array_equal(native.bgra_to_rgb(image), rgb)
+
+
+def test_raw_video_luma(native):
+    data = numpy.arange(12, dtype=numpy.uint16).reshape(3, 4)
+    luma = native.raw_video_to_luma(data, 4, 3, native.ImageType.Y16)
+    numpy.testing.assert_array_equal(luma, data)
+
+
+def test_raw_video_checks_size(native):
+    with pytest.raises(native.NativeError):
+        native.raw_video_to_bgra(b"\x00" * 11, 2, 2, native.ImageType.RGB24)
+    with pytest.raises(native.NativeError):
+        native.raw_video_to_bgra(b"\x00" * 100, 3, 3, native.ImageType.I420)
+
+
+def test_timing(native):
+    native.set_timing_enabled(True)
+    native.timing_stats(reset=True)
+    data = numpy.zeros((16, 16), numpy.uint8)
+    native.raw_video_to_bgra(data, 16, 16, native.ImageType.Y8)
+    stats = native.timing_stats()
+    assert stats["decode"]["count"] == 1
+    assert stats["decode"]["p99"] >= stats["decode"]["p50"] >= 0
+
+
+def test_timing_toggle_and_reset(native):
+    data = numpy.zeros((16, 16), numpy.uint8)
+    native.set_timing_enabled(True)
+    try:
+        native.timing_stats(reset=True)
+        native.raw_video_to_bgra(data, 16, 16, native.ImageType.Y8)
+        native.raw_video_to_bgra(data, 16, 16, native.ImageType.Y8)
+        # the stats are returned before the reset
+        stats = native.timing_stats(reset=True)
+        assert stats["decode"]["count"] == 2
+        assert stats["decode"]["total"] >= stats["decode"]["max"] >= 0
+        for stat in native.timing_stats().values():
+            assert stat["count"] == 0
+            assert stat["total"] == stat["max"] == stat["p99"] == 0
+
+        native.set_timing_enabled(False)
+        assert not native.timing_enabled()
+        native.raw_video_to_bgra(data, 16, 16, native.ImageType.Y8)
+        assert native.timing_stats()["decode"]["count"] == 0
+
+        native.set_timing_enabled(True)
+        assert native.timing_enabled()
+        native.raw_video_to_bgra(data, 16, 16, native.ImageType.Y8)
+        assert native.timing_stats()["decode"]["count"] == 1
+    finally:
+        native.set_timing_enabled(True)
+
+
+def test_lima_image_native_fallback(native, monkeypatch):
+    monkeypatch.setattr(lima_image, "pixmaptools_core", native)
+    monkeypatch.setattr(lima_image, "_RGB_CODECS", {})
+    header = lima_image.struct.pack(
+        lima_image.VIDEO_HEADER_FORMAT,
+        lima_image.VIDEO_MAGIC,
+        1,
+        lima_image.VIDEO_MODES.BGR24.value,
+        3,
+        2,
+        1,
+        0,
+        lima_image.VIDEO_HEADER_SIZE,
+        0,
+        0,
+    )
+    bgr = numpy.array([[[0, 0, 255], [0, 255, 0]]], numpy.uint8)
+    data, frame_number = lima_image.decode_devencoded_video(header + bgr.tobytes())
+    assert frame_number == 3
+    numpy.testing.assert_array_equal(data, bgr[..., ::-1])
+
+
+def test_cpu_levels_match(native):
+    initial = native.cpu_level()
+    rand = numpy.random.RandomState(1)
+    floats = rand.normal(size=(37, 53))
+    floats[3, 4] = numpy.nan
+    shorts = rand.randint(-500, 500, size=(37, 53)).astype(numpy.int16)
+    rgb = rand.randint(0, 256, size=(37, 53, 3)).astype(numpy.uint8)
+    results = []
+    try:
+        for level in ("generic", "sse2", "avx2", "avx512"):
+            native.set_cpu_level(level)
+            scaling = native.Scaling()
+            scaling.set_custom_mapping(10, 200)
+            scaling.mode = native.ScalingMode.QUICK
+            results.append(
+                (
+                    native.map(floats),
+                    native.map(shorts),
+                    native.raw_video_to_bgra(rgb, 53, 37, native.ImageType.RGB24),
+                    native.raw_video_to_bgra(
+                        rgb, 53, 37, native.ImageType.BGR24, scaling=scaling
+                    ),
+                )
+            )
+        with pytest.raises(ValueError):
+            native.set_cpu_level("mmx")
+    finally:
+        native.set_cpu_level(initial)
+    for result in results[1:]:
+        for (image, vmin, vmax), (ref, ref_min, ref_max) in zip(
+            result[:2], results[0][:2]
+        ):
+            numpy.testing.assert_array_equal(image, ref)
+            assert (vmin, vmax) == (ref_min, ref_max)
+        for image, ref in zip(result[2:], results[0][2:]):
+            numpy.testing.assert_array_equal(image, ref)
+
+
+def test_display_worker_latest_frame_wins(native):
+    worker = native.DisplayWorker()
+    assert worker.fetch() is None
+    frames = [numpy.full((4, 6), value, numpy.uint8) for value in (10, 20, 30)]
+    # not started: the mailbox keeps only the latest frame
+    for frame_number, frame in enumerate(frames):
+        worker.push(frame, 6, 4, native.ImageType.Y8, frame_number)
+    counters = worker.counters
+    assert counters["pushed"] == 3 and counters["dropped"] == 2
+    worker.start()
+    try:
+        result = None
+        for _ in range(1000):
+            result = worker.fetch()
+            if result is not None:
+                break
+            time.sleep(0.005)
+        assert result is not None
+        image, frame_number, latency = result
+        assert frame_number == 2 and latency >= 0
+        assert image.shape == (4, 6)
+        assert numpy.all(image == 0xFF000000 | 30 << 16 | 30 << 8 | 30)
+        assert worker.fetch() is None
+        with pytest.raises(native.NativeError):
+            worker.push(b"\x00" * 10, 6, 4, native.ImageType.Y8)
+    finally:
+        worker.stop()
+    assert worker.counters["decoded"] == 1
+
+
+def test_display_worker_stream(native):
+    worker = native.DisplayWorker()
+    worker.set_autoscale(native.Autoscale.MIN_MAX)
+    worker.start()
+    try:
+        last = -1
+        rand = numpy.random.RandomState(2)
+        for frame_number in range(200):
+            frame = rand.randint(0, 4096, size=(32, 48)).astype(numpy.uint16)
+            worker.push(frame, 48, 32, native.ImageType.Y16, frame_number)
+            result = worker.fetch()
+            if result is not None:
+                assert result[1] > last
+                last = result[1]
+    finally:
+        worker.stop()
+    counters = worker.counters
+    assert counters["pushed"] == 200 and counters["errors"] == 0
+    assert counters["decoded"] + counters["dropped"] <= 200
+
+
+def _wait_image(pipeline):
+    for _ in range(1000):
+        result = pipeline.fetch()
+        if result is not None:
+            return result
+        time.sleep(0.005)
+    raise AssertionError("no image from the pipeline")
+
+
+def test_video_pipeline_devencoded(native):
+    pipeline = native.VideoPipeline()
+    rgb = numpy.array([[[255, 0, 0], [0, 255, 0], [0, 0, 255]]], numpy.uint8)
+
+    def devencoded(frame_number, mode=lima_image.VIDEO_MODES.RGB24):
+        header = lima_image.struct.pack(
+            lima_image.VIDEO_HEADER_FORMAT,
+            lima_image.VIDEO_MAGIC,
+            1,
+            mode.value,
+            frame_number,
+            3,
+            1,
+            0,
+            lima_image.VIDEO_HEADER_SIZE,
+            0,
+            0,
+        )
+        return header + rgb.tobytes()
+
+    assert not pipeline.push_devencoded(devencoded(-1))
+    with pytest.raises(native.NativeError):
+        pipeline.push_devencoded(devencoded(0, lima_image.VIDEO_MODES.YUV444PACKED))
+    with pytest.raises(native.NativeError):
+        pipeline.push_devencoded(b"VDEO")
+    assert pipeline.push_devencoded(("VIDEO_IMAGE", devencoded(7)))
+    pipeline.start()
+    try:
+        image, frame_number, latency = _wait_image(pipeline)
+    finally:
+        pipeline.stop()
+    assert frame_number == 7 and latency >= 0
+    assert not image.flags.writeable
+    numpy.testing.assert_array_equal(native.bgra_to_rgb(image), rgb)
+    latencies = pipeline.latencies
+    assert latencies["total"]["last"] >= latencies["decode"]["last"] > 0
+
+
+def test_video_pipeline_zero_copy_buffers(native):
+    pipeline = native.VideoPipeline()
+    pipeline.start()
+    held = []
+    try:
+        for frame_number in range(native.VideoPipeline.MAX_IMAGES):
+            frame = numpy.full((8, 8), frame_number, numpy.uint8)
+            pipeline.push(frame, 8, 8, native.ImageType.Y8, frame_number)
+            held.append(_wait_image(pipeline))
+        # all images are held by the caller: nothing to decode into
+        pipeline.push(numpy.zeros((8, 8), numpy.uint8), 8, 8, native.ImageType.Y8)
+        for _ in range(1000):
+            if pipeline.counters["errors"]:
+                break
+            time.sleep(0.005)
+        assert pipeline.fetch() is None
+        # images held by the caller are never overwritten
+        for image, frame_number, _ in held:
+            assert numpy.all(image & 0xFF == frame_number)
+        del held, image
+        pipeline.push(numpy.ones((8, 8), numpy.uint8), 8, 8, native.ImageType.Y8, 42)
+        assert _wait_image(pipeline)[1] == 42
+    finally:
+        pipeline.stop()
+    counters = pipeline.counters
+    assert counters["decoded"] == native.VideoPipeline.MAX_IMAGES + 1
+    assert counters["errors"] == 1
+    assert pipeline.fps > 0
+
+
+def _decode_png(data):
+    """(h, w, channels) uint8 array of an 8 bits RGB(A) png"""
+    assert data[:8] == b"\x89PNG\r\n\x1a\n"
+    pos, idat = 8, b""
+    while pos < len(data):
+        length, kind = struct.unpack("!I4s", data[pos : pos + 8])
+        chunk = data[pos + 8 : pos + 8 + length]
+        (crc,) = struct.unpack("!I", data[pos + 8 + length : pos + 12 + length])
+        assert crc == zlib.crc32(kind + chunk)
+        if kind == b"IHDR":
+            width, height, depth, color = struct.unpack("!IIBB", chunk[:10])
+            assert depth == 8
+            bpp = {2: 3, 6: 4}[color]
+        elif kind == b"IDAT":
+            idat += chunk
+        pos += 12 + length
+    assert kind == b"IEND"
+    raw = zlib.decompress(idat)  # checks adler32 too
+    stride = width * bpp
+    image = numpy.zeros((height, stride), numpy.int32)
+    prev = numpy.zeros(stride, numpy.int32)
+    for r in range(height):
+        line = raw[r * (stride + 1) : (r + 1) * (stride + 1)]
+        kind, cur = line[0], list(line[1:])
+        for i in range(stride):
+            a = cur[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                cur[i] += a
+            elif kind == 2:
+                cur[i] += b
+            elif kind == 3:
+                cur[i] += (a + b) >> 1
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                cur[i] += a if pa <= pb and pa <= pc else b if pb <= pc else c
+            cur[i] &= 0xFF
+        image[r] = prev = numpy.array(cur, numpy.int32)
+    return image.astype(numpy.uint8).reshape(height, width, bpp)
+
+
+def test_encode_png(native):
+    rand = numpy.random.RandomState(3)
+    data = numpy.add.outer(numpy.arange(300), numpy.arange(70)).astype(numpy.float32)
+    data += rand.normal(scale=5, size=data.shape)
+    image, _, _ = native.map(data, palette=native.PaletteType.TEMP)
+    rgb = native.bgra_to_rgb(image)
+    previous_threads = native.nb_threads()
+    try:
+        native.set_nb_threads(4)
+        for level in (0, 1, 9):
+            encoded = native.encode_png(image, level=level)
+            numpy.testing.assert_array_equal(_decode_png(encoded), rgb)
+    finally:
+        native.set_nb_threads(previous_threads)
+    rgba = _decode_png(native.encode_png(image[:5, :7], alpha=True))
+    numpy.testing.assert_array_equal(rgba[..., :3], rgb[:5, :7])
+    assert numpy.all(rgba[..., 3] == 0xFF)
+    assert native.thumbnail(data, "png") == native.encode_png(native.map(data)[0])
+    with pytest.raises(native.NativeError):
+        native.encode_png(image, level=10)
+
+
+def test_encode_jpeg(native):
+    image, _, _ = native.map(numpy.arange(64 * 48).reshape(48, 64))
+    if not native.has_jpeg():
+        with pytest.raises(native.NativeError):
+            native.encode_jpeg(image)
+        return
+    encoded = native.encode_jpeg(image, quality=90)
+    assert encoded[:2] == b"\xff\xd8" and encoded[-2:] == b"\xff\xd9"
+    assert struct.unpack("!HH", encoded[encoded.index(b"\xff\xc0") + 5 :][:4]) == (
+        48,
+        64,
+    )
+    assert len(native.thumbnail(image, "jpeg", quality=10)) < len(encoded)
+    with pytest.raises(native.NativeError):
+        native.encode_jpeg(image, quality=0)
+
+
+def _edf_block(data, extra="", dtype=None):
+    dtype = data.dtype if dtype is None else dtype
+    names = {"u2": "UnsignedShort", "i4": "SignedInteger", "f8": "DoubleValue"}
+    header = "{\n"
+    for i, dim in enumerate(reversed(data.shape)):
+        header += f"Dim_{i + 1} = {dim} ;\n"
+    header += f"DataType = {names[dtype.kind + str(dtype.itemsize)]} ;\n"
+    header += "ByteOrder = %s ;\n" % (
+        "HighByteFirst" if dtype.byteorder == ">" else "LowByteFirst"
+    )
+    header += extra
+    header += " " * (512 - (len(header) + 2) % 512) + "}\n"
+    return header.encode() + data.tobytes()
+
+
+def test_edf_reader(native, tmp_path):
+    rand = numpy.random.RandomState(4)
+    frames = [
+        rand.randint(0, 60000, size=(5, 7)).astype(numpy.uint16),
+        rand.randint(-1000, 1000, size=(3, 4)).astype(">i4"),
+        rand.normal(size=(2, 3, 4)),
+    ]
+    filename = str(tmp_path / "concat.edf")
+    with open(filename, "wb") as f:
+        f.write(b"{\nEDF_DataFormatVersion = 2.30 ;\n}\n")  # general header
+        for index, frame in enumerate(frames):
+            f.write(_edf_block(frame, f"Image = {index} ;\nSize = {frame.nbytes} ;\n"))
+        f.write(_edf_block(frames[0])[:-10])  # frame being written
+
+    edf = native.open_edf(filename)
+    assert len(edf) == 3
+    for index, frame in enumerate(frames):
+        data = edf.data(index)
+        assert data.dtype == frame.dtype and not data.flags.writeable
+        numpy.testing.assert_array_equal(data, frame)
+    assert edf.header(1)["Image"] == "1"
+    numpy.testing.assert_array_equal(edf.data(-1), frames[-1])
+    with pytest.raises(native.NativeError):
+        edf.data(3)
+    assert native.open_edf(filename) is edf
+
+    # a frame added: the file is indexed again
+    with open(filename, "ab") as f:
+        f.write(_edf_block(frames[0])[-10:])
+    os.utime(filename, ns=(edf.mtime_ns + 10 ** 9, edf.mtime_ns + 10 ** 9))
+    data = edf.data(0)
+    del edf
+    edf = native.open_edf(filename)
+    assert len(edf) == 4
+    numpy.testing.assert_array_equal(edf.data(3), frames[0])
+    numpy.testing.assert_array_equal(data, frames[0])  # old mapping still valid
+
+
+def test_edf_reader_lz4(native, tmp_path):
+    image = numpy.tile(numpy.arange(16, dtype=numpy.uint8), 96).view(numpy.uint16)
+    image = image.reshape(16, 48)
+    raw = image.tobytes()
+    # LZ4 frame: a compressed block (16 literals, a 1000 bytes match,
+    # 8 literals), an empty uncompressed one (not an end mark) then an
+    # uncompressed one
+    block = bytes([0xFF, 1]) + raw[:16] + bytes([0x10, 0, 0xFF, 0xFF, 0xFF, 216])
+    block += bytes([0x80]) + raw[1016:1024]
+    lz4 = struct.pack("<IBBB", 0x184D2204, 0x40, 0x40, 0)
+    lz4 += struct.pack("<I", len(block)) + block
+    lz4 += struct.pack("<I", 0x80000000)
+    lz4 += struct.pack("<I", 0x80000000 | 512) + raw[1024:]
+    lz4 += struct.pack("<I", 0)
+    filename = str(tmp_path / "frames.edf.lz4")
+    header = _edf_block(image)[: -image.nbytes]
+    header = header.replace(b"{\n", b"{\nCompression = LZ4 ;")
+    with open(filename, "wb") as f:
+        for _ in range(2):
+            f.write(header + lz4)
+    edf = native.open_edf(filename)
+    assert len(edf) == 2
+    numpy.testing.assert_array_equal(edf.data(1), image)
+
+    with open(filename, "r+b") as f:  # match offset before the output
+        f.seek(len(header) + lz4.index(bytes([0x10, 0, 0xFF])))
+        f.write(b"\x20\x00")
+    edf = native.EdfReader(filename)
+    with pytest.raises(native.NativeError):
+        edf.data(0)
+
+
+def test_image_from_file_edf(native, tmp_path, monkeypatch):
+    monkeypatch.setattr(lima_image, "pixmaptools_core", native)
+    frames = [numpy.full((4, 5), i, numpy.uint16) for i in range(3)]
+    filename = str(tmp_path / "frames.edf")
+    with open(filename, "wb") as f:
+        for frame in frames:
+            f.write(_edf_block(frame))
+    data = lima_image.image_from_file(filename, "", 2, "EDF")
+    numpy.testing.assert_array_equal(data, frames[2])
+
+
+def test_frame_prefetcher(native, tmp_path):
+    rand = numpy.random.RandomState(5)
+    frames = [rand.randint(-1000, 1000, size=(32, 16)).astype(">i4") for _ in range(6)]
+    filename = str(tmp_path / "frames.edf")
+    with open(filename, "wb") as f:
+        for frame in frames:
+            f.write(_edf_block(frame))
+    frame_size = frames[0].nbytes
+
+    prefetcher = native.FramePrefetcher(nb_threads=2, memory_budget=3 * frame_size)
+    data = prefetcher.get(filename, 0)  # not prefetched: read here
+    assert data.dtype == numpy.int32 and data.dtype.isnative
+    assert not data.flags.writeable
+    numpy.testing.assert_array_equal(data, frames[0])
+    assert prefetcher.counters["misses"] == 1
+
+    assert prefetcher.prefetch(filename, 1)
+    assert not prefetcher.prefetch(filename, 1)  # already queued
+    assert prefetcher.prefetch(filename, 2)
+    numpy.testing.assert_array_equal(prefetcher.get(filename, 1), frames[1])
+    numpy.testing.assert_array_equal(prefetcher.get(filename, 2), frames[2])
+    counters = prefetcher.counters
+    assert counters["hits"] + counters["misses"] == 3
+    assert counters["memory_used"] <= 3 * frame_size
+
+    # frames taken are evicted for the read-ahead ones, not these
+    assert all(prefetcher.prefetch(filename, i) for i in (3, 4, 5))
+    assert not prefetcher.prefetch(filename, 0)
+    assert prefetcher.counters["refused"] == 1
+    assert prefetcher.cancel(filename, 5)
+    assert not prefetcher.cancel(filename, 5)
+    assert prefetcher.prefetch(filename, 0)
+    for i in (3, 4, 0):
+        numpy.testing.assert_array_equal(prefetcher.get(filename, i), frames[i])
+    numpy.testing.assert_array_equal(data, frames[0])  # evicted, still valid
+
+    assert not prefetcher.prefetch(filename, 6)
+    with pytest.raises(native.NativeError):
+        prefetcher.get(filename, 6)
+    with pytest.raises(native.NativeError):
+        prefetcher.get(str(tmp_path / "missing.edf"), 0)
+    prefetcher.clear()
+    assert prefetcher.counters["memory_used"] == 0
+
+
+def test_iter_images_from_file(native, tmp_path, monkeypatch):
+    monkeypatch.setattr(lima_image, "pixmaptools_core", native)
+    monkeypatch.setattr(lima_image, "_frame_prefetcher", None)
+    frames = [numpy.full((4, 5), i, numpy.uint16) for i in range(10)]
+    references = []
+    for n in range(2):
+        filename = str(tmp_path / f"frames_{n}.edf")
+        with open(filename, "wb") as f:
+            for frame in frames[n * 5 : (n + 1) * 5]:
+                f.write(_edf_block(frame))
+        references += [(filename, "", i, "EDF") for i in range(5)]
+
+    images = lima_image.iter_images_from_file(references, depth=3)
+    for image, frame in zip(images, frames):
+        numpy.testing.assert_array_equal(image, frame)
+    prefetcher = lima_image.frame_prefetcher()
+    counters = prefetcher.counters
+    assert counters["hits"] + counters["misses"] == 10
+
+    images = lima_image.iter_images_from_file(references[::-1], depth=4)
+    numpy.testing.assert_array_equal(next(images), frames[-1])
+    images.close()  # frames read ahead are dropped
+    assert all(not prefetcher.cancel(*ref[:1], ref[2]) for ref in references[:-1])
+    assert prefetcher.counters["errors"] == 0
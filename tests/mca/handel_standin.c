@@ -0,0 +1,94 @@
+/* -*- coding: utf-8 -*- */
+/*
+ * This file is part of the bliss project
+ *
+ * Copyright (c) 2015-2020 Beamline Control Unit, ESRF
+ * Distributed under the GNU LGPLv3. See LICENSE for more info.
+*/
+
+/* Stand-in for the handel library, the mapping buffer run data and board
+ * operations of a few channels whose state is set by standin_set().
+ * Built by tests/mca/test_handel_status.py.
+ */
+
+#include <string.h>
+
+#define NB_CHANNELS 8
+#define XIA_BAD_CHANNEL 314
+#define XIA_BAD_NAME 306
+
+struct channel
+{
+  unsigned long	pixel;
+  unsigned short full[2];
+  unsigned short overrun;
+  short		running;
+  int		error;		/* returned by every call when not 0 */
+};
+
+static struct channel channels[NB_CHANNELS];
+static int nb_calls;
+
+void standin_set(int channel,unsigned long pixel,int full_a,int full_b,
+		 int overrun,int running,int error)
+{
+  channels[channel].pixel = pixel;
+  channels[channel].full[0] = full_a;
+  channels[channel].full[1] = full_b;
+  channels[channel].overrun = overrun;
+  channels[channel].running = running ? 0x3 : 0x2;
+  channels[channel].error = error;
+}
+
+int standin_calls(void)
+{
+  int n = nb_calls;
+  nb_calls = 0;
+  return n;
+}
+
+static struct channel* get_channel(int detChan,int *code)
+{
+  ++nb_calls;
+  if(detChan < 0 || detChan >= NB_CHANNELS)
+    {
+      *code = XIA_BAD_CHANNEL;
+      return NULL;
+    }
+  *code = channels[detChan].error;
+  return *code ? NULL : &channels[detChan];
+}
+
+int xiaGetRunData(int detChan,char *name,void *value)
+{
+  int code;
+  struct channel *c = get_channel(detChan,&code);
+  if(!c)
+    return code;
+  if(!strcmp(name,"current_pixel"))
+    *(unsigned long*)value = c->pixel;
+  else if(!strcmp(name,"buffer_full_a"))
+    *(unsigned short*)value = c->full[0];
+  else if(!strcmp(name,"buffer_full_b"))
+    *(unsigned short*)value = c->full[1];
+  else if(!strcmp(name,"buffer_overrun"))
+    *(unsigned short*)value = c->overrun;
+  else if(!strcmp(name,"run_active"))
+    *(short*)value = c->running;
+  else
+    return XIA_BAD_NAME;
+  return 0;
+}
+
+int xiaBoardOperation(int detChan,char *name,void *value)
+{
+  int code;
+  char bid = *(char*)value;
+  struct channel *c = get_channel(detChan,&code);
+  if(!c)
+    return code;
+  if(strcmp(name,"buffer_done") || (bid != 'a' && bid != 'b'))
+    return XIA_BAD_NAME;
+  c->full[bid - 'a'] = 0;
+  return 0;
+}
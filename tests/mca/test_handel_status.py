@@ -0,0 +1,125 @@
+import os
+import sys
+from unittest import mock
+
+import cffi
+import pytest
+
+from bliss.controllers.mca.handel import _cffi, status
+from bliss.controllers.mca.handel.error import HandelError
+from ..conftest import native_library_context
+
+ROOT = os.path.join(os.path.dirname(__file__), "..", "..")
+
+
+@pytest.fixture(scope="module")
+def native(build_native_library, tmp_path_factory):
+    """status bound to the library built from handel_status.c, and a handel
+    stand-in loaded like handel.dll, with its controls"""
+    generated_dir = str(tmp_path_factory.mktemp("handel_status_codes"))
+    sys.path.insert(0, os.path.join(ROOT, "scripts", "handel"))
+    try:
+        import parse_error_header
+    finally:
+        del sys.path[0]
+    parse_error_header.write_c_header(
+        os.path.join(ROOT, "scripts", "handel", "handel_errors.h"),
+        os.path.join(generated_dir, "handel_status_codes.h"),
+    )
+    handel_dir = os.path.dirname(status.__file__)
+    library = build_native_library(
+        "handel_status",
+        [os.path.join(handel_dir, "handel_status.c")],
+        [handel_dir, generated_dir],
+    )
+    standin = build_native_library(
+        "handel_standin", [os.path.join(os.path.dirname(__file__), "handel_standin.c")]
+    )
+    controls_ffi = cffi.FFI()
+    controls_ffi.cdef(
+        """
+        void standin_set(int channel, unsigned long pixel, int full_a, int full_b,
+                         int overrun, int running, int error);
+        int standin_calls(void);
+        """
+    )
+    with native_library_context("HANDEL_STATUS_LIBRARY", library, status):
+        yield status, _cffi.ffi.dlopen(standin), controls_ffi.dlopen(standin)
+
+
+def test_not_available_on_mocks(native):
+    status, handel, _ = native
+    assert status.available(handel)
+    assert not status.available(mock.MagicMock())
+    assert not status.available(None)
+
+
+def test_error_table(native):
+    status, _, _ = native
+    assert str(status.error(404)) == "[HandelError 404] EOF: EOF encountered"
+    assert str(status.error(801)) == "[HandelError 801] UNIT_TEST"
+    # not in handel_errors.h, from the Python table
+    assert status.error(13009).strerror == "LOW_REFRESH_RATE"
+    assert str(status.error(802)) == "[HandelError 802] UNKNOWN_ERROR_CODE"
+
+
+def test_poll(native):
+    status, handel, controls = native
+    controls.standin_set(0, 12, 1, 0, 0, 1, 0)
+    controls.standin_set(4, 15, 1, 1, 0, 1, 0)
+    controls.standin_calls()
+    assert status.poll(handel, [0, 4]) == (15, {"a"}, False)
+    # pixels: 2, full a: 2, full b: first one decides, overrun: 2
+    assert controls.standin_calls() == 7
+    controls.standin_set(0, 12, 1, 1, 1, 1, 0)
+    assert status.poll(handel, [0, 4]) == (15, {"a", "b"}, True)
+    assert status.poll(handel, []) == (0, set(), False)
+
+    controls.standin_set(4, 15, 1, 1, 0, 1, 314)
+    with pytest.raises(HandelError) as context:
+        status.poll(handel, [0, 4])
+    assert context.value.errno == 314
+    assert context.value.strerror == "BAD_CHANNEL"
+
+
+def test_buffer_done(native):
+    status, handel, controls = native
+    controls.standin_set(0, 0, 1, 0, 0, 1, 0)
+    controls.standin_set(4, 0, 1, 0, 0, 1, 0)
+    assert status.buffer_done(handel, [0, 4], b"a") is False
+    assert status.poll(handel, [0, 4])[1] == set()
+    # the other buffer already full on a running channel
+    controls.standin_set(0, 0, 1, 1, 0, 1, 0)
+    assert status.buffer_done(handel, [0, 4], "a") is True
+    controls.standin_set(0, 0, 1, 1, 0, 0, 0)
+    assert status.buffer_done(handel, [0, 4], "a") is False
+
+    controls.standin_set(0, 0, 1, 0, 0, 1, 306)
+    with pytest.raises(HandelError) as context:
+        status.buffer_done(handel, [0, 4], "a")
+    assert context.value.errno == 306
+
+
+def test_synchronized_poll_data(native):
+    status, handel, controls = native
+    from bliss.controllers.mca.handel import interface
+
+    controls.standin_set(0, 20, 0, 1, 0, 1, 0)
+    controls.standin_set(4, 21, 0, 1, 0, 1, 0)
+    with mock.patch.multiple(
+        interface,
+        handel=handel,
+        get_master_channels=mock.DEFAULT,
+        get_all_buffer_data=mock.DEFAULT,
+    ) as ms:
+        ms["get_master_channels"].return_value = (0, 4)
+        ms["get_all_buffer_data"].return_value = "spectrums", "stats"
+        assert interface.synchronized_poll_data(
+            100, done=set(), pixel_seen_cache={"pixel": 0, "times": 0}
+        ) == (21, "spectrums", "stats")
+        ms["get_all_buffer_data"].assert_called_once_with("b")
+
+        controls.standin_set(4, 21, 0, 1, 1, 1, 0)
+        with pytest.raises(RuntimeError) as ctx:
+            interface.synchronized_poll_data(100, done=set())
+        assert "Buffer overrun (hwd)!" in str(ctx.value)